@@ -0,0 +1,90 @@
+/**
+ * @file
+ * @brief Benchmark of parallel differentiation and optimization of one large AST
+ *
+ * Generates an AST of the realistic mix, differentiates it and optimizes the derivative sequentially and then
+ * in parallel with 1, 2, 4, ... threads up to the number of hardware threads. Prints the best time of several runs
+ * and the speedup over the sequential functions:
+ *     parallel-bench [<nodes number>] [<cutoff>]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <malloc.h>
+#include <memory>
+#include <thread>
+#include "../src/ast-math.h"
+#include "../src/ast-optimizers.h"
+#include "../src/expression_generator.h"
+#include "../src/thread_pool.h"
+
+static const size_t DEFAULT_NODES_NUMBER = 1000000;
+static const int REPEATS = 3;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @return the best time of the runs in seconds. Preparation isn't measured.
+ */
+static double measure(const std::function<void()>& prepare, const std::function<void()>& run) {
+    double bestSeconds = 0.;
+    for (int i = 0; i < REPEATS; ++i) {
+        prepare();
+        // Freed nodes of the previous run are released, otherwise they are consolidated by the first large allocation
+        malloc_trim(0);
+        const Clock::time_point start = Clock::now();
+        run();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        bestSeconds = (i == 0) ? seconds : std::min(bestSeconds, seconds);
+    }
+    return bestSeconds;
+}
+
+/**
+ * @param threadsNumber number of threads or 0 for the sequential function
+ */
+static void printResult(const char* stage, size_t threadsNumber, double seconds, double sequentialSeconds) {
+    char mode[32] = "sequential";
+    if (threadsNumber != 0) {
+        snprintf(mode, sizeof(mode), "%zu threads", threadsNumber);
+    }
+    printf("%-14s %-12s %10.3lf ms   speedup %6.2lf\n", stage, mode, seconds * 1000., sequentialSeconds / seconds);
+}
+
+int main(int argc, char* argv[]) {
+    const size_t nodesNumber = (argc > 1) ? strtoul(argv[1], nullptr, 10) : DEFAULT_NODES_NUMBER;
+    const size_t cutoff = (argc > 2) ? strtoul(argv[2], nullptr, 10) : DEFAULT_PARALLEL_CUTOFF;
+    GeneratorOptions options = getPresetOptions(REALISTIC_MIX, nodesNumber);
+    options.maxDepth = UNLIMITED_DEPTH;
+    ExpressionGenerator generator(options);
+    const std::shared_ptr<ASTNode> root = generator.generateAST();
+    const FullOptimizer optimizer;
+    printf("AST of %zu nodes, cutoff %zu\n", nodesNumber, cutoff);
+
+    std::shared_ptr<ASTNode> derivative;
+    const double differentiateSeconds = measure([&derivative]() { derivative = nullptr; },
+                                                [&root, &derivative]() { derivative = differentiate(root, "x"); });
+    const double optimizeSeconds = measure([&root, &derivative]() { derivative = differentiate(root, "x"); },
+                                           [&optimizer, &derivative]() { derivative = optimizer.optimize(derivative); });
+    printResult("differentiate", 0, differentiateSeconds, differentiateSeconds);
+    printResult("optimize", 0, optimizeSeconds, optimizeSeconds);
+
+    const size_t hardwareThreadsNumber = std::max(std::thread::hardware_concurrency(), 1u);
+    for (size_t threadsNumber = 1; threadsNumber <= hardwareThreadsNumber; threadsNumber *= 2) {
+        ThreadPool pool(threadsNumber);
+        const double parallelDifferentiateSeconds = measure([&derivative]() { derivative = nullptr; },
+                [&root, &derivative, &pool, cutoff]() { derivative = differentiateInParallel(root, "x", pool, cutoff); });
+        // Derivative is optimized as prepared, including the shared divisors
+        const double parallelOptimizeSeconds = measure(
+                [&root, &derivative, &pool, cutoff]() { derivative = differentiateInParallel(root, "x", pool, cutoff); },
+                [&optimizer, &derivative, &pool, cutoff]() { derivative = optimizeInParallel(optimizer, derivative, pool, cutoff); });
+        printResult("differentiate", threadsNumber, parallelDifferentiateSeconds, differentiateSeconds);
+        printResult("optimize", threadsNumber, parallelOptimizeSeconds, optimizeSeconds);
+        if ((threadsNumber < hardwareThreadsNumber) && (threadsNumber * 2 > hardwareThreadsNumber)) {
+            threadsNumber = hardwareThreadsNumber / 2; // Last run uses all hardware threads
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file
+ * @brief Benchmark of the parser core against the legacy parsers
+ *
+ * Every parser parses the same corpus of generated expressions. Corpus uses only the grammar that all the parsers
+ * support: integer constants, variables of letters, binary operators and parentheses.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/ast.h"
+#include "../src/recursive_parser.h"
+#include "../src/tokenizer.h"
+
+static constexpr unsigned int CORPUS_SEED = 42u;
+static constexpr int REPEATS = 5;
+
+using ParserFunction = std::function<std::shared_ptr<ASTNode>(const std::string&)>;
+
+static void generateExpression(std::mt19937& random, int depth, std::string& expression) {
+    static const char* const variables[] = { "x", "y", "z", "alpha", "beta" };
+    static const char operators[] = { '+', '-', '*', '/', '^' };
+
+    if (depth == 0 || random() % 4 == 0) {
+        if (random() % 2 == 0) {
+            expression += std::to_string(random() % 1000);
+        } else {
+            expression += variables[random() % (sizeof(variables) / sizeof(variables[0]))];
+        }
+        return;
+    }
+
+    const bool parenthesised = random() % 3 == 0;
+    if (parenthesised) expression += '(';
+    generateExpression(random, depth - 1, expression);
+    expression += ' ';
+    expression += operators[random() % sizeof(operators)];
+    expression += ' ';
+    generateExpression(random, depth - 1, expression);
+    if (parenthesised) expression += ')';
+}
+
+static std::vector<std::string> generateCorpus(size_t expressionsNumber, int depth) {
+    std::mt19937 random(CORPUS_SEED);
+    std::vector<std::string> corpus(expressionsNumber);
+    for (std::string& expression : corpus) {
+        generateExpression(random, depth, expression);
+    }
+    return corpus;
+}
+
+static void runBenchmark(const char* name, const ParserFunction& parser, const std::vector<std::string>& corpus) {
+    size_t corpusBytes = 0;
+    for (const std::string& expression : corpus) {
+        corpusBytes += expression.size();
+    }
+
+    double bestSeconds = 0;
+    for (int repeat = 0; repeat < REPEATS; ++repeat) {
+        const auto start = std::chrono::steady_clock::now();
+        for (const std::string& expression : corpus) {
+            parser(expression);
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (repeat == 0 || seconds < bestSeconds) {
+            bestSeconds = seconds;
+        }
+    }
+
+    printf("%-28s %12.0f expr/s %10.2f MB/s %10.2f ns/byte\n", name,
+           corpus.size() / bestSeconds, corpusBytes / bestSeconds / 1e6, bestSeconds * 1e9 / corpusBytes);
+}
+
+int main(int argc, char* argv[]) {
+    const size_t expressionsNumber = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 2000;
+    const int depths[] = { 3, 8, 12 };
+
+    for (int depth : depths) {
+        const std::vector<std::string> corpus = generateCorpus(expressionsNumber, depth);
+        printf("Corpus: %zu expressions, depth %d\n", corpus.size(), depth);
+
+        runBenchmark("parser core (buildAST)", [](const std::string& expression) {
+            return buildAST(const_cast<char*>(expression.c_str()));
+        }, corpus);
+        runBenchmark("legacy tokenizer + yard", [](const std::string& expression) {
+            return buildAST(tokenize(const_cast<char*>(expression.c_str())));
+        }, corpus);
+        runBenchmark("legacy recursive descent", [](const std::string& expression) {
+            return buildASTByRecursiveDescent(expression.c_str());
+        }, corpus);
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Benchmark of bulk evaluation through the shared-memory ring against the socket server
+ *
+ * Both paths evaluate the same expression for the same rows. Socket path sends one pipelined EVAL request per row
+ * to the expression server, ring path passes columns through the shared-memory ring to the evaluator.
+ * Server and evaluator run in threads of this process, but communicate only through the socket and the ring.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../src/expression_client.h"
+#include "../src/expression_server.h"
+#include "../src/shm_ring.h"
+
+static const char* const EXPRESSION = "sin(x) * x ^ 2 + ln(y) / 3";
+static const size_t SOCKET_ROWS_NUMBER = 200000;
+static const size_t RING_ROWS_NUMBER = 10000000;
+/** Number of requests sent before their responses are read **/
+static const size_t PIPELINE_DEPTH = 64;
+
+using Clock = std::chrono::steady_clock;
+
+static void generateColumns(size_t rowsNumber, std::vector<double>& x, std::vector<double>& y) {
+    x.resize(rowsNumber);
+    y.resize(rowsNumber);
+    for (size_t i = 0; i < rowsNumber; ++i) {
+        x[i] = 0.001 * (double)i;
+        y[i] = 1. + 0.5 * (double)(i % 1000);
+    }
+}
+
+static void printResult(const char* name, size_t rowsNumber, double seconds, double checksum) {
+    printf("%-8s %10zu rows %8.3lf s %14.0lf rows/s %10.1lf ns/row   (checksum %.6e)\n",
+           name, rowsNumber, seconds, (double)rowsNumber / seconds, seconds * 1e9 / (double)rowsNumber, checksum);
+}
+
+static void runSocketBenchmark() {
+    const std::string socketPath = "/tmp/ast-builder-bench-" + std::to_string(getpid()) + ".sock";
+    ExpressionServer server(socketPath.c_str());
+    std::thread serverThread(&ExpressionServer::run, &server);
+
+    std::vector<double> x;
+    std::vector<double> y;
+    generateColumns(SOCKET_ROWS_NUMBER, x, y);
+
+    {
+        ExpressionClient client(socketPath.c_str());
+        const std::string handle = client.request(std::string("PARSE ") + EXPRESSION).substr(3);
+        char request[128];
+        double checksum = 0;
+
+        const Clock::time_point start = Clock::now();
+        size_t sentRows = 0;
+        for (size_t receivedRows = 0; receivedRows < SOCKET_ROWS_NUMBER; ++receivedRows) {
+            while ((sentRows < SOCKET_ROWS_NUMBER) && (sentRows - receivedRows < PIPELINE_DEPTH)) {
+                snprintf(request, sizeof(request), "EVAL %s x=%.17g,y=%.17g", handle.c_str(), x[sentRows], y[sentRows]);
+                client.send(request);
+                ++sentRows;
+            }
+            checksum += strtod(client.receive().c_str() + 3, nullptr);
+        }
+        printResult("socket", SOCKET_ROWS_NUMBER, std::chrono::duration<double>(Clock::now() - start).count(), checksum);
+    }
+
+    server.stop();
+    serverThread.join();
+}
+
+static void runRingBenchmark() {
+    const std::string name = "/ast-builder-bench-" + std::to_string(getpid());
+    ShmRingProducer producer(name.c_str(), EXPRESSION, { "x", "y" });
+    ShmRingEvaluator evaluator(name.c_str());
+    std::thread evaluatorThread(&ShmRingEvaluator::run, &evaluator);
+
+    std::vector<double> x;
+    std::vector<double> y;
+    generateColumns(RING_ROWS_NUMBER, x, y);
+    const double* columns[] = { x.data(), y.data() };
+    std::vector<double> results(RING_ROWS_NUMBER);
+
+    const Clock::time_point start = Clock::now();
+    producer.evaluate(columns, RING_ROWS_NUMBER, results.data());
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double checksum = 0;
+    for (size_t i = 0; i < RING_ROWS_NUMBER; ++i) {
+        checksum += results[i];
+    }
+    printResult("ring", RING_ROWS_NUMBER, seconds, checksum);
+
+    producer.close();
+    evaluatorThread.join();
+}
+
+int main() {
+    printf("Expression: %s\n", EXPRESSION);
+    runSocketBenchmark();
+    runRingBenchmark();
+    return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file
+ * @brief Benchmark of every stage of expression processing
+ *
+ * Every stage (tokenizing, parsing, each optimizer, differentiation, calculation and writers) processes corpora
+ * of generated expressions of increasing depth. For every stage and depth it reports time and heap allocations
+ * per AST node, latency percentiles of one expression and peak RSS of the process.
+ *
+ * Output is JSON with one result per line in fixed order and format, so runs can be compared with diff:
+ *
+ *     ./bench > before.json
+ *     ./bench > after.json
+ *     diff before.json after.json
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+#include "../src/allocation_tracker.h"
+#include "../src/ast.h"
+#include "../src/ast-math.h"
+#include "../src/ast-optimizers.h"
+#include "../src/expression_generator.h"
+#include "../src/iterative_parser.h"
+#include "../src/output_buffer.h"
+#include "../src/recursive_parser.h"
+#include "../src/tex_writer.h"
+#include "../src/tokenizer.h"
+
+static constexpr unsigned int CORPUS_SEED = DEFAULT_GENERATOR_SEED;
+static constexpr int REPEATS = 5;
+static constexpr size_t DEFAULT_CORPUS_NODES = 200000;
+
+struct Corpus {
+    int depth;
+    /** Expressions with variables **/
+    std::vector<std::string> expressions;
+    /** Expressions of the same size and depth without variables, so they can be calculated **/
+    std::vector<std::string> numericExpressions;
+};
+
+static size_t countNodes(const std::shared_ptr<ASTNode>& root);
+
+/**
+ * Generates expressions of the realistic mix (see getPresetOptions) with the given depth limit until they have
+ * the given number of nodes in total. Exponents are constants, so every expression can be differentiated.
+ */
+static Corpus generateCorpus(int depth, size_t nodesNumber) {
+    GeneratorOptions options = getPresetOptions(REALISTIC_MIX, (size_t)1 << (depth / 2 + 2));
+    options.maxDepth = depth;
+    ExpressionGenerator generator(options, CORPUS_SEED + depth);
+    options.variablesNumber = 0;
+    ExpressionGenerator numericGenerator(options, CORPUS_SEED + depth);
+
+    Corpus corpus;
+    corpus.depth = depth;
+    size_t corpusNodesNumber = 0;
+    while (corpusNodesNumber < nodesNumber) {
+        const auto root = generator.generateAST();
+        corpusNodesNumber += countNodes(root);
+        corpus.expressions.push_back(root->toInfix());
+        corpus.numericExpressions.push_back(numericGenerator.generateExpression());
+    }
+    return corpus;
+}
+
+static size_t getPeakRSSKilobytes() {
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return (size_t)usage.ru_maxrss;
+}
+
+/**
+ * Runs the stage for every expression of the corpus. Preparation (e.g. copying of the AST that is changed in place)
+ * isn't measured. Time is the best of the repeats, allocations are counted in the first repeat.
+ * @param prepare   prepares the input for the expression with the given index
+ * @param run       runs the stage for the expression with the given index
+ */
+static void runStage(const char* stage, const Corpus& corpus, size_t nodesNumber,
+                     const std::function<void(size_t)>& prepare, const std::function<void(size_t)>& run,
+                     bool& firstResult) {
+    const size_t expressionsNumber = corpus.expressions.size();
+    std::vector<double> latencies(expressionsNumber);
+    std::vector<double> bestLatencies;
+    double bestSeconds = 0;
+    size_t allocations = 0;
+    for (int repeat = 0; repeat < REPEATS; ++repeat) {
+        double seconds = 0;
+        size_t repeatAllocations = 0;
+        for (size_t i = 0; i < expressionsNumber; ++i) {
+            if (prepare) prepare(i);
+            const size_t allocationsBefore = getTotalAllocationStatistics().allocationsNumber;
+            const auto start = std::chrono::steady_clock::now();
+            run(i);
+            latencies[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            repeatAllocations += getTotalAllocationStatistics().allocationsNumber - allocationsBefore;
+            seconds += latencies[i];
+        }
+        if (repeat == 0) {
+            allocations = repeatAllocations;
+        }
+        if ((repeat == 0) || (seconds < bestSeconds)) {
+            bestSeconds = seconds;
+            bestLatencies = latencies;
+        }
+    }
+
+    std::sort(bestLatencies.begin(), bestLatencies.end());
+    const double p50 = bestLatencies[bestLatencies.size() / 2];
+    const double p99 = bestLatencies[std::min(bestLatencies.size() - 1, bestLatencies.size() * 99 / 100)];
+    printf("%s{\"stage\":\"%s\",\"depth\":%d,\"expressions\":%zu,\"nodes\":%zu,\"ns_per_node\":%.2f,"
+           "\"latency_p50_ns\":%.0f,\"latency_p99_ns\":%.0f,\"allocations_per_node\":%.3f,\"peak_rss_kb\":%zu}",
+           firstResult ? "\n" : ",\n", stage, corpus.depth, expressionsNumber, nodesNumber,
+           bestSeconds * 1e9 / (double)nodesNumber, p50 * 1e9, p99 * 1e9, (double)allocations / (double)nodesNumber,
+           getPeakRSSKilobytes());
+    fflush(stdout);
+    firstResult = false;
+}
+
+static size_t countNodes(const std::shared_ptr<ASTNode>& root) {
+    size_t nodesNumber = 0;
+    std::vector<const ASTNode*> nodes(1, root.get());
+    while (!nodes.empty()) {
+        const ASTNode* node = nodes.back();
+        nodes.pop_back();
+        ++nodesNumber;
+        for (size_t i = 0; i < node->getChildrenNumber(); ++i) {
+            nodes.push_back(node->getChildren()[i].get());
+        }
+    }
+    return nodesNumber;
+}
+
+static void benchmarkCorpus(const Corpus& corpus, bool& firstResult) {
+    const size_t expressionsNumber = corpus.expressions.size();
+    std::vector<std::shared_ptr<ASTNode> > roots(expressionsNumber);
+    std::vector<std::shared_ptr<ASTNode> > numericRoots(expressionsNumber);
+    size_t nodesNumber = 0;
+    size_t numericNodesNumber = 0;
+    for (size_t i = 0; i < expressionsNumber; ++i) {
+        roots[i] = buildASTIteratively(corpus.expressions[i].c_str());
+        numericRoots[i] = buildASTIteratively(corpus.numericExpressions[i].c_str());
+        nodesNumber += countNodes(roots[i]);
+        numericNodesNumber += countNodes(numericRoots[i]);
+    }
+    // Results are kept until the next run, so releasing them isn't measured
+    std::vector<std::shared_ptr<ASTNode> > results(expressionsNumber);
+    const std::function<void(size_t)> noPreparation;
+
+    runStage("tokenize", corpus, nodesNumber, noPreparation, [&](size_t i) {
+        tokenize(const_cast<char*>(corpus.expressions[i].c_str()));
+    }, firstResult);
+    runStage("buildAST", corpus, nodesNumber, [&](size_t i) { results[i] = nullptr; }, [&](size_t i) {
+        results[i] = buildAST(const_cast<char*>(corpus.expressions[i].c_str()));
+    }, firstResult);
+    runStage("buildASTRecursively", corpus, nodesNumber, [&](size_t i) { results[i] = nullptr; }, [&](size_t i) {
+        results[i] = buildASTRecursively(corpus.expressions[i].c_str());
+    }, firstResult);
+
+    const std::pair<const char*, std::shared_ptr<Optimizer> > optimizers[] = {
+        { "UnaryAdditionOptimizer", std::make_shared<UnaryAdditionOptimizer>() },
+        { "ArithmeticNegationOptimizer", std::make_shared<ArithmeticNegationOptimizer>() },
+        { "TrivialAdditionOptimizer", std::make_shared<TrivialAdditionOptimizer>() },
+        { "TrivialMultiplicationOptimizer", std::make_shared<TrivialMultiplicationOptimizer>() },
+        { "ConstantCompressor", std::make_shared<ConstantCompressor>() },
+        { "TrivialOperationsOptimizer", std::make_shared<TrivialOperationsOptimizer>() },
+        { "FullOptimizer", std::make_shared<FullOptimizer>() },
+    };
+    for (const auto& optimizer : optimizers) {
+        // Optimizers change the AST in place, so every run gets a fresh copy
+        runStage(optimizer.first, corpus, nodesNumber, [&](size_t i) { results[i] = copyAST(roots[i]); }, [&](size_t i) {
+            results[i] = optimizer.second->optimize(results[i]);
+        }, firstResult);
+    }
+
+    runStage("differentiate", corpus, nodesNumber, [&](size_t i) { results[i] = nullptr; }, [&](size_t i) {
+        results[i] = differentiate(roots[i], "x");
+    }, firstResult);
+    volatile double sum = 0;
+    runStage("calculate", corpus, numericNodesNumber, noPreparation, [&](size_t i) {
+        sum = sum + numericRoots[i]->calculate();
+    }, firstResult);
+
+    OutputBuffer buffer;
+    runStage("texPrint", corpus, nodesNumber, [&](size_t) { buffer.release(); }, [&](size_t i) {
+        texPrint(*roots[i], buffer);
+    }, firstResult);
+    FILE* nullFile = fopen("/dev/null", "w");
+    runStage("dotPrint", corpus, nodesNumber, noPreparation, [&](size_t i) {
+        roots[i]->dotPrint(nullFile);
+    }, firstResult);
+    fclose(nullFile);
+}
+
+int main(int argc, char* argv[]) {
+    const size_t corpusNodesNumber = (argc > 1) ? strtoul(argv[1], nullptr, 10) : DEFAULT_CORPUS_NODES;
+    const int depths[] = { 4, 8, 12, 16 };
+
+    setAllocationTracking(true);
+    printf("{\"corpus_nodes\":%zu,\"repeats\":%d,\"results\":[", corpusNodesNumber, REPEATS);
+    bool firstResult = true;
+    for (int depth : depths) {
+        benchmarkCorpus(generateCorpus(depth, corpusNodesNumber), firstResult);
+    }
+    printf("\n]}\n");
+    return 0;
+}
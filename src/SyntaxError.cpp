@@ -6,11 +6,11 @@
 #include <cstring>
 #include "SyntaxError.h"
 
-SyntaxError::SyntaxError(int position_, const char* cause_) {
+SyntaxError::SyntaxError(size_t position_, const char* cause_) {
     position = position_;
-    size_t messageLen = strlen(cause_) + 4 + MAX_INT_LENGTH;
+    size_t messageLen = strlen(cause_) + 4 + MAX_POSITION_LENGTH;
     message = (char*)calloc(messageLen + 1, sizeof(char));
-    snprintf(message, messageLen, "%s at %d", cause_, position_);
+    snprintf(message, messageLen, "%s at %zu", cause_, position_);
 }
 
 SyntaxError::~SyntaxError() {
@@ -21,6 +21,6 @@ const char* SyntaxError::what() const noexcept {
     return message;
 }
 
-int SyntaxError::at() const noexcept {
+size_t SyntaxError::at() const noexcept {
     return position;
 }
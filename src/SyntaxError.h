@@ -4,24 +4,25 @@
 #ifndef AST_BUILDER_SYNTAXERROR_H
 #define AST_BUILDER_SYNTAXERROR_H
 
+#include <cstddef>
 #include <exception>
 
 class SyntaxError : public std::exception {
 private:
-    static constexpr int MAX_INT_LENGTH = 10;
+    static constexpr int MAX_POSITION_LENGTH = 20;
 
 protected:
-    int position;
+    size_t position;
     char* message;
 
 public:
-    SyntaxError(int position_, const char* cause_);
+    SyntaxError(size_t position_, const char* cause_);
 
     ~SyntaxError() override;
 
     const char* what() const noexcept override;
 
-    int at() const noexcept;
+    size_t at() const noexcept;
 };
 
 #endif // AST_BUILDER_SYNTAXERROR_H
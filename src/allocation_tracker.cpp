@@ -0,0 +1,205 @@
+/**
+ * @file
+ * @brief Implementation of heap allocation tracker
+ *
+ * Hooks forward to the allocator of glibc through it's __libc_* entry points, so they don't call themselves.
+ * Operator new and delete go through the hooked malloc and free, so every heap block is counted exactly once.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#include "allocation_tracker.h"
+
+extern "C" {
+void* __libc_malloc(size_t size) noexcept;
+void* __libc_calloc(size_t number, size_t size) noexcept;
+void* __libc_realloc(void* pointer, size_t size) noexcept;
+void __libc_free(void* pointer) noexcept;
+}
+
+struct StageCounters {
+    std::atomic<size_t> allocationsNumber;
+    std::atomic<size_t> deallocationsNumber;
+    std::atomic<size_t> allocatedBytes;
+    std::atomic<int64_t> liveBytes;
+    std::atomic<int64_t> peakLiveBytes;
+};
+
+// Counters have static storage and trivial constructors, so they are zero before any constructor calls malloc
+static StageCounters stageCounters[ALLOCATION_STAGES_NUMBER];
+static StageCounters totalCounters;
+static std::atomic<bool> trackingEnabled(false);
+static thread_local AllocationStage currentStage = OTHER_STAGE;
+
+static inline void addLiveBytes(StageCounters& counters, int64_t bytes) {
+    const int64_t liveBytes = counters.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peakLiveBytes = counters.peakLiveBytes.load(std::memory_order_relaxed);
+    while ((liveBytes > peakLiveBytes) &&
+           !counters.peakLiveBytes.compare_exchange_weak(peakLiveBytes, liveBytes, std::memory_order_relaxed)) { }
+}
+
+static inline void recordAllocation(void* pointer) {
+    if ((pointer == nullptr) || !trackingEnabled.load(std::memory_order_relaxed)) return;
+
+    const size_t bytes = malloc_usable_size(pointer);
+    for (StageCounters* counters : { &stageCounters[currentStage], &totalCounters }) {
+        counters->allocationsNumber.fetch_add(1, std::memory_order_relaxed);
+        counters->allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        addLiveBytes(*counters, (int64_t)bytes);
+    }
+}
+
+static inline void recordDeallocation(size_t bytes) {
+    for (StageCounters* counters : { &stageCounters[currentStage], &totalCounters }) {
+        counters->deallocationsNumber.fetch_add(1, std::memory_order_relaxed);
+        addLiveBytes(*counters, -(int64_t)bytes);
+    }
+}
+
+extern "C" void* malloc(size_t size) noexcept {
+    void* pointer = __libc_malloc(size);
+    recordAllocation(pointer);
+    return pointer;
+}
+
+extern "C" void* calloc(size_t number, size_t size) noexcept {
+    void* pointer = __libc_calloc(number, size);
+    recordAllocation(pointer);
+    return pointer;
+}
+
+extern "C" void* realloc(void* pointer, size_t size) noexcept {
+    const bool tracked = (pointer != nullptr) && trackingEnabled.load(std::memory_order_relaxed);
+    const size_t oldBytes = tracked ? malloc_usable_size(pointer) : 0;
+    void* newPointer = __libc_realloc(pointer, size);
+    // Old block is kept if realloc fails
+    if (tracked && ((newPointer != nullptr) || (size == 0))) {
+        recordDeallocation(oldBytes);
+    }
+    recordAllocation(newPointer);
+    return newPointer;
+}
+
+extern "C" void free(void* pointer) noexcept {
+    if ((pointer != nullptr) && trackingEnabled.load(std::memory_order_relaxed)) {
+        recordDeallocation(malloc_usable_size(pointer));
+    }
+    __libc_free(pointer);
+}
+
+void* operator new(size_t size) {
+    while (true) {
+        void* pointer = malloc(size != 0 ? size : 1);
+        if (pointer != nullptr) {
+            return pointer;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    free(pointer);
+}
+
+void setAllocationTracking(bool enabled) {
+    trackingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isAllocationTrackingEnabled() {
+    return trackingEnabled.load(std::memory_order_relaxed);
+}
+
+static void resetCounters(StageCounters& counters) {
+    counters.allocationsNumber.store(0, std::memory_order_relaxed);
+    counters.deallocationsNumber.store(0, std::memory_order_relaxed);
+    counters.allocatedBytes.store(0, std::memory_order_relaxed);
+    counters.liveBytes.store(0, std::memory_order_relaxed);
+    counters.peakLiveBytes.store(0, std::memory_order_relaxed);
+}
+
+void resetAllocationStatistics() {
+    for (StageCounters& counters : stageCounters) {
+        resetCounters(counters);
+    }
+    resetCounters(totalCounters);
+}
+
+static AllocationStatistics getStatistics(const StageCounters& counters) {
+    AllocationStatistics statistics;
+    statistics.allocationsNumber = counters.allocationsNumber.load(std::memory_order_relaxed);
+    statistics.deallocationsNumber = counters.deallocationsNumber.load(std::memory_order_relaxed);
+    statistics.allocatedBytes = counters.allocatedBytes.load(std::memory_order_relaxed);
+    statistics.peakLiveBytes = (size_t)std::max<int64_t>(counters.peakLiveBytes.load(std::memory_order_relaxed), 0);
+    return statistics;
+}
+
+AllocationStatistics getAllocationStatistics(AllocationStage stage) {
+    return getStatistics(stageCounters[stage]);
+}
+
+AllocationStatistics getTotalAllocationStatistics() {
+    return getStatistics(totalCounters);
+}
+
+void printAllocationStatistics(FILE* file) {
+    fprintf(file, "%-16s %14s %14s %16s %16s\n", "stage", "allocations", "deallocations", "bytes", "peak live bytes");
+    for (int stage = 0; stage <= ALLOCATION_STAGES_NUMBER; ++stage) {
+        const bool total = stage == ALLOCATION_STAGES_NUMBER;
+        const AllocationStatistics statistics = total ? getTotalAllocationStatistics()
+                                                      : getAllocationStatistics((AllocationStage)stage);
+        fprintf(file, "%-16s %14zu %14zu %16zu %16zu\n", total ? "total" : AllocationStageNames[stage],
+                statistics.allocationsNumber, statistics.deallocationsNumber, statistics.allocatedBytes,
+                statistics.peakLiveBytes);
+    }
+}
+
+AllocationScope::AllocationScope(AllocationStage stage) : previousStage(currentStage) {
+    currentStage = stage;
+}
+
+AllocationScope::~AllocationScope() {
+    currentStage = previousStage;
+}
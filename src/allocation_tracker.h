@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @brief Definition of heap allocation tracker
+ *
+ * Tracker replaces global operator new and delete and malloc, calloc, realloc and free of the C library. Tracking
+ * is off by default: then the hooks only forward to the C library. When it's on, every allocation and deallocation
+ * is counted in the stage of the calling thread (see AllocationScope), so allocations of parsing, optimizing,
+ * differentiating and rendering can be measured separately.
+ *
+ * Bytes are sizes of heap blocks (malloc_usable_size), so they include rounding of the allocator.
+ * Memory is attributed to the stage of the thread that allocates or frees it, e.g. nodes replaced by optimizer
+ * are freed in the optimize stage, though they were allocated while parsing.
+ */
+#ifndef AST_BUILDER_ALLOCATION_TRACKER_H
+#define AST_BUILDER_ALLOCATION_TRACKER_H
+
+#include <cstddef>
+#include <cstdio>
+
+enum AllocationStage {
+    OTHER_STAGE,
+    PARSE_STAGE,
+    OPTIMIZE_STAGE,
+    DIFFERENTIATE_STAGE,
+    RENDER_STAGE,
+    ALLOCATION_STAGES_NUMBER,
+};
+
+static const char* const AllocationStageNames[] = {
+    "other",
+    "parse",
+    "optimize",
+    "differentiate",
+    "render",
+};
+
+struct AllocationStatistics {
+    size_t allocationsNumber = 0;
+    size_t deallocationsNumber = 0;
+    size_t allocatedBytes = 0;
+    /** Maximum of allocated minus freed bytes since the reset **/
+    size_t peakLiveBytes = 0;
+};
+
+/**
+ * Turns tracking on or off. Statistics are kept when tracking is off.
+ */
+void setAllocationTracking(bool enabled);
+
+bool isAllocationTrackingEnabled();
+
+/**
+ * Clears statistics of all the stages. Memory that is allocated before the reset and freed after it
+ * decreases live bytes, but peaks are never less than 0.
+ */
+void resetAllocationStatistics();
+
+AllocationStatistics getAllocationStatistics(AllocationStage stage);
+
+/**
+ * @return statistics of all the stages together. Peak is the peak of the whole process, not a sum of the stages' peaks.
+ */
+AllocationStatistics getTotalAllocationStatistics();
+
+/**
+ * Prints a table with statistics of every stage and the total.
+ */
+void printAllocationStatistics(FILE* file);
+
+/**
+ * Sets the stage of the calling thread until the scope ends, then restores the previous one.
+ */
+class AllocationScope {
+
+private:
+    const AllocationStage previousStage;
+
+public:
+    explicit AllocationScope(AllocationStage stage);
+
+    AllocationScope(const AllocationScope& scope) = delete;
+    AllocationScope& operator=(const AllocationScope& scope) = delete;
+
+    ~AllocationScope();
+};
+
+#endif // AST_BUILDER_ALLOCATION_TRACKER_H
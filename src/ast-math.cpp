@@ -2,100 +2,81 @@
  * @file
  * @brief Implementation of mathematical functions for AST
  */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "ast.h"
 #include "ast-math.h"
+#include "ast_metrics.h"
+#include "thread_pool.h"
 #include "tokenizer.h"
+#include "tracing.h"
 
-static inline std::shared_ptr<ASTNode> copy(const std::shared_ptr<ASTNode>& root) {
-    const TokenType rootTokenType = root->getToken()->getType();
-    if (rootTokenType == CONSTANT_VALUE) {
-        return std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(dynamic_cast<ConstantValueToken*>(root->getToken().get())->getValue()));
-    } else if (rootTokenType == VARIABLE) {
-        return std::make_shared<ASTNode>(VariableToken::getVariableByName(dynamic_cast<VariableToken*>(root->getToken().get())->getName()));
-    } else if (rootTokenType == OPERATOR) {
-        const auto operatorToken = dynamic_cast<OperatorToken*>(root->getToken().get());
-        const OperatorType operatorType = operatorToken->getOperatorType();
-        if (operatorToken->getArity() == 1) {
-            std::shared_ptr<ASTNode> child = copy(root->getChildren()[0]);
-            switch (operatorType) {
-                case ARITHMETIC_NEGATION:
-                    return std::make_shared<ASTNode>(std::make_shared<ArithmeticNegationOperator>(), child);
-                case UNARY_ADDITION:
-                    return std::make_shared<ASTNode>(std::make_shared<UnaryAdditionOperator>(), child);
-                default:
-                    throw std::logic_error("Unsupported unary operator type");
-            }
-        } else if (operatorToken->getArity() == 2) {
-            const auto leftChild  = copy(root->getChildren()[0]);
-            const auto rightChild = copy(root->getChildren()[1]);
-            switch (operatorType) {
-                case ADDITION:
-                    return std::make_shared<ASTNode>(std::make_shared<AdditionOperator>(), leftChild, rightChild);
-                case SUBTRACTION:
-                    return std::make_shared<ASTNode>(std::make_shared<SubtractionOperator>(), leftChild, rightChild);
-                case MULTIPLICATION:
-                    return std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), leftChild, rightChild);
-                case DIVISION:
-                    return std::make_shared<ASTNode>(std::make_shared<DivisionOperator>(), leftChild, rightChild);
-                case POWER:
-                    return std::make_shared<ASTNode>(std::make_shared<PowerOperator>(), leftChild, rightChild);
-                default:
-                    throw std::logic_error("Unsupported binary operator type");
-            }
-        } else {
-            throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
-        }
-    } else if (rootTokenType == FUNCTION) {
-        const auto functionToken = dynamic_cast<FunctionToken*>(root->getToken().get());
-        const FunctionType functionType = functionToken->getFunctionType();
-        if (functionToken->getArity() == 1) {
-            std::shared_ptr<ASTNode> child = copy(root->getChildren()[0]);
-            switch (functionType) {
-                case SIN:
-                    return std::make_shared<ASTNode>(std::make_shared<SinFunction>(), child);
-                case COS:
-                    return std::make_shared<ASTNode>(std::make_shared<CosFunction>(), child);
-                case TG:
-                    return std::make_shared<ASTNode>(std::make_shared<TgFunction>(), child);
-                case CTG:
-                    return std::make_shared<ASTNode>(std::make_shared<CtgFunction>(), child);
-                case LN:
-                    return std::make_shared<ASTNode>(std::make_shared<LnFunction>(), child);
-                default:
-                    throw std::logic_error("Unsupported unary function type");
-            }
-        } else {
-            throw std::logic_error("Unsupported arity of function. Only unary are supported yet");
-        }
-    } else {
-        throw std::logic_error("Unsupported token type");
+/**
+ * Derivatives and copies of the children that the derivative of the node is built from.
+ */
+struct ChildrenDerivatives {
+    std::shared_ptr<ASTNode> derivatives[2];
+    /** Copies aren't made for the operators whose derivatives don't contain the operands (e.g. addition) **/
+    std::shared_ptr<ASTNode> copies[2];
+};
+
+/**
+ * @return whether the derivative of the node contains copies of it's children.
+ */
+static inline bool needsChildrenCopies(const Token* token) {
+    if (token->getType() != OPERATOR) {
+        return true;
     }
+    const auto operatorToken = dynamic_cast<const OperatorToken*>(token);
+    const OperatorType operatorType = operatorToken->getOperatorType();
+    return (operatorToken->getArity() != 1) && (operatorType != ADDITION) && (operatorType != SUBTRACTION);
 }
 
-std::shared_ptr<ASTNode> differentiate(const std::shared_ptr<ASTNode>& root, const char* differentiatedVariableName) {
+/**
+ * @return derivative of the variable that isn't differentiated: y' = y'.
+ * @throws std::invalid_argument if the name of the derivative is too long.
+ */
+static std::shared_ptr<ASTNode> differentiateOtherVariable(const VariableToken* variableToken) {
+    const char* variableName = variableToken->getName();
+    std::string derivativeName = std::string(variableName) + '\'';
+    if (derivativeName.size() >= VariableToken::MAX_NAME_LENGTH) {
+        throw std::invalid_argument("Name of variable '" + std::string(variableName) + "' is too long to be differentiated");
+    }
+    return std::make_shared<ASTNode>(VariableToken::getVariableByName(&derivativeName[0]));
+}
+
+static std::shared_ptr<ASTNode> differentiateLeaf(const std::shared_ptr<ASTNode>& root, const char* differentiatedVariableName) {
     const TokenType rootTokenType = root->getToken()->getType();
     if (rootTokenType == CONSTANT_VALUE) { // C' = 0
         return std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(0));
     } else if (rootTokenType == VARIABLE) { // x' = 1, y' = y'
         const auto variableToken = dynamic_cast<VariableToken*>(root->getToken().get());
-        const char* variableName = variableToken->getName();
-        if (strcmp(variableName, differentiatedVariableName) == 0) {
+        if (strcmp(variableToken->getName(), differentiatedVariableName) == 0) {
             return std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(1));
-        } else {
-            const size_t variableNameLen = strlen(variableName);
-            char* newVariableName = (char*)calloc(variableNameLen + 2, sizeof(char));
-            newVariableName[variableNameLen] = '\'';
-            for (size_t i = 0; i < variableNameLen; ++i) {
-                newVariableName[i] = variableName[i];
-            }
-            return std::make_shared<ASTNode>(VariableToken::getVariableByName(newVariableName));
         }
-    } else if (rootTokenType == OPERATOR) {
+        return differentiateOtherVariable(variableToken);
+    } else {
+        throw std::logic_error("Unsupported token type");
+    }
+}
+
+/**
+ * Builds the derivative of the operator or function node from the derivatives and copies of it's children.
+ */
+static std::shared_ptr<ASTNode> combineDerivatives(const std::shared_ptr<ASTNode>& root, const ChildrenDerivatives& children) {
+    const TokenType rootTokenType = root->getToken()->getType();
+    if (rootTokenType == OPERATOR) {
         const auto operatorToken = dynamic_cast<OperatorToken*>(root->getToken().get());
         const OperatorType operatorType = operatorToken->getOperatorType();
         if (operatorToken->getArity() == 1) {
-            std::shared_ptr<ASTNode> childDerivative = differentiate(root->getChildren()[0], differentiatedVariableName);
+            const std::shared_ptr<ASTNode>& childDerivative = children.derivatives[0];
             if (operatorType == ARITHMETIC_NEGATION) { // (-f(x))' = -(f(x))'
                 return std::make_shared<ASTNode>(std::make_shared<ArithmeticNegationOperator>(), childDerivative);
             } else if (operatorType == UNARY_ADDITION) { // (+f(x))' = +(f(x))'
@@ -104,10 +85,10 @@ std::shared_ptr<ASTNode> differentiate(const std::shared_ptr<ASTNode>& root, con
                 throw std::logic_error("Unsupported unary operator type");
             }
         } else if (operatorToken->getArity() == 2) {
-            const auto leftChildDerivative  = differentiate(root->getChildren()[0], differentiatedVariableName);
-            const auto rightChildDerivative = differentiate(root->getChildren()[1], differentiatedVariableName);
-            const auto leftChildCopy  = copy(root->getChildren()[0]);
-            const auto rightChildCopy = copy(root->getChildren()[1]);
+            const auto& leftChildDerivative  = children.derivatives[0];
+            const auto& rightChildDerivative = children.derivatives[1];
+            const auto& leftChildCopy  = children.copies[0];
+            const auto& rightChildCopy = children.copies[1];
             if (operatorType == ADDITION) { // (f(x) + g(x))' = f(x)' + g(x)'
                 return std::make_shared<ASTNode>(std::make_shared<AdditionOperator>(), leftChildDerivative, rightChildDerivative);
             } else if (operatorType == SUBTRACTION) { // (f(x) - g(x))' = f(x)' - g(x)'
@@ -133,7 +114,9 @@ std::shared_ptr<ASTNode> differentiate(const std::shared_ptr<ASTNode>& root, con
                     const auto rightMultiplier = std::make_shared<ASTNode>(std::make_shared<PowerOperator>(), leftChildCopy, decConst);
                     return std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), leftMultiplier, rightMultiplier);
                 } else if (leftChildType == CONSTANT_VALUE) { // (C^f(x))' = ln(C) * C^f(x) * f(x)'
-                    const auto rootCopy = copy(root);
+                    // Copy of f(x) is reused as the exponent of the copied power
+                    const auto constCopy = std::make_shared<ASTNode>(root->getChildren()[0]->getToken());
+                    const auto rootCopy = std::make_shared<ASTNode>(root->getToken(), constCopy, rightChildCopy);
                     const auto lnConst = std::make_shared<ASTNode>(std::make_shared<LnFunction>(), leftChildCopy);
                     const auto leftMultiplier = std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), lnConst, rightChildDerivative);
                     return std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), leftMultiplier, rootCopy);
@@ -150,8 +133,8 @@ std::shared_ptr<ASTNode> differentiate(const std::shared_ptr<ASTNode>& root, con
         const auto functionToken = dynamic_cast<FunctionToken*>(root->getToken().get());
         const FunctionType functionType = functionToken->getFunctionType();
         if (functionToken->getArity() == 1) {
-            std::shared_ptr<ASTNode> childDerivative = differentiate(root->getChildren()[0], differentiatedVariableName);
-            std::shared_ptr<ASTNode> childCopy = copy(root->getChildren()[0]);
+            const std::shared_ptr<ASTNode>& childDerivative = children.derivatives[0];
+            const std::shared_ptr<ASTNode>& childCopy = children.copies[0];
             if (functionType == SIN) { // sin(f(x))' = f(x)' * cos(f(x))
                 auto funcDerivative = std::make_shared<ASTNode>(std::make_shared<CosFunction>(), childCopy);
                 return std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), childDerivative, funcDerivative);
@@ -179,4 +162,311 @@ std::shared_ptr<ASTNode> differentiate(const std::shared_ptr<ASTNode>& root, con
     } else {
         throw std::logic_error("Unsupported token type");
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Runs the tasks of a node and waits for them. Large tasks are forked except the last one, which is run by this thread
+ * after the small ones (see TaskGroup::run).
+ */
+static void runTasks(ThreadPool& pool, const Task* tasks, const bool* large, size_t tasksNumber) {
+    size_t lastLargeTask = tasksNumber;
+    for (size_t i = 0; i < tasksNumber; ++i) {
+        if (large[i]) {
+            lastLargeTask = i;
+        }
+    }
+    TaskGroup group(pool);
+    for (size_t i = 0; i < tasksNumber; ++i) {
+        if (!large[i]) {
+            tasks[i]();
+        } else if (i != lastLargeTask) {
+            group.run(tasks[i]);
+        }
+    }
+    if (lastLargeTask != tasksNumber) {
+        tasks[lastLargeTask]();
+    }
+    group.wait();
+}
+
+/**
+ * Differentiation of one AST. Without a pool it's sequential. With a pool, children that are roots of large subtrees
+ * (see findLargeSubtrees) are differentiated and copied by separate tasks, smaller subtrees are processed by the task
+ * of their parent.
+ */
+class Differentiation {
+
+private:
+    const char* const differentiatedVariableName;
+    ThreadPool* const pool;
+    const std::unordered_map<std::shared_ptr<ASTNode>, bool> largeSubtrees;
+
+public:
+    /**
+     * @param root                          root of the differentiated AST
+     * @param differentiatedVariableName_   name of the variable
+     * @param pool_                         pool of the tasks or nullptr for sequential differentiation
+     * @param cutoff                        minimum number of nodes of the subtree that is processed by a separate task
+     */
+    Differentiation(const std::shared_ptr<ASTNode>& root, const char* differentiatedVariableName_, ThreadPool* pool_, size_t cutoff) :
+            differentiatedVariableName(differentiatedVariableName_), pool(pool_),
+            largeSubtrees((pool_ != nullptr) ? findLargeSubtrees(root, cutoff) : std::unordered_map<std::shared_ptr<ASTNode>, bool>()) { }
+
+    bool isLarge(const std::shared_ptr<ASTNode>& node) const {
+        return largeSubtrees.find(node) != largeSubtrees.end();
+    }
+
+    /**
+     * Copies the subtree, tokens are shared because they are immutable.
+     * @param parallel whether large children are copied by separate tasks
+     */
+    std::shared_ptr<ASTNode> copy(const std::shared_ptr<ASTNode>& root, bool parallel) const;
+
+    /**
+     * @param parallel whether large children are processed by separate tasks
+     */
+    std::shared_ptr<ASTNode> differentiate(const std::shared_ptr<ASTNode>& root, bool parallel) const;
+};
+
+std::shared_ptr<ASTNode> Differentiation::copy(const std::shared_ptr<ASTNode>& root, bool parallel) const {
+    const std::shared_ptr<ASTNode>* children = root->getChildren();
+    switch (root->getChildrenNumber()) {
+        case 0:
+            return std::make_shared<ASTNode>(root->getToken());
+        case 1:
+            return std::make_shared<ASTNode>(root->getToken(), copy(children[0], parallel && isLarge(children[0])));
+        case 2: {
+            if (!parallel) {
+                const auto leftChild = copy(children[0], false);
+                return std::make_shared<ASTNode>(root->getToken(), leftChild, copy(children[1], false));
+            }
+            std::shared_ptr<ASTNode> childrenCopies[2];
+            Task tasks[2];
+            bool large[2];
+            for (size_t i = 0; i < 2; ++i) {
+                const bool largeChild = isLarge(children[i]);
+                tasks[i] = [this, &childrenCopies, children, i, largeChild]() { childrenCopies[i] = copy(children[i], largeChild); };
+                large[i] = largeChild;
+            }
+            runTasks(*pool, tasks, large, 2);
+            return std::make_shared<ASTNode>(root->getToken(), childrenCopies[0], childrenCopies[1]);
+        }
+        default:
+            throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
+    }
+}
+
+std::shared_ptr<ASTNode> Differentiation::differentiate(const std::shared_ptr<ASTNode>& root, bool parallel) const {
+    const size_t childrenNumber = root->getChildrenNumber();
+    if (childrenNumber == 0) {
+        return differentiateLeaf(root, differentiatedVariableName);
+    } else if (childrenNumber > 2) {
+        throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
+    }
+
+    const std::shared_ptr<ASTNode>* rootChildren = root->getChildren();
+    const bool copied = needsChildrenCopies(root->getToken().get());
+    ChildrenDerivatives children;
+    if (!parallel) {
+        for (size_t i = 0; i < childrenNumber; ++i) {
+            children.derivatives[i] = differentiate(rootChildren[i], false);
+        }
+        for (size_t i = 0; copied && (i < childrenNumber); ++i) {
+            children.copies[i] = copy(rootChildren[i], false);
+        }
+        return combineDerivatives(root, children);
+    }
+
+    // Derivatives and copies of a large child are separate tasks, so they are built at the same time
+    Task tasks[4];
+    bool large[4];
+    size_t tasksNumber = 0;
+    for (size_t i = 0; i < childrenNumber; ++i) {
+        const std::shared_ptr<ASTNode>& child = rootChildren[i];
+        const bool largeChild = isLarge(child);
+        tasks[tasksNumber] = [this, &children, &child, i, largeChild]() { children.derivatives[i] = differentiate(child, largeChild); };
+        large[tasksNumber++] = largeChild;
+        if (copied) {
+            tasks[tasksNumber] = [this, &children, &child, i, largeChild]() { children.copies[i] = copy(child, largeChild); };
+            large[tasksNumber++] = largeChild;
+        }
+    }
+    runTasks(*pool, tasks, large, tasksNumber);
+    return combineDerivatives(root, children);
+}
+
+std::shared_ptr<ASTNode> differentiate(const std::shared_ptr<ASTNode>& root, const char* differentiatedVariableName) {
+    TRACE_SCOPE("differentiate");
+    return Differentiation(root, differentiatedVariableName, nullptr, 0).differentiate(root, false);
+}
+
+std::shared_ptr<ASTNode> differentiateInParallel(const std::shared_ptr<ASTNode>& root, const char* differentiatedVariableName,
+                                                 ThreadPool& pool, size_t cutoff) {
+    TRACE_SCOPE("differentiate");
+    const Differentiation differentiation(root, differentiatedVariableName, &pool, cutoff);
+    return differentiation.differentiate(root, differentiation.isLarge(root));
+}
+
+/**
+ * Copy and derivatives of a subtree by the variables of the gradient. Derivatives by the variables that the subtree
+ * doesn't contain are equal, so only one of them is built.
+ */
+struct SubtreeGradient {
+    /** Copy of the subtree or nullptr if it isn't needed by the parents **/
+    std::shared_ptr<ASTNode> copy;
+    /** Indices of the contained variables in increasing order and derivatives by them **/
+    std::vector<std::pair<size_t, std::shared_ptr<ASTNode> > > derivatives;
+    /** Derivative by the variables that aren't contained or nullptr if the subtree contains all of them **/
+    std::shared_ptr<ASTNode> otherDerivative;
+
+    const std::shared_ptr<ASTNode>& getDerivative(size_t variableIndex) const {
+        const auto found = std::lower_bound(derivatives.begin(), derivatives.end(), variableIndex,
+                [](const std::pair<size_t, std::shared_ptr<ASTNode> >& derivative, size_t index) { return derivative.first < index; });
+        return ((found != derivatives.end()) && (found->first == variableIndex)) ? found->second : otherDerivative;
+    }
+};
+
+/**
+ * Differentiation of one AST by several variables.
+ */
+class Gradient {
+
+private:
+    const std::vector<std::string>& differentiatedVariableNames;
+    /** Gradients of the nodes that have several parents, so they are built once for all of them **/
+    std::unordered_map<const ASTNode*, SubtreeGradient> sharedNodes;
+
+public:
+    explicit Gradient(const std::vector<std::string>& differentiatedVariableNames_) :
+            differentiatedVariableNames(differentiatedVariableNames_) { }
+
+    /**
+     * @param copied whether the copy of the subtree is needed
+     */
+    SubtreeGradient differentiate(const std::shared_ptr<ASTNode>& root, bool copied);
+
+private:
+    SubtreeGradient differentiateChild(const std::shared_ptr<ASTNode>& child, bool copied);
+
+    SubtreeGradient differentiateLeaf(const std::shared_ptr<ASTNode>& root, bool copied) const;
+};
+
+SubtreeGradient Gradient::differentiateChild(const std::shared_ptr<ASTNode>& child, bool copied) {
+    if (child.use_count() == 1) {
+        return differentiate(child, copied);
+    }
+    const auto found = sharedNodes.find(child.get());
+    if (found != sharedNodes.end()) {
+        return found->second;
+    }
+    // Other parents can need the copy, so shared nodes are always copied
+    const SubtreeGradient childGradient = differentiate(child, true);
+    sharedNodes.emplace(child.get(), childGradient);
+    return childGradient;
+}
+
+SubtreeGradient Gradient::differentiateLeaf(const std::shared_ptr<ASTNode>& root, bool copied) const {
+    SubtreeGradient result;
+    if (copied) {
+        result.copy = std::make_shared<ASTNode>(root->getToken());
+    }
+    const TokenType rootTokenType = root->getToken()->getType();
+    if (rootTokenType == CONSTANT_VALUE) { // C' = 0
+        result.otherDerivative = std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(0));
+    } else if (rootTokenType == VARIABLE) { // x' = 1, y' = y'
+        const auto variableToken = dynamic_cast<VariableToken*>(root->getToken().get());
+        std::shared_ptr<ASTNode> unit = nullptr;
+        for (size_t i = 0; i < differentiatedVariableNames.size(); ++i) {
+            if (differentiatedVariableNames[i] == variableToken->getName()) {
+                if (unit == nullptr) unit = std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(1));
+                result.derivatives.emplace_back(i, unit);
+            }
+        }
+        if (result.derivatives.size() < differentiatedVariableNames.size()) {
+            result.otherDerivative = differentiateOtherVariable(variableToken);
+        }
+    } else {
+        throw std::logic_error("Unsupported token type");
+    }
+    return result;
+}
+
+SubtreeGradient Gradient::differentiate(const std::shared_ptr<ASTNode>& root, bool copied) {
+    const size_t childrenNumber = root->getChildrenNumber();
+    if (childrenNumber == 0) {
+        return differentiateLeaf(root, copied);
+    } else if (childrenNumber > 2) {
+        throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
+    }
+
+    // Copies of the children are shared by the copy of the node and by it's derivatives
+    const std::shared_ptr<ASTNode>* rootChildren = root->getChildren();
+    const bool childrenCopied = copied || needsChildrenCopies(root->getToken().get());
+    SubtreeGradient childrenGradients[2];
+    ChildrenDerivatives children;
+    std::vector<size_t> variableIndices;
+    for (size_t i = 0; i < childrenNumber; ++i) {
+        childrenGradients[i] = differentiateChild(rootChildren[i], childrenCopied);
+        children.copies[i] = childrenGradients[i].copy;
+        for (const auto& derivative : childrenGradients[i].derivatives) {
+            variableIndices.push_back(derivative.first);
+        }
+    }
+    SubtreeGradient result;
+    if (copied) {
+        result.copy = (childrenNumber == 1) ? std::make_shared<ASTNode>(root->getToken(), children.copies[0])
+                                            : std::make_shared<ASTNode>(root->getToken(), children.copies[0], children.copies[1]);
+    }
+
+    // Node contains the variables of all it's children
+    std::sort(variableIndices.begin(), variableIndices.end());
+    variableIndices.erase(std::unique(variableIndices.begin(), variableIndices.end()), variableIndices.end());
+    for (size_t variableIndex : variableIndices) {
+        for (size_t i = 0; i < childrenNumber; ++i) {
+            children.derivatives[i] = childrenGradients[i].getDerivative(variableIndex);
+        }
+        result.derivatives.emplace_back(variableIndex, combineDerivatives(root, children));
+    }
+    if (result.derivatives.size() < differentiatedVariableNames.size()) {
+        for (size_t i = 0; i < childrenNumber; ++i) {
+            children.derivatives[i] = childrenGradients[i].otherDerivative;
+        }
+        result.otherDerivative = combineDerivatives(root, children);
+    }
+    return result;
+}
+
+std::vector<std::shared_ptr<ASTNode> > gradient(const std::shared_ptr<ASTNode>& root,
+                                                const std::vector<std::string>& differentiatedVariableNames) {
+    TRACE_SCOPE("gradient");
+    const SubtreeGradient rootGradient = Gradient(differentiatedVariableNames).differentiate(root, false);
+    std::vector<std::shared_ptr<ASTNode> > partialDerivatives;
+    partialDerivatives.reserve(differentiatedVariableNames.size());
+    for (size_t i = 0; i < differentiatedVariableNames.size(); ++i) {
+        partialDerivatives.push_back(rootGradient.getDerivative(i));
+    }
+    return partialDerivatives;
+}
+
+GradientStatistics compareGradient(const std::shared_ptr<ASTNode>& root, const std::vector<std::string>& differentiatedVariableNames) {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    GradientStatistics statistics;
+    statistics.variablesNumber = differentiatedVariableNames.size();
+
+    auto start = std::chrono::steady_clock::now();
+    const auto partialDerivatives = gradient(root, differentiatedVariableNames);
+    statistics.milliseconds = Milliseconds(std::chrono::steady_clock::now() - start).count();
+    statistics.uniqueNodesNumber = countUniqueNodes(partialDerivatives);
+
+    // Derivatives are freed after the measurement like the gradient
+    std::vector<std::shared_ptr<ASTNode> > derivatives;
+    start = std::chrono::steady_clock::now();
+    for (const std::string& name : differentiatedVariableNames) {
+        derivatives.push_back(differentiate(root, name.c_str()));
+    }
+    statistics.separateMilliseconds = Milliseconds(std::chrono::steady_clock::now() - start).count();
+    for (const auto& derivative : derivatives) {
+        statistics.separateUniqueNodesNumber += countUniqueNodes({derivative});
+    }
+    return statistics;
+}
@@ -6,9 +6,70 @@
 #define AST_BUILDER_AST_MATH_H
 
 #include <memory>
+#include <string>
+#include <vector>
 #include "ast.h"
+#include "thread_pool.h"
 #include "tokenizer.h"
 
+/**
+ * Differentiates the AST. Derivative doesn't share nodes with the AST, but nodes can be shared inside it
+ * (copies of the divisor in derivatives of divisions).
+ * @param root                          root of the AST
+ * @param differentiatedVariableName    name of the variable, other variables y are differentiated into y'
+ * @return root of the derivative.
+ * @throws std::logic_error if the AST contains f(x)^g(x), which isn't supported.
+ */
 std::shared_ptr<ASTNode> differentiate(const std::shared_ptr<ASTNode>& root, const char* differentiatedVariableName);
 
+/**
+ * Differentiates the AST by tasks of the pool. Children that are roots of subtrees with at least cutoff nodes are
+ * differentiated and copied by separate tasks, smaller subtrees are processed by the task of their parent.
+ * Derivative is the same as the one of differentiate.
+ * @param root                          root of the AST
+ * @param differentiatedVariableName    name of the variable
+ * @param pool                          pool of the tasks, calling thread runs tasks too while it waits
+ * @param cutoff                        minimum number of nodes of the subtree that is processed by a separate task
+ * @return root of the derivative.
+ * @throws std::logic_error if the AST contains f(x)^g(x), which isn't supported.
+ */
+std::shared_ptr<ASTNode> differentiateInParallel(const std::shared_ptr<ASTNode>& root, const char* differentiatedVariableName,
+                                                 ThreadPool& pool, size_t cutoff = DEFAULT_PARALLEL_CUTOFF);
+
+/**
+ * Differentiates the AST by several variables in one traversal. Copies of the subtrees are built once and are shared
+ * by all the partial derivatives. Derivatives of a subtree by the variables that it doesn't contain are equal, so they
+ * are built once too. Derivatives of the nodes that are shared in the AST are cached and are reused by all their
+ * parents. Partial derivatives share nodes with each other, so optimizing one of them in place changes the shared
+ * subtrees of the others into equivalent ones.
+ * @param root                          root of the AST
+ * @param differentiatedVariableNames   names of the variables
+ * @return partial derivatives in order of the names, each is the same as the one of differentiate.
+ * @throws std::logic_error if the AST contains f(x)^g(x), which isn't supported.
+ */
+std::vector<std::shared_ptr<ASTNode> > gradient(const std::shared_ptr<ASTNode>& root,
+                                                const std::vector<std::string>& differentiatedVariableNames);
+
+/**
+ * Comparison of the gradient with the derivatives by every variable that are built separately.
+ */
+struct GradientStatistics {
+    size_t variablesNumber = 0;
+    /** Number of distinct nodes of all the partial derivatives, nodes shared by several of them are counted once **/
+    size_t uniqueNodesNumber = 0;
+    /** Sum of the numbers of distinct nodes of the separate derivatives **/
+    size_t separateUniqueNodesNumber = 0;
+    double milliseconds = 0.;
+    double separateMilliseconds = 0.;
+};
+
+/**
+ * Builds the gradient and the derivatives by every variable with differentiate, and compares their sizes and times.
+ * @param root                          root of the AST
+ * @param differentiatedVariableNames   names of the variables
+ * @return statistics of the gradient.
+ * @throws std::logic_error if the AST contains f(x)^g(x), which isn't supported.
+ */
+GradientStatistics compareGradient(const std::shared_ptr<ASTNode>& root, const std::vector<std::string>& differentiatedVariableNames);
+
 #endif // AST_BUILDER_AST_MATH_H
@@ -4,14 +4,112 @@
  */
 #include <cmath>
 #include <memory>
+#include <stdexcept>
+#include <unordered_map>
 #include "ast.h"
 #include "ast-optimizers.h"
+#include "thread_pool.h"
 #include "tokenizer.h"
+#include "tracing.h"
 
 static constexpr double COMPARE_EPS = 1e-9;
 
+/** Optimizer whose outermost optimize call is running in this thread **/
+static thread_local const Optimizer* tracedOptimizer = nullptr;
+
+/**
+ * Traces the outermost optimize call of the optimizer, so recursion into the children doesn't make a span per node.
+ */
+class OptimizerSpan {
+
+private:
+    /** Thread local isn't touched when tracing is off **/
+    const bool enabled;
+    const Optimizer* const previousOptimizer;
+    const TraceSpan span;
+
+public:
+    explicit OptimizerSpan(const Optimizer* optimizer) :
+            enabled(isTracingEnabled()),
+            previousOptimizer(enabled ? tracedOptimizer : nullptr),
+            span((enabled && (optimizer != previousOptimizer)) ? optimizer->getName() : nullptr) {
+        if (enabled) tracedOptimizer = optimizer;
+    }
+
+    ~OptimizerSpan() {
+        if (enabled) tracedOptimizer = previousOptimizer;
+    }
+};
+
+/**
+ * Parallel optimization of one AST (see optimizeInParallel).
+ */
+struct ParallelOptimization {
+    ThreadPool& pool;
+    /** Large subtrees and whether they can be optimized by separate tasks **/
+    const std::unordered_map<std::shared_ptr<ASTNode>, bool> largeSubtrees;
+};
+
+/** Parallel optimization of the subtree that is optimized in this thread, nullptr if the subtree is small **/
+static thread_local const ParallelOptimization* currentParallelOptimization = nullptr;
+
+/**
+ * Sets the parallel optimization of the current thread until the scope ends.
+ */
+class ParallelOptimizationScope {
+
+private:
+    const ParallelOptimization* const previousOptimization;
+
+public:
+    explicit ParallelOptimizationScope(const ParallelOptimization* optimization) : previousOptimization(currentParallelOptimization) {
+        currentParallelOptimization = optimization;
+    }
+
+    ~ParallelOptimizationScope() {
+        currentParallelOptimization = previousOptimization;
+    }
+};
+
+/**
+ * Optimizes the children of the node. In parallel optimization children that are roots of large independent subtrees
+ * are optimized by separate tasks. Subtrees of small children are small too, so they are optimized sequentially.
+ * The last child is optimized by this thread (see TaskGroup::run).
+ */
+static void optimizeChildNodes(const Optimizer& optimizer, std::shared_ptr<ASTNode>& node) {
+    const auto children = node->getChildren();
+    const size_t childrenNumber = node->getChildrenNumber();
+    const ParallelOptimization* parallelOptimization = currentParallelOptimization;
+    if (parallelOptimization == nullptr) {
+        for (size_t i = 0; i < childrenNumber; ++i) {
+            node->setChild(i, optimizer.optimize(children[i]));
+        }
+        return;
+    }
+
+    ASTNode* parent = node.get(); // Tasks don't hold references, so use counts of the nodes are exact
+    TaskGroup group(parallelOptimization->pool);
+    for (size_t i = 0; i < childrenNumber; ++i) {
+        const auto largeSubtree = parallelOptimization->largeSubtrees.find(children[i]);
+        const bool large = largeSubtree != parallelOptimization->largeSubtrees.end();
+        // Previous passes can make an independent node shared, e.g. +x shared by several parents is replaced by x
+        // in all of them, so the node is forked only if it's referenced by this node and largeSubtrees
+        if (large && largeSubtree->second && (children[i].use_count() == 2) && (i + 1 < childrenNumber)) {
+            // Tasks change different children, setChild only resets the atomic hash of the node
+            group.run([&optimizer, parallelOptimization, parent, children, i]() {
+                const ParallelOptimizationScope scope(parallelOptimization);
+                parent->setChild(i, optimizer.optimize(children[i]));
+            });
+        } else {
+            const ParallelOptimizationScope scope(large ? parallelOptimization : nullptr);
+            node->setChild(i, optimizer.optimize(children[i]));
+        }
+    }
+    group.wait();
+}
 
 std::shared_ptr<ASTNode>& Optimizer::optimize(std::shared_ptr<ASTNode>& node) const {
+    const OptimizerSpan span(this);
     if (optimizeChildrenFirst) {
         return optimizeCurrent(optimizeChildren(node));
     } else {
@@ -20,11 +118,7 @@ std::shared_ptr<ASTNode>& Optimizer::optimize(std::shared_ptr<ASTNode>& node) co
 }
 
 std::shared_ptr<ASTNode>& Optimizer::optimizeChildren(std::shared_ptr<ASTNode>& node) const {
-    const auto children = node->getChildren();
-    const size_t childrenNumber = node->getChildrenNumber();
-    for (size_t i = 0; i < childrenNumber; ++i) {
-        children[i] = optimize(children[i]);
-    }
+    optimizeChildNodes(*this, node);
     return node;
 }
 
@@ -161,11 +255,25 @@ std::shared_ptr<ASTNode>& ConstantCompressor::optimizeCurrent(std::shared_ptr<AS
     }
 }
 
-std::shared_ptr<ASTNode>& TrivialOperationsOptimizer::optimize(std::shared_ptr<ASTNode>& node) const {
-    const auto children = node->getChildren();
-    const size_t childrenNumber = node->getChildrenNumber();
-    for (size_t i = 0; i < childrenNumber; ++i) {
-        children[i] = optimize(children[i]);
+std::shared_ptr<ASTNode>& CompositeOptimizer::optimize(std::shared_ptr<ASTNode>& node) const {
+    const OptimizerSpan span(this);
+    for (const auto& optimizer : optimizers) {
+        node = optimizer->optimize(node);
     }
+    return node;
+}
+
+std::shared_ptr<ASTNode>& TrivialOperationsOptimizer::optimize(std::shared_ptr<ASTNode>& node) const {
+    const OptimizerSpan span(this);
+    optimizeChildNodes(*this, node);
     return CompositeOptimizer::optimizeCurrent(node);
 }
+
+std::shared_ptr<ASTNode>& optimizeInParallel(const Optimizer& optimizer, std::shared_ptr<ASTNode>& root, ThreadPool& pool, size_t cutoff) {
+    // Optimizers only replace nodes with their descendants, so subtrees stay independent between the passes of composite
+    // optimizers, except the replacing nodes of shared nodes (see optimizeChildNodes)
+    const ParallelOptimization parallelOptimization{pool, findLargeSubtrees(root, cutoff)};
+    const bool large = parallelOptimization.largeSubtrees.find(root) != parallelOptimization.largeSubtrees.end();
+    const ParallelOptimizationScope scope(large ? &parallelOptimization : nullptr);
+    return optimizer.optimize(root);
+}
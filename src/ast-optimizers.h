@@ -8,6 +8,7 @@
 #include <memory>
 #include <vector>
 #include "ast.h"
+#include "thread_pool.h"
 
 class Optimizer {
 
@@ -16,9 +17,20 @@ private:
 public:
     explicit Optimizer(bool optimizeChildrenFirst_) : optimizeChildrenFirst(optimizeChildrenFirst_) { }
 
+    virtual ~Optimizer() = default;
+
+    /**
+     * Optimizes the subtree. Outermost call of every optimizer is traced as a span with the optimizer's name
+     * (see tracing.h), recursive calls for children aren't.
+     */
     virtual std::shared_ptr<ASTNode>& optimize(std::shared_ptr<ASTNode>& node) const;
     virtual std::shared_ptr<ASTNode>& optimizeCurrent(std::shared_ptr<ASTNode>& node) const = 0;
     virtual std::shared_ptr<ASTNode>& optimizeChildren(std::shared_ptr<ASTNode>& node) const;
+
+    /**
+     * @return name of the optimizer class.
+     */
+    virtual const char* getName() const = 0;
 };
 
 class CompositeOptimizer : public Optimizer {
@@ -33,12 +45,7 @@ public:
         optimizers.push_back(optimizer);
     }
 
-    std::shared_ptr<ASTNode>& optimize(std::shared_ptr<ASTNode>& node) const override {
-        for (const auto& optimizer : optimizers) {
-            node = optimizer->optimize(node);
-        }
-        return node;
-    }
+    std::shared_ptr<ASTNode>& optimize(std::shared_ptr<ASTNode>& node) const override;
 
     std::shared_ptr<ASTNode>& optimizeChildren(std::shared_ptr<ASTNode>& node) const override {
         for (const auto& optimizer : optimizers) {
@@ -63,6 +70,10 @@ class UnaryAdditionOptimizer : public Optimizer {
 public:
     UnaryAdditionOptimizer() : Optimizer(false) { }
     std::shared_ptr<ASTNode>& optimizeCurrent(std::shared_ptr<ASTNode>& node) const override;
+
+    const char* getName() const override {
+        return "UnaryAdditionOptimizer";
+    }
 };
 
 /**
@@ -73,6 +84,10 @@ class ArithmeticNegationOptimizer : public Optimizer {
 public:
     ArithmeticNegationOptimizer() : Optimizer(false) { }
     std::shared_ptr<ASTNode>& optimizeCurrent(std::shared_ptr<ASTNode>& node) const override;
+
+    const char* getName() const override {
+        return "ArithmeticNegationOptimizer";
+    }
 };
 
 /**
@@ -83,6 +98,10 @@ class TrivialAdditionOptimizer : public Optimizer {
 public:
     TrivialAdditionOptimizer() : Optimizer(true) { }
     std::shared_ptr<ASTNode>& optimizeCurrent(std::shared_ptr<ASTNode>& node) const override;
+
+    const char* getName() const override {
+        return "TrivialAdditionOptimizer";
+    }
 };
 
 /**
@@ -93,6 +112,10 @@ class TrivialMultiplicationOptimizer : public Optimizer {
 public:
     TrivialMultiplicationOptimizer() : Optimizer(true) { }
     std::shared_ptr<ASTNode>& optimizeCurrent(std::shared_ptr<ASTNode>& node) const override;
+
+    const char* getName() const override {
+        return "TrivialMultiplicationOptimizer";
+    }
 };
 
 /**
@@ -103,6 +126,10 @@ class ConstantCompressor : public Optimizer {
 public:
     ConstantCompressor() : Optimizer(true) { }
     std::shared_ptr<ASTNode>& optimizeCurrent(std::shared_ptr<ASTNode>& node) const override;
+
+    const char* getName() const override {
+        return "ConstantCompressor";
+    }
 };
 
 // TODO: TrivialPowerOptimizer (x^0 = 1, x^1 = x, 1^x = 1, maybe x^-y = 1/x^y)
@@ -120,8 +147,43 @@ public:
     }
 
     std::shared_ptr<ASTNode>& optimize(std::shared_ptr<ASTNode>& node) const override;
+
+    const char* getName() const override {
+        return "TrivialOperationsOptimizer";
+    }
 };
 
+/**
+ * Composite optimizer with all the optimizers (see UnaryAdditionOptimizer, ArithmeticNegationOptimizer, TrivialOperationsOptimizer)
+ */
+class FullOptimizer : public CompositeOptimizer {
+
+public:
+    FullOptimizer() : CompositeOptimizer() {
+        addOptimizer(std::make_shared<UnaryAdditionOptimizer>());
+        addOptimizer(std::make_shared<ArithmeticNegationOptimizer>());
+        addOptimizer(std::make_shared<TrivialOperationsOptimizer>());
+    }
+
+    const char* getName() const override {
+        return "FullOptimizer";
+    }
+};
+
+/**
+ * Optimizes the AST by tasks of the pool. Children that are roots of independent subtrees with at least cutoff nodes
+ * (see findLargeSubtrees) are optimized by separate tasks. Optimizers change the nodes in place, so a node shared with
+ * other parts of the AST is optimized by the task that optimizes all it's parents. Result is the same as of
+ * optimizer.optimize.
+ * @param optimizer optimizer, it's optimize is called from several threads
+ * @param root      root of the AST
+ * @param pool      pool of the tasks, calling thread runs tasks too while it waits
+ * @param cutoff    minimum number of nodes of the subtree that is optimized by a separate task
+ * @return reference to the optimized root.
+ */
+std::shared_ptr<ASTNode>& optimizeInParallel(const Optimizer& optimizer, std::shared_ptr<ASTNode>& root, ThreadPool& pool,
+                                             size_t cutoff = DEFAULT_PARALLEL_CUTOFF);
+
 // TODO: 0 - x -> -x
 // TODO: Push negation operators down to constants and variables. (to eliminate x - -4*x)
 
@@ -2,14 +2,54 @@
  * @file
  * @brief Implementation of AST building functions
  */
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstdio>
 #include <cstring>
+#include <functional>
+#include <iterator>
 #include <stack>
 #include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "ast.h"
+#include "iterative_parser.h"
+#include "render_pipeline.h"
+#include "svg_renderer.h"
+#include "tex_writer.h"
 #include "tokenizer.h"
+#include "tracing.h"
+
+/**
+ * Children that are released during destruction of the AST. While it's not null, destructors of nested
+ * nodes move their children here instead of releasing them recursively, so destroying a deep tree
+ * doesn't overflow the call stack.
+ */
+static thread_local std::vector<std::shared_ptr<ASTNode> >* releasedNodes = nullptr;
+
+ASTNode::~ASTNode() {
+    if ((releasedNodes != nullptr) || (childrenNumber == 0)) {
+        for (size_t i = 0; i < childrenNumber; ++i) {
+            releasedNodes->push_back(std::move(children[i]));
+        }
+        delete[] children;
+        return;
+    }
+
+    std::vector<std::shared_ptr<ASTNode> > nodes(std::make_move_iterator(children), std::make_move_iterator(children + childrenNumber));
+    delete[] children;
+    releasedNodes = &nodes;
+    while (!nodes.empty()) {
+        std::shared_ptr<ASTNode> node = std::move(nodes.back());
+        nodes.pop_back();
+        node.reset();
+    }
+    releasedNodes = nullptr;
+}
 
 void ASTNode::print(int depth) const {
     for (int i = 0; i < depth; ++i) {
@@ -23,42 +63,40 @@ void ASTNode::print(int depth) const {
     }
 }
 
-void ASTNode::visualize(const char* fileName) const {
-    assert(fileName != nullptr);
-
-    char dotFileName[100];
-    strcpy(dotFileName, fileName);
-    strcat(dotFileName, ".dot");
-
-    FILE* graphvizTextFile = fopen(dotFileName, "w");
-    fprintf(graphvizTextFile, "digraph AST {\n");
-    int nodeId = 0;
-    dotPrint(graphvizTextFile, nodeId);
-    fprintf(graphvizTextFile, "}\n");
-    fclose(graphvizTextFile);
+void ASTNode::visualize(const std::string& fileName, RenderMode renderMode) const {
+    TRACE_SCOPE("visualize");
+    const std::string dotFileName = fileName + ".dot";
+    FILE* dotFile = fopen(dotFileName.c_str(), "w");
+    if (dotFile == nullptr) {
+        throw std::system_error(errno, std::generic_category(), dotFileName);
+    }
+    try {
+        dotPrint(dotFile);
+    } catch (...) {
+        fclose(dotFile);
+        throw;
+    }
+    if (fclose(dotFile) != 0) {
+        throw std::system_error(errno, std::generic_category(), dotFileName);
+    }
 
-    char command[1000];
-    sprintf(command, "dot -Tpng -o%s.png %s.dot && xdg-open %s.png", fileName, fileName, fileName);
-    system(command);
+    if (renderMode != NO_RENDER) {
+        const std::string svgFileName = fileName + ".svg";
+        saveSVG(*this, svgFileName);
+        if (renderMode == RENDER_AND_VIEW) {
+            launchInBackground(getViewCommand(svgFileName));
+        }
+    }
 }
 
-void ASTNode::texify(const char* fileName) const {
-    assert(fileName != nullptr);
-
-    char texFileName[100];
-    strcpy(texFileName, fileName);
-    strcat(texFileName, ".tex");
+void ASTNode::texify(const std::string& fileName, RenderMode renderMode) const {
+    TRACE_SCOPE("texify");
+    const std::string texFileName = fileName + ".tex";
+    saveTeX(*this, texFileName);
 
-    FILE* texFile = fopen(texFileName, "w");
-    fprintf(texFile, "\\documentclass{article}\n\\begin{document}\n\\begin{center}\n\t$ ");
-    texPrint(texFile);
-    fprintf(texFile, " $\n\\end{center}\n\\end{document}\n");
-    fclose(texFile);
-
-    char command[1000];
-    sprintf(command, "pdflatex %s.tex > .tmp_%s && rm .tmp_%s && rm %s.log && rm %s.aux && xdg-open %s.pdf",
-            fileName, fileName, fileName, fileName, fileName, fileName);
-    system(command);
+    if (renderMode != NO_RENDER) {
+        launchInBackground(getTexCommand(fileName, renderMode == RENDER_AND_VIEW));
+    }
 }
 
 double ASTNode::calculate() const {
@@ -74,125 +112,180 @@ double ASTNode::calculate() const {
     }
 }
 
-void ASTNode::dotPrint(FILE* dotFile, int& nodeId) const {
+/** Size of the buffered DOT text that is written to the file at once **/
+static constexpr size_t DOT_BUFFER_SIZE = 1u << 20u;
+
+static constexpr const char* DOT_CONSTANT_COLOR = "#FFFEC9";
+static constexpr const char* DOT_VARIABLE_COLOR = "#99FF9D";
+static constexpr const char* DOT_OPERATION_COLOR = "#C9E7FF";
+
+static void dotPrintNode(OutputBuffer& buffer, size_t nodeId, const ASTNode* node, const DotNodeStyler* styler) {
+    const Token* token = node->getToken().get();
+    const char* fillColor = nullptr;
+    buffer.appendUnsigned(nodeId);
     if (token->getType() == TokenType::CONSTANT_VALUE) {
-        auto constantValueToken = dynamic_cast<ConstantValueToken*>(token.get());
-        fprintf(dotFile, "%d [label=\"const\nvalue: %lg\", shape=box, style=filled, color=\"grey\", fillcolor=\"#FFFEC9\"];\n", nodeId, constantValueToken->getValue());
-        ++nodeId;
+        buffer.append(" [label=\"const\\nvalue: ");
+        buffer.appendNumber(dynamic_cast<const ConstantValueToken*>(token)->getValue());
+        fillColor = DOT_CONSTANT_COLOR;
     } else if (token->getType() == TokenType::VARIABLE) {
-        auto variableToken = dynamic_cast<VariableToken*>(token.get());
-        fprintf(dotFile, "%d [label=\"var\nname: %s\", shape=box, style=filled, color=\"grey\", fillcolor=\"#99FF9D\"];\n", nodeId, variableToken->getName());
-        ++nodeId;
+        buffer.append(" [label=\"var\\nname: ");
+        buffer.append(dynamic_cast<const VariableToken*>(token)->getName());
+        fillColor = DOT_VARIABLE_COLOR;
     } else if (token->getType() == TokenType::OPERATOR) {
-        auto operatorToken = dynamic_cast<OperatorToken*>(token.get());
-        const char* operatorSymbol = operatorToken->getSymbol();
+        auto operatorToken = dynamic_cast<const OperatorToken*>(token);
         if (operatorToken->getArity() == 1) {
-            fprintf(dotFile, "%d [label=\"unary op\nop: %s\", shape=box, style=filled, color=\"grey\", fillcolor=\"#C9E7FF\"];\n",
-                    nodeId, operatorSymbol);
+            buffer.append(" [label=\"unary op\\nop: ");
         } else if (operatorToken->getArity() == 2) {
-            fprintf(dotFile, "%d [label=\"binary op\nop: %s\", shape=box, style=filled, color=\"grey\", fillcolor=\"#C9E7FF\"];\n",
-                    nodeId, operatorSymbol);
+            buffer.append(" [label=\"binary op\\nop: ");
         } else {
             throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
         }
-        int childrenNodeId = nodeId + 1;
-        for (size_t i = 0; i < childrenNumber; ++i) {
-            fprintf(dotFile, "%d->%d\n", nodeId, childrenNodeId);
-            children[i]->dotPrint(dotFile, childrenNodeId);
-        }
-        nodeId = childrenNodeId;
+        buffer.append(operatorToken->getSymbol());
+        fillColor = DOT_OPERATION_COLOR;
     } else if (token->getType() == TokenType::FUNCTION) {
-        auto functionToken = dynamic_cast<FunctionToken*>(token.get());
-        if (functionToken->getArity() == 1) {
-            fprintf(dotFile, "%d [label=\"unary func\nfunc: %s\", shape=box, style=filled, color=\"grey\", fillcolor=\"#C9E7FF\"];\n",
-                    nodeId, functionToken->getName());
-        } else {
+        auto functionToken = dynamic_cast<const FunctionToken*>(token);
+        if (functionToken->getArity() != 1) {
             throw std::logic_error("Unsupported arity of function. Only unary are supported yet");
         }
-        int childrenNodeId = nodeId + 1;
-        for (size_t i = 0; i < childrenNumber; ++i) {
-            fprintf(dotFile, "%d->%d\n", nodeId, childrenNodeId);
-            children[i]->dotPrint(dotFile, childrenNodeId);
-        }
-        nodeId = childrenNodeId;
+        buffer.append(" [label=\"unary func\\nfunc: ");
+        buffer.append(functionToken->getName());
+        fillColor = DOT_OPERATION_COLOR;
     } else {
         throw std::logic_error("Unsupported token type");
     }
+
+    if (styler != nullptr) {
+        styler->appendLabel(*node, buffer);
+        const char* styledColor = styler->getFillColor(*node);
+        if (styledColor != nullptr) fillColor = styledColor;
+    }
+    buffer.append("\", shape=box, style=filled, color=\"grey\", fillcolor=\"");
+    buffer.append(fillColor);
+    buffer.append("\"];\n");
 }
 
-void ASTNode::texPrint(FILE* texFile, TexBraceType braceType) const {
-    if (token->getType() == TokenType::CONSTANT_VALUE) {
-        auto constantValueToken = dynamic_cast<ConstantValueToken*>(token.get());
-        fprintf(texFile, "{%lg}", constantValueToken->getValue());
-    } else if (token->getType() == TokenType::VARIABLE) {
-        auto variableToken = dynamic_cast<VariableToken*>(token.get());
-        fprintf(texFile, "{%s}", variableToken->getName());
-    } else if (token->getType() == TokenType::OPERATOR) {
-        auto operatorToken = dynamic_cast<OperatorToken*>(token.get());
-        const char* operatorSymbol = operatorToken->getSymbol();
-        if (operatorToken->getArity() == 1) {
-            if (braceType != NONE) fprintf(texFile, braceType == ROUND ? "(" : "{");
-            fprintf(texFile, "%s", operatorSymbol);
-            children[0]->texPrint(texFile, ROUND);
-            if (braceType != NONE) fprintf(texFile, braceType == ROUND ? ")" : "}");
-        } else if (operatorToken->getArity() == 2) {
-            if (operatorToken->getOperatorType() == OperatorType::DIVISION) {
-                // No braces needed, because `\frac` can be safely used with `^` as `\frac{...}{...} ^ \frac{...}{...}`
-                fprintf(texFile, "\\frac{");
-                children[0]->texPrint(texFile, NONE);
-                fprintf(texFile, "}{");
-                children[1]->texPrint(texFile, NONE);
-                fprintf(texFile, "}");
-            } else {
-                if (braceType != NONE) fprintf(texFile, braceType == ROUND ? "(" : "{");
-                auto leftChild = children[0];
-                TexBraceType leftChildBrace = getChildBraceType(operatorToken, leftChild->getToken().get(), false);
-                leftChild->texPrint(texFile, leftChildBrace);
+void ASTNode::dotPrint(FILE* dotFile, const DotNodeStyler* styler) const {
+    assert(dotFile != nullptr);
 
-                fprintf(texFile, " %s ", operatorSymbol);
+    OutputBuffer buffer;
+    buffer.reserve(DOT_BUFFER_SIZE + 4096);
+    buffer.append("digraph AST {\n");
 
-                auto rightChild = children[1];
-                TexBraceType rightChildBrace = getChildBraceType(operatorToken, rightChild->getToken().get(), true);
-                rightChild->texPrint(texFile, rightChildBrace);
-                if (braceType != NONE) fprintf(texFile, braceType == ROUND ? ")" : "}");
+    // Nodes get ids when they are found, so a shared node has one id and is written once
+    std::unordered_map<const ASTNode*, size_t> nodeIds;
+    std::vector<std::pair<const ASTNode*, size_t> > nodes;
+    nodeIds.emplace(this, 0);
+    nodes.emplace_back(this, 0);
+    while (!nodes.empty()) {
+        const ASTNode* node = nodes.back().first;
+        const size_t nodeId = nodes.back().second;
+        nodes.pop_back();
+        dotPrintNode(buffer, nodeId, node, styler);
+
+        const size_t firstChild = nodes.size();
+        for (size_t i = 0; i < node->childrenNumber; ++i) {
+            auto childId = nodeIds.emplace(node->children[i].get(), nodeIds.size());
+            if (childId.second) {
+                nodes.emplace_back(node->children[i].get(), childId.first->second);
             }
-        } else {
-            throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
+            buffer.appendUnsigned(nodeId);
+            buffer.append("->", 2);
+            buffer.appendUnsigned(childId.first->second);
+            buffer.append('\n');
         }
-    } else if (token->getType() == TokenType::FUNCTION) {
-        auto functionToken = dynamic_cast<FunctionToken*>(token.get());
-        if (functionToken->getArity() == 1) {
-            fprintf(texFile, "{%s}", functionToken->getName());
-            children[0]->texPrint(texFile, ROUND);
-        } else {
-            throw std::logic_error("Unsupported arity of function. Only unary are supported yet");
+        std::reverse(nodes.begin() + firstChild, nodes.end()); // Left child is written first
+
+        if ((buffer.getSize() >= DOT_BUFFER_SIZE) && !buffer.writeTo(dotFile)) {
+            throw std::system_error(errno, std::generic_category(), "Can't write DOT file");
         }
-    } else {
-        throw std::logic_error("Unsupported token type");
+    }
+    buffer.append("}\n");
+    if (!buffer.writeTo(dotFile)) {
+        throw std::system_error(errno, std::generic_category(), "Can't write DOT file");
     }
 }
 
-ASTNode::TexBraceType ASTNode::getChildBraceType(const OperatorToken* parentOperator, const Token* child, bool isRightChild) {
+/**
+ * Checks whether the child of the operator should be parenthesised to be parsed back into the same tree.
+ * Same idea as choosing braces in the TeX writer, but equal precedence is checked for every binary operator, so "a + (b + c)"
+ * and "(a ^ b) ^ c" keep their shape. Unary operators bind tighter than binary ones and are never parenthesised.
+ */
+static bool needsInfixParentheses(const OperatorToken* parentOperator, const Token* child, bool isRightChild) {
     if (child->getType() != TokenType::OPERATOR)
-        return NONE;
+        return false;
+
+    auto childOperator = static_cast<const OperatorToken*>(child);
+    if (childOperator->getArity() == 1)
+        return false;
 
-    if (parentOperator->getOperatorType() == OperatorType::POWER)
-        return isRightChild ? CURLY : ROUND;
+    if (parentOperator->getArity() == 1)
+        return true;
 
-    if (dynamic_cast<const OperatorToken*>(child)->getPrecedence() < parentOperator->getPrecedence())
-        return ROUND;
+    if (childOperator->getPrecedence() != parentOperator->getPrecedence())
+        return childOperator->getPrecedence() < parentOperator->getPrecedence();
 
-    if (isRightChild && (parentOperator->getOperatorType() == OperatorType::SUBTRACTION) &&
-        (dynamic_cast<const OperatorToken*>(child)->getPrecedence() == parentOperator->getPrecedence()))
-        return ROUND;
+    return isRightChild ? parentOperator->isLeftAssociative() : parentOperator->isRightAssociative();
+}
 
-    return NONE;
+void ASTNode::infixPrint(OutputBuffer& buffer) const {
+    struct Item {
+        const ASTNode* node;
+        const char* text;
+    };
+    printInStackOrder(buffer, Item{ this, nullptr }, [&buffer](const Item& item, std::vector<Item>& items) {
+        const ASTNode* node = item.node;
+        // Type of the token is checked, so it's cast without dynamic_cast
+        const Token* nodeToken = node->token.get();
+        if (nodeToken->getType() == TokenType::CONSTANT_VALUE) {
+            buffer.appendNumber(static_cast<const ConstantValueToken*>(nodeToken)->getValue());
+        } else if (nodeToken->getType() == TokenType::VARIABLE) {
+            buffer.append(static_cast<const VariableToken*>(nodeToken)->getName());
+        } else if (nodeToken->getType() == TokenType::OPERATOR) {
+            auto operatorToken = static_cast<const OperatorToken*>(nodeToken);
+            if (operatorToken->getArity() == 1) {
+                buffer.append(operatorToken->getSymbol());
+                const bool parenthesised = needsInfixParentheses(operatorToken, node->children[0]->token.get(), false);
+                if (parenthesised) items.push_back({ nullptr, ")" });
+                items.push_back({ node->children[0].get(), nullptr });
+                if (parenthesised) items.push_back({ nullptr, "(" });
+            } else if (operatorToken->getArity() == 2) {
+                const bool leftParenthesised = needsInfixParentheses(operatorToken, node->children[0]->token.get(), false);
+                const bool rightParenthesised = needsInfixParentheses(operatorToken, node->children[1]->token.get(), true);
+                if (rightParenthesised) items.push_back({ nullptr, ")" });
+                items.push_back({ node->children[1].get(), nullptr });
+                if (rightParenthesised) items.push_back({ nullptr, "(" });
+                items.push_back({ nullptr, BinaryOperatorTexts[operatorToken->getOperatorType()] });
+                if (leftParenthesised) items.push_back({ nullptr, ")" });
+                items.push_back({ node->children[0].get(), nullptr });
+                if (leftParenthesised) buffer.append('(');
+            } else {
+                throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
+            }
+        } else if (nodeToken->getType() == TokenType::FUNCTION) {
+            auto functionToken = static_cast<const FunctionToken*>(nodeToken);
+            if (functionToken->getArity() != 1) {
+                throw std::logic_error("Unsupported arity of function. Only unary are supported yet");
+            }
+            buffer.append(functionToken->getName());
+            buffer.append('(');
+            items.push_back({ nullptr, ")" });
+            items.push_back({ node->children[0].get(), nullptr });
+        } else {
+            throw std::logic_error("Unsupported token type");
+        }
+    });
+}
+
+std::string ASTNode::toInfix() const {
+    OutputBuffer buffer;
+    infixPrint(buffer);
+    return buffer.release();
 }
 
 static inline void connectWithOperands(std::stack<std::shared_ptr<ASTNode> >& astNodes, const std::shared_ptr<Token>& parentNodeToken);
 
 std::shared_ptr<ASTNode> buildAST(char* expression) {
-    return buildAST(tokenize(expression));
+    return buildASTIteratively(expression);
 }
 
 std::shared_ptr<ASTNode> buildAST(const std::vector<std::shared_ptr<Token> >& infixNotationTokens) {
@@ -274,3 +367,214 @@ static inline void connectWithOperands(std::stack<std::shared_ptr<ASTNode> >& as
         throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
     }
 }
+
+std::shared_ptr<ASTNode> copyAST(const std::shared_ptr<ASTNode>& root) {
+    assert(root != nullptr);
+
+    std::unordered_map<const ASTNode*, std::shared_ptr<ASTNode> > copies;
+    // Post-order traversal. Every element is a node and number of it's children that are already visited.
+    std::vector<std::pair<const ASTNode*, size_t> > nodes;
+    nodes.emplace_back(root.get(), 0);
+    while (!nodes.empty()) {
+        auto& top = nodes.back();
+        const ASTNode* node = top.first;
+        if (top.second < node->getChildrenNumber()) {
+            const ASTNode* child = node->getChildren()[top.second++].get();
+            if (copies.find(child) == copies.end()) {
+                nodes.emplace_back(child, 0);
+            }
+            continue;
+        }
+        nodes.pop_back();
+
+        const std::shared_ptr<ASTNode>* children = node->getChildren();
+        switch (node->getChildrenNumber()) {
+            case 0:
+                copies[node] = std::make_shared<ASTNode>(node->getToken());
+                break;
+            case 1:
+                copies[node] = std::make_shared<ASTNode>(node->getToken(), copies.at(children[0].get()));
+                break;
+            case 2:
+                copies[node] = std::make_shared<ASTNode>(node->getToken(), copies.at(children[0].get()), copies.at(children[1].get()));
+                break;
+            default:
+                throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
+        }
+    }
+    return copies.at(root.get());
+}
+
+/**
+ * Counts the reference to the shared node. Node is removed when all it's references are found.
+ */
+static inline void addSharedReferences(std::unordered_map<const ASTNode*, long>& references, const ASTNode* node,
+                                       long referencesNumber, long useCount) {
+    long& foundReferencesNumber = references[node];
+    foundReferencesNumber += referencesNumber;
+    if (foundReferencesNumber == useCount) {
+        references.erase(node);
+    }
+}
+
+std::unordered_map<std::shared_ptr<ASTNode>, bool> findLargeSubtrees(const std::shared_ptr<ASTNode>& root, size_t cutoff) {
+    assert(root != nullptr);
+
+    struct SharedNode {
+        size_t nodesNumber;
+        long useCount;
+    };
+
+    struct Subtree {
+        const std::shared_ptr<ASTNode>* node;
+        size_t visitedChildrenNumber;
+        size_t nodesNumber;
+        /** Found references to the shared nodes that also have references from outside of the subtree **/
+        std::unordered_map<const ASTNode*, long> sharedReferences;
+    };
+
+    std::unordered_map<std::shared_ptr<ASTNode>, bool> largeSubtrees;
+    /** Shared nodes are visited once, use count is saved before the node is added to largeSubtrees **/
+    std::unordered_map<const ASTNode*, SharedNode> sharedNodes;
+    // Post-order traversal, sizes and references of the children are added to the parent when they are finished
+    std::vector<Subtree> subtrees;
+    subtrees.push_back(Subtree{&root, 0, 1, {}});
+    while (true) {
+        Subtree& top = subtrees.back();
+        const ASTNode* node = top.node->get();
+        if (top.visitedChildrenNumber < node->getChildrenNumber()) {
+            const std::shared_ptr<ASTNode>* child = &node->getChildren()[top.visitedChildrenNumber++];
+            // Node with one reference can't be visited before, so shared nodes are looked up only for the others
+            const auto sharedNode = (child->use_count() > 1) ? sharedNodes.find(child->get()) : sharedNodes.end();
+            if (sharedNode != sharedNodes.end()) {
+                top.nodesNumber += sharedNode->second.nodesNumber;
+                addSharedReferences(top.sharedReferences, child->get(), 1, sharedNode->second.useCount);
+            } else {
+                subtrees.push_back(Subtree{child, 0, 1, {}});
+            }
+            continue;
+        }
+
+        Subtree subtree = std::move(top);
+        subtrees.pop_back();
+        if (subtrees.empty()) {
+            if (subtree.nodesNumber >= cutoff) {
+                largeSubtrees.emplace(root, subtree.sharedReferences.empty());
+            }
+            break;
+        }
+        const long useCount = subtree.node->use_count();
+        if (subtree.nodesNumber >= cutoff) {
+            largeSubtrees.emplace(*subtree.node, (useCount == 1) && subtree.sharedReferences.empty());
+        }
+
+        Subtree& parent = subtrees.back();
+        parent.nodesNumber += subtree.nodesNumber;
+        if (parent.sharedReferences.size() < subtree.sharedReferences.size()) {
+            parent.sharedReferences.swap(subtree.sharedReferences);
+        }
+        for (const auto& references : subtree.sharedReferences) {
+            addSharedReferences(parent.sharedReferences, references.first, references.second,
+                                sharedNodes.at(references.first).useCount);
+        }
+        if (useCount > 1) {
+            sharedNodes.emplace(subtree.node->get(), SharedNode{subtree.nodesNumber, useCount});
+            addSharedReferences(parent.sharedReferences, subtree.node->get(), 1, useCount);
+        }
+    }
+    return largeSubtrees;
+}
+
+static uint64_t hashToken(const Token* token) {
+    const uint64_t hash = (uint64_t)token->getType();
+    switch (token->getType()) {
+        case CONSTANT_VALUE: {
+            const double value = dynamic_cast<const ConstantValueToken*>(token)->getValue();
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return mixHash(hash, bits);
+        }
+        case VARIABLE:
+            return mixHash(hash, std::hash<std::string>()(dynamic_cast<const VariableToken*>(token)->getName()));
+        case OPERATOR:
+            return mixHash(hash, (uint64_t)dynamic_cast<const OperatorToken*>(token)->getOperatorType());
+        case FUNCTION:
+            return mixHash(hash, (uint64_t)dynamic_cast<const FunctionToken*>(token)->getFunctionType());
+        default:
+            return hash;
+    }
+}
+
+static bool tokensEqual(const Token* first, const Token* second) {
+    if (first == second) return true;
+    if (first->getType() != second->getType()) return false;
+    switch (first->getType()) {
+        case CONSTANT_VALUE: {
+            // Bitwise comparison, so hashes of equal constants are equal too
+            const double firstValue = dynamic_cast<const ConstantValueToken*>(first)->getValue();
+            const double secondValue = dynamic_cast<const ConstantValueToken*>(second)->getValue();
+            return memcmp(&firstValue, &secondValue, sizeof(double)) == 0;
+        }
+        case VARIABLE:
+            return strcmp(dynamic_cast<const VariableToken*>(first)->getName(),
+                          dynamic_cast<const VariableToken*>(second)->getName()) == 0;
+        case OPERATOR:
+            return dynamic_cast<const OperatorToken*>(first)->getOperatorType() ==
+                   dynamic_cast<const OperatorToken*>(second)->getOperatorType();
+        case FUNCTION:
+            return dynamic_cast<const FunctionToken*>(first)->getFunctionType() ==
+                   dynamic_cast<const FunctionToken*>(second)->getFunctionType();
+        default:
+            return false;
+    }
+}
+
+uint64_t ASTNode::getHash() const {
+    uint64_t rootHash = hash.load(std::memory_order_relaxed);
+    if (rootHash != 0) {
+        return rootHash;
+    }
+
+    // Post-order traversal of the nodes without hash. Every element is a node and number of it's children
+    // that are already visited. Concurrent calls may compute the same hash, they store equal values.
+    std::vector<std::pair<const ASTNode*, size_t> > nodes;
+    nodes.emplace_back(this, 0);
+    while (!nodes.empty()) {
+        auto& top = nodes.back();
+        const ASTNode* node = top.first;
+        if (top.second < node->childrenNumber) {
+            const ASTNode* child = node->children[top.second++].get();
+            if (child->hash.load(std::memory_order_relaxed) == 0) {
+                nodes.emplace_back(child, 0);
+            }
+            continue;
+        }
+        nodes.pop_back();
+
+        uint64_t nodeHash = hashToken(node->token.get());
+        for (size_t i = 0; i < node->childrenNumber; ++i) {
+            nodeHash = mixHash(nodeHash, node->children[i]->hash.load(std::memory_order_relaxed));
+        }
+        node->hash.store((nodeHash != 0) ? nodeHash : 1, std::memory_order_relaxed);
+    }
+    return hash.load(std::memory_order_relaxed);
+}
+
+bool ASTNode::structurallyEquals(const ASTNode& astNode) const {
+    std::vector<std::pair<const ASTNode*, const ASTNode*> > nodes;
+    nodes.emplace_back(this, &astNode);
+    while (!nodes.empty()) {
+        const ASTNode* first = nodes.back().first;
+        const ASTNode* second = nodes.back().second;
+        nodes.pop_back();
+        if (first == second) continue;
+        if ((first->getHash() != second->getHash()) || (first->childrenNumber != second->childrenNumber) ||
+            !tokensEqual(first->token.get(), second->token.get())) {
+            return false;
+        }
+        for (size_t i = 0; i < first->childrenNumber; ++i) {
+            nodes.emplace_back(first->children[i].get(), second->children[i].get());
+        }
+    }
+    return true;
+}
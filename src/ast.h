@@ -5,17 +5,57 @@
 #ifndef AST_BUILDER_AST_H
 #define AST_BUILDER_AST_H
 
+#include <atomic>
 #include <cassert>
 #include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "output_buffer.h"
 #include "tokenizer.h"
 
+/**
+ * What is done with the written graph or document.
+ */
+enum RenderMode {
+    NO_RENDER,       // Only the source file (e.g. DOT) is written
+    RENDER,          // Graph is rendered into a picture
+    RENDER_AND_VIEW, // Rendered file is also opened in the viewer
+};
+
+class ASTNode;
+
+/**
+ * Changes how ASTNode::dotPrint draws the nodes, e.g. colors them as a heatmap.
+ */
+class DotNodeStyler {
+
+public:
+    virtual ~DotNodeStyler() = default;
+
+    /**
+     * @return fill color of the node (e.g. "#FF8080") or nullptr for the default color of it's token type.
+     */
+    virtual const char* getFillColor(const ASTNode& node) const = 0;
+
+    /**
+     * Appends extra lines to the label of the node, every line starts with "\\n". Quotes must be escaped.
+     */
+    virtual void appendLabel(const ASTNode& node, OutputBuffer& label) const = 0;
+};
+
 class ASTNode {
 
 private:
     std::shared_ptr<ASTNode>* children = nullptr;
     size_t childrenNumber = 0;
     std::shared_ptr<Token> token;
+    /** Structural hash, 0 means it's not computed yet **/
+    mutable std::atomic<uint64_t> hash{0};
 
 public:
     explicit ASTNode(const std::shared_ptr<Token>& token_) {
@@ -59,6 +99,8 @@ public:
         std::swap(token, astNode.token);
         std::swap(childrenNumber, astNode.childrenNumber);
         std::swap(children, astNode.children);
+        hash.store(0, std::memory_order_relaxed);
+        astNode.hash.store(0, std::memory_order_relaxed);
     }
 
     ASTNode& operator=(ASTNode astNode) {
@@ -66,14 +108,25 @@ public:
         return *this;
     }
 
-    ~ASTNode() {
-        delete[] children;
-    }
+    ~ASTNode();
 
+    /**
+     * Children should be replaced with setChild, so the structural hash is reset.
+     */
     std::shared_ptr<ASTNode>* getChildren() const {
         return children;
     }
 
+    /**
+     * Replaces the child and resets the structural hash of the node. Hashes of the ancestors aren't reset, so
+     * the whole path from the root should be updated (optimizers do it because they visit every node).
+     */
+    void setChild(size_t index, const std::shared_ptr<ASTNode>& child) {
+        assert(index < childrenNumber);
+        children[index] = child;
+        hash.store(0, std::memory_order_relaxed);
+    }
+
     size_t getChildrenNumber() const {
         return childrenNumber;
     }
@@ -84,22 +137,141 @@ public:
 
     void print(int depth = 0) const;
 
-    void visualize(const char* fileName) const;
-    void texify(const char* fileName) const;
+    /**
+     * Writes the AST into <fileName>.dot and optionally renders it into <fileName>.svg (see svg_renderer.h).
+     * Viewer is launched in background, so the call doesn't wait for it.
+     * @param fileName      name of the files without extension
+     * @param renderMode    whether the graph is rendered and opened in the viewer
+     * @throws std::system_error if the file can't be written.
+     */
+    void visualize(const std::string& fileName, RenderMode renderMode = NO_RENDER) const;
+
+    /**
+     * Writes the AST into <fileName>.tex (see tex_writer.h) and optionally compiles it into <fileName>.pdf with pdflatex.
+     * Compilation and viewer are launched in background, so the call doesn't wait for them.
+     * @param fileName      name of the files without extension
+     * @param renderMode    whether the document is compiled and opened in the viewer
+     * @throws std::system_error if the file can't be written.
+     */
+    void texify(const std::string& fileName, RenderMode renderMode = NO_RENDER) const;
+
+    /**
+     * Writes the AST as a DOT graph. Traversal is iterative and output is buffered, so it works for graphs with
+     * millions of nodes. Node shared by several parents (e.g. in derivatives) is written once.
+     * @param dotFile   file to write the graph to
+     * @param styler    styler of the nodes or nullptr for the default colors
+     * @throws std::system_error if the file can't be written.
+     */
+    void dotPrint(FILE* dotFile, const DotNodeStyler* styler = nullptr) const;
+
+    /**
+     * Writes the AST as an infix expression that is parsed back into an equal tree. Parentheses are written only
+     * where precedence or associativity requires them. Exceptions: negative constants are read back as negation
+     * of a constant, and NaN constant can't be read back. Shared subtrees are written for every parent.
+     * @param buffer buffer to append the expression to
+     */
+    void infixPrint(OutputBuffer& buffer) const;
+
+    /**
+     * @return infix expression (see infixPrint).
+     */
+    std::string toInfix() const;
 
     double calculate() const;
 
-private:
-    enum TexBraceType { NONE, ROUND, CURLY };
+    /**
+     * Returns hash of the tokens and the shape of the subtree. It's computed on the first call (without recursion,
+     * only for the nodes that don't have it yet) and is cached. Can be called from several threads.
+     */
+    uint64_t getHash() const;
 
-    void dotPrint(FILE* dotFile, int& nodeId) const;
-    void texPrint(FILE* texFile, TexBraceType braceType = NONE) const;
+    /**
+     * Checks whether the subtrees have equal tokens and shapes. Stops on different hashes and on shared nodes.
+     */
+    bool structurallyEquals(const ASTNode& astNode) const;
+};
 
-    static TexBraceType getChildBraceType(const OperatorToken* parentOperator, const Token* child, bool isRightChild);
+/**
+ * Combines the hash with the next value. Is used by structural hash of AST and by the keys that are built on it.
+ */
+static inline uint64_t mixHash(uint64_t hash, uint64_t value) {
+    return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
+
+struct ASTNodeHash {
+    size_t operator()(const std::shared_ptr<ASTNode>& node) const {
+        return (size_t)node->getHash();
+    }
+};
+
+struct ASTNodeEqual {
+    bool operator()(const std::shared_ptr<ASTNode>& first, const std::shared_ptr<ASTNode>& second) const {
+        return first->structurallyEquals(*second);
+    }
 };
 
+/**
+ * Builds AST from the expression. Same as buildASTIteratively with default nesting depth limit.
+ * @param expression expression to parse
+ * @return root of the built AST.
+ * @throws SyntaxError if expression is invalid.
+ */
 std::shared_ptr<ASTNode> buildAST(char* expression);
 
+/**
+ * Builds AST from the tokens using shunting-yard algorithm.
+ * @param infixNotationTokens tokens of the expression (see tokenize)
+ * @return root of the built AST.
+ * @throws std::invalid_argument if parentheses or operands don't match.
+ */
 std::shared_ptr<ASTNode> buildAST(const std::vector<std::shared_ptr<Token> >& infixNotationTokens);
 
+/**
+ * Copies all nodes of the AST. Tokens are shared with the original because they are immutable.
+ * Nodes that are shared by several parents are copied once, so the copy has the same shape.
+ * Copy can be changed (e.g. by optimizers) without affecting the original.
+ * @param root root of the AST to copy
+ * @return root of the copy.
+ */
+std::shared_ptr<ASTNode> copyAST(const std::shared_ptr<ASTNode>& root);
+
+/**
+ * Prints the AST without recursion, so deep trees don't overflow the call stack. Items are printed in stack order,
+ * every item is either a node or a text between nodes: text is appended as is, node is printed by printNode, which
+ * appends the text before the children and pushes the children and the texts between them in reverse order.
+ * @param buffer    buffer to append the text to
+ * @param rootItem  item of the root, Item has fields node (nullptr for a text) and text
+ * @param printNode function that is called as printNode(item, items)
+ */
+template <typename Item, typename NodePrinter>
+void printInStackOrder(OutputBuffer& buffer, const Item& rootItem, NodePrinter printNode) {
+    std::vector<Item> items;
+    items.reserve(64);
+    items.push_back(rootItem);
+    while (!items.empty()) {
+        const Item item = items.back();
+        items.pop_back();
+        if (item.node == nullptr) {
+            buffer.append(item.text);
+        } else {
+            printNode(item, items);
+        }
+    }
+}
+
+/** Subtrees with fewer nodes are processed by one task in parallel differentiation and optimization **/
+static const size_t DEFAULT_PARALLEL_CUTOFF = 8 * 1024;
+
+/**
+ * Finds the subtrees that are large enough to be processed by separate tasks. Nodes are counted like recursive
+ * traversals visit them: node shared by several parents is counted for every parent.
+ * @param root      root of the AST
+ * @param cutoff    minimum number of nodes of the found subtrees
+ * @return roots of the found subtrees (the root of the AST too, if it's large enough) and whether the subtree is
+ * independent: it's nodes are referenced only from inside of it (except the root of the AST), so it can be changed
+ * by a separate thread. Subtree with nodes shared by it's own parents (e.g. derivative of division) is independent.
+ * Roots are kept alive by the map, so their addresses aren't reused while the AST is changed.
+ */
+std::unordered_map<std::shared_ptr<ASTNode>, bool> findLargeSubtrees(const std::shared_ptr<ASTNode>& root, size_t cutoff);
+
 #endif // AST_BUILDER_AST_H
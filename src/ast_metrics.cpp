@@ -0,0 +1,141 @@
+/**
+ * @file
+ * @brief Implementation of size metrics of AST
+ */
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "ast_metrics.h"
+
+/** Bytes of the control block of make_shared besides the object: vtable pointer and two reference counters **/
+static const size_t CONTROL_BLOCK_SIZE = sizeof(void*) + 2 * sizeof(int);
+
+static inline size_t addSaturated(size_t first, size_t second) {
+    return (first > SIZE_MAX - second) ? SIZE_MAX : first + second;
+}
+
+static size_t estimateTokenBytes(const Token* token) {
+    switch (token->getType()) {
+        case CONSTANT_VALUE:
+            return CONTROL_BLOCK_SIZE + sizeof(ConstantValueToken);
+        case VARIABLE:
+            return CONTROL_BLOCK_SIZE + sizeof(VariableToken) + VariableToken::MAX_NAME_LENGTH;
+        case OPERATOR:
+            return CONTROL_BLOCK_SIZE + sizeof(OperatorToken);
+        case FUNCTION:
+            return CONTROL_BLOCK_SIZE + sizeof(FunctionToken);
+        default:
+            throw std::logic_error("Unsupported token type");
+    }
+}
+
+/**
+ * Counts the distinct node in the histograms and in the estimated bytes. Token shared by several nodes is counted once.
+ */
+static void countNode(const ASTNode* node, std::unordered_set<const Token*>& tokens, ASTMetrics& metrics) {
+    const Token* token = node->getToken().get();
+    const bool newToken = tokens.insert(token).second;
+
+    metrics.estimatedBytes += CONTROL_BLOCK_SIZE + sizeof(ASTNode);
+    if (node->getChildrenNumber() > 0) { // Array of children is allocated with new[], so it has a size cookie
+        metrics.estimatedBytes += sizeof(size_t) + node->getChildrenNumber() * sizeof(std::shared_ptr<ASTNode>);
+    }
+    if (newToken) {
+        metrics.estimatedBytes += estimateTokenBytes(token);
+    }
+
+    switch (token->getType()) {
+        case CONSTANT_VALUE:
+            ++metrics.constantsNumber;
+            break;
+        case VARIABLE: // Variable tokens are unique per name (see VariableToken::getVariableByName)
+            if (newToken) ++metrics.variablesNumber;
+            break;
+        case OPERATOR:
+            ++metrics.operatorsNumbers[dynamic_cast<const OperatorToken*>(token)->getOperatorType()];
+            break;
+        case FUNCTION:
+            ++metrics.functionsNumbers[dynamic_cast<const FunctionToken*>(token)->getFunctionType()];
+            break;
+        default:
+            throw std::logic_error("Unsupported token type");
+    }
+}
+
+ASTMetrics computeASTMetrics(const std::shared_ptr<ASTNode>& root) {
+    assert(root != nullptr);
+
+    ASTMetrics metrics;
+    // Number of tree nodes and depth of the subtree of every visited node
+    std::unordered_map<const ASTNode*, std::pair<size_t, size_t> > subtrees;
+    std::unordered_set<const Token*> tokens;
+
+    // Post-order traversal. Every element is a node and number of it's children that are already visited.
+    std::vector<std::pair<const ASTNode*, size_t> > stack;
+    stack.emplace_back(root.get(), 0);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const ASTNode* node = top.first;
+        if (top.second < node->getChildrenNumber()) {
+            const ASTNode* child = node->getChildren()[top.second++].get();
+            if (subtrees.find(child) == subtrees.end()) {
+                stack.emplace_back(child, 0);
+            }
+            continue;
+        }
+        stack.pop_back();
+
+        size_t nodesNumber = 1;
+        size_t depth = 0;
+        for (size_t i = 0; i < node->getChildrenNumber(); ++i) {
+            const auto& subtree = subtrees.at(node->getChildren()[i].get());
+            nodesNumber = addSaturated(nodesNumber, subtree.first);
+            depth = std::max(depth, subtree.second);
+        }
+        subtrees.emplace(node, std::make_pair(nodesNumber, depth + 1));
+        countNode(node, tokens, metrics);
+    }
+
+    const auto& rootSubtree = subtrees.at(root.get());
+    metrics.nodesNumber = rootSubtree.first;
+    metrics.depth = rootSubtree.second;
+    metrics.uniqueNodesNumber = subtrees.size();
+    return metrics;
+}
+
+void printASTMetrics(FILE* file, const char* name, const ASTMetrics& metrics) {
+    fprintf(file, "%s: %zu nodes, %zu unique (sharing %.2f), depth %zu, %zu constants, %zu variables, ~%zu bytes\n",
+            name, metrics.nodesNumber, metrics.uniqueNodesNumber, metrics.getSharingRatio(), metrics.depth,
+            metrics.constantsNumber, metrics.variablesNumber, metrics.estimatedBytes);
+    fprintf(file, "%*s ", (int)strlen(name), "");
+    for (size_t i = 0; i < OPERATOR_TYPES_NUMBER; ++i) {
+        if (metrics.operatorsNumbers[i] > 0) fprintf(file, " %s %zu", OperatorTypeStrings[i], metrics.operatorsNumbers[i]);
+    }
+    for (size_t i = 0; i < FUNCTION_TYPES_NUMBER; ++i) {
+        if (metrics.functionsNumbers[i] > 0) fprintf(file, " %s %zu", FunctionTypeStrings[i], metrics.functionsNumbers[i]);
+    }
+    fprintf(file, "\n");
+}
+
+size_t countUniqueNodes(const std::vector<std::shared_ptr<ASTNode> >& roots) {
+    std::unordered_set<const ASTNode*> visitedNodes;
+    std::vector<const ASTNode*> stack;
+    for (const auto& root : roots) {
+        if (visitedNodes.insert(root.get()).second) stack.push_back(root.get());
+    }
+    while (!stack.empty()) {
+        const ASTNode* node = stack.back();
+        stack.pop_back();
+        for (size_t i = 0; i < node->getChildrenNumber(); ++i) {
+            const ASTNode* child = node->getChildren()[i].get();
+            if (visitedNodes.insert(child).second) stack.push_back(child);
+        }
+    }
+    return visitedNodes.size();
+}
@@ -0,0 +1,66 @@
+/**
+ * @file
+ * @brief Definition of size metrics of AST
+ *
+ * Metrics are computed in one iterative pass over the distinct nodes, so they are cheap even for derivatives whose
+ * trees are exponentially larger than the stored graph. They are used to reject or route pathological expressions
+ * and to track how derivatives grow.
+ */
+#ifndef AST_BUILDER_AST_METRICS_H
+#define AST_BUILDER_AST_METRICS_H
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "ast.h"
+
+static const size_t OPERATOR_TYPES_NUMBER = sizeof(OperatorTypeStrings) / sizeof(OperatorTypeStrings[0]);
+static const size_t FUNCTION_TYPES_NUMBER = sizeof(FunctionTypeStrings) / sizeof(FunctionTypeStrings[0]);
+
+struct ASTMetrics {
+    /** Number of nodes of the tree, node shared by several parents is counted for every parent. Saturates at SIZE_MAX **/
+    size_t nodesNumber = 0;
+    /** Number of distinct nodes, i.e. nodes that are actually stored **/
+    size_t uniqueNodesNumber = 0;
+    /** Number of nodes on the longest path from the root, depth of a single node is 1 **/
+    size_t depth = 0;
+    /** Number of distinct nodes of every operator and function type (indexed by OperatorType and FunctionType) **/
+    size_t operatorsNumbers[OPERATOR_TYPES_NUMBER] = {};
+    size_t functionsNumbers[FUNCTION_TYPES_NUMBER] = {};
+    /** Number of distinct constant nodes **/
+    size_t constantsNumber = 0;
+    /** Number of distinct variables **/
+    size_t variablesNumber = 0;
+    /** Estimated heap bytes held by the distinct nodes, their children arrays and tokens **/
+    size_t estimatedBytes = 0;
+
+    /**
+     * @return number of tree nodes per stored node: 1 if nothing is shared, larger if subtrees are shared.
+     */
+    double getSharingRatio() const {
+        return (uniqueNodesNumber == 0) ? 1.0 : (double)nodesNumber / (double)uniqueNodesNumber;
+    }
+};
+
+/**
+ * Computes metrics of the AST without recursion, every distinct node is visited once.
+ * @param root root of the AST
+ * @return metrics of the AST.
+ */
+ASTMetrics computeASTMetrics(const std::shared_ptr<ASTNode>& root);
+
+/**
+ * Prints the metrics in two lines: sizes and histogram of operators and functions (only the present ones).
+ * @param file      file to print to
+ * @param name      name of the AST, e.g. "expression"
+ * @param metrics   metrics to print
+ */
+void printASTMetrics(FILE* file, const char* name, const ASTMetrics& metrics);
+
+/**
+ * @return number of distinct nodes of the ASTs, nodes shared by several of them are counted once.
+ */
+size_t countUniqueNodes(const std::vector<std::shared_ptr<ASTNode> >& roots);
+
+#endif // AST_BUILDER_AST_METRICS_H
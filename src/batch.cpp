@@ -0,0 +1,206 @@
+/**
+ * @file
+ * @brief Implementation of batch processing of expressions
+ */
+#include <cassert>
+#include <cmath>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include "ast_metrics.h"
+#include "batch.h"
+#include "compiled_expression.h"
+#include "output_buffer.h"
+#include "thread_pool.h"
+#include "tracing.h"
+
+/** Number of lines that are read and processed together. Results of a chunk are written when it's finished. **/
+static const size_t CHUNK_SIZE = 4096;
+
+struct ExpressionResult {
+    std::string output;
+    bool failed = false;
+};
+
+static void appendFormat(std::string& output, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendFormat(std::string& output, const char* format, ...) {
+    char buffer[64];
+    va_list arguments;
+    va_start(arguments, format);
+    const int length = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    assert((length >= 0) && ((size_t)length < sizeof(buffer)));
+    output.append(buffer, length);
+}
+
+/**
+ * Appends the value like the other writers do (see OutputBuffer::appendNumber). JSON has no NaN, so it's written as null.
+ */
+static void appendNumber(std::string& output, double value) {
+    if (std::isnan(value)) {
+        output += "null";
+        return;
+    }
+    OutputBuffer number;
+    number.appendNumber(value);
+    output += number.getString();
+}
+
+static void appendString(std::string& output, const char* string) {
+    output += '"';
+    for (const char* symbol = string; *symbol != '\0'; ++symbol) {
+        if ((*symbol == '"') || (*symbol == '\\')) {
+            output += '\\';
+            output += *symbol;
+        } else if ((unsigned char)*symbol < 0x20) {
+            appendFormat(output, "\\u%04x", (unsigned)*symbol);
+        } else {
+            output += *symbol;
+        }
+    }
+    output += '"';
+}
+
+/**
+ * Evaluates the expression if all it's variables have values.
+ */
+static void appendValue(std::string& output, const CompiledExpression& expression, const BatchOptions& options) {
+    std::vector<double> values;
+    for (const std::string& variable : expression.getVariables()) {
+        bool found = false;
+        for (const auto& variableValue : options.variableValues) {
+            if (variableValue.first == variable) {
+                values.push_back(variableValue.second);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            output += "null";
+            return;
+        }
+    }
+    appendNumber(output, expression.evaluate(values.data()));
+}
+
+static void processExpression(const std::string& expression, size_t lineNumber,
+                              ExpressionCache& cache, const BatchOptions& options, ExpressionResult& result) {
+    std::string& output = result.output;
+    output.clear();
+    result.failed = false;
+    appendFormat(output, "{\"line\":%zu,", lineNumber);
+
+    const size_t prefixLength = output.size();
+    try {
+        ParseError error(NO_ERROR, 0);
+        std::shared_ptr<const CachedExpression> cachedExpression =
+                cache.get(expression.c_str(), options.differentiatedVariable, options.optimized, error);
+        if (cachedExpression == nullptr) {
+            output += "\"error\":{\"code\":";
+            appendString(output, ParseErrorCodeStrings[error.code]);
+            appendFormat(output, ",\"position\":%zu,\"message\":", error.position);
+            appendString(output, error.getMessage());
+            output += "}}";
+            result.failed = true;
+            return;
+        }
+
+        appendFormat(output, "\"nodes\":%zu,\"value\":", countUniqueNodes({ cachedExpression->root }));
+        appendValue(output, cachedExpression->expression, options);
+        if (cachedExpression->derivative != nullptr) {
+            output += ",\"derivative\":";
+            appendString(output, cachedExpression->derivative->toInfix().c_str());
+            appendFormat(output, ",\"derivative_nodes\":%zu,\"derivative_value\":", countUniqueNodes({ cachedExpression->derivative }));
+            appendValue(output, *cachedExpression->derivativeExpression, options);
+        }
+        output += '}';
+    } catch (const std::logic_error& ex) {
+        output.resize(prefixLength);
+        output += "\"error\":{\"code\":\"UNSUPPORTED_OPERATION\",\"message\":";
+        appendString(output, ex.what());
+        output += "}}";
+        result.failed = true;
+    }
+}
+
+/**
+ * Reads the next line without the line break.
+ * @return false if the input is over.
+ */
+static bool readLine(FILE* input, std::string& line) {
+    line.clear();
+    int symbol;
+    while (((symbol = fgetc_unlocked(input)) != EOF) && (symbol != '\n')) {
+        line += (char)symbol;
+    }
+    if ((symbol == EOF) && line.empty()) {
+        return false;
+    }
+    if (!line.empty() && (line.back() == '\r')) {
+        line.pop_back();
+    }
+    return true;
+}
+
+BatchStatistics runBatch(FILE* input, FILE* output, const BatchOptions& options) {
+    assert(input != nullptr);
+    assert(output != nullptr);
+
+    ExpressionCache cache(options.cacheCapacity, options.cacheDirectory, options.maxDepth);
+    ThreadPool pool(options.threadsNumber);
+    BatchStatistics statistics;
+
+    std::vector<std::string> lines(CHUNK_SIZE);
+    std::vector<ExpressionResult> results(CHUNK_SIZE);
+    bool inputIsOver = false;
+    while (!inputIsOver) {
+        size_t linesNumber = 0;
+        while ((linesNumber < CHUNK_SIZE) && !(inputIsOver = !readLine(input, lines[linesNumber]))) {
+            ++linesNumber;
+        }
+
+        TRACE_SCOPE("batch chunk");
+        const size_t firstLineNumber = statistics.expressionsNumber + 1;
+        TaskGroup tasks(pool);
+        for (size_t i = 0; i < linesNumber; ++i) {
+            tasks.run([&, i]() {
+                TRACE_SCOPE("batch expression");
+                processExpression(lines[i], firstLineNumber + i, cache, options, results[i]);
+            });
+        }
+        tasks.wait();
+
+        for (size_t i = 0; i < linesNumber; ++i) {
+            if (results[i].failed) ++statistics.errorsNumber;
+            fputs(results[i].output.c_str(), output);
+            fputc('\n', output);
+        }
+        statistics.expressionsNumber += linesNumber;
+    }
+    fflush(output);
+    statistics.cacheStatistics = cache.getStatistics();
+    return statistics;
+}
+
+std::vector<std::pair<std::string, double> > parseVariableValues(const char* values) {
+    assert(values != nullptr);
+
+    std::vector<std::pair<std::string, double> > variableValues;
+    const char* position = values;
+    while (*position != '\0') {
+        const char* nameEnd = strchr(position, '=');
+        if ((nameEnd == nullptr) || (nameEnd == position)) {
+            throw std::invalid_argument("Variable value should look like 'name=value'");
+        }
+        char* valueEnd = nullptr;
+        const double value = strtod(nameEnd + 1, &valueEnd);
+        if ((valueEnd == nameEnd + 1) || ((*valueEnd != ',') && (*valueEnd != '\0'))) {
+            throw std::invalid_argument("Invalid variable value");
+        }
+        variableValues.emplace_back(std::string(position, nameEnd), value);
+        position = (*valueEnd == ',') ? valueEnd + 1 : valueEnd;
+    }
+    return variableValues;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file
+ * @brief Definition of batch processing of expressions
+ *
+ * Batch reads newline-delimited expressions and processes them in parallel. Every expression is parsed,
+ * optimized (optionally), differentiated and evaluated. Results are written as JSON lines in input order:
+ *
+ *     {"line":1,"nodes":5,"value":3,"derivative":"2 * x","derivative_nodes":3,"derivative_value":2}
+ *     {"line":2,"error":{"code":"INVALID_SYMBOL","position":4,"message":"Invalid symbol"}}
+ *
+ * Value is null if the expression contains a variable without a value or if it's NaN. Infinities are written
+ * as 1e999 and -1e999 like in the other outputs.
+ * Repeated expressions are taken from the expression cache instead of being processed again.
+ */
+#ifndef AST_BUILDER_BATCH_H
+#define AST_BUILDER_BATCH_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include "expression_cache.h"
+#include "iterative_parser.h"
+
+struct BatchOptions {
+    /** Number of worker threads, 0 means number of hardware threads **/
+    size_t threadsNumber = 0;
+    bool optimized = false;
+    const char* differentiatedVariable = "x";
+    /** Values of the variables used for evaluation **/
+    std::vector<std::pair<std::string, double> > variableValues;
+    size_t maxDepth = DEFAULT_MAX_NESTING_DEPTH;
+    /** Number of cached expressions, 0 disables the cache **/
+    size_t cacheCapacity = DEFAULT_CACHE_CAPACITY;
+    /** Directory for spilled cache artifacts, empty string disables spilling **/
+    std::string cacheDirectory;
+};
+
+struct BatchStatistics {
+    size_t expressionsNumber = 0;
+    size_t errorsNumber = 0;
+    ExpressionCacheStatistics cacheStatistics;
+};
+
+/**
+ * Processes all the expressions of the input.
+ * @param input     input with one expression per line
+ * @param output    output for the results
+ * @param options   options of processing
+ * @return number of processed expressions and number of errors.
+ */
+BatchStatistics runBatch(FILE* input, FILE* output, const BatchOptions& options);
+
+/**
+ * Parses values of the variables like "x=1,y=2.5".
+ * @param values    values to parse
+ * @return pairs of names and values.
+ * @throws std::invalid_argument if values are invalid.
+ */
+std::vector<std::pair<std::string, double> > parseVariableValues(const char* values);
+
+#endif // AST_BUILDER_BATCH_H
@@ -0,0 +1,300 @@
+/**
+ * @file
+ * @brief Implementation of compact binary format of AST
+ */
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include "binary_ast.h"
+
+static const char BINARY_AST_MAGIC[4] = { 'A', 'S', 'T', 'B' };
+
+static const size_t OPERATORS_NUMBER = sizeof(OperatorTypeStrings) / sizeof(OperatorTypeStrings[0]);
+static const size_t FUNCTIONS_NUMBER = sizeof(FunctionTypeStrings) / sizeof(FunctionTypeStrings[0]);
+
+static BinaryASTNode encodeNode(const ASTNode* node, const std::unordered_map<const ASTNode*, uint32_t>& indices,
+                                std::unordered_map<std::string, uint32_t>& nameOffsets, std::string& strings) {
+    BinaryASTNode binaryNode = {};
+    const Token* token = node->getToken().get();
+    binaryNode.kind = (uint8_t)token->getType();
+    binaryNode.childrenNumber = (uint16_t)node->getChildrenNumber();
+
+    switch (token->getType()) {
+        case CONSTANT_VALUE:
+            binaryNode.value = dynamic_cast<const ConstantValueToken*>(token)->getValue();
+            return binaryNode;
+        case VARIABLE: {
+            const char* name = dynamic_cast<const VariableToken*>(token)->getName();
+            auto nameOffset = nameOffsets.find(name);
+            if (nameOffset == nameOffsets.end()) {
+                nameOffset = nameOffsets.emplace(name, (uint32_t)strings.size()).first;
+                strings.append(name, strlen(name) + 1);
+            }
+            binaryNode.nameOffset = nameOffset->second;
+            return binaryNode;
+        }
+        case OPERATOR:
+            binaryNode.subtype = (uint8_t)dynamic_cast<const OperatorToken*>(token)->getOperatorType();
+            break;
+        case FUNCTION:
+            binaryNode.subtype = (uint8_t)dynamic_cast<const FunctionToken*>(token)->getFunctionType();
+            break;
+        default:
+            throw std::logic_error("Unsupported token type");
+    }
+
+    for (size_t i = 0; i < node->getChildrenNumber(); ++i) {
+        binaryNode.children[i] = indices.at(node->getChildren()[i].get());
+    }
+    return binaryNode;
+}
+
+std::string serializeAST(const std::shared_ptr<ASTNode>& root) {
+    assert(root != nullptr);
+
+    std::vector<BinaryASTNode> nodes;
+    std::string strings;
+    std::unordered_map<const ASTNode*, uint32_t> indices;
+    std::unordered_map<std::string, uint32_t> nameOffsets;
+
+    // Post-order traversal. Every element is a node and number of it's children that are already visited.
+    std::vector<std::pair<const ASTNode*, size_t> > stack;
+    stack.emplace_back(root.get(), 0);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const ASTNode* node = top.first;
+        if (top.second < node->getChildrenNumber()) {
+            const ASTNode* child = node->getChildren()[top.second++].get();
+            if (indices.find(child) == indices.end()) {
+                stack.emplace_back(child, 0);
+            }
+            continue;
+        }
+        stack.pop_back();
+
+        nodes.push_back(encodeNode(node, indices, nameOffsets, strings));
+        indices.emplace(node, (uint32_t)(nodes.size() - 1));
+    }
+
+    BinaryASTHeader header = {};
+    memcpy(header.magic, BINARY_AST_MAGIC, sizeof(header.magic));
+    header.version = BINARY_AST_VERSION;
+    header.nodesNumber = (uint32_t)nodes.size();
+    header.rootIndex = (uint32_t)(nodes.size() - 1);
+    header.stringsOffset = sizeof(BinaryASTHeader) + nodes.size() * sizeof(BinaryASTNode);
+    header.stringsSize = strings.size();
+
+    std::string data;
+    data.reserve(header.stringsOffset + strings.size());
+    data.append((const char*)&header, sizeof(header));
+    data.append((const char*)nodes.data(), nodes.size() * sizeof(BinaryASTNode));
+    data.append(strings);
+    return data;
+}
+
+void saveAST(const std::shared_ptr<ASTNode>& root, const char* fileName) {
+    assert(fileName != nullptr);
+
+    const std::string data = serializeAST(root);
+    FILE* file = fopen(fileName, "wb");
+    if (file == nullptr) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    const int writeError = errno;
+    const bool closed = fclose(file) == 0;
+    if (!written || !closed) {
+        throw std::system_error(written ? errno : writeError, std::generic_category(), fileName);
+    }
+}
+
+ASTView::ASTView(const char* data, size_t size) {
+    if ((data == nullptr) || (size < sizeof(BinaryASTHeader))) {
+        throw std::invalid_argument("Binary AST is too small");
+    }
+    if ((uintptr_t)data % alignof(BinaryASTNode) != 0) {
+        throw std::invalid_argument("Binary AST is not aligned");
+    }
+    header = (const BinaryASTHeader*)data;
+    nodes = (const BinaryASTNode*)(data + sizeof(BinaryASTHeader));
+    validate(size);
+    strings = data + header->stringsOffset;
+}
+
+/**
+ * Checks everything that is used by the view without further checks, so invalid file can't make it read
+ * outside of the data or loop forever.
+ */
+void ASTView::validate(size_t size) const {
+    if (memcmp(header->magic, BINARY_AST_MAGIC, sizeof(header->magic)) != 0) {
+        throw std::invalid_argument("Not a binary AST");
+    }
+    if (header->version != BINARY_AST_VERSION) {
+        throw std::invalid_argument("Unsupported version of binary AST");
+    }
+    if ((header->nodesNumber == 0) || (header->rootIndex >= header->nodesNumber)) {
+        throw std::invalid_argument("Invalid root of binary AST");
+    }
+    const uint64_t nodesEnd = sizeof(BinaryASTHeader) + (uint64_t)header->nodesNumber * sizeof(BinaryASTNode);
+    if ((header->stringsOffset != nodesEnd) || (header->stringsSize > size) || (nodesEnd > size - header->stringsSize)) {
+        throw std::invalid_argument("Invalid size of binary AST");
+    }
+    const char* stringTable = (const char*)header + header->stringsOffset;
+    if ((header->stringsSize > 0) && (stringTable[header->stringsSize - 1] != '\0')) {
+        throw std::invalid_argument("Invalid string table of binary AST");
+    }
+
+    for (uint32_t i = 0; i < header->nodesNumber; ++i) {
+        const BinaryASTNode& node = nodes[i];
+        size_t expectedChildrenNumber = 0;
+        switch (node.kind) {
+            case CONSTANT_VALUE:
+                break;
+            case VARIABLE:
+                // Names are copied into tokens with the fixed size buffer, so they must fit it with the terminator
+                if ((node.nameOffset >= header->stringsSize) ||
+                    (strnlen(stringTable + node.nameOffset, VariableToken::MAX_NAME_LENGTH) == VariableToken::MAX_NAME_LENGTH)) {
+                    throw std::invalid_argument("Invalid variable name in binary AST");
+                }
+                break;
+            case OPERATOR:
+                if (node.subtype >= OPERATORS_NUMBER) {
+                    throw std::invalid_argument("Invalid operator in binary AST");
+                }
+                expectedChildrenNumber = ((node.subtype == ARITHMETIC_NEGATION) || (node.subtype == UNARY_ADDITION)) ? 1 : 2;
+                break;
+            case FUNCTION:
+                if (node.subtype >= FUNCTIONS_NUMBER) {
+                    throw std::invalid_argument("Invalid function in binary AST");
+                }
+                expectedChildrenNumber = 1;
+                break;
+            default:
+                throw std::invalid_argument("Invalid node kind in binary AST");
+        }
+        if (node.childrenNumber != expectedChildrenNumber) {
+            throw std::invalid_argument("Invalid number of children in binary AST");
+        }
+        for (size_t j = 0; j < node.childrenNumber; ++j) {
+            if (node.children[j] >= i) { // Post-order also guarantees there are no cycles
+                throw std::invalid_argument("Invalid child index in binary AST");
+            }
+        }
+    }
+}
+
+static double applyOperator(OperatorType operatorType, double leftOperand, double rightOperand) {
+    switch (operatorType) {
+        case ADDITION:            return leftOperand + rightOperand;
+        case SUBTRACTION:         return leftOperand - rightOperand;
+        case MULTIPLICATION:      return leftOperand * rightOperand;
+        case DIVISION:            return leftOperand / rightOperand;
+        case POWER:               return pow(leftOperand, rightOperand);
+        case ARITHMETIC_NEGATION: return -leftOperand;
+        case UNARY_ADDITION:      return leftOperand;
+    }
+    throw std::logic_error("Unsupported operator type");
+}
+
+static double applyFunction(FunctionType functionType, double operand) {
+    switch (functionType) {
+        case SIN: return sin(operand);
+        case COS: return cos(operand);
+        case TG:  return tan(operand);
+        case CTG: return 1. / tan(operand);
+        case LN:  return log(operand);
+    }
+    throw std::logic_error("Unsupported function type");
+}
+
+double ASTView::evaluate(const std::vector<std::pair<std::string, double> >& variableValues) const {
+    // Names are stored once, so variables can be found by the offset of their name
+    std::unordered_map<uint32_t, double> valuesByOffset;
+    std::vector<double> values(header->rootIndex + 1);
+    for (uint32_t i = 0; i <= header->rootIndex; ++i) {
+        const BinaryASTNode& node = nodes[i];
+        switch (node.kind) {
+            case CONSTANT_VALUE:
+                values[i] = node.value;
+                break;
+            case VARIABLE: {
+                auto value = valuesByOffset.find(node.nameOffset);
+                if (value == valuesByOffset.end()) {
+                    const char* name = getVariableName(node);
+                    size_t j = 0;
+                    while ((j < variableValues.size()) && (variableValues[j].first != name)) ++j;
+                    if (j == variableValues.size()) {
+                        throw std::invalid_argument(std::string("Variable '") + name + "' has no value");
+                    }
+                    value = valuesByOffset.emplace(node.nameOffset, variableValues[j].second).first;
+                }
+                values[i] = value->second;
+                break;
+            }
+            case OPERATOR:
+                values[i] = applyOperator((OperatorType)node.subtype, values[node.children[0]],
+                                          (node.childrenNumber == 2) ? values[node.children[1]] : 0.);
+                break;
+            default:
+                values[i] = applyFunction((FunctionType)node.subtype, values[node.children[0]]);
+                break;
+        }
+    }
+    return values[header->rootIndex];
+}
+
+static std::shared_ptr<Token> createToken(const ASTView& view, const BinaryASTNode& node) {
+    static const std::shared_ptr<Token> functions[] = {
+        std::make_shared<SinFunction>(),
+        std::make_shared<CosFunction>(),
+        std::make_shared<TgFunction>(),
+        std::make_shared<CtgFunction>(),
+        std::make_shared<LnFunction>(),
+    };
+
+    switch (node.kind) {
+        case CONSTANT_VALUE:
+            return std::make_shared<ConstantValueToken>(node.value);
+        case VARIABLE:
+            return VariableToken::getVariableByName((char*)view.getVariableName(node));
+        case FUNCTION:
+            return functions[node.subtype];
+        default:
+            break;
+    }
+    switch ((OperatorType)node.subtype) {
+        case ADDITION:            return std::make_shared<AdditionOperator>();
+        case SUBTRACTION:         return std::make_shared<SubtractionOperator>();
+        case MULTIPLICATION:      return std::make_shared<MultiplicationOperator>();
+        case DIVISION:            return std::make_shared<DivisionOperator>();
+        case POWER:               return std::make_shared<PowerOperator>();
+        case ARITHMETIC_NEGATION: return std::make_shared<ArithmeticNegationOperator>();
+        case UNARY_ADDITION:      return std::make_shared<UnaryAdditionOperator>();
+    }
+    throw std::logic_error("Unsupported operator type");
+}
+
+std::shared_ptr<ASTNode> ASTView::toAST() const {
+    std::vector<std::shared_ptr<ASTNode> > astNodes(header->rootIndex + 1);
+    for (uint32_t i = 0; i <= header->rootIndex; ++i) {
+        const BinaryASTNode& node = nodes[i];
+        const std::shared_ptr<Token> token = createToken(*this, node);
+        switch (node.childrenNumber) {
+            case 0:
+                astNodes[i] = std::make_shared<ASTNode>(token);
+                break;
+            case 1:
+                astNodes[i] = std::make_shared<ASTNode>(token, astNodes[node.children[0]]);
+                break;
+            default:
+                astNodes[i] = std::make_shared<ASTNode>(token, astNodes[node.children[0]], astNodes[node.children[1]]);
+                break;
+        }
+    }
+    return astNodes[header->rootIndex];
+}
@@ -0,0 +1,146 @@
+/**
+ * @file
+ * @brief Definition of compact binary format of AST
+ *
+ * Binary AST is a header, a table of nodes and a table of strings:
+ *
+ *     header   : magic "ASTB", version, number of nodes, index of the root, offset and size of the string table
+ *     nodes    : 16-byte nodes in post-order (children always go before their parents)
+ *     strings  : null-terminated variable names, every name is stored once
+ *
+ * Node shared by several parents (derivatives are DAGs) is stored once. Format uses native byte order and
+ * is designed to be used in place: ASTView reads nodes right from the memory (e.g. from a memory-mapped file),
+ * evaluates or traverses them without building ASTNode objects.
+ */
+#ifndef AST_BUILDER_BINARY_AST_H
+#define AST_BUILDER_BINARY_AST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ast.h"
+#include "mapped_file.h"
+
+static constexpr uint16_t BINARY_AST_VERSION = 1;
+
+struct BinaryASTHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t nodesNumber;
+    uint32_t rootIndex;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+struct BinaryASTNode {
+    /** TokenType of the node **/
+    uint8_t kind;
+    /** OperatorType or FunctionType of the node **/
+    uint8_t subtype;
+    uint16_t childrenNumber;
+    /** Offset of the variable name in the string table **/
+    uint32_t nameOffset;
+    union {
+        double value;
+        uint32_t children[2];
+    };
+};
+
+static_assert(sizeof(BinaryASTHeader) == 32, "Binary AST header should be packed");
+static_assert(sizeof(BinaryASTNode) == 16, "Binary AST node should be packed");
+
+/**
+ * Encodes the AST.
+ * @param root root of the AST
+ * @return binary AST.
+ */
+std::string serializeAST(const std::shared_ptr<ASTNode>& root);
+
+/**
+ * Writes the binary AST into the file.
+ * @param root      root of the AST
+ * @param fileName  name of the file
+ * @throws std::system_error if the file can't be written.
+ */
+void saveAST(const std::shared_ptr<ASTNode>& root, const char* fileName);
+
+/**
+ * Read-only view of the binary AST. Doesn't copy the data, so the memory should live while the view is used.
+ */
+class ASTView {
+
+private:
+    const BinaryASTHeader* header = nullptr;
+    const BinaryASTNode* nodes = nullptr;
+    const char* strings = nullptr;
+
+    void validate(size_t size) const;
+
+public:
+    /**
+     * Checks the binary AST and creates the view.
+     * @param data  start of the binary AST (should be aligned to 8 bytes)
+     * @param size  size of the binary AST
+     * @throws std::invalid_argument if data is not a valid binary AST.
+     */
+    ASTView(const char* data, size_t size);
+
+    size_t getNodesNumber() const {
+        return header->nodesNumber;
+    }
+
+    size_t getRootIndex() const {
+        return header->rootIndex;
+    }
+
+    const BinaryASTNode& getNode(size_t index) const {
+        return nodes[index];
+    }
+
+    const char* getVariableName(const BinaryASTNode& node) const {
+        return strings + node.nameOffset;
+    }
+
+    /**
+     * Evaluates the AST in one pass over the node table.
+     * @param variableValues values of the variables
+     * @return value of the AST.
+     * @throws std::invalid_argument if some variable has no value.
+     */
+    double evaluate(const std::vector<std::pair<std::string, double> >& variableValues = {}) const;
+
+    /**
+     * Builds ASTNode objects (e.g. to differentiate or optimize the AST). Shared nodes stay shared.
+     * @return root of the AST.
+     */
+    std::shared_ptr<ASTNode> toAST() const;
+};
+
+/**
+ * Binary AST file that is memory-mapped and is used in place.
+ */
+class MappedAST {
+
+private:
+    MappedFile file;
+    ASTView view;
+
+public:
+    /**
+     * Maps the file.
+     * @param fileName name of the file
+     * @throws std::system_error if the file can't be mapped.
+     * @throws std::invalid_argument if it's not a valid binary AST.
+     */
+    explicit MappedAST(const char* fileName) : file(fileName), view(file.begin(), file.getSize()) { }
+
+    const ASTView& getView() const {
+        return view;
+    }
+};
+
+#endif // AST_BUILDER_BINARY_AST_H
@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @brief Implementation of compiled expression
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include "compiled_expression.h"
+
+/** Stack of this size is allocated on the call stack of evaluate, bigger ones are allocated on the heap. **/
+static const size_t LOCAL_STACK_SIZE = 64;
+/** Number of rows evaluated together by evaluateColumns **/
+static const size_t BLOCK_SIZE = 256;
+
+CompiledExpression::CompiledExpression(const std::shared_ptr<ASTNode>& root) {
+    assert(root != nullptr);
+
+    // Post-order traversal. Every element is a node and number of it's children that are already compiled.
+    std::vector<std::pair<const ASTNode*, size_t> > nodes;
+    nodes.emplace_back(root.get(), 0);
+    size_t stackSize = 0;
+    while (!nodes.empty()) {
+        auto& top = nodes.back();
+        if (top.second < top.first->getChildrenNumber()) {
+            const ASTNode* child = top.first->getChildren()[top.second].get();
+            ++top.second;
+            nodes.emplace_back(child, 0);
+            continue;
+        }
+
+        const ASTNode* node = top.first;
+        nodes.pop_back();
+        addInstruction(node);
+
+        // Node pops it's operands and pushes the result
+        stackSize = stackSize - node->getChildrenNumber() + 1;
+        if (stackSize > maxStackSize) maxStackSize = stackSize;
+    }
+}
+
+void CompiledExpression::addInstruction(const ASTNode* node) {
+    const Token* token = node->getToken().get();
+    Instruction instruction = {PUSH_CONSTANT, 0, 0.};
+
+    switch (token->getType()) {
+        case TokenType::CONSTANT_VALUE:
+            instruction.value = dynamic_cast<const ConstantValueToken*>(token)->getValue();
+            break;
+        case TokenType::VARIABLE: {
+            const char* name = dynamic_cast<const VariableToken*>(token)->getName();
+            instruction.opcode = PUSH_VARIABLE;
+            instruction.variableIndex = getVariableIndex(name);
+            if (instruction.variableIndex == SIZE_MAX) {
+                instruction.variableIndex = variables.size();
+                variables.emplace_back(name);
+            }
+            break;
+        }
+        case TokenType::OPERATOR:
+            switch (dynamic_cast<const OperatorToken*>(token)->getOperatorType()) {
+                case ADDITION:            instruction.opcode = ADD; break;
+                case SUBTRACTION:         instruction.opcode = SUBTRACT; break;
+                case MULTIPLICATION:      instruction.opcode = MULTIPLY; break;
+                case DIVISION:            instruction.opcode = DIVIDE; break;
+                case ARITHMETIC_NEGATION: instruction.opcode = NEGATE; break;
+                case POWER:               instruction.opcode = RAISE; break;
+                case UNARY_ADDITION:      return; // Operand is already on the stack
+            }
+            break;
+        case TokenType::FUNCTION:
+            switch (dynamic_cast<const FunctionToken*>(token)->getFunctionType()) {
+                case SIN: instruction.opcode = CALL_SIN; break;
+                case COS: instruction.opcode = CALL_COS; break;
+                case TG:  instruction.opcode = CALL_TG; break;
+                case CTG: instruction.opcode = CALL_CTG; break;
+                case LN:  instruction.opcode = CALL_LN; break;
+            }
+            break;
+        default:
+            throw std::logic_error("Parenthesis can't be calculated");
+    }
+    program.push_back(instruction);
+}
+
+size_t CompiledExpression::getVariableIndex(const char* name) const {
+    for (size_t i = 0; i < variables.size(); ++i) {
+        if (strcmp(variables[i].c_str(), name) == 0) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+double CompiledExpression::evaluate(const double* variableValues) const {
+    assert((variableValues != nullptr) || variables.empty());
+
+    double localStack[LOCAL_STACK_SIZE];
+    std::vector<double> heapStack;
+    double* stack = localStack;
+    if (maxStackSize > LOCAL_STACK_SIZE) {
+        heapStack.resize(maxStackSize);
+        stack = heapStack.data();
+    }
+
+    size_t top = 0; // Index of the first free element
+    for (const Instruction& instruction : program) {
+        switch (instruction.opcode) {
+            case PUSH_CONSTANT: stack[top++] = instruction.value; break;
+            case PUSH_VARIABLE: stack[top++] = variableValues[instruction.variableIndex]; break;
+            case NEGATE:        stack[top - 1] = -stack[top - 1]; break;
+            case ADD:           --top; stack[top - 1] += stack[top]; break;
+            case SUBTRACT:      --top; stack[top - 1] -= stack[top]; break;
+            case MULTIPLY:      --top; stack[top - 1] *= stack[top]; break;
+            case DIVIDE:        --top; stack[top - 1] /= stack[top]; break;
+            case RAISE:         --top; stack[top - 1] = pow(stack[top - 1], stack[top]); break;
+            case CALL_SIN:      stack[top - 1] = sin(stack[top - 1]); break;
+            case CALL_COS:      stack[top - 1] = cos(stack[top - 1]); break;
+            case CALL_TG:       stack[top - 1] = tan(stack[top - 1]); break;
+            case CALL_CTG:      stack[top - 1] = 1. / tan(stack[top - 1]); break;
+            case CALL_LN:       stack[top - 1] = log(stack[top - 1]); break;
+        }
+    }
+    assert(top == 1);
+    return stack[top - 1];
+}
+
+void CompiledExpression::evaluateColumns(const double* const* columns, size_t rowsNumber, double* results) const {
+    assert((columns != nullptr) || variables.empty());
+    assert(results != nullptr);
+
+    // Every element of the stack is a block of values
+    std::vector<double> stack(maxStackSize * BLOCK_SIZE);
+    for (size_t blockStart = 0; blockStart < rowsNumber; blockStart += BLOCK_SIZE) {
+        const size_t blockSize = (rowsNumber - blockStart < BLOCK_SIZE) ? rowsNumber - blockStart : BLOCK_SIZE;
+
+        size_t top = 0; // Index of the first free block
+        for (const Instruction& instruction : program) {
+            double* operand = (top >= 1) ? stack.data() + (top - 1) * BLOCK_SIZE : nullptr;
+            double* leftOperand = (top >= 2) ? stack.data() + (top - 2) * BLOCK_SIZE : nullptr;
+            const double* rightOperand = operand;
+            switch (instruction.opcode) {
+                case PUSH_CONSTANT:
+                    std::fill(stack.data() + top * BLOCK_SIZE, stack.data() + top * BLOCK_SIZE + blockSize, instruction.value);
+                    ++top;
+                    break;
+                case PUSH_VARIABLE:
+                    memcpy(stack.data() + top * BLOCK_SIZE, columns[instruction.variableIndex] + blockStart, blockSize * sizeof(double));
+                    ++top;
+                    break;
+                case NEGATE:   for (size_t i = 0; i < blockSize; ++i) operand[i] = -operand[i]; break;
+                case CALL_SIN: for (size_t i = 0; i < blockSize; ++i) operand[i] = sin(operand[i]); break;
+                case CALL_COS: for (size_t i = 0; i < blockSize; ++i) operand[i] = cos(operand[i]); break;
+                case CALL_TG:  for (size_t i = 0; i < blockSize; ++i) operand[i] = tan(operand[i]); break;
+                case CALL_CTG: for (size_t i = 0; i < blockSize; ++i) operand[i] = 1. / tan(operand[i]); break;
+                case CALL_LN:  for (size_t i = 0; i < blockSize; ++i) operand[i] = log(operand[i]); break;
+                case ADD:
+                    for (size_t i = 0; i < blockSize; ++i) leftOperand[i] += rightOperand[i];
+                    --top;
+                    break;
+                case SUBTRACT:
+                    for (size_t i = 0; i < blockSize; ++i) leftOperand[i] -= rightOperand[i];
+                    --top;
+                    break;
+                case MULTIPLY:
+                    for (size_t i = 0; i < blockSize; ++i) leftOperand[i] *= rightOperand[i];
+                    --top;
+                    break;
+                case DIVIDE:
+                    for (size_t i = 0; i < blockSize; ++i) leftOperand[i] /= rightOperand[i];
+                    --top;
+                    break;
+                case RAISE:
+                    for (size_t i = 0; i < blockSize; ++i) leftOperand[i] = pow(leftOperand[i], rightOperand[i]);
+                    --top;
+                    break;
+            }
+        }
+        assert(top == 1);
+        memcpy(results + blockStart, stack.data(), blockSize * sizeof(double));
+    }
+}
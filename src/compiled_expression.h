@@ -0,0 +1,93 @@
+/**
+ * @file
+ * @brief Definition of compiled expression
+ *
+ * Compiled expression is an AST flattened into a postfix program for a stack machine. Variables are numbered
+ * in order of their first appearance, so the expression can be evaluated for many variable values
+ * without walking the tree and without name lookups.
+ */
+#ifndef AST_BUILDER_COMPILED_EXPRESSION_H
+#define AST_BUILDER_COMPILED_EXPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+class CompiledExpression {
+
+private:
+    enum Opcode : uint8_t {
+        PUSH_CONSTANT,
+        PUSH_VARIABLE,
+        NEGATE,
+        ADD,
+        SUBTRACT,
+        MULTIPLY,
+        DIVIDE,
+        RAISE,
+        CALL_SIN,
+        CALL_COS,
+        CALL_TG,
+        CALL_CTG,
+        CALL_LN,
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        size_t variableIndex;
+        double value;
+    };
+
+    std::vector<Instruction> program;
+    std::vector<std::string> variables;
+    size_t maxStackSize = 0;
+
+    void addInstruction(const ASTNode* node);
+
+public:
+    /**
+     * Compiles the AST.
+     * @param root root of the AST
+     */
+    explicit CompiledExpression(const std::shared_ptr<ASTNode>& root);
+
+    /**
+     * Names of the variables in order of their indices.
+     * @return variable names.
+     */
+    const std::vector<std::string>& getVariables() const {
+        return variables;
+    }
+
+    /**
+     * Finds index of the variable.
+     * @param name name of the variable
+     * @return index of the variable or SIZE_MAX if the expression doesn't contain it.
+     */
+    size_t getVariableIndex(const char* name) const;
+
+    size_t getInstructionsNumber() const {
+        return program.size();
+    }
+
+    /**
+     * Evaluates the expression.
+     * @param variableValues values of the variables in order of getVariables(). Can be null if there are no variables.
+     * @return value of the expression.
+     */
+    double evaluate(const double* variableValues) const;
+
+    /**
+     * Evaluates the expression for many rows of variable values. Rows are processed in blocks, every instruction
+     * is applied to the whole block at once, so interpretation overhead is paid once per block instead of once per row.
+     * @param columns       values of every variable (in order of getVariables()), one column per variable
+     * @param rowsNumber    number of rows in every column
+     * @param results       column for the values of the expression
+     */
+    void evaluateColumns(const double* const* columns, size_t rowsNumber, double* results) const;
+};
+
+#endif // AST_BUILDER_COMPILED_EXPRESSION_H
@@ -0,0 +1,298 @@
+/**
+ * @file
+ * @brief Implementation of per-node evaluation profiler
+ */
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <system_error>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "evaluation_profiler.h"
+
+/** Number of empty measurements, the cheapest of them is the measurement overhead **/
+static const size_t CALIBRATION_RUNS_NUMBER = 1000;
+/** Subtrees of at most this size are printed in the report as infix expressions **/
+static const size_t MAX_REPORTED_SUBTREE_SIZE = 16;
+
+enum ProfiledOpcode : uint8_t {
+    PUSH_VALUE,
+    NEGATE,
+    IDENTITY,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    RAISE,
+    CALL_SIN,
+    CALL_COS,
+    CALL_TG,
+    CALL_CTG,
+    CALL_LN,
+};
+
+struct ProfiledInstruction {
+    ProfiledOpcode opcode;
+    /** Value of the constant or of the variable **/
+    double value;
+    /** Index of the node in EvaluationProfile::nodes **/
+    size_t nodeIndex;
+    /** Index of the first instruction of the subtree **/
+    size_t subtreeStart;
+};
+
+static inline uint64_t readTicks() {
+    // Compiler barriers keep the measured operation between the reads
+    __asm__ __volatile__("" ::: "memory");
+#if defined(__x86_64__) || defined(__i386__)
+    const uint64_t ticks = __rdtsc();
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    const uint64_t ticks = (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+#endif
+    __asm__ __volatile__("" ::: "memory");
+    return ticks;
+}
+
+const char* getProfileTickUnit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+static uint64_t calibrateOverhead() {
+    uint64_t overhead = UINT64_MAX;
+    for (size_t i = 0; i < CALIBRATION_RUNS_NUMBER; ++i) {
+        const uint64_t start = readTicks();
+        const uint64_t finish = readTicks();
+        overhead = std::min(overhead, finish - start);
+    }
+    return overhead;
+}
+
+static ProfiledInstruction makeInstruction(const ASTNode* node,
+                                           const std::vector<std::pair<std::string, double> >& variableValues) {
+    const Token* token = node->getToken().get();
+    ProfiledInstruction instruction = {PUSH_VALUE, 0., 0, 0};
+    switch (token->getType()) {
+        case TokenType::CONSTANT_VALUE:
+            instruction.value = dynamic_cast<const ConstantValueToken*>(token)->getValue();
+            return instruction;
+        case TokenType::VARIABLE: {
+            const char* name = dynamic_cast<const VariableToken*>(token)->getName();
+            for (const auto& variableValue : variableValues) {
+                if (strcmp(variableValue.first.c_str(), name) == 0) {
+                    instruction.value = variableValue.second;
+                    return instruction;
+                }
+            }
+            throw std::invalid_argument("Value of variable '" + std::string(name) + "' isn't given");
+        }
+        case TokenType::OPERATOR:
+            switch (dynamic_cast<const OperatorToken*>(token)->getOperatorType()) {
+                case ADDITION:            instruction.opcode = ADD; break;
+                case SUBTRACTION:         instruction.opcode = SUBTRACT; break;
+                case MULTIPLICATION:      instruction.opcode = MULTIPLY; break;
+                case DIVISION:            instruction.opcode = DIVIDE; break;
+                case ARITHMETIC_NEGATION: instruction.opcode = NEGATE; break;
+                case UNARY_ADDITION:      instruction.opcode = IDENTITY; break;
+                case POWER:               instruction.opcode = RAISE; break;
+            }
+            return instruction;
+        case TokenType::FUNCTION:
+            switch (dynamic_cast<const FunctionToken*>(token)->getFunctionType()) {
+                case SIN: instruction.opcode = CALL_SIN; break;
+                case COS: instruction.opcode = CALL_COS; break;
+                case TG:  instruction.opcode = CALL_TG; break;
+                case CTG: instruction.opcode = CALL_CTG; break;
+                case LN:  instruction.opcode = CALL_LN; break;
+            }
+            return instruction;
+        default:
+            throw std::logic_error("Parenthesis can't be calculated");
+    }
+}
+
+EvaluationProfile::EvaluationProfile(const std::shared_ptr<ASTNode>& root_,
+                                     const std::vector<std::pair<std::string, double> >& variableValues,
+                                     size_t runsNumber_) : root(root_), runsNumber(runsNumber_) {
+    assert(root != nullptr);
+    if (runsNumber == 0) {
+        throw std::invalid_argument("Number of runs must be positive");
+    }
+
+    // Post-order traversal like in CompiledExpression. Every element is a node, number of it's children
+    // that are already compiled and index of the first instruction of it's subtree.
+    std::vector<ProfiledInstruction> program;
+    std::vector<std::pair<const ASTNode*, size_t> > stack;
+    std::vector<size_t> subtreeStarts;
+    stack.emplace_back(root.get(), 0);
+    subtreeStarts.push_back(0);
+    size_t maxStackSize = 0;
+    size_t stackSize = 0;
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const ASTNode* node = top.first;
+        if (top.second < node->getChildrenNumber()) {
+            stack.emplace_back(node->getChildren()[top.second++].get(), 0);
+            subtreeStarts.push_back(program.size());
+            continue;
+        }
+        stack.pop_back();
+
+        ProfiledInstruction instruction = makeInstruction(node, variableValues);
+        auto index = indices.emplace(node, nodes.size());
+        if (index.second) {
+            nodes.emplace_back();
+            nodes.back().node = node;
+        }
+        instruction.nodeIndex = index.first->second;
+        instruction.subtreeStart = subtreeStarts.back();
+        subtreeStarts.pop_back();
+        nodes[instruction.nodeIndex].subtreeSize = program.size() - instruction.subtreeStart + 1;
+        program.push_back(instruction);
+
+        stackSize = stackSize - node->getChildrenNumber() + 1;
+        maxStackSize = std::max(maxStackSize, stackSize);
+    }
+
+    overheadTicks = calibrateOverhead();
+    std::vector<uint64_t> ticks(program.size(), 0);
+    std::vector<double> values(maxStackSize);
+    for (size_t run = 0; run < runsNumber; ++run) {
+        double* stack = values.data();
+        size_t top = 0; // Index of the first free element
+        for (size_t i = 0; i < program.size(); ++i) {
+            const ProfiledInstruction& instruction = program[i];
+            const uint64_t start = readTicks();
+            switch (instruction.opcode) {
+                case PUSH_VALUE: stack[top++] = instruction.value; break;
+                case NEGATE:     stack[top - 1] = -stack[top - 1]; break;
+                case IDENTITY:   break;
+                case ADD:        --top; stack[top - 1] += stack[top]; break;
+                case SUBTRACT:   --top; stack[top - 1] -= stack[top]; break;
+                case MULTIPLY:   --top; stack[top - 1] *= stack[top]; break;
+                case DIVIDE:     --top; stack[top - 1] /= stack[top]; break;
+                case RAISE:      --top; stack[top - 1] = pow(stack[top - 1], stack[top]); break;
+                case CALL_SIN:   stack[top - 1] = sin(stack[top - 1]); break;
+                case CALL_COS:   stack[top - 1] = cos(stack[top - 1]); break;
+                case CALL_TG:    stack[top - 1] = tan(stack[top - 1]); break;
+                case CALL_CTG:   stack[top - 1] = 1. / tan(stack[top - 1]); break;
+                case CALL_LN:    stack[top - 1] = log(stack[top - 1]); break;
+            }
+            const uint64_t elapsed = readTicks() - start;
+            ticks[i] += (elapsed > overheadTicks) ? elapsed - overheadTicks : 0;
+        }
+        assert(top == 1);
+        value = stack[0];
+    }
+
+    // Subtree of every instruction is a contiguous range of the program, so it's ticks are a difference of prefix sums
+    std::vector<uint64_t> prefixTicks(program.size() + 1, 0);
+    for (size_t i = 0; i < program.size(); ++i) {
+        prefixTicks[i + 1] = prefixTicks[i] + ticks[i];
+        NodeProfile& profile = nodes[program[i].nodeIndex];
+        profile.callsNumber += runsNumber;
+        profile.selfTicks += ticks[i];
+        profile.totalTicks += prefixTicks[i + 1] - prefixTicks[program[i].subtreeStart];
+    }
+
+    const uint64_t totalTicks = std::max<uint64_t>(getTotalTicks(), 1);
+    fillColors.reserve(nodes.size());
+    for (const NodeProfile& profile : nodes) {
+        const double share = std::min(1., (double)profile.totalTicks / (double)totalTicks);
+        const unsigned int shade = 255u - (unsigned int)lround(share * 207.);
+        char color[8];
+        snprintf(color, sizeof(color), "#FF%02X%02X", shade, shade);
+        fillColors.emplace_back(color);
+    }
+}
+
+const char* EvaluationProfile::getFillColor(const ASTNode& node) const {
+    const auto index = indices.find(&node);
+    return (index == indices.end()) ? nullptr : fillColors[index->second].c_str();
+}
+
+void EvaluationProfile::appendLabel(const ASTNode& node, OutputBuffer& label) const {
+    const auto index = indices.find(&node);
+    if (index == indices.end()) {
+        return;
+    }
+    const NodeProfile& profile = nodes[index->second];
+    const double totalTicks = (double)std::max<uint64_t>(getTotalTicks(), 1);
+    char line[96];
+    snprintf(line, sizeof(line), "\\ncalls: %llu\\nself: %.1f%%\\ntotal: %.1f%%", (unsigned long long)profile.callsNumber,
+             100. * (double)profile.selfTicks / totalTicks, 100. * (double)profile.totalTicks / totalTicks);
+    label.append(line);
+}
+
+void EvaluationProfile::dotPrint(FILE* dotFile) const {
+    root->dotPrint(dotFile, this);
+}
+
+void EvaluationProfile::saveDot(const std::string& fileName) const {
+    FILE* dotFile = fopen(fileName.c_str(), "w");
+    if (dotFile == nullptr) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+    try {
+        dotPrint(dotFile);
+    } catch (...) {
+        fclose(dotFile);
+        throw;
+    }
+    if (fclose(dotFile) != 0) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+}
+
+/**
+ * Describes the node by it's subtree if it's small or by it's token and subtree size otherwise.
+ */
+static std::string describeNode(const NodeProfile& profile) {
+    if (profile.subtreeSize <= MAX_REPORTED_SUBTREE_SIZE) {
+        return profile.node->toInfix();
+    }
+    const Token* token = profile.node->getToken().get();
+    std::string description;
+    if (token->getType() == TokenType::OPERATOR) {
+        const auto operatorToken = dynamic_cast<const OperatorToken*>(token);
+        description = (operatorToken->getArity() == 1) ? std::string(operatorToken->getSymbol()) + "(...)"
+                                                       : std::string("(...) ") + operatorToken->getSymbol() + " (...)";
+    } else {
+        description = std::string(dynamic_cast<const FunctionToken*>(token)->getName()) + "(...)";
+    }
+    return description + " [" + std::to_string(profile.subtreeSize) + " nodes]";
+}
+
+void EvaluationProfile::printReport(FILE* file, size_t linesNumber) const {
+    const char* unit = getProfileTickUnit();
+    const double totalTicks = (double)std::max<uint64_t>(getTotalTicks(), 1);
+    fprintf(file, "Evaluated %zu times, value %.17g, %.1f %s per run (measurement overhead %llu %s is subtracted)\n",
+            runsNumber, value, totalTicks / (double)runsNumber, unit, (unsigned long long)overheadTicks, unit);
+
+    std::vector<size_t> ranking(nodes.size());
+    for (size_t i = 0; i < ranking.size(); ++i) {
+        ranking[i] = i;
+    }
+    linesNumber = std::min(linesNumber, ranking.size());
+    std::partial_sort(ranking.begin(), ranking.begin() + linesNumber, ranking.end(), [this](size_t first, size_t second) {
+        return nodes[first].selfTicks > nodes[second].selfTicks;
+    });
+
+    fprintf(file, "%4s %7s %7s %12s %10s/call  %s\n", "rank", "self", "total", "calls", unit, "node");
+    for (size_t i = 0; i < linesNumber; ++i) {
+        const NodeProfile& profile = nodes[ranking[i]];
+        fprintf(file, "%4zu %6.1f%% %6.1f%% %12llu %15.1f  %s\n", i + 1, 100. * (double)profile.selfTicks / totalTicks,
+                100. * (double)profile.totalTicks / totalTicks, (unsigned long long)profile.callsNumber,
+                (double)profile.selfTicks / (double)profile.callsNumber, describeNode(profile).c_str());
+    }
+}
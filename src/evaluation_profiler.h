@@ -0,0 +1,136 @@
+/**
+ * @file
+ * @brief Definition of per-node evaluation profiler
+ *
+ * Profiler evaluates the AST like CompiledExpression does (postfix program, shared subtree is evaluated for every
+ * parent) and measures every operation with the time stamp counter (rdtsc) on x86 or with clock_gettime elsewhere.
+ * Cost of the measurement itself is calibrated and subtracted, still additions are measured less precisely than
+ * calls like pow, tan and log. Profile shows which subtrees dominate the evaluation, so it helps to decide which
+ * rewrites pay off. It's exported as a DOT heatmap and as a ranked text report.
+ */
+#ifndef AST_BUILDER_EVALUATION_PROFILER_H
+#define AST_BUILDER_EVALUATION_PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ast.h"
+
+static const size_t DEFAULT_PROFILE_RUNS_NUMBER = 1000;
+static const size_t DEFAULT_PROFILE_REPORT_LINES = 20;
+
+/**
+ * @return unit of the measured ticks: "cycles" for the time stamp counter or "ns" for clock_gettime.
+ */
+const char* getProfileTickUnit();
+
+struct NodeProfile {
+    const ASTNode* node = nullptr;
+    /** Number of evaluations: number of occurrences of the node in the tree times number of runs **/
+    uint64_t callsNumber = 0;
+    /** Ticks of the operation of the node itself **/
+    uint64_t selfTicks = 0;
+    /** Ticks of the whole subtree, including the node itself **/
+    uint64_t totalTicks = 0;
+    /** Number of nodes of the subtree with shared nodes counted for every parent **/
+    size_t subtreeSize = 0;
+};
+
+class EvaluationProfile : public DotNodeStyler {
+
+private:
+    std::shared_ptr<ASTNode> root;
+    /** Profiles of the distinct nodes in post-order **/
+    std::vector<NodeProfile> nodes;
+    std::unordered_map<const ASTNode*, size_t> indices;
+    /** Heatmap colors of the nodes, e.g. "#FF8080" **/
+    std::vector<std::string> fillColors;
+    size_t runsNumber;
+    uint64_t overheadTicks = 0;
+    double value = 0.;
+
+public:
+    /**
+     * Evaluates the AST several times and measures every node.
+     * @param root_             root of the AST
+     * @param variableValues    values of the variables of the AST
+     * @param runsNumber_       number of evaluations
+     * @throws std::invalid_argument if a variable has no value or runsNumber_ is 0.
+     */
+    EvaluationProfile(const std::shared_ptr<ASTNode>& root_,
+                      const std::vector<std::pair<std::string, double> >& variableValues,
+                      size_t runsNumber_ = DEFAULT_PROFILE_RUNS_NUMBER);
+
+    const std::vector<NodeProfile>& getNodes() const {
+        return nodes;
+    }
+
+    /**
+     * @return profile of the node of the AST.
+     * @throws std::out_of_range if the node isn't in the AST.
+     */
+    const NodeProfile& getProfile(const ASTNode& node) const {
+        return nodes[indices.at(&node)];
+    }
+
+    /**
+     * @return ticks of all the runs.
+     */
+    uint64_t getTotalTicks() const {
+        return nodes.back().totalTicks;
+    }
+
+    size_t getRunsNumber() const {
+        return runsNumber;
+    }
+
+    /**
+     * @return cost of one measurement that is subtracted from the ticks of every operation.
+     */
+    uint64_t getOverheadTicks() const {
+        return overheadTicks;
+    }
+
+    /**
+     * @return value of the expression.
+     */
+    double getValue() const {
+        return value;
+    }
+
+    /**
+     * Colors the node from white to red by the share of it's subtree in the total ticks.
+     */
+    const char* getFillColor(const ASTNode& node) const override;
+
+    /**
+     * Adds number of calls and shares of the self and total ticks to the label.
+     */
+    void appendLabel(const ASTNode& node, OutputBuffer& label) const override;
+
+    /**
+     * Writes the AST as a DOT graph (see ASTNode::dotPrint) colored as a heatmap.
+     * @throws std::system_error if the file can't be written.
+     */
+    void dotPrint(FILE* dotFile) const;
+
+    /**
+     * Writes the heatmap into the DOT file (see dotPrint).
+     * @throws std::system_error if the file can't be written.
+     */
+    void saveDot(const std::string& fileName) const;
+
+    /**
+     * Prints the nodes ranked by their self ticks. Small subtrees are printed as infix expressions.
+     * @param file          file to print to
+     * @param linesNumber   maximum number of printed nodes
+     */
+    void printReport(FILE* file, size_t linesNumber = DEFAULT_PROFILE_REPORT_LINES) const;
+};
+
+#endif // AST_BUILDER_EVALUATION_PROFILER_H
@@ -0,0 +1,299 @@
+/**
+ * @file
+ * @brief Implementation of cache of expression artifacts
+ */
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "ast-math.h"
+#include "binary_ast.h"
+#include "expression_cache.h"
+
+static const char SPILL_MAGIC[8] = { 'A', 'S', 'T', 'C', 'A', 'C', 'H', 'E' };
+
+CachedExpression::CachedExpression(const std::shared_ptr<ASTNode>& root_, const std::shared_ptr<ASTNode>& derivative_)
+        : root(root_), derivative(derivative_), expression(root_),
+          derivativeExpression(derivative_ != nullptr ? new CompiledExpression(derivative_) : nullptr) { }
+
+static inline bool isNameSymbol(char symbol) {
+    return std::isalnum((unsigned char)symbol) || (symbol == '_') || (symbol == '.') || (symbol == '\'');
+}
+
+std::string normalizeExpression(const char* expression) {
+    assert(expression != nullptr);
+
+    std::string normalizedExpression;
+    for (const char* symbol = expression; *symbol != '\0'; ++symbol) {
+        if (!std::isspace((unsigned char)*symbol)) {
+            normalizedExpression += *symbol;
+            continue;
+        }
+        while (std::isspace((unsigned char)symbol[1])) ++symbol;
+        if (!normalizedExpression.empty() && isNameSymbol(normalizedExpression.back()) && isNameSymbol(symbol[1])) {
+            normalizedExpression += ' ';
+        }
+    }
+    return normalizedExpression;
+}
+
+ExpressionCache::ExpressionCache(size_t capacity_, const std::string& directory_, size_t maxDepth_)
+        : capacity(capacity_), directory(directory_), maxDepth(maxDepth_),
+          hits(0), misses(0), structuralHits(0), diskHits(0), evictions(0) { }
+
+ExpressionCache::~ExpressionCache() {
+    try {
+        flush();
+    } catch (const std::exception&) {
+        // Spilling is best-effort
+    }
+}
+
+std::shared_ptr<const CachedExpression> ExpressionCache::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entriesByKey.find(key);
+    if (entry == entriesByKey.end()) {
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, entry->second);
+    return entry->second->expression;
+}
+
+/**
+ * Inserts the artifacts unless they were inserted by another thread.
+ * @return cached artifacts.
+ */
+std::shared_ptr<const CachedExpression> ExpressionCache::insert(const std::string& key, uint64_t structuralKey,
+                                                                const std::shared_ptr<ASTNode>& source,
+                                                                const std::shared_ptr<const CachedExpression>& expression) {
+    if (capacity == 0) {
+        return expression;
+    }
+
+    std::vector<Entry> evictedEntries;
+    std::shared_ptr<const CachedExpression> cachedExpression;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto entry = entriesByKey.find(key);
+        if (entry != entriesByKey.end()) {
+            entries.splice(entries.begin(), entries, entry->second);
+            return entry->second->expression;
+        }
+
+        entries.push_front(Entry{ key, structuralKey, source, expression });
+        entriesByKey[key] = entries.begin();
+        if (source != nullptr) {
+            entriesByStructure[structuralKey] = entries.begin();
+        }
+        while (entries.size() > capacity) {
+            auto evictedEntry = std::prev(entries.end());
+            entriesByKey.erase(evictedEntry->key);
+            auto structuralEntry = entriesByStructure.find(evictedEntry->structuralKey);
+            if ((structuralEntry != entriesByStructure.end()) && (structuralEntry->second == evictedEntry)) {
+                entriesByStructure.erase(structuralEntry);
+            }
+            evictedEntries.push_back(std::move(*evictedEntry));
+            entries.erase(evictedEntry);
+            ++evictions;
+        }
+        cachedExpression = expression;
+    }
+
+    // Files are written without the lock
+    if (!directory.empty()) {
+        for (const Entry& evictedEntry : evictedEntries) {
+            spill(evictedEntry.key, *evictedEntry.expression);
+        }
+    }
+    return cachedExpression;
+}
+
+std::shared_ptr<const CachedExpression> ExpressionCache::get(const char* expression, const char* variable,
+                                                             bool optimized, ParseError& error) {
+    assert(expression != nullptr);
+    assert(variable != nullptr);
+
+    error = ParseError(NO_ERROR, 0);
+    std::string key = normalizeExpression(expression);
+    key += '\0';
+    key += variable;
+    key += '\0';
+    key += optimized ? '1' : '0';
+
+    std::shared_ptr<const CachedExpression> cachedExpression = find(key);
+    if (cachedExpression != nullptr) {
+        ++hits;
+        return cachedExpression;
+    }
+    ++misses;
+
+    // Texts that are loaded from the disk aren't parsed, so they aren't found by structure
+    if (!directory.empty() && ((cachedExpression = load(key)) != nullptr)) {
+        ++diskHits;
+        return insert(key, 0, nullptr, cachedExpression);
+    }
+
+    ParseResult parseResult = tryBuildAST(expression, maxDepth);
+    if (!parseResult.isSuccess()) {
+        error = parseResult.getError();
+        return nullptr;
+    }
+    const std::shared_ptr<ASTNode>& parsedRoot = parseResult.getRoot();
+    uint64_t structuralKey = mixHash(parsedRoot->getHash(), std::hash<std::string>()(variable));
+    structuralKey = mixHash(structuralKey, optimized ? 1 : 0);
+
+    std::shared_ptr<ASTNode> source;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto entry = entriesByStructure.find(structuralKey);
+        if (entry != entriesByStructure.end()) {
+            source = entry->second->source;
+            cachedExpression = entry->second->expression;
+        }
+    }
+    // Hashes may collide, so ASTs are compared without the lock
+    if ((source != nullptr) && source->structurallyEquals(*parsedRoot)) {
+        ++structuralHits;
+        return insert(key, structuralKey, source, cachedExpression);
+    }
+
+    // Optimizers change the AST in place, so the root and the derivative don't share nodes
+    std::shared_ptr<ASTNode> root = parsedRoot;
+    if (optimized) {
+        root = copyAST(root);
+        root = optimizer.optimize(root);
+    }
+    std::shared_ptr<ASTNode> derivative;
+    if (*variable != '\0') {
+        derivative = differentiate(root, variable);
+        if (optimized) {
+            derivative = copyAST(derivative);
+            derivative = optimizer.optimize(derivative);
+        }
+    }
+    return insert(key, structuralKey, parsedRoot, std::make_shared<const CachedExpression>(root, derivative));
+}
+
+ExpressionCacheStatistics ExpressionCache::getStatistics() {
+    ExpressionCacheStatistics statistics;
+    statistics.hits = hits.load();
+    statistics.misses = misses.load();
+    statistics.structuralHits = structuralHits.load();
+    statistics.diskHits = diskHits.load();
+    statistics.evictions = evictions.load();
+    std::lock_guard<std::mutex> lock(mutex);
+    statistics.size = entries.size();
+    return statistics;
+}
+
+void ExpressionCache::flush() {
+    if (directory.empty()) {
+        return;
+    }
+    std::vector<std::pair<std::string, std::shared_ptr<const CachedExpression> > > cachedExpressions;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Entry& entry : entries) {
+            cachedExpressions.emplace_back(entry.key, entry.expression);
+        }
+    }
+    for (const auto& cachedExpression : cachedExpressions) {
+        spill(cachedExpression.first, *cachedExpression.second);
+    }
+}
+
+std::string ExpressionCache::getSpillFileName(const std::string& key) const {
+    // FNV-1a, the key itself is stored in the file and is checked on load
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char symbol : key) {
+        hash = (hash ^ (unsigned char)symbol) * 0x100000001b3ull;
+    }
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "/%016llx.astc", (unsigned long long)hash);
+    return directory + fileName;
+}
+
+/**
+ * Appends the block with it's size before it and padding after it, so every block is aligned to 8 bytes.
+ */
+static void appendBlock(std::string& data, const std::string& block) {
+    const uint64_t size = block.size();
+    data.append((const char*)&size, sizeof(size));
+    data.append(block);
+    data.append((8 - block.size() % 8) % 8, '\0');
+}
+
+/**
+ * Spill file is a magic number and three blocks: the key, the binary AST and the binary derivative (empty block
+ * if there is no derivative). File is written under a temporary name and renamed, so readers never see
+ * a partially written file.
+ */
+void ExpressionCache::spill(const std::string& key, const CachedExpression& expression) const {
+    std::string data(SPILL_MAGIC, sizeof(SPILL_MAGIC));
+    appendBlock(data, key);
+    appendBlock(data, serializeAST(expression.root));
+    appendBlock(data, expression.derivative != nullptr ? serializeAST(expression.derivative) : std::string());
+
+    const std::string fileName = getSpillFileName(key);
+    // Name is unique for every writing thread of every process
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%d.%p.tmp", (int)getpid(), (const void*)&data);
+    const std::string temporaryFileName = fileName + suffix;
+    FILE* file = fopen(temporaryFileName.c_str(), "wb");
+    if (file == nullptr) {
+        return;
+    }
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    if ((fclose(file) != 0) || !written || (rename(temporaryFileName.c_str(), fileName.c_str()) != 0)) {
+        remove(temporaryFileName.c_str());
+    }
+}
+
+std::shared_ptr<const CachedExpression> ExpressionCache::load(const std::string& key) const {
+    FILE* file = fopen(getSpillFileName(key).c_str(), "rb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+    // Buffer of 8-byte words, so binary ASTs in it are aligned
+    std::vector<uint64_t> data;
+    uint64_t buffer[512];
+    size_t readBytes;
+    while ((readBytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + (readBytes + 7) / 8);
+    }
+    fclose(file);
+
+    // Stale or foreign files (e.g. with a hash collision) are ignored
+    std::vector<std::pair<const char*, size_t> > blocks;
+    size_t position = 1;
+    if (data.empty() || (memcmp(data.data(), SPILL_MAGIC, sizeof(SPILL_MAGIC)) != 0)) {
+        return nullptr;
+    }
+    while ((position < data.size()) && (blocks.size() < 3)) {
+        const uint64_t size = data[position++];
+        if (size > (data.size() - position) * 8) {
+            return nullptr;
+        }
+        blocks.emplace_back((const char*)&data[position], (size_t)size);
+        position += (size + 7) / 8;
+    }
+    if ((blocks.size() != 3) || (std::string(blocks[0].first, blocks[0].second) != key)) {
+        return nullptr;
+    }
+
+    try {
+        const std::shared_ptr<ASTNode> root = ASTView(blocks[1].first, blocks[1].second).toAST();
+        std::shared_ptr<ASTNode> derivative;
+        if (blocks[2].second > 0) {
+            derivative = ASTView(blocks[2].first, blocks[2].second).toAST();
+        }
+        return std::make_shared<const CachedExpression>(root, derivative);
+    } catch (const std::invalid_argument&) {
+        return nullptr;
+    }
+}
@@ -0,0 +1,136 @@
+/**
+ * @file
+ * @brief Definition of cache of expression artifacts
+ *
+ * Cache maps normalized expression text (with differentiated variable and optimization flag) to the artifacts that
+ * are built for it: AST, derivative and their compiled programs. Cached artifacts are shared between threads and
+ * are never changed, so ASTs from the cache should be copied (copyAST) before they are optimized in place.
+ *
+ * Expressions that are written differently but have the same structure (e.g. "x+1" and "((x) + 1)") share
+ * artifacts: on a text miss the expression is parsed and looked up by structural hash of the AST.
+ *
+ * Cache is a bounded LRU. If a directory is given, evicted artifacts are spilled there in binary AST format
+ * (and all the artifacts are written when the cache is destroyed), so they survive restarts.
+ */
+#ifndef AST_BUILDER_EXPRESSION_CACHE_H
+#define AST_BUILDER_EXPRESSION_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "ast.h"
+#include "ast-optimizers.h"
+#include "compiled_expression.h"
+#include "iterative_parser.h"
+
+static constexpr size_t DEFAULT_CACHE_CAPACITY = 4096u;
+
+struct CachedExpression {
+    std::shared_ptr<ASTNode> root;
+    /** Derivative of the root, null if no variable was given **/
+    std::shared_ptr<ASTNode> derivative;
+    CompiledExpression expression;
+    /** Compiled derivative, null if no variable was given **/
+    std::unique_ptr<const CompiledExpression> derivativeExpression;
+
+    CachedExpression(const std::shared_ptr<ASTNode>& root_, const std::shared_ptr<ASTNode>& derivative_);
+};
+
+struct ExpressionCacheStatistics {
+    size_t hits = 0;
+    size_t misses = 0;
+    /** Misses by text that were found by structure **/
+    size_t structuralHits = 0;
+    /** Misses that were loaded from the spill directory **/
+    size_t diskHits = 0;
+    size_t evictions = 0;
+    size_t size = 0;
+};
+
+class ExpressionCache {
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t structuralKey;
+        /** Parsed AST the artifacts were built from, null if they were loaded from the disk **/
+        std::shared_ptr<ASTNode> source;
+        std::shared_ptr<const CachedExpression> expression;
+    };
+
+    const size_t capacity;
+    const std::string directory;
+    const size_t maxDepth;
+    const FullOptimizer optimizer;
+
+    std::mutex mutex;
+    /** Most recently used entry goes first **/
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> entriesByKey;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> entriesByStructure;
+
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+    std::atomic<size_t> structuralHits;
+    std::atomic<size_t> diskHits;
+    std::atomic<size_t> evictions;
+
+    std::shared_ptr<const CachedExpression> find(const std::string& key);
+    std::shared_ptr<const CachedExpression> insert(const std::string& key, uint64_t structuralKey,
+                                                   const std::shared_ptr<ASTNode>& source,
+                                                   const std::shared_ptr<const CachedExpression>& expression);
+    std::string getSpillFileName(const std::string& key) const;
+    void spill(const std::string& key, const CachedExpression& expression) const;
+    std::shared_ptr<const CachedExpression> load(const std::string& key) const;
+
+public:
+    /**
+     * Creates the cache.
+     * @param capacity_     maximum number of cached expressions, 0 disables caching
+     * @param directory_    directory for spilled artifacts, empty string disables spilling
+     * @param maxDepth_     maximum nesting depth of parsed expressions
+     */
+    explicit ExpressionCache(size_t capacity_ = DEFAULT_CACHE_CAPACITY, const std::string& directory_ = "",
+                             size_t maxDepth_ = DEFAULT_MAX_NESTING_DEPTH);
+
+    ExpressionCache(const ExpressionCache& cache) = delete;
+    ExpressionCache& operator=(const ExpressionCache& cache) = delete;
+
+    /**
+     * Writes all the cached artifacts to the spill directory.
+     */
+    ~ExpressionCache();
+
+    /**
+     * Returns artifacts of the expression, builds them on miss. Can be called from any thread.
+     * Artifacts of the same expression can be built twice by concurrent misses, then one of them is cached.
+     * @param expression    expression
+     * @param variable      differentiated variable, empty string means no derivative
+     * @param optimized     whether the AST and the derivative are optimized
+     * @param error         parse error if the expression is invalid
+     * @return artifacts or null if the expression is invalid.
+     * @throws std::logic_error if the expression can't be differentiated.
+     */
+    std::shared_ptr<const CachedExpression> get(const char* expression, const char* variable, bool optimized,
+                                                ParseError& error);
+
+    ExpressionCacheStatistics getStatistics();
+
+    /**
+     * Writes all the cached artifacts to the spill directory (if it's given).
+     */
+    void flush();
+};
+
+/**
+ * Removes insignificant whitespaces from the expression. Whitespaces between two symbols of names or numbers
+ * are replaced with one space, so invalid expressions stay invalid.
+ */
+std::string normalizeExpression(const char* expression);
+
+#endif // AST_BUILDER_EXPRESSION_CACHE_H
@@ -0,0 +1,85 @@
+/**
+ * @file
+ * @brief Implementation of expression server client
+ */
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+#include "expression_client.h"
+
+static const size_t INITIAL_BUFFER_SIZE = 64 * 1024;
+
+ExpressionClient::ExpressionClient(const char* socketPath) : buffer(INITIAL_BUFFER_SIZE) {
+    assert(socketPath != nullptr);
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), socketPath);
+    }
+    strcpy(address.sun_path, socketPath);
+
+    socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket < 0) {
+        throw std::system_error(errno, std::generic_category(), socketPath);
+    }
+    if (connect(socket, (const sockaddr*)&address, sizeof(address)) != 0) {
+        const int error = errno;
+        close(socket);
+        throw std::system_error(error, std::generic_category(), socketPath);
+    }
+}
+
+ExpressionClient::~ExpressionClient() {
+    close(socket);
+}
+
+void ExpressionClient::send(const std::string& request) {
+    std::string line = request + '\n';
+    size_t sentLength = 0;
+    while (sentLength < line.size()) {
+        const ssize_t sent = ::send(socket, line.data() + sentLength, line.size() - sentLength, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "send");
+        }
+        sentLength += sent;
+    }
+}
+
+std::string ExpressionClient::receive() {
+    size_t scanned = bufferStart;
+    while (true) {
+        const char* lineEnd = (const char*)memchr(buffer.data() + scanned, '\n', bufferEnd - scanned);
+        if (lineEnd != nullptr) {
+            std::string response((const char*)buffer.data() + bufferStart, lineEnd);
+            bufferStart = lineEnd - buffer.data() + 1;
+            return response;
+        }
+        scanned = bufferEnd;
+
+        if (bufferStart > 0) { // Free the space of already received responses
+            memmove(buffer.data(), buffer.data() + bufferStart, bufferEnd - bufferStart);
+            bufferEnd -= bufferStart;
+            scanned -= bufferStart;
+            bufferStart = 0;
+        }
+        if (bufferEnd == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+
+        const ssize_t receivedLength = recv(socket, buffer.data() + bufferEnd, buffer.size() - bufferEnd, 0);
+        if (receivedLength < 0) {
+            if (errno == EINTR) continue;
+            throw std::system_error(errno, std::generic_category(), "recv");
+        }
+        if (receivedLength == 0) {
+            throw std::system_error(ECONNRESET, std::generic_category(), "Server closed the connection");
+        }
+        bufferEnd += receivedLength;
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * @file
+ * @brief Definition of expression server client
+ */
+#ifndef AST_BUILDER_EXPRESSION_CLIENT_H
+#define AST_BUILDER_EXPRESSION_CLIENT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Connection to the expression server (see ExpressionServer). Requests can be sent one by one with request
+ * or pipelined: several sends followed by the same number of receives.
+ */
+class ExpressionClient {
+
+private:
+    int socket = -1;
+    std::vector<char> buffer;
+    size_t bufferStart = 0;
+    size_t bufferEnd = 0;
+
+public:
+    /**
+     * Connects to the server.
+     * @param socketPath path of the server socket
+     * @throws std::system_error if connection failed.
+     */
+    explicit ExpressionClient(const char* socketPath);
+
+    ExpressionClient(const ExpressionClient& client) = delete;
+    ExpressionClient& operator=(const ExpressionClient& client) = delete;
+
+    ~ExpressionClient();
+
+    /**
+     * Sends the request.
+     * @param request request line without line break
+     * @throws std::system_error if sending failed.
+     */
+    void send(const std::string& request);
+
+    /**
+     * Receives response to the earliest request without response.
+     * @return response line without line break.
+     * @throws std::system_error if receiving failed or the server closed the connection.
+     */
+    std::string receive();
+
+    /**
+     * Sends the request and receives the response.
+     */
+    std::string request(const std::string& request) {
+        send(request);
+        return receive();
+    }
+};
+
+#endif // AST_BUILDER_EXPRESSION_CLIENT_H
@@ -0,0 +1,195 @@
+/**
+ * @file
+ * @brief Implementation of seeded generator of random expressions
+ *
+ * Random numbers are taken from std::mt19937 directly instead of distributions, because distributions differ
+ * between standard libraries and the same seed must give the same expressions everywhere.
+ */
+#include <stdexcept>
+#include "expression_generator.h"
+
+GeneratorOptions getPresetOptions(GeneratorPreset preset, size_t nodesNumber) {
+    GeneratorOptions options;
+    options.nodesNumber = nodesNumber;
+    if (preset == REALISTIC_MIX) {
+        return options;
+    }
+
+    options.maxDepth = UNLIMITED_DEPTH;
+    options.sumWeight = 0;
+    options.productWeight = 0;
+    options.powerWeight = 0;
+    options.functionWeight = 0;
+    options.unaryWeight = 0;
+    options.chains = true;
+    switch (preset) {
+        case DEEP_POWER_CHAINS:
+            options.powerWeight = 1;
+            options.constantExponents = false;
+            break;
+        case LONG_SUMS:
+            options.sumWeight = 1;
+            break;
+        case NESTED_FUNCTIONS:
+            options.functionWeight = 1;
+            options.functions = { TG, LN };
+            options.maxFunctionNesting = SIZE_MAX;
+            break;
+        default:
+            throw std::invalid_argument("Unknown generator preset");
+    }
+    return options;
+}
+
+GeneratorPreset getPresetByName(const std::string& name) {
+    for (size_t i = 0; i < sizeof(GeneratorPresetNames) / sizeof(GeneratorPresetNames[0]); ++i) {
+        if (name == GeneratorPresetNames[i]) {
+            return (GeneratorPreset)i;
+        }
+    }
+    throw std::invalid_argument("Unknown generator preset '" + name + "'");
+}
+
+static std::shared_ptr<Token> createFunction(FunctionType functionType) {
+    switch (functionType) {
+        case SIN: return std::make_shared<SinFunction>();
+        case COS: return std::make_shared<CosFunction>();
+        case TG : return std::make_shared<TgFunction >();
+        case CTG: return std::make_shared<CtgFunction>();
+        case LN : return std::make_shared<LnFunction >();
+        default:
+            throw std::invalid_argument("Unsupported function type");
+    }
+}
+
+ExpressionGenerator::ExpressionGenerator(const GeneratorOptions& options_, unsigned int seed) :
+        options(options_), random(seed) {
+    if (options.nodesNumber == 0) {
+        throw std::invalid_argument("Number of nodes must be positive");
+    }
+    if (options.maxDepth == 0) {
+        throw std::invalid_argument("Maximum depth must be positive");
+    }
+
+    static const char* const firstNames[] = { "x", "y", "z", "u", "v", "w" };
+    static constexpr size_t firstNamesNumber = sizeof(firstNames) / sizeof(firstNames[0]);
+    for (size_t i = 0; i < options.variablesNumber; ++i) {
+        std::string name = i < firstNamesNumber ? firstNames[i] : "x" + std::to_string(i);
+        variables.push_back(VariableToken::getVariableByName(&name[0]));
+    }
+}
+
+std::shared_ptr<ASTNode> ExpressionGenerator::generateLeaf() {
+    if (!variables.empty() && (random() % 2 == 0)) {
+        return std::make_shared<ASTNode>(variables[random() % variables.size()]);
+    }
+    return std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(random() % 10));
+}
+
+std::shared_ptr<ASTNode> ExpressionGenerator::generateAST() {
+    // Task either generates a subtree of the given size or, if it has a token, connects the generated operands
+    struct Task {
+        size_t nodesNumber;
+        size_t depth;
+        size_t functionNesting;
+        bool exponent;
+        std::shared_ptr<Token> token;
+    };
+    enum NodeKind { SUM, PRODUCT, POWER_KIND, FUNCTION_KIND, UNARY, NODE_KINDS_NUMBER };
+
+    std::vector<Task> tasks;
+    std::vector<std::shared_ptr<ASTNode> > operands;
+    tasks.push_back(Task{ options.nodesNumber, 1, 0, false, nullptr });
+    while (!tasks.empty()) {
+        Task task = std::move(tasks.back());
+        tasks.pop_back();
+        if (task.token != nullptr) {
+            std::shared_ptr<ASTNode> rightOperand = std::move(operands.back());
+            operands.pop_back();
+            if ((task.token->getType() == OPERATOR) && (static_cast<OperatorToken*>(task.token.get())->getArity() == 2)) {
+                std::shared_ptr<ASTNode> leftOperand = std::move(operands.back());
+                operands.pop_back();
+                operands.push_back(std::make_shared<ASTNode>(task.token, leftOperand, rightOperand));
+            } else {
+                operands.push_back(std::make_shared<ASTNode>(task.token, rightOperand));
+            }
+            continue;
+        }
+        if (task.exponent) {
+            operands.push_back(std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(random() % 4)));
+            continue;
+        }
+
+        unsigned int weights[NODE_KINDS_NUMBER] = {};
+        if ((task.nodesNumber >= 2) && (task.depth < options.maxDepth)) {
+            const bool binary = task.nodesNumber >= 3;
+            weights[SUM] = binary ? options.sumWeight : 0;
+            weights[PRODUCT] = binary ? options.productWeight : 0;
+            weights[POWER_KIND] = binary ? options.powerWeight : 0;
+            weights[FUNCTION_KIND] = (task.functionNesting < options.maxFunctionNesting) && !options.functions.empty()
+                                     ? options.functionWeight : 0;
+            weights[UNARY] = options.unaryWeight;
+        }
+        unsigned int totalWeight = 0;
+        for (unsigned int weight : weights) {
+            totalWeight += weight;
+        }
+        if (totalWeight == 0) {
+            operands.push_back(generateLeaf());
+            continue;
+        }
+
+        unsigned int choice = random() % totalWeight;
+        int kind = 0;
+        while (choice >= weights[kind]) {
+            choice -= weights[kind];
+            ++kind;
+        }
+
+        const size_t childDepth = task.depth + 1;
+        if ((kind == FUNCTION_KIND) || (kind == UNARY)) {
+            std::shared_ptr<Token> token;
+            if (kind == FUNCTION_KIND) {
+                token = createFunction(options.functions[random() % options.functions.size()]);
+            } else if (random() % 2 == 0) {
+                token = std::make_shared<ArithmeticNegationOperator>();
+            } else {
+                token = std::make_shared<UnaryAdditionOperator>();
+            }
+            const size_t childFunctionNesting = task.functionNesting + (kind == FUNCTION_KIND ? 1 : 0);
+            tasks.push_back(Task{ 0, 0, 0, false, token });
+            tasks.push_back(Task{ task.nodesNumber - 1, childDepth, childFunctionNesting, false, nullptr });
+            continue;
+        }
+
+        std::shared_ptr<Token> token;
+        if (kind == SUM) {
+            token = random() % 2 == 0 ? std::shared_ptr<Token>(std::make_shared<AdditionOperator>())
+                                      : std::make_shared<SubtractionOperator>();
+        } else if (kind == PRODUCT) {
+            token = random() % 2 == 0 ? std::shared_ptr<Token>(std::make_shared<MultiplicationOperator>())
+                                      : std::make_shared<DivisionOperator>();
+        } else {
+            token = std::make_shared<PowerOperator>();
+        }
+        const bool constantExponent = (kind == POWER_KIND) && options.constantExponents;
+        size_t leftNodesNumber;
+        if (constantExponent || (options.chains && (kind != POWER_KIND))) {
+            leftNodesNumber = task.nodesNumber - 2;
+        } else if (options.chains) { // '^' is right-associative, so the chain grows to the right
+            leftNodesNumber = 1;
+        } else {
+            leftNodesNumber = 1 + random() % (task.nodesNumber - 2);
+        }
+        const size_t rightNodesNumber = task.nodesNumber - 1 - leftNodesNumber;
+        // Left operand is generated first, so it's pushed last
+        tasks.push_back(Task{ 0, 0, 0, false, token });
+        tasks.push_back(Task{ rightNodesNumber, childDepth, task.functionNesting, constantExponent, nullptr });
+        tasks.push_back(Task{ leftNodesNumber, childDepth, task.functionNesting, false, nullptr });
+    }
+    return operands.back();
+}
+
+std::string ExpressionGenerator::generateExpression() {
+    return generateAST()->toInfix();
+}
@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @brief Definition of seeded generator of random expressions
+ *
+ * Generator builds random ASTs of the grammar that is parsed by the parsers (see iterative_parser.cpp) and prints
+ * them as infix expressions with minimal parentheses. Size, depth, mix of operators and functions and number of
+ * variables are controlled by GeneratorOptions, presets give the worst cases and a realistic mix.
+ * The same options and seed always give the same expressions.
+ */
+#ifndef AST_BUILDER_EXPRESSION_GENERATOR_H
+#define AST_BUILDER_EXPRESSION_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+static constexpr unsigned int DEFAULT_GENERATOR_SEED = 42u;
+
+/** Depth of the generated ASTs isn't limited **/
+static constexpr size_t UNLIMITED_DEPTH = SIZE_MAX;
+
+struct GeneratorOptions {
+    /** Approximate number of nodes of every AST, AST is smaller if the depth limit is reached **/
+    size_t nodesNumber = 64;
+    /** Maximum depth of the AST, nodes at this depth are constants and variables **/
+    size_t maxDepth = 16;
+    /** Variables are named x, y, z, u, v, w, x6, x7 and so on. If it's 0, expressions contain only constants **/
+    size_t variablesNumber = 3;
+    /** Maximum number of functions on a path from the root **/
+    size_t maxFunctionNesting = 2;
+    /** Functions that are called in the expressions **/
+    std::vector<FunctionType> functions = { SIN, COS, TG, CTG, LN };
+
+    /**
+     * Relative weights of node kinds: '+' and '-', '*' and '/', '^', functions and unary '+' and '-'.
+     * Without unary operators expressions follow the grammar of the recursive descent (see recursive_parser.cpp).
+     */
+    unsigned int sumWeight = 4;
+    unsigned int productWeight = 3;
+    unsigned int powerWeight = 1;
+    unsigned int functionWeight = 2;
+    unsigned int unaryWeight = 1;
+
+    /** Exponents are single constants, so every expression can be differentiated **/
+    bool constantExponents = true;
+    /**
+     * Binary operators give all the rest of the nodes to one operand and a leaf to another one, so expressions are
+     * flat chains like "x + 2 - y + ..." or "x ^ y ^ 2 ^ ...". Otherwise the nodes are split randomly.
+     */
+    bool chains = false;
+};
+
+enum GeneratorPreset {
+    REALISTIC_MIX,
+    DEEP_POWER_CHAINS,
+    LONG_SUMS,
+    NESTED_FUNCTIONS,
+};
+
+static const char* const GeneratorPresetNames[] = {
+    "realistic",
+    "deep-powers",
+    "long-sums",
+    "nested-functions",
+};
+
+/**
+ * @return options of the preset for ASTs of the given size:
+ *     realistic        - random mix of all operators and functions, depth is at most 16;
+ *     deep-powers      - chain of '^' like "x ^ 2 ^ y ^ ...", it's right-associative, so the AST is as deep as it's long;
+ *     long-sums        - chain of '+' and '-' like "x + 2 - y + ...", the AST is as deep as it's long;
+ *     nested-functions - nested calls like "tg(ln(tg(...)))". Every call is a level of parentheses, so the parsers
+ *                        reject the expressions longer than their nesting limit.
+ */
+GeneratorOptions getPresetOptions(GeneratorPreset preset, size_t nodesNumber);
+
+/**
+ * @return preset with the name from GeneratorPresetNames.
+ * @throws std::invalid_argument if there is no such preset.
+ */
+GeneratorPreset getPresetByName(const std::string& name);
+
+class ExpressionGenerator {
+
+private:
+    const GeneratorOptions options;
+    std::mt19937 random;
+    std::vector<std::shared_ptr<Token> > variables;
+
+    std::shared_ptr<ASTNode> generateLeaf();
+
+public:
+    /**
+     * @throws std::invalid_argument if nodesNumber or maxDepth is 0.
+     */
+    explicit ExpressionGenerator(const GeneratorOptions& options_, unsigned int seed = DEFAULT_GENERATOR_SEED);
+
+    /**
+     * Generates the next AST. Generation doesn't use recursion, so ASTs can be as deep as they are long.
+     */
+    std::shared_ptr<ASTNode> generateAST();
+
+    /**
+     * @return the next AST printed as an infix expression (see ASTNode::infixPrint).
+     */
+    std::string generateExpression();
+};
+
+#endif // AST_BUILDER_EXPRESSION_GENERATOR_H
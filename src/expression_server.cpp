@@ -0,0 +1,346 @@
+/**
+ * @file
+ * @brief Implementation of expression server
+ */
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+#include "ast-math.h"
+#include "batch.h"
+#include "expression_server.h"
+#include "iterative_parser.h"
+
+static const size_t INITIAL_BUFFER_SIZE = 64 * 1024;
+/** Connection that sends longer request line is closed **/
+static const size_t MAX_REQUEST_LENGTH = 64 * 1024 * 1024;
+
+ExpressionServer::ExpressionServer(const char* socketPath_, size_t cacheCapacity, WorkloadRecorder* recorder_)
+        : socketPath(socketPath_), stopping(false), cache(cacheCapacity), recorder(recorder_) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), socketPath);
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    listeningSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listeningSocket < 0) {
+        throw std::system_error(errno, std::generic_category(), socketPath);
+    }
+    unlink(socketPath.c_str());
+    if ((bind(listeningSocket, (const sockaddr*)&address, sizeof(address)) != 0) || (listen(listeningSocket, SOMAXCONN) != 0)) {
+        const int error = errno;
+        close(listeningSocket);
+        throw std::system_error(error, std::generic_category(), socketPath);
+    }
+}
+
+ExpressionServer::~ExpressionServer() {
+    stop();
+    for (Connection& connection : connections) {
+        connection.thread.join();
+        close(connection.socket);
+    }
+    close(listeningSocket);
+    unlink(socketPath.c_str());
+}
+
+void ExpressionServer::run() {
+    while (!stopping.load()) {
+        const int clientSocket = accept4(listeningSocket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (clientSocket < 0) {
+            if ((errno == EINTR) || (errno == ECONNABORTED)) continue;
+            break; // Listening socket is shut down by stop
+        }
+
+        joinFinishedConnections();
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        connections.emplace_back(clientSocket);
+        Connection& connection = connections.back();
+        if (stopping.load()) {
+            shutdown(clientSocket, SHUT_RDWR);
+        }
+        connection.thread = std::thread(&ExpressionServer::serve, this, std::ref(connection));
+    }
+}
+
+void ExpressionServer::stop() {
+    stopping.store(true);
+    shutdown(listeningSocket, SHUT_RDWR);
+
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (Connection& connection : connections) {
+        shutdown(connection.socket, SHUT_RDWR);
+    }
+}
+
+void ExpressionServer::joinFinishedConnections() {
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (auto connection = connections.begin(); connection != connections.end(); ) {
+        if (connection->finished.load()) {
+            connection->thread.join();
+            close(connection->socket);
+            connection = connections.erase(connection);
+        } else {
+            ++connection;
+        }
+    }
+}
+
+static bool sendAll(int socket, const std::string& data) {
+    size_t sentLength = 0;
+    while (sentLength < data.size()) {
+        const ssize_t sent = send(socket, data.data() + sentLength, data.size() - sentLength, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        sentLength += sent;
+    }
+    return true;
+}
+
+/**
+ * Reads requests from the connection and sends responses. All requests that are received together
+ * are handled before their responses are sent, so pipelined requests are answered with one write.
+ */
+void ExpressionServer::serve(Connection& connection) {
+    std::vector<char> buffer(INITIAL_BUFFER_SIZE);
+    size_t bufferLength = 0;
+    std::string response;
+
+    while (true) {
+        if (bufferLength == buffer.size()) {
+            if (buffer.size() >= MAX_REQUEST_LENGTH) {
+                sendAll(connection.socket, "ERROR Request is too long\n");
+                break;
+            }
+            buffer.resize(buffer.size() * 2);
+        }
+
+        const ssize_t receivedLength = recv(connection.socket, buffer.data() + bufferLength, buffer.size() - bufferLength, 0);
+        if (receivedLength < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (receivedLength == 0) {
+            break;
+        }
+
+        size_t lineStart = 0;
+        for (size_t i = bufferLength; i < bufferLength + receivedLength; ++i) {
+            if (buffer[i] != '\n') continue;
+            buffer[i] = '\0';
+            if ((i > lineStart) && (buffer[i - 1] == '\r')) buffer[i - 1] = '\0';
+            handleRequest(buffer.data() + lineStart, response);
+            lineStart = i + 1;
+        }
+        bufferLength += receivedLength;
+        memmove(buffer.data(), buffer.data() + lineStart, bufferLength - lineStart);
+        bufferLength -= lineStart;
+
+        if (!response.empty()) {
+            if (!sendAll(connection.socket, response)) break;
+            response.clear();
+        }
+    }
+    connection.finished.store(true);
+}
+
+/**
+ * Checks if the request starts with the command and finds it's arguments.
+ */
+static bool isCommand(const char* request, const char* command, const char*& arguments) {
+    const size_t commandLength = strlen(command);
+    if ((strncmp(request, command, commandLength) != 0) || ((request[commandLength] != ' ') && (request[commandLength] != '\0'))) {
+        return false;
+    }
+    arguments = request + commandLength;
+    while (*arguments == ' ') ++arguments;
+    return true;
+}
+
+/**
+ * Reads handle from the start of the arguments and moves them to the next argument.
+ * @throws std::invalid_argument if there is no handle.
+ */
+static uint64_t readHandle(const char*& arguments) {
+    char* handleEnd = nullptr;
+    const uint64_t handle = strtoull(arguments, &handleEnd, 10);
+    if ((handleEnd == arguments) || ((*handleEnd != ' ') && (*handleEnd != '\0'))) {
+        throw std::invalid_argument("Invalid handle");
+    }
+    arguments = handleEnd;
+    while (*arguments == ' ') ++arguments;
+    return handle;
+}
+
+void ExpressionServer::handleRequest(const char* request, std::string& response) {
+    assert(request != nullptr);
+    if (recorder == nullptr) {
+        dispatchRequest(request, response);
+        return;
+    }
+
+    const size_t responseStart = response.size();
+    const auto start = std::chrono::steady_clock::now();
+    dispatchRequest(request, response);
+    const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    recorder->record(request, getCreatedHandle(request, response.c_str() + responseStart), (uint64_t)duration.count());
+}
+
+void ExpressionServer::dispatchRequest(const char* request, std::string& response) {
+    const char* arguments = nullptr;
+    try {
+        if (isCommand(request, "PARSE", arguments)) {
+            handleParse(arguments, response);
+        } else if (isCommand(request, "OPTIMIZE", arguments)) {
+            handleOptimize(arguments, response);
+        } else if (isCommand(request, "DIFF", arguments)) {
+            handleDiff(arguments, response);
+        } else if (isCommand(request, "EVAL", arguments)) {
+            handleEval(arguments, response);
+        } else if (isCommand(request, "PRINT", arguments)) {
+            handlePrint(arguments, response);
+        } else if (isCommand(request, "RELEASE", arguments)) {
+            handleRelease(arguments, response);
+        } else if (isCommand(request, "STATS", arguments)) {
+            handleStats(response);
+        } else {
+            response += "ERROR Unknown command\n";
+        }
+    } catch (const std::logic_error& ex) { // Also catches std::invalid_argument
+        response += "ERROR ";
+        response += ex.what();
+        response += '\n';
+    }
+}
+
+uint64_t ExpressionServer::store(const std::shared_ptr<ASTNode>& root) {
+    return store(std::make_shared<const StoredExpression>(root));
+}
+
+uint64_t ExpressionServer::store(const std::shared_ptr<const StoredExpression>& expression) {
+    std::lock_guard<std::mutex> lock(expressionsMutex);
+    const uint64_t handle = nextHandle++;
+    expressions.emplace(handle, expression);
+    return handle;
+}
+
+std::shared_ptr<const ExpressionServer::StoredExpression> ExpressionServer::find(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(expressionsMutex);
+    auto expression = expressions.find(handle);
+    if (expression == expressions.end()) {
+        throw std::invalid_argument("Unknown handle");
+    }
+    return expression->second;
+}
+
+size_t ExpressionServer::getExpressionsNumber() {
+    std::lock_guard<std::mutex> lock(expressionsMutex);
+    return expressions.size();
+}
+
+void ExpressionServer::handleParse(const char* arguments, std::string& response) {
+    // Cached AST is shared with other handles, but stored expressions are never changed
+    ParseError error(NO_ERROR, 0);
+    std::shared_ptr<const CachedExpression> cachedExpression = cache.get(arguments, "", false, error);
+    char line[64];
+    if (cachedExpression != nullptr) {
+        auto expression = std::make_shared<const StoredExpression>(cachedExpression->root, cachedExpression->expression);
+        snprintf(line, sizeof(line), "OK %llu\n", (unsigned long long)store(expression));
+        response += line;
+    } else {
+        snprintf(line, sizeof(line), "ERROR %s %zu ", ParseErrorCodeStrings[error.code], error.position);
+        response += line;
+        response += error.getMessage();
+        response += '\n';
+    }
+}
+
+void ExpressionServer::handleOptimize(const char* arguments, std::string& response) {
+    auto expression = find(readHandle(arguments));
+    // Optimizers change the AST in place, but stored expressions are shared, so the copy is optimized
+    std::shared_ptr<ASTNode> root = copyAST(expression->root);
+    root = optimizer.optimize(root);
+
+    char line[32];
+    snprintf(line, sizeof(line), "OK %llu\n", (unsigned long long)store(root));
+    response += line;
+}
+
+void ExpressionServer::handleDiff(const char* arguments, std::string& response) {
+    auto expression = find(readHandle(arguments));
+    if (*arguments == '\0') {
+        throw std::invalid_argument("Missing differentiated variable");
+    }
+    const std::string variableName(arguments, strcspn(arguments, " "));
+
+    char line[32];
+    snprintf(line, sizeof(line), "OK %llu\n", (unsigned long long)store(differentiate(expression->root, variableName.c_str())));
+    response += line;
+}
+
+void ExpressionServer::handleEval(const char* arguments, std::string& response) {
+    auto expression = find(readHandle(arguments));
+    const auto variableValues = parseVariableValues(arguments);
+
+    const auto& variables = expression->compiledExpression.getVariables();
+    std::vector<double> values(variables.size());
+    for (size_t i = 0; i < variables.size(); ++i) {
+        bool found = false;
+        for (const auto& variableValue : variableValues) {
+            if (variableValue.first == variables[i]) {
+                values[i] = variableValue.second;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            throw std::invalid_argument("Variable '" + variables[i] + "' has no value");
+        }
+    }
+
+    char line[64];
+    snprintf(line, sizeof(line), "OK %.17g\n", expression->compiledExpression.evaluate(values.data()));
+    response += line;
+}
+
+void ExpressionServer::handlePrint(const char* arguments, std::string& response) {
+    auto expression = find(readHandle(arguments));
+    response += "OK ";
+    response += expression->root->toInfix();
+    response += '\n';
+}
+
+void ExpressionServer::handleRelease(const char* arguments, std::string& response) {
+    const uint64_t handle = readHandle(arguments);
+    std::shared_ptr<const StoredExpression> expression; // Is destroyed after the lock is released
+    {
+        std::lock_guard<std::mutex> lock(expressionsMutex);
+        auto storedExpression = expressions.find(handle);
+        if (storedExpression == expressions.end()) {
+            throw std::invalid_argument("Unknown handle");
+        }
+        expression = std::move(storedExpression->second);
+        expressions.erase(storedExpression);
+    }
+    response += "OK\n";
+}
+
+void ExpressionServer::handleStats(std::string& response) {
+    const ExpressionCacheStatistics statistics = cache.getStatistics();
+    char line[128];
+    snprintf(line, sizeof(line), "OK hits=%zu misses=%zu evictions=%zu size=%zu\n",
+             statistics.hits, statistics.misses, statistics.evictions, statistics.size);
+    response += line;
+}
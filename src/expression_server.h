@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @brief Definition of expression server
+ *
+ * Expression server listens on a Unix domain socket and keeps parsed expressions under numeric handles.
+ * Protocol is line-based, every request line gets exactly one response line:
+ *
+ *     PARSE <expression>           -> OK <handle>
+ *     OPTIMIZE <handle>            -> OK <handle of the optimized expression>
+ *     DIFF <handle> <variable>     -> OK <handle of the derivative>
+ *     EVAL <handle> [x=1,y=2,...]  -> OK <value>
+ *     PRINT <handle>               -> OK <infix expression>
+ *     RELEASE <handle>             -> OK
+ *     STATS                        -> OK hits=<n> misses=<n> evictions=<n> size=<n>
+ *
+ * Failed requests get "ERROR <message>" response (parse errors are "ERROR <code> <position> <message>").
+ * Clients can send many requests without waiting for responses (pipelining), responses come in request order.
+ * Connections are served concurrently, stored expressions are shared between them.
+ * Parsed expressions are taken from the expression cache, so repeated PARSE requests are cheap (STATS shows
+ * counters of the cache). Requests can be recorded into a workload log with their handling times (see workload_log.h).
+ */
+#ifndef AST_BUILDER_EXPRESSION_SERVER_H
+#define AST_BUILDER_EXPRESSION_SERVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "ast.h"
+#include "ast-optimizers.h"
+#include "compiled_expression.h"
+#include "expression_cache.h"
+#include "workload_log.h"
+
+class ExpressionServer {
+
+private:
+    struct StoredExpression {
+        std::shared_ptr<ASTNode> root;
+        CompiledExpression compiledExpression;
+
+        explicit StoredExpression(const std::shared_ptr<ASTNode>& root_) : root(root_), compiledExpression(root_) { }
+
+        StoredExpression(const std::shared_ptr<ASTNode>& root_, const CompiledExpression& compiledExpression_)
+                : root(root_), compiledExpression(compiledExpression_) { }
+    };
+
+    struct Connection {
+        int socket;
+        std::thread thread;
+        std::atomic<bool> finished;
+
+        explicit Connection(int socket_) : socket(socket_), finished(false) { }
+    };
+
+    const std::string socketPath;
+    int listeningSocket = -1;
+    std::atomic<bool> stopping;
+
+    std::mutex connectionsMutex;
+    std::list<Connection> connections;
+
+    std::mutex expressionsMutex;
+    std::unordered_map<uint64_t, std::shared_ptr<const StoredExpression> > expressions;
+    uint64_t nextHandle = 1;
+
+    const FullOptimizer optimizer;
+    ExpressionCache cache;
+    WorkloadRecorder* const recorder;
+
+    void serve(Connection& connection);
+    void joinFinishedConnections();
+
+    uint64_t store(const std::shared_ptr<ASTNode>& root);
+    uint64_t store(const std::shared_ptr<const StoredExpression>& expression);
+    std::shared_ptr<const StoredExpression> find(uint64_t handle);
+
+    void dispatchRequest(const char* request, std::string& response);
+
+    void handleParse(const char* arguments, std::string& response);
+    void handleOptimize(const char* arguments, std::string& response);
+    void handleDiff(const char* arguments, std::string& response);
+    void handleEval(const char* arguments, std::string& response);
+    void handlePrint(const char* arguments, std::string& response);
+    void handleRelease(const char* arguments, std::string& response);
+    void handleStats(std::string& response);
+
+public:
+    /**
+     * Creates the socket and starts listening on it. Existing file with the same path is removed.
+     * @param socketPath_    path of the Unix domain socket
+     * @param cacheCapacity  number of cached expressions, 0 disables the cache
+     * @param recorder_      recorder of the requests or nullptr, it must live longer than the server
+     * @throws std::system_error if the socket can't be created.
+     */
+    explicit ExpressionServer(const char* socketPath_, size_t cacheCapacity = DEFAULT_CACHE_CAPACITY,
+                              WorkloadRecorder* recorder_ = nullptr);
+
+    ExpressionServer(const ExpressionServer& server) = delete;
+    ExpressionServer& operator=(const ExpressionServer& server) = delete;
+
+    /**
+     * Stops the server and removes the socket file.
+     */
+    ~ExpressionServer();
+
+    /**
+     * Accepts connections and serves them until stop is called.
+     */
+    void run();
+
+    /**
+     * Stops accepting connections and closes all the connections. Can be called from any thread.
+     */
+    void stop();
+
+    /**
+     * Handles one request and records it if there is a recorder.
+     * @param request   request line without line break
+     * @param response  string to append response line to (with line break)
+     */
+    void handleRequest(const char* request, std::string& response);
+
+    size_t getExpressionsNumber();
+};
+
+#endif // AST_BUILDER_EXPRESSION_SERVER_H
@@ -0,0 +1,181 @@
+/**
+ * @file
+ * @brief Implementation of incremental parser
+ */
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <unordered_map>
+#include "incremental_parser.h"
+
+IncrementalParser::IncrementalParser(const char* source_, size_t maxDepth_) : source(source_), maxDepth(maxDepth_) {
+    reparseAll();
+}
+
+/**
+ * Checks if the symbol can continue a constant or a variable.
+ */
+static inline bool isAtomSymbol(char symbol) {
+    return std::isalnum((unsigned char)symbol) || (symbol == '.');
+}
+
+static std::shared_ptr<ASTNode> replaceChild(const ASTNode& node, size_t childIndex, const std::shared_ptr<ASTNode>& child) {
+    if (node.getChildrenNumber() == 1) {
+        return std::make_shared<ASTNode>(node.getToken(), child);
+    }
+    assert(node.getChildrenNumber() == 2);
+    const auto& leftChild  = (childIndex == 0) ? child : node.getChildren()[0];
+    const auto& rightChild = (childIndex == 1) ? child : node.getChildren()[1];
+    return std::make_shared<ASTNode>(node.getToken(), leftChild, rightChild);
+}
+
+ParseError IncrementalParser::edit(size_t begin, size_t end, const char* replacement) {
+    assert(replacement != nullptr);
+    assert((begin <= end) && (end <= source.size()));
+
+    const size_t replacementLength = strlen(replacement);
+    const ptrdiff_t delta = (ptrdiff_t)replacementLength - (ptrdiff_t)(end - begin);
+    source.replace(begin, end - begin, replacement, replacementLength);
+
+    if (root != nullptr) {
+        std::vector<size_t> candidates;
+        for (size_t i = 0; i < spans.size(); ++i) {
+            if ((spans[i].begin <= begin) && (end <= spans[i].end)) {
+                candidates.push_back(i);
+            }
+        }
+        // From the innermost span to the outermost. Constants and variables go before parentheses with the same content.
+        std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) {
+            const size_t aLength = spans[a].end - spans[a].begin;
+            const size_t bLength = spans[b].end - spans[b].begin;
+            return (aLength < bLength) || ((aLength == bLength) && !spans[a].parenthesised && spans[b].parenthesised);
+        });
+
+        // Nesting depth of the span content is a number of parenthesised spans that contain it
+        size_t depth = 0;
+        for (size_t candidate : candidates) {
+            if (spans[candidate].parenthesised) ++depth;
+        }
+        for (size_t candidate : candidates) {
+            if (reparseSpan(candidate, depth, delta)) {
+                return ParseError(NO_ERROR, 0);
+            }
+            if (spans[candidate].parenthesised) --depth;
+        }
+    }
+
+    return reparseAll();
+}
+
+bool IncrementalParser::reparseSpan(size_t spanIndex, size_t depth, ptrdiff_t delta) {
+    const SourceSpan span = spans[spanIndex];
+    const size_t newEnd = span.end + delta;
+    const std::string text = source.substr(span.begin, newEnd - span.begin);
+
+    // New subtree is nested in the parentheses and below the ancestors of the span node, so it gets the rest of the limit
+    const std::vector<std::pair<ASTNode*, size_t> > path = findPath(span.node);
+    const size_t usedDepth = std::max(depth, path.size() - 1);
+    if (usedDepth > maxDepth) {
+        return false;
+    }
+    std::vector<SourceSpan> newSpans;
+    ParseResult result = tryBuildAST(text.c_str(), maxDepth - usedDepth, &newSpans);
+    if (!result.isSuccess()) {
+        return false;
+    }
+    if (!span.parenthesised) {
+        // Constant or variable can only be replaced by a constant or a variable that doesn't merge with neighbours
+        if (result.getRoot()->getChildrenNumber() != 0) return false;
+        if ((span.begin > 0) && isAtomSymbol(source[span.begin - 1])) return false;
+        if ((newEnd < source.size()) && isAtomSymbol(source[newEnd])) return false;
+    }
+
+    std::vector<std::pair<const ASTNode*, const ASTNode*> > replacedNodes;
+    root = splice(path, result.getRoot(), replacedNodes);
+    std::unordered_map<const ASTNode*, const ASTNode*> newNodes(replacedNodes.begin(), replacedNodes.end());
+
+    size_t keptSpansNumber = 0;
+    for (size_t i = 0; i < spans.size(); ++i) {
+        SourceSpan currentSpan = spans[i];
+        const bool isInside = (span.begin <= currentSpan.begin) && (currentSpan.end <= span.end);
+        const bool isEnclosing = (currentSpan.begin <= span.begin) && (span.end <= currentSpan.end);
+        if ((i == spanIndex) && span.parenthesised) {
+            currentSpan.end = newEnd;
+        } else if (isInside) {
+            continue; // Subtree of the span is replaced, so it's spans are replaced by the new ones
+        } else if (isEnclosing) {
+            currentSpan.end += delta;
+        } else if (currentSpan.begin >= span.end) {
+            currentSpan.begin += delta;
+            currentSpan.end += delta;
+        }
+
+        const auto newNode = newNodes.find(currentSpan.node);
+        if (newNode != newNodes.end()) {
+            currentSpan.node = newNode->second;
+        }
+        spans[keptSpansNumber++] = currentSpan;
+    }
+    spans.resize(keptSpansNumber);
+
+    for (SourceSpan newSpan : newSpans) {
+        newSpan.begin += span.begin;
+        newSpan.end += span.begin;
+        spans.push_back(newSpan);
+    }
+
+    reparsedLength = text.size();
+    return true;
+}
+
+ParseError IncrementalParser::reparseAll() {
+    spans.clear();
+    ParseResult result = tryBuildAST(source.c_str(), maxDepth, &spans);
+    root = result.getRoot();
+    if (!result.isSuccess()) {
+        spans.clear();
+    }
+    reparsedLength = source.size();
+    return result.getError();
+}
+
+/**
+ * Finds the path from the root to the node.
+ * @return every node of the path with index of the child that is visited next, the last element is the node itself.
+ */
+std::vector<std::pair<ASTNode*, size_t> > IncrementalParser::findPath(const ASTNode* node) const {
+    std::vector<std::pair<ASTNode*, size_t> > path;
+    path.emplace_back(root.get(), 0);
+    while (path.back().first != node) {
+        auto& top = path.back();
+        if (top.second < top.first->getChildrenNumber()) {
+            path.emplace_back(top.first->getChildren()[top.second].get(), 0);
+        } else {
+            path.pop_back();
+            assert(!path.empty()); // node should be in the tree
+            ++path.back().second;
+        }
+    }
+    return path;
+}
+
+/**
+ * Replaces the last node of the path with newNode. All ancestors of the replaced node are copied, other nodes are kept.
+ * @param path          path from the root to the replaced node (see findPath)
+ * @param newNode       node to put instead of the replaced node
+ * @param replacedNodes pairs of old and new nodes (replaced node and it's copied ancestors)
+ * @return new root.
+ */
+std::shared_ptr<ASTNode> IncrementalParser::splice(const std::vector<std::pair<ASTNode*, size_t> >& path,
+                                                   const std::shared_ptr<ASTNode>& newNode,
+                                                   std::vector<std::pair<const ASTNode*, const ASTNode*> >& replacedNodes) const {
+    const ASTNode* oldNode = path.back().first;
+    replacedNodes.emplace_back(oldNode, newNode.get());
+    std::shared_ptr<ASTNode> replacement = newNode;
+    for (size_t i = path.size() - 1; i > 0; --i) {
+        const ASTNode* parent = path[i - 1].first;
+        replacement = replaceChild(*parent, path[i - 1].second, replacement);
+        replacedNodes.emplace_back(parent, replacement.get());
+    }
+    return replacement;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @brief Definition of incremental parser
+ *
+ * Incremental parser keeps the source, it's AST and source spans of the nodes. After an edit only the smallest
+ * enclosing subexpression that can be parsed on it's own (a constant, a variable or a parenthesised subexpression)
+ * is parsed again. New subtree is spliced into the AST by copying it's ancestors, so all the other subtrees
+ * keep their identity.
+ */
+#ifndef AST_BUILDER_INCREMENTAL_PARSER_H
+#define AST_BUILDER_INCREMENTAL_PARSER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ast.h"
+#include "iterative_parser.h"
+
+class IncrementalParser {
+
+private:
+    std::string source;
+    std::shared_ptr<ASTNode> root;
+    std::vector<SourceSpan> spans;
+    size_t maxDepth;
+    size_t reparsedLength = 0;
+
+    bool reparseSpan(size_t spanIndex, size_t depth, ptrdiff_t delta);
+    ParseError reparseAll();
+    std::vector<std::pair<ASTNode*, size_t> > findPath(const ASTNode* node) const;
+    std::shared_ptr<ASTNode> splice(const std::vector<std::pair<ASTNode*, size_t> >& path, const std::shared_ptr<ASTNode>& newNode,
+                                    std::vector<std::pair<const ASTNode*, const ASTNode*> >& replacedNodes) const;
+
+public:
+    /**
+     * Parses the source. If it's invalid, the root is null until a valid source is made by edits.
+     * @param source_   source to parse
+     * @param maxDepth_ maximum allowed nesting depth of parentheses and depth of the AST
+     */
+    explicit IncrementalParser(const char* source_, size_t maxDepth_ = DEFAULT_MAX_NESTING_DEPTH);
+
+    /**
+     * Replaces [begin, end) part of the source with the replacement and updates the AST.
+     * @param begin         start of the replaced part
+     * @param end           end of the replaced part
+     * @param replacement   new text of the replaced part
+     * @return syntax error of the edited source or error with NO_ERROR code if it's valid.
+     *         If the source is invalid, root becomes null.
+     */
+    ParseError edit(size_t begin, size_t end, const char* replacement);
+
+    const std::string& getSource() const {
+        return source;
+    }
+
+    const std::shared_ptr<ASTNode>& getRoot() const {
+        return root;
+    }
+
+    /**
+     * Number of source characters parsed by the last edit (or by construction).
+     * @return length of the reparsed part.
+     */
+    size_t getReparsedLength() const {
+        return reparsedLength;
+    }
+};
+
+#endif // AST_BUILDER_INCREMENTAL_PARSER_H
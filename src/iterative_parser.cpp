@@ -0,0 +1,494 @@
+/**
+ * @file
+ * @brief Implementation of iterative parser
+ *
+ * It's the parser core behind buildAST, buildASTRecursively and buildASTIteratively.
+ * It parses mathematical expressions using next grammar:
+ *
+ *     G = E '\0'
+ *     E = T ([+|-] T)*
+ *     T = F ([*|/] F)*
+ *     F = U (^ U)*
+ *     U = [+|-] U | P
+ *     P = '(' E ')' | N | ID | ID '(' E ')'
+ *     N = [0-9]+ ('.' [0-9]*)? ([eE] [+|-]? [0-9]+)?
+ *     ID = [a-zA-Z][a-zA-Z0-9]* '*
+ *
+ * Unary operators bind tighter than '^' (like in tokenizer), so -2^2 is (-2)^2.
+ * Trailing apostrophes of ID are used by derivatives of other variables (e.g. y'), so printed derivatives are parsed back.
+ *
+ * Instead of descending into E for every parenthesis it uses shunting-yard algorithm:
+ * operators, open parentheses and function calls wait on one stack and built operands on another.
+ * Operands are built by a builder, so the same parsing code is used either to build an AST
+ * or only to check the syntax.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "iterative_parser.h"
+#include "SyntaxError.h"
+#include "tracing.h"
+
+/** Initial capacity of parser stacks. It's enough for usual expressions to parse them without reallocations. **/
+static constexpr size_t INITIAL_STACK_CAPACITY = 32u;
+
+/**
+ * Element of operators stack. It's either a pending binary operator, an open parenthesis
+ * or an open parenthesis of a function call.
+ */
+struct PendingOperation {
+    enum Kind { OPERATOR, PARENTHESIS, FUNCTION_CALL };
+
+    Kind kind;
+    OperatorType operatorType;
+    FunctionType functionType;
+    size_t position; // Position after the parenthesis for PARENTHESIS and FUNCTION_CALL
+
+    PendingOperation(Kind kind_, OperatorType operatorType_, FunctionType functionType_, size_t position_) :
+        kind(kind_), operatorType(operatorType_), functionType(functionType_), position(position_) { }
+};
+
+struct FunctionName {
+    const char* name;
+    FunctionType functionType;
+};
+
+static const FunctionName functionNames[] = {
+    { "sin", SIN },
+    { "cos", COS },
+    { "tg" , TG  },
+    { "ctg", CTG },
+    { "ln" , LN  },
+};
+
+/**
+ * Builder that creates AST nodes for parsed operands and operators.
+ */
+class ASTBuilder {
+
+private:
+    std::vector<std::shared_ptr<ASTNode> > operands;
+    std::vector<SourceSpan>* spans;
+
+public:
+    explicit ASTBuilder(std::vector<SourceSpan>* spans_ = nullptr) : spans(spans_) {
+        operands.reserve(INITIAL_STACK_CAPACITY);
+    }
+
+    void addConstant(double value) {
+        operands.push_back(std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(value)));
+    }
+
+    void addVariable(const char* name, size_t length) {
+        assert(length < VariableToken::MAX_NAME_LENGTH);
+        char variableName[VariableToken::MAX_NAME_LENGTH];
+        memcpy(variableName, name, length);
+        variableName[length] = '\0';
+        operands.push_back(std::make_shared<ASTNode>(VariableToken::getVariableByName(variableName)));
+    }
+
+    void applyOperator(OperatorType operatorType) {
+        if (operatorType == ARITHMETIC_NEGATION) {
+            assert(!operands.empty());
+            operands.back() = std::make_shared<ASTNode>(std::make_shared<ArithmeticNegationOperator>(), operands.back());
+            return;
+        } else if (operatorType == UNARY_ADDITION) {
+            assert(!operands.empty());
+            operands.back() = std::make_shared<ASTNode>(std::make_shared<UnaryAdditionOperator>(), operands.back());
+            return;
+        }
+
+        assert(operands.size() >= 2);
+        std::shared_ptr<Token> token;
+        switch (operatorType) {
+            case ADDITION:
+                token = std::make_shared<AdditionOperator>();
+                break;
+            case SUBTRACTION:
+                token = std::make_shared<SubtractionOperator>();
+                break;
+            case MULTIPLICATION:
+                token = std::make_shared<MultiplicationOperator>();
+                break;
+            case DIVISION:
+                token = std::make_shared<DivisionOperator>();
+                break;
+            case POWER:
+                token = std::make_shared<PowerOperator>();
+                break;
+            default:
+                assert(false);
+        }
+        auto rightOperand = std::move(operands.back());
+        operands.pop_back();
+        operands.back() = std::make_shared<ASTNode>(token, operands.back(), rightOperand);
+    }
+
+    void applyFunction(FunctionType functionType) {
+        static const std::shared_ptr<Token> functions[] = {
+            std::make_shared<SinFunction>(),
+            std::make_shared<CosFunction>(),
+            std::make_shared<TgFunction>(),
+            std::make_shared<CtgFunction>(),
+            std::make_shared<LnFunction>(),
+        };
+
+        assert(!operands.empty());
+        operands.back() = std::make_shared<ASTNode>(functions[functionType], operands.back());
+    }
+
+    /**
+     * Remembers that the last built operand was parsed from [begin, end) of the expression.
+     */
+    void markSpan(size_t begin, size_t end, bool parenthesised) {
+        if (spans != nullptr) {
+            spans->push_back({ operands.back().get(), begin, end, parenthesised });
+        }
+    }
+
+    std::shared_ptr<ASTNode> getResult() const {
+        assert(operands.size() == 1);
+        return operands.back();
+    }
+};
+
+/**
+ * Builder that creates nothing. Is used to check the syntax only.
+ */
+class SyntaxChecker {
+
+public:
+    void addConstant(double value __attribute__((unused))) { }
+
+    void addVariable(const char* name __attribute__((unused)), size_t length __attribute__((unused))) { }
+
+    void applyOperator(OperatorType operatorType __attribute__((unused))) { }
+
+    void applyFunction(FunctionType functionType __attribute__((unused))) { }
+
+    void markSpan(size_t begin __attribute__((unused)), size_t end __attribute__((unused)), bool parenthesised __attribute__((unused))) { }
+};
+
+/**
+ * Parsed expression. It's not required to be null-terminated, so symbols after the end are read as '\0'.
+ */
+struct Input {
+    const char* data;
+    size_t length;
+
+    char operator[](size_t pos) const {
+        return (pos < length) ? data[pos] : '\0';
+    }
+};
+
+static inline void skipSpaces(const Input& expression, size_t& pos) {
+    while (std::isspace((unsigned char)expression[pos])) ++pos;
+}
+
+static inline bool getBinaryOperator(char symbol, OperatorType& operatorType) {
+    switch (symbol) {
+        case '+':
+            operatorType = ADDITION;
+            return true;
+        case '-':
+            operatorType = SUBTRACTION;
+            return true;
+        case '*':
+            operatorType = MULTIPLICATION;
+            return true;
+        case '/':
+            operatorType = DIVISION;
+            return true;
+        case '^':
+            operatorType = POWER;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static inline bool getUnaryOperator(char symbol, OperatorType& operatorType) {
+    switch (symbol) {
+        case '+':
+            operatorType = UNARY_ADDITION;
+            return true;
+        case '-':
+            operatorType = ARITHMETIC_NEGATION;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Precedence of operator. Same as in corresponding OperatorToken.
+ */
+static inline size_t getPrecedence(OperatorType operatorType) {
+    switch (operatorType) {
+        case ARITHMETIC_NEGATION:
+        case UNARY_ADDITION:
+            return 1000;
+        case ADDITION:
+        case SUBTRACTION:
+            return 1;
+        case MULTIPLICATION:
+        case DIVISION:
+            return 2;
+        case POWER:
+            return 3;
+        default:
+            assert(false);
+            return 0;
+    }
+}
+
+static inline bool isRightAssociative(OperatorType operatorType) {
+    return (operatorType == POWER) || (operatorType == ARITHMETIC_NEGATION) || (operatorType == UNARY_ADDITION);
+}
+
+/**
+ * Reads constant value (see N in grammar) that starts at pos.
+ */
+static inline double getNumber(const Input& expression, size_t& pos) {
+    const size_t startPos = pos;
+    while (std::isdigit((unsigned char)expression[pos])) ++pos;
+    if (expression[pos] == '.') {
+        ++pos;
+        while (std::isdigit((unsigned char)expression[pos])) ++pos;
+    }
+    if ((expression[pos] == 'e') || (expression[pos] == 'E')) {
+        size_t exponentPos = pos + 1;
+        if ((expression[exponentPos] == '+') || (expression[exponentPos] == '-')) ++exponentPos;
+        if (std::isdigit((unsigned char)expression[exponentPos])) {
+            pos = exponentPos;
+            while (std::isdigit((unsigned char)expression[pos])) ++pos;
+        }
+    }
+
+    // Copy is needed, because strtod accepts wider syntax (e.g. hexadecimal numbers) than the grammar
+    static constexpr size_t MAX_NUMBER_LENGTH = 64;
+    const size_t length = pos - startPos;
+    if (length < MAX_NUMBER_LENGTH) {
+        char number[MAX_NUMBER_LENGTH];
+        memcpy(number, expression.data + startPos, length);
+        number[length] = '\0';
+        return strtod(number, nullptr);
+    }
+    char* number = (char*)calloc(length + 1, sizeof(char));
+    memcpy(number, expression.data + startPos, length);
+    const double value = strtod(number, nullptr);
+    free(number);
+    return value;
+}
+
+static inline bool getFunction(const char* name, size_t length, FunctionType& functionType) {
+    for (const FunctionName& functionName : functionNames) {
+        if ((strncmp(functionName.name, name, length) == 0) && (functionName.name[length] == '\0')) {
+            functionType = functionName.functionType;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Applies the pending operator or function call to the last built operands. Depths of operands are tracked
+ * by the parser itself, so the depth of AST is bounded even if only the syntax is checked.
+ * @return false if the depth of the built operand exceeds maxDepth.
+ */
+template <typename Builder>
+static bool applyPendingOperation(Builder& builder, const PendingOperation& operation,
+                                  std::vector<size_t>& operandDepths, size_t maxDepth) {
+    assert(!operandDepths.empty());
+    size_t depth = operandDepths.back() + 1;
+    if ((operation.kind == PendingOperation::OPERATOR) && (operation.operatorType != ARITHMETIC_NEGATION)
+            && (operation.operatorType != UNARY_ADDITION)) {
+        assert(operandDepths.size() >= 2);
+        operandDepths.pop_back();
+        depth = std::max(depth, operandDepths.back() + 1);
+    }
+    if (depth > maxDepth) {
+        return false;
+    }
+    operandDepths.back() = depth;
+
+    if (operation.kind == PendingOperation::FUNCTION_CALL) {
+        builder.applyFunction(operation.functionType);
+    } else {
+        assert(operation.kind == PendingOperation::OPERATOR);
+        builder.applyOperator(operation.operatorType);
+    }
+    return true;
+}
+
+template <typename Builder>
+static ParseError parse(const Input& expression, size_t maxDepth, Builder& builder) {
+    assert((expression.data != nullptr) || (expression.length == 0));
+
+    std::vector<PendingOperation> operations;
+    operations.reserve(INITIAL_STACK_CAPACITY);
+    std::vector<size_t> operandDepths;
+    operandDepths.reserve(INITIAL_STACK_CAPACITY);
+    size_t depth = 0;
+    bool expectOperand = true;
+    size_t pos = 0;
+
+    while (true) {
+        skipSpaces(expression, pos);
+        const char symbol = expression[pos];
+        OperatorType operatorType = ADDITION;
+
+        if (expectOperand) {
+            if (symbol == '(') {
+                if (++depth > maxDepth) {
+                    return ParseError(MAX_NESTING_DEPTH_EXCEEDED, pos);
+                }
+                ++pos;
+                operations.emplace_back(PendingOperation::PARENTHESIS, ADDITION, SIN, pos);
+            } else if (getUnaryOperator(symbol, operatorType)) {
+                operations.emplace_back(PendingOperation::OPERATOR, operatorType, SIN, pos);
+                ++pos;
+            } else if (std::isdigit((unsigned char)symbol)) {
+                const size_t startPos = pos;
+                builder.addConstant(getNumber(expression, pos));
+                builder.markSpan(startPos, pos, false);
+                operandDepths.push_back(0);
+                expectOperand = false;
+            } else if (std::isalpha((unsigned char)symbol)) {
+                const size_t startPos = pos;
+                while (std::isalnum((unsigned char)expression[pos])) {
+                    ++pos;
+                }
+                const size_t nameEnd = pos;
+                while (expression[pos] == '\'') {
+                    ++pos;
+                }
+                FunctionType functionType = SIN;
+                if ((nameEnd == pos) && getFunction(expression.data + startPos, pos - startPos, functionType)) {
+                    skipSpaces(expression, pos);
+                    if (expression[pos] != '(') {
+                        return ParseError(EXPECTED_OPEN_PARENTHESIS, pos);
+                    }
+                    if (++depth > maxDepth) {
+                        return ParseError(MAX_NESTING_DEPTH_EXCEEDED, pos);
+                    }
+                    ++pos;
+                    operations.emplace_back(PendingOperation::FUNCTION_CALL, ADDITION, functionType, pos);
+                } else {
+                    if (pos - startPos >= VariableToken::MAX_NAME_LENGTH) {
+                        return ParseError(TOO_LONG_VARIABLE_NAME, startPos);
+                    }
+                    builder.addVariable(expression.data + startPos, pos - startPos);
+                    builder.markSpan(startPos, pos, false);
+                    operandDepths.push_back(0);
+                    expectOperand = false;
+                }
+            } else {
+                return ParseError(INVALID_SYMBOL, pos);
+            }
+        } else {
+            if (getBinaryOperator(symbol, operatorType)) {
+                const size_t precedence = getPrecedence(operatorType);
+                while (!operations.empty() && (operations.back().kind == PendingOperation::OPERATOR)) {
+                    const size_t topPrecedence = getPrecedence(operations.back().operatorType);
+                    if ((topPrecedence < precedence) || ((topPrecedence == precedence) && isRightAssociative(operatorType))) {
+                        break;
+                    }
+                    if (!applyPendingOperation(builder, operations.back(), operandDepths, maxDepth)) {
+                        return ParseError(MAX_NESTING_DEPTH_EXCEEDED, operations.back().position);
+                    }
+                    operations.pop_back();
+                }
+                operations.emplace_back(PendingOperation::OPERATOR, operatorType, SIN, pos);
+                expectOperand = true;
+                ++pos;
+            } else if ((symbol == ')') && (depth > 0)) {
+                while (operations.back().kind == PendingOperation::OPERATOR) {
+                    if (!applyPendingOperation(builder, operations.back(), operandDepths, maxDepth)) {
+                        return ParseError(MAX_NESTING_DEPTH_EXCEEDED, operations.back().position);
+                    }
+                    operations.pop_back();
+                }
+                builder.markSpan(operations.back().position, pos, true);
+                if ((operations.back().kind == PendingOperation::FUNCTION_CALL)
+                        && !applyPendingOperation(builder, operations.back(), operandDepths, maxDepth)) {
+                    return ParseError(MAX_NESTING_DEPTH_EXCEEDED, pos);
+                }
+                operations.pop_back();
+                --depth;
+                ++pos;
+            } else if (depth > 0) {
+                return ParseError(EXPECTED_CLOSING_PARENTHESIS, pos);
+            } else if (pos < expression.length) {
+                return ParseError(INVALID_SYMBOL, pos);
+            } else {
+                break;
+            }
+        }
+    }
+
+    while (!operations.empty()) {
+        if (!applyPendingOperation(builder, operations.back(), operandDepths, maxDepth)) {
+            return ParseError(MAX_NESTING_DEPTH_EXCEEDED, operations.back().position);
+        }
+        operations.pop_back();
+    }
+    return ParseError(NO_ERROR, pos);
+}
+
+std::shared_ptr<ASTNode> buildASTIteratively(const char* expression, size_t maxDepth) {
+    assert(expression != nullptr);
+    return buildASTFromRange(expression, expression + strlen(expression), maxDepth);
+}
+
+std::shared_ptr<ASTNode> buildASTFromRange(const char* begin, const char* end, size_t maxDepth) {
+    assert(begin <= end);
+
+    ASTBuilder builder;
+    const ParseError error = parse(Input{ begin, (size_t)(end - begin) }, maxDepth, builder);
+    if (error.isError()) {
+        throw SyntaxError(error.position, error.getMessage());
+    }
+    return builder.getResult();
+}
+
+ParseResult tryBuildAST(const char* expression, size_t maxDepth) {
+    return tryBuildAST(expression, maxDepth, nullptr);
+}
+
+ParseResult tryBuildAST(const char* expression, size_t maxDepth, std::vector<SourceSpan>* spans) {
+    assert(expression != nullptr);
+    TRACE_SCOPE("tryBuildAST");
+
+    ASTBuilder builder(spans);
+    const ParseError error = parse(Input{ expression, strlen(expression) }, maxDepth, builder);
+    if (error.isError()) {
+        return ParseResult(error);
+    }
+    return ParseResult(builder.getResult());
+}
+
+ParseResult tryBuildASTFromRange(const char* begin, const char* end, size_t maxDepth) {
+    assert(begin <= end);
+
+    ASTBuilder builder;
+    const ParseError error = parse(Input{ begin, (size_t)(end - begin) }, maxDepth, builder);
+    if (error.isError()) {
+        return ParseResult(error);
+    }
+    return ParseResult(builder.getResult());
+}
+
+ParseError validateExpression(const char* expression, size_t maxDepth) {
+    assert(expression != nullptr);
+    return validateRange(expression, expression + strlen(expression), maxDepth);
+}
+
+ParseError validateRange(const char* begin, const char* end, size_t maxDepth) {
+    assert(begin <= end);
+
+    SyntaxChecker checker;
+    return parse(Input{ begin, (size_t)(end - begin) }, maxDepth, checker);
+}
@@ -0,0 +1,169 @@
+/**
+ * @file
+ * @brief Definition of iterative parser
+ *
+ * Parses the same grammar as the recursive parser, but keeps pending operators and operands on heap-allocated
+ * stacks instead of the call stack, so deeply nested expressions can't overflow it.
+ */
+#ifndef AST_BUILDER_ITERATIVE_PARSER_H
+#define AST_BUILDER_ITERATIVE_PARSER_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "ast.h"
+
+/**
+ * Default limit of parentheses nesting depth and of AST depth for iterative parser. Differentiation, optimization
+ * and calculation are recursive, so deeper ASTs overflow 8 MB thread stacks (it happens at about 10000 levels).
+ */
+static constexpr size_t DEFAULT_MAX_NESTING_DEPTH = 1000u;
+
+enum ParseErrorCode {
+    NO_ERROR,
+    INVALID_SYMBOL,
+    EXPECTED_OPEN_PARENTHESIS,
+    EXPECTED_CLOSING_PARENTHESIS,
+    MAX_NESTING_DEPTH_EXCEEDED,
+    TOO_LONG_VARIABLE_NAME,
+};
+
+static const char* const ParseErrorCodeStrings[] = {
+    "NO_ERROR",
+    "INVALID_SYMBOL",
+    "EXPECTED_OPEN_PARENTHESIS",
+    "EXPECTED_CLOSING_PARENTHESIS",
+    "MAX_NESTING_DEPTH_EXCEEDED",
+    "TOO_LONG_VARIABLE_NAME",
+};
+
+static const char* const ParseErrorMessages[] = {
+    "No error",
+    "Invalid symbol",
+    "Expected open parenthesis",
+    "Expected closing parenthesis",
+    "Maximum nesting depth exceeded",
+    "Too long variable name",
+};
+
+/**
+ * Syntax error found by the parser. Same as SyntaxError, but is returned instead of being thrown.
+ */
+struct ParseError {
+    ParseErrorCode code;
+    size_t position;
+
+    ParseError(ParseErrorCode code_, size_t position_) : code(code_), position(position_) { }
+
+    bool isError() const {
+        return code != NO_ERROR;
+    }
+
+    const char* getMessage() const {
+        return ParseErrorMessages[code];
+    }
+};
+
+/**
+ * Result of parsing. Holds either root of the built AST or the syntax error.
+ */
+class ParseResult {
+
+private:
+    std::shared_ptr<ASTNode> root;
+    ParseError error;
+
+public:
+    explicit ParseResult(const std::shared_ptr<ASTNode>& root_) : root(root_), error(NO_ERROR, 0) { }
+
+    explicit ParseResult(const ParseError& error_) : root(nullptr), error(error_) { }
+
+    bool isSuccess() const {
+        return !error.isError();
+    }
+
+    const std::shared_ptr<ASTNode>& getRoot() const {
+        return root;
+    }
+
+    const ParseError& getError() const {
+        return error;
+    }
+};
+
+/**
+ * Part of the source that AST node was parsed from. Spans are recorded for constants, variables
+ * and parenthesised subexpressions (including arguments of functions).
+ */
+struct SourceSpan {
+    const ASTNode* node;
+    size_t begin;        // For parenthesised subexpression it's the position after open parenthesis
+    size_t end;          // For parenthesised subexpression it's the position of closing parenthesis
+    bool parenthesised;
+};
+
+/**
+ * Builds AST from the expression without recursion. Works in linear time for any nesting depth.
+ * @param expression    expression to parse
+ * @param maxDepth      maximum allowed nesting depth of parentheses (function calls count as parentheses) and
+ *                      depth of the AST (number of operators and functions on the longest path from the root)
+ * @return root of the built AST.
+ * @throws SyntaxError if expression is invalid or it's nesting depth or depth of it's AST exceeds maxDepth.
+ */
+std::shared_ptr<ASTNode> buildASTIteratively(const char* expression, size_t maxDepth = DEFAULT_MAX_NESTING_DEPTH);
+
+/**
+ * Builds AST from the [begin, end) range like buildASTIteratively. The range is parsed in place and doesn't need to be
+ * null-terminated, so it may be a part of memory-mapped file.
+ * @param begin     start of the expression
+ * @param end       end of the expression
+ * @param maxDepth  maximum allowed nesting depth of parentheses and depth of the AST
+ * @return root of the built AST.
+ * @throws SyntaxError if expression is invalid or it's nesting depth or depth of it's AST exceeds maxDepth.
+ */
+std::shared_ptr<ASTNode> buildASTFromRange(const char* begin, const char* end, size_t maxDepth = DEFAULT_MAX_NESTING_DEPTH);
+
+/**
+ * Builds AST from the expression like buildASTIteratively, but doesn't throw on invalid expression.
+ * @param expression    expression to parse
+ * @param maxDepth      maximum allowed nesting depth of parentheses and depth of the AST
+ * @return result with the root of built AST or with the first syntax error.
+ */
+ParseResult tryBuildAST(const char* expression, size_t maxDepth = DEFAULT_MAX_NESTING_DEPTH);
+
+/**
+ * Builds AST from the expression like tryBuildAST and records source spans of the built nodes.
+ * @param expression    expression to parse
+ * @param maxDepth      maximum allowed nesting depth of parentheses and depth of the AST
+ * @param spans         vector to append spans to (inner spans are appended before outer ones)
+ * @return result with the root of built AST or with the first syntax error.
+ */
+ParseResult tryBuildAST(const char* expression, size_t maxDepth, std::vector<SourceSpan>* spans);
+
+/**
+ * Builds AST from the [begin, end) range like buildASTFromRange, but doesn't throw on invalid expression.
+ * @param begin     start of the expression
+ * @param end       end of the expression
+ * @param maxDepth  maximum allowed nesting depth of parentheses and depth of the AST
+ * @return result with the root of built AST or with the first syntax error.
+ */
+ParseResult tryBuildASTFromRange(const char* begin, const char* end, size_t maxDepth = DEFAULT_MAX_NESTING_DEPTH);
+
+/**
+ * Checks syntax of the expression without building an AST, so no nodes, tokens or variables are created.
+ * @param expression    expression to check
+ * @param maxDepth      maximum allowed nesting depth of parentheses and depth of the AST
+ * @return the first syntax error or error with NO_ERROR code if expression is valid.
+ */
+ParseError validateExpression(const char* expression, size_t maxDepth = DEFAULT_MAX_NESTING_DEPTH);
+
+/**
+ * Checks syntax of the [begin, end) range like validateExpression. The range doesn't need to be null-terminated.
+ * @param begin     start of the expression
+ * @param end       end of the expression
+ * @param maxDepth  maximum allowed nesting depth of parentheses and depth of the AST
+ * @return the first syntax error or error with NO_ERROR code if expression is valid.
+ */
+ParseError validateRange(const char* begin, const char* end, size_t maxDepth = DEFAULT_MAX_NESTING_DEPTH);
+
+#endif // AST_BUILDER_ITERATIVE_PARSER_H
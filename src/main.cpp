@@ -1,49 +1,488 @@
 /**
  * @file
  */
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "allocation_tracker.h"
 #include "ast.h"
 #include "ast-math.h"
 #include "ast-optimizers.h"
+#include "ast_metrics.h"
+#include "batch.h"
+#include "binary_ast.h"
+#include "evaluation_profiler.h"
+#include "expression_server.h"
+#include "iterative_parser.h"
+#include "mapped_file.h"
 #include "recursive_parser.h"
+#include "render_pipeline.h"
+#include "shm_ring.h"
 #include "SyntaxError.h"
+#include "thread_pool.h"
+#include "tracing.h"
+#include "workload_log.h"
 
-void outputAST(const std::shared_ptr<ASTNode>& root, const char* fileName) {
-    root->visualize(fileName);
-    root->texify(fileName);
+static inline double getMillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static inline double getSavedPercents(double value, double separateValue) {
+    return (separateValue > 0.) ? 100. * (1. - value / separateValue) : 0.;
+}
+
+/**
+ * Prints the statistics in one line with the saved shares of nodes and time.
+ */
+static void printGradientStatistics(FILE* file, const GradientStatistics& statistics) {
+    fprintf(file, "gradient of %zu variables: %zu unique nodes in %.3f ms, separate derivatives: %zu unique nodes in %.3f ms, "
+                  "saved %.1f%% of nodes and %.1f%% of time\n",
+            statistics.variablesNumber, statistics.uniqueNodesNumber, statistics.milliseconds,
+            statistics.separateUniqueNodesNumber, statistics.separateMilliseconds,
+            getSavedPercents((double)statistics.uniqueNodesNumber, (double)statistics.separateUniqueNodesNumber),
+            getSavedPercents(statistics.milliseconds, statistics.separateMilliseconds));
+}
+
+/**
+ * Writes the recorded trace spans into the file if it's given (see --trace option).
+ * @return false if the file can't be written.
+ */
+static bool saveTrace(const char* traceFileName) {
+    if (traceFileName == nullptr) {
+        return true;
+    }
+    try {
+        saveChromeTrace(traceFileName);
+    } catch (const std::system_error& ex) {
+        fprintf(stderr, "Can't write trace: %s", ex.what());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parses names of the variables of the gradient (see --gradient option): "x,y,z".
+ * @throws std::invalid_argument if a name isn't a name of variable.
+ */
+static std::vector<std::string> parseVariableNames(const char* names) {
+    std::vector<std::string> variableNames;
+    const char* position = names;
+    while (true) {
+        const char* nameEnd = position;
+        while ((*nameEnd != ',') && (*nameEnd != '\0')) ++nameEnd;
+        const std::string name(position, nameEnd);
+        if (name.empty() || !isalpha((unsigned char)name[0]) || (name.size() >= VariableToken::MAX_NAME_LENGTH) ||
+            !std::all_of(name.begin(), name.end(), [](char symbol) { return isalnum((unsigned char)symbol) != 0; })) {
+            throw std::invalid_argument("Name '" + name + "' should start with letter and contain only letters and digits");
+        }
+        if (std::find(variableNames.begin(), variableNames.end(), name) != variableNames.end()) {
+            throw std::invalid_argument("Name '" + name + "' is repeated");
+        }
+        variableNames.push_back(name);
+        if (*nameEnd == '\0') {
+            return variableNames;
+        }
+        position = nameEnd + 1;
+    }
+}
+
+/**
+ * Records stages of the run into the workload log as requests of the server protocol (see --record option).
+ * Handles are numbered like the server does: every recorded stage creates the next one.
+ */
+class StageRecorder {
+
+private:
+    std::unique_ptr<WorkloadRecorder> recorder;
+    uint64_t handlesNumber = 0;
+
+public:
+    /**
+     * Starts recording into the workload log.
+     * @throws std::system_error if the log can't be opened.
+     */
+    void open(const char* fileName) {
+        recorder.reset(new WorkloadRecorder(fileName));
+    }
+
+    bool isRecording() const {
+        return recorder != nullptr;
+    }
+
+    /**
+     * Stops recording, e.g. if the expression can't be recorded.
+     */
+    void stop() {
+        recorder.reset();
+    }
+
+    /**
+     * @return handle created by the request.
+     */
+    uint64_t record(const std::string& request, double milliseconds) {
+        ++handlesNumber;
+        if ((recorder != nullptr) && !recorder->record(request, handlesNumber, (uint64_t)(milliseconds * 1e6))) {
+            fprintf(stderr, "Can't write workload log\n");
+            recorder.reset();
+        }
+        return handlesNumber;
+    }
+};
+
+/**
+ * Runs batch mode: ast-builder --batch [<file>] [--optimized] [--threads <number>] [--values <name>=<value>,...]
+ *                                      [--trace <file>]
+ * Expressions are read from the file or from stdin, results are written to stdout.
+ */
+int runBatchMode(int argc, char* argv[]) {
+    FILE* input = stdin;
+    int optionsStart = 2;
+    if ((argc > 2) && (strncmp(argv[2], "--", 2) != 0)) {
+        input = fopen(argv[2], "r");
+        if (input == nullptr) {
+            fprintf(stderr, "Can't open expressions file '%s'", argv[2]);
+            return -1;
+        }
+        optionsStart = 3;
+    }
+
+    BatchOptions options;
+    const char* traceFileName = nullptr;
+    for (int i = optionsStart; i < argc; ++i) {
+        if (strcmp(argv[i], "--optimized") == 0) {
+            options.optimized = true;
+        } else if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc)) {
+            options.threadsNumber = strtoul(argv[++i], nullptr, 10);
+        } else if ((strcmp(argv[i], "--values") == 0) && (i + 1 < argc)) {
+            try {
+                options.variableValues = parseVariableValues(argv[++i]);
+            } catch (const std::invalid_argument& ex) {
+                fprintf(stderr, "Invalid variable values: %s", ex.what());
+                return -1;
+            }
+        } else if ((strcmp(argv[i], "--cache") == 0) && (i + 1 < argc)) {
+            options.cacheCapacity = strtoul(argv[++i], nullptr, 10);
+        } else if ((strcmp(argv[i], "--cache-dir") == 0) && (i + 1 < argc)) {
+            options.cacheDirectory = argv[++i];
+        } else if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+            traceFileName = argv[++i];
+        } else {
+            fprintf(stderr, "Invalid option '%s'. Only '--optimized', '--threads', '--values', '--cache', "
+                            "'--cache-dir' and '--trace' are supported", argv[i]);
+            return -1;
+        }
+    }
+
+    setTracing(traceFileName != nullptr);
+    BatchStatistics statistics = runBatch(input, stdout, options);
+    if (input != stdin) fclose(input);
+    fprintf(stderr, "Processed %zu expressions, %zu errors\n", statistics.expressionsNumber, statistics.errorsNumber);
+    const ExpressionCacheStatistics& cacheStatistics = statistics.cacheStatistics;
+    fprintf(stderr, "Cache: %zu hits, %zu misses (%zu found by structure, %zu loaded from disk), %zu evictions\n",
+            cacheStatistics.hits, cacheStatistics.misses, cacheStatistics.structuralHits, cacheStatistics.diskHits,
+            cacheStatistics.evictions);
+    return saveTrace(traceFileName) ? 0 : -1;
+}
+
+/**
+ * Runs the expression server on the socket until SIGINT or SIGTERM is received:
+ * ast-builder --serve <socket> [--record <workload log>]
+ */
+int runServerMode(int argc, char* argv[]) {
+    if ((argc != 3) && !((argc == 5) && (strcmp(argv[3], "--record") == 0))) {
+        fprintf(stderr, "Usage: ast-builder --serve <socket> [--record <workload log>]");
+        return -1;
+    }
+
+    // Signals are blocked in all threads and are waited for by the main thread, which then stops the server
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+    try {
+        std::unique_ptr<WorkloadRecorder> recorder((argc == 5) ? new WorkloadRecorder(argv[4]) : nullptr);
+        ExpressionServer server(argv[2], DEFAULT_CACHE_CAPACITY, recorder.get());
+        std::thread serverThread(&ExpressionServer::run, &server);
+        fprintf(stderr, "Listening on %s\n", argv[2]);
+
+        int signal = 0;
+        sigwait(&stopSignals, &signal);
+        server.stop();
+        serverThread.join();
+    } catch (const std::system_error& ex) {
+        fprintf(stderr, "Can't start server: %s", ex.what());
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Evaluates slots of the shared-memory ring until the producer closes it: ast-builder --shm <name>
+ */
+int runShmMode(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: ast-builder --shm <name>");
+        return -1;
+    }
+
+    try {
+        ShmRingEvaluator ring(argv[2]);
+        const size_t rowsNumber = ring.run();
+        fprintf(stderr, "Evaluated %zu rows\n", rowsNumber);
+    } catch (const std::invalid_argument& ex) {
+        fprintf(stderr, "Invalid ring: %s", ex.what());
+        return -1;
+    } catch (const std::system_error& ex) {
+        fprintf(stderr, "Ring failed: %s", ex.what());
+        return -1;
+    }
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2 || argc > 3) {
+    if (argc < 2) {
         fprintf(stderr, "Invalid arguments number (argc = %d)", argc);
         return -1;
     }
-    if ((argc == 3) && (strcmp(argv[2], "--optimized") != 0)) {
-        fprintf(stderr, "Invalid option '%s'. Only '--optimized' is supported", argv[2]);
-        return -1;
+    if (strcmp(argv[1], "--batch") == 0) {
+        return runBatchMode(argc, argv);
+    }
+    if (strcmp(argv[1], "--serve") == 0) {
+        return runServerMode(argc, argv);
+    }
+    if (strcmp(argv[1], "--shm") == 0) {
+        return runShmMode(argc, argv);
     }
 
-    bool optimized = (argc == 3);
+    // Expression is given either as the first argument, as a file after '--file' option
+    // or as a binary AST file after '--load' option
+    const char* expression = nullptr;
+    const char* fileName = nullptr;
+    const char* binaryFileName = nullptr;
+    int optionsStart = 2;
+    if ((strcmp(argv[1], "--file") == 0) || (strcmp(argv[1], "--load") == 0)) {
+        if (argc < 3) {
+            fprintf(stderr, "Missing file name after '%s'", argv[1]);
+            return -1;
+        }
+        if (strcmp(argv[1], "--file") == 0) {
+            fileName = argv[2];
+        } else {
+            binaryFileName = argv[2];
+        }
+        optionsStart = 3;
+    } else {
+        expression = argv[1];
+    }
+
+    bool optimized = false;
+    bool binary = false;
+    bool rendered = true;
+    bool allocationsTracked = false;
+    bool metricsPrinted = false;
+    bool profiled = false;
+    const char* recordFileName = nullptr;
+    // Differentiation and optimization are parallel with --threads, 0 threads means number of hardware threads
+    bool parallel = false;
+    size_t threadsNumber = 0;
+    std::vector<std::pair<std::string, double> > variableValues;
+    // With --gradient the expression is differentiated by the given variables instead of x
+    std::vector<std::string> gradientVariableNames;
+    const char* traceFileName = nullptr;
+    for (int i = optionsStart; i < argc; ++i) {
+        if (strcmp(argv[i], "--optimized") == 0) {
+            optimized = true;
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            binary = true;
+        } else if (strcmp(argv[i], "--no-render") == 0) {
+            rendered = false;
+        } else if (strcmp(argv[i], "--allocations") == 0) {
+            allocationsTracked = true;
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            metricsPrinted = true;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profiled = true;
+        } else if ((strcmp(argv[i], "--values") == 0) && (i + 1 < argc)) {
+            try {
+                variableValues = parseVariableValues(argv[++i]);
+            } catch (const std::invalid_argument& ex) {
+                fprintf(stderr, "Invalid variable values: %s", ex.what());
+                return -1;
+            }
+        } else if ((strcmp(argv[i], "--gradient") == 0) && (i + 1 < argc)) {
+            try {
+                gradientVariableNames = parseVariableNames(argv[++i]);
+            } catch (const std::invalid_argument& ex) {
+                fprintf(stderr, "Invalid variable names: %s", ex.what());
+                return -1;
+            }
+        } else if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc)) {
+            traceFileName = argv[++i];
+        } else if ((strcmp(argv[i], "--record") == 0) && (i + 1 < argc)) {
+            recordFileName = argv[++i];
+        } else if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc)) {
+            parallel = true;
+            threadsNumber = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "Invalid option '%s'. Only '--optimized', '--binary', '--no-render', '--allocations', "
+                            "'--metrics', '--profile', '--values', '--gradient', '--trace', '--record' and '--threads' are supported", argv[i]);
+            return -1;
+        }
+    }
 
-    auto optimizer = std::make_shared<CompositeOptimizer>();
-    optimizer->addOptimizer(std::make_shared<UnaryAdditionOptimizer>());
-    optimizer->addOptimizer(std::make_shared<ArithmeticNegationOptimizer>());
-    optimizer->addOptimizer(std::make_shared<TrivialOperationsOptimizer>());
+    auto optimizer = std::make_shared<FullOptimizer>();
+    std::unique_ptr<ThreadPool> pool(parallel ? new ThreadPool(threadsNumber) : nullptr);
+    const RenderMode renderMode = rendered ? RENDER_AND_VIEW : NO_RENDER;
 
+    setAllocationTracking(allocationsTracked);
+    setTracing(traceFileName != nullptr);
+
+    StageRecorder stageRecorder;
     try {
-        std::shared_ptr<ASTNode> ASTRoot = buildASTRecursively(argv[1]);
-        if (optimized) ASTRoot = optimizer->optimize(ASTRoot);
-        outputAST(ASTRoot, "expression");
+        if (recordFileName != nullptr) stageRecorder.open(recordFileName);
+    } catch (const std::system_error& ex) {
+        fprintf(stderr, "Can't open workload log: %s", ex.what());
+        return -1;
+    }
+
+    // Output of the expression is written and rendered by the pipeline while the derivative is built
+    RenderPipeline pipeline;
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        auto stageStart = std::chrono::steady_clock::now();
+        std::shared_ptr<ASTNode> ASTRoot = nullptr;
+        std::string parseRequest;
+        {
+            TRACE_SCOPE("parse");
+            AllocationScope scope(PARSE_STAGE);
+            if (fileName != nullptr) {
+                MappedFile file(fileName);
+                ASTRoot = buildASTFromRange(file.begin(), file.end());
+                if (stageRecorder.isRecording() && (file.getSize() <= MAX_RECORDED_REQUEST_LENGTH)) {
+                    parseRequest = "PARSE " + std::string(file.begin(), file.end());
+                } else {
+                    stageRecorder.stop(); // Too large expression isn't recorded
+                }
+            } else if (binaryFileName != nullptr) {
+                MappedAST file(binaryFileName);
+                ASTRoot = file.getView().toAST();
+                stageRecorder.stop(); // Binary AST has no text to record
+            } else {
+                ASTRoot = buildASTRecursively(expression);
+                parseRequest = std::string("PARSE ") + expression;
+            }
+        }
+        double milliseconds = getMillisecondsSince(stageStart);
+        pipeline.addTiming("parse", milliseconds);
+        uint64_t expressionHandle = stageRecorder.record(parseRequest, milliseconds);
+        if (optimized) {
+            AllocationScope scope(OPTIMIZE_STAGE);
+            stageStart = std::chrono::steady_clock::now();
+            ASTRoot = (pool != nullptr) ? optimizeInParallel(*optimizer, ASTRoot, *pool) : optimizer->optimize(ASTRoot);
+            milliseconds = getMillisecondsSince(stageStart);
+            pipeline.addTiming("optimize", milliseconds);
+            expressionHandle = stageRecorder.record("OPTIMIZE " + std::to_string(expressionHandle), milliseconds);
+        }
+        pipeline.output(ASTRoot, "expression", renderMode, binary);
+        ASTMetrics expressionMetrics;
+        if (metricsPrinted) {
+            expressionMetrics = computeASTMetrics(ASTRoot);
+        }
+
+        ASTMetrics derivativeMetrics;
+        if (!gradientVariableNames.empty()) {
+            // Partial derivatives share nodes, so all of them are optimized before any of them is written
+            stageRecorder.stop(); // Gradient isn't a request of the server protocol
+            stageStart = std::chrono::steady_clock::now();
+            std::vector<std::shared_ptr<ASTNode> > partialDerivatives;
+            {
+                AllocationScope scope(DIFFERENTIATE_STAGE);
+                partialDerivatives = gradient(ASTRoot, gradientVariableNames);
+            }
+            pipeline.addTiming("gradient", getMillisecondsSince(stageStart));
+            if (optimized) {
+                AllocationScope scope(OPTIMIZE_STAGE);
+                stageStart = std::chrono::steady_clock::now();
+                for (auto& partialDerivative : partialDerivatives) {
+                    partialDerivative = (pool != nullptr) ? optimizeInParallel(*optimizer, partialDerivative, *pool)
+                                                          : optimizer->optimize(partialDerivative);
+                }
+                pipeline.addTiming("optimize gradient", getMillisecondsSince(stageStart));
+            }
+            for (size_t i = 0; i < partialDerivatives.size(); ++i) {
+                pipeline.output(partialDerivatives[i], "expression-derivative-" + gradientVariableNames[i], renderMode, binary);
+            }
+        } else {
+            // Derivative doesn't share nodes with the expression, so it can be optimized while the expression is written
+            stageStart = std::chrono::steady_clock::now();
+            std::shared_ptr<ASTNode> derivative = nullptr;
+            {
+                AllocationScope scope(DIFFERENTIATE_STAGE);
+                derivative = (pool != nullptr) ? differentiateInParallel(ASTRoot, "x", *pool) : differentiate(ASTRoot, "x");
+            }
+            milliseconds = getMillisecondsSince(stageStart);
+            pipeline.addTiming("differentiate", milliseconds);
+            const uint64_t derivativeHandle = stageRecorder.record("DIFF " + std::to_string(expressionHandle) + " x", milliseconds);
+            if (optimized) {
+                AllocationScope scope(OPTIMIZE_STAGE);
+                stageStart = std::chrono::steady_clock::now();
+                derivative = (pool != nullptr) ? optimizeInParallel(*optimizer, derivative, *pool) : optimizer->optimize(derivative);
+                milliseconds = getMillisecondsSince(stageStart);
+                pipeline.addTiming("optimize derivative", milliseconds);
+                stageRecorder.record("OPTIMIZE " + std::to_string(derivativeHandle), milliseconds);
+            }
+            pipeline.output(derivative, "expression-derivative", renderMode, binary);
+            if (metricsPrinted) {
+                derivativeMetrics = computeASTMetrics(derivative);
+            }
+        }
 
-        ASTRoot = differentiate(ASTRoot, "x");
-        if (optimized) ASTRoot = optimizer->optimize(ASTRoot);
-        outputAST(ASTRoot, "expression-derivative");
+        pipeline.waitAll();
+        for (const StageTiming& timing : pipeline.getTimings()) {
+            fprintf(stderr, "%-40s %10.3f ms\n", timing.stage.c_str(), timing.milliseconds);
+        }
+        fprintf(stderr, "%-40s %10.3f ms\n", "total", getMillisecondsSince(start));
+        if (metricsPrinted) {
+            printASTMetrics(stderr, "expression", expressionMetrics);
+            if (gradientVariableNames.empty()) {
+                printASTMetrics(stderr, "derivative", derivativeMetrics);
+            } else {
+                // Compared after the outputs are written, so the pipeline doesn't disturb the measurements
+                printGradientStatistics(stderr, compareGradient(ASTRoot, gradientVariableNames));
+            }
+        }
+        if (allocationsTracked) {
+            printAllocationStatistics(stderr);
+        }
+        if (profiled) {
+            // Profiled after the outputs are written, so the pipeline doesn't disturb the measurements
+            const EvaluationProfile profile(ASTRoot, variableValues);
+            profile.saveDot("expression-profile.dot");
+            profile.printReport(stderr);
+        }
+        if (!saveTrace(traceFileName)) {
+            return -1;
+        }
     } catch (const std::invalid_argument& ex) {
         fprintf(stderr, "Invalid expression: %s", ex.what());
     } catch (const std::logic_error& ex) {
         fprintf(stderr, "Invalid expression: %s", ex.what());
     } catch (const SyntaxError& ex) {
         fprintf(stderr, "Syntax error: %s", ex.what());
+    } catch (const std::system_error& ex) {
+        fprintf(stderr, "Can't read or write expression file: %s", ex.what());
     }
 }
@@ -0,0 +1,47 @@
+/**
+ * @file
+ * @brief Implementation of read-only memory-mapped file
+ */
+#include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include "mapped_file.h"
+
+MappedFile::MappedFile(const char* fileName) {
+    assert(fileName != nullptr);
+
+    const int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+
+    struct stat fileStat = {};
+    if (fstat(fd, &fileStat) != 0) {
+        const int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), fileName);
+    }
+
+    size = (size_t)fileStat.st_size;
+    if (size > 0) { // Empty file can't be mapped
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), fileName);
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL); // Parser reads the file once from the start to the end
+        data = (const char*)mapping;
+    }
+    close(fd); // Mapping stays valid after the descriptor is closed
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        munmap((void*)data, size);
+    }
+}
@@ -0,0 +1,46 @@
+/**
+ * @file
+ * @brief Definition of read-only memory-mapped file
+ */
+#ifndef AST_BUILDER_MAPPED_FILE_H
+#define AST_BUILDER_MAPPED_FILE_H
+
+#include <cstddef>
+
+/**
+ * Read-only memory mapping of the whole file. Contents are loaded by the OS on demand,
+ * so the file isn't copied into the process memory.
+ */
+class MappedFile {
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+
+public:
+    /**
+     * Maps the file into memory.
+     * @param fileName name of the file to map
+     * @throws std::system_error if file can't be opened or mapped.
+     */
+    explicit MappedFile(const char* fileName);
+
+    MappedFile(const MappedFile& mappedFile) = delete;
+    MappedFile& operator=(const MappedFile& mappedFile) = delete;
+
+    ~MappedFile();
+
+    const char* begin() const {
+        return data;
+    }
+
+    const char* end() const {
+        return data + size;
+    }
+
+    size_t getSize() const {
+        return size;
+    }
+};
+
+#endif // AST_BUILDER_MAPPED_FILE_H
@@ -0,0 +1,79 @@
+/**
+ * @file
+ * @brief Implementation of growable output buffer
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "output_buffer.h"
+
+/** Integers below it are exact in double **/
+static constexpr double MAX_EXACT_INTEGER = 9007199254740992.; // 2^53
+
+void OutputBuffer::appendDecimal(double value, uint64_t digits, size_t fractionLength) {
+    char text[32];
+    size_t length = 0;
+    do {
+        text[length++] = (char)('0' + digits % 10);
+        digits /= 10;
+        if (length == fractionLength) text[length++] = '.';
+    } while ((digits > 0) || (length <= fractionLength));
+    if (text[length - 1] == '.') text[length++] = '0';
+    if (std::signbit(value)) text[length++] = '-';
+    while (length > 0) {
+        data += text[--length];
+    }
+}
+
+void OutputBuffer::appendUnsigned(uint64_t value) {
+    char digits[20];
+    size_t length = 0;
+    do {
+        digits[length++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (length > 0) {
+        data += digits[--length];
+    }
+}
+
+void OutputBuffer::appendNumber(double value) {
+    if (std::isnan(value)) {
+        data += "nan";
+        return;
+    }
+    if (std::isinf(value)) {
+        data += (value > 0) ? "1e999" : "-1e999";
+        return;
+    }
+
+    // Most of constants are integers or short decimals, they are written without printf. Digits are used only if
+    // dividing them by the power of 10 gives exactly the value, because that's how strtod reads the text back.
+    static const double powersOf10[] = { 1., 10., 100., 1000., 10000., 100000., 1000000. };
+    const double absoluteValue = std::fabs(value);
+    for (size_t fractionLength = 0; fractionLength < sizeof(powersOf10) / sizeof(powersOf10[0]); ++fractionLength) {
+        const double scaledValue = absoluteValue * powersOf10[fractionLength];
+        if (!(scaledValue < MAX_EXACT_INTEGER)) break;
+        const double digits = std::trunc(scaledValue);
+        const double readValue = digits / powersOf10[fractionLength];
+        if (memcmp(&readValue, &absoluteValue, sizeof(double)) == 0) {
+            appendDecimal(value, (uint64_t)digits, fractionLength);
+            return;
+        }
+    }
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.15g", value);
+    const double readValue = strtod(buffer, nullptr);
+    if (memcmp(&readValue, &value, sizeof(double)) != 0) {
+        snprintf(buffer, sizeof(buffer), "%.17g", value);
+    }
+    data += buffer;
+}
+
+bool OutputBuffer::writeTo(FILE* file) {
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    data.clear();
+    return written;
+}
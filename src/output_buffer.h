@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @brief Definition of growable output buffer
+ */
+#ifndef AST_BUILDER_OUTPUT_BUFFER_H
+#define AST_BUILDER_OUTPUT_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/**
+ * Text that is built in memory and is written at once. Writers append to it instead of calling fprintf
+ * for every node.
+ */
+class OutputBuffer {
+
+private:
+    std::string data;
+
+    void appendDecimal(double value, uint64_t digits, size_t fractionLength);
+
+public:
+    void append(char symbol) {
+        data += symbol;
+    }
+
+    void append(const char* text) {
+        data.append(text);
+    }
+
+    void append(const char* text, size_t length) {
+        data.append(text, length);
+    }
+
+    void appendUnsigned(uint64_t value);
+
+    /**
+     * Appends the shortest representation of the value that is read back exactly (e.g. "0.1", "1e+20").
+     * Infinities are written as "1e999" and "-1e999", NaN as "nan".
+     */
+    void appendNumber(double value);
+
+    void reserve(size_t capacity) {
+        data.reserve(capacity);
+    }
+
+    size_t getSize() const {
+        return data.size();
+    }
+
+    const std::string& getString() const {
+        return data;
+    }
+
+    std::string release() {
+        std::string result;
+        result.swap(data);
+        return result;
+    }
+
+    /**
+     * Writes the contents to the file and clears the buffer.
+     * @return false if it can't be written.
+     */
+    bool writeTo(FILE* file);
+};
+
+#endif // AST_BUILDER_OUTPUT_BUFFER_H
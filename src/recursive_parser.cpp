@@ -2,7 +2,8 @@
  * @file
  * @brief Implementation of recursive parser
  *
- * It parses mathematical expressions using next grammar:
+ * buildASTRecursively delegates to the iterative parser core (see iterative_parser.cpp).
+ * Original recursive descent is available as buildASTByRecursiveDescent. It parses mathematical expressions using next grammar:
  *
  *     G = E '\0'
  *     E = T ([+|-] T)*
@@ -17,8 +18,10 @@
 #include <cstdlib>
 #include <cctype>
 #include <vector>
+#include "iterative_parser.h"
 #include "recursive_parser.h"
 #include "SyntaxError.h"
+#include "tracing.h"
 
 SymbolTable::SymbolTable() {
     addFunction("sin", std::make_shared<SinFunction>());
@@ -33,7 +36,9 @@ void SymbolTable::addFunction(const char* name, const std::shared_ptr<FunctionTo
 }
 
 void SymbolTable::addVariable(char* name) noexcept {
-    symbols[name] = VariableToken::getVariableByName(name);
+    // Key should live as long as the table, so variable's own name is used instead of the given one
+    std::shared_ptr<VariableToken> variable = VariableToken::getVariableByName(name);
+    symbols[variable->getName()] = variable;
 }
 
 std::shared_ptr<Token> SymbolTable::getSymbolByName(char* name) noexcept {
@@ -43,24 +48,29 @@ std::shared_ptr<Token> SymbolTable::getSymbolByName(char* name) noexcept {
     return symbols.at(name);
 }
 
-SymbolTable symbolTable;
+static SymbolTable symbolTable;
 
-std::shared_ptr<ASTNode> getExpression(const char* expression, int& pos);
+static std::shared_ptr<ASTNode> getExpression(const char* expression, size_t& pos);
 
-std::shared_ptr<ASTNode> getTerm(const char* expression, int& pos);
+static std::shared_ptr<ASTNode> getTerm(const char* expression, size_t& pos);
 
-std::shared_ptr<ASTNode> getFactor(const char* expression, int& pos);
+static std::shared_ptr<ASTNode> getFactor(const char* expression, size_t& pos);
 
-std::shared_ptr<ASTNode> getParenthesised(const char* expression, int& pos);
+static std::shared_ptr<ASTNode> getParenthesised(const char* expression, size_t& pos);
 
-std::shared_ptr<ASTNode> getNumber(const char* expression, int& pos);
+static std::shared_ptr<ASTNode> getNumber(const char* expression, size_t& pos);
 
-std::shared_ptr<Token> getId(const char* expression, int& pos);
+static std::shared_ptr<Token> getId(const char* expression, size_t& pos);
 
-void skipSpaces(const char* expression, int& pos);
+static void skipSpaces(const char* expression, size_t& pos);
 
 std::shared_ptr<ASTNode> buildASTRecursively(const char* expression) {
-    int pos = 0;
+    TRACE_SCOPE("buildASTRecursively");
+    return buildASTIteratively(expression);
+}
+
+std::shared_ptr<ASTNode> buildASTByRecursiveDescent(const char* expression) {
+    size_t pos = 0;
     skipSpaces(expression, pos);
     std::shared_ptr<ASTNode> root = getExpression(expression, pos);
     if (expression[pos] != '\0') {
@@ -70,7 +80,7 @@ std::shared_ptr<ASTNode> buildASTRecursively(const char* expression) {
     return root;
 }
 
-std::shared_ptr<ASTNode> getExpression(const char* expression, int& pos) {
+static std::shared_ptr<ASTNode> getExpression(const char* expression, size_t& pos) {
     std::shared_ptr<ASTNode> result = getTerm(expression, pos);
     skipSpaces(expression, pos);
     std::shared_ptr<ASTNode> term = nullptr;
@@ -92,7 +102,7 @@ std::shared_ptr<ASTNode> getExpression(const char* expression, int& pos) {
     return result;
 }
 
-std::shared_ptr<ASTNode> getTerm(const char* expression, int& pos) {
+static std::shared_ptr<ASTNode> getTerm(const char* expression, size_t& pos) {
     std::shared_ptr<ASTNode> result = getFactor(expression, pos);
     skipSpaces(expression, pos);
     std::shared_ptr<ASTNode> factor = nullptr;
@@ -114,7 +124,7 @@ std::shared_ptr<ASTNode> getTerm(const char* expression, int& pos) {
     return result;
 }
 
-std::shared_ptr<ASTNode> getFactor(const char* expression, int& pos) {
+static std::shared_ptr<ASTNode> getFactor(const char* expression, size_t& pos) {
     std::shared_ptr<ASTNode> result = getParenthesised(expression, pos);
     skipSpaces(expression, pos);
     std::shared_ptr<ASTNode> operand = nullptr;
@@ -139,7 +149,7 @@ std::shared_ptr<ASTNode> getFactor(const char* expression, int& pos) {
     return result;
 }
 
-std::shared_ptr<ASTNode> getParenthesised(const char* expression, int& pos) {
+static std::shared_ptr<ASTNode> getParenthesised(const char* expression, size_t& pos) {
     std::shared_ptr<Token> idToken = nullptr;
     if (expression[pos] != '(') {
         if (isdigit(expression[pos])) {
@@ -176,9 +186,9 @@ std::shared_ptr<ASTNode> getParenthesised(const char* expression, int& pos) {
     return result;
 }
 
-std::shared_ptr<ASTNode> getNumber(const char* expression, int &pos) {
+static std::shared_ptr<ASTNode> getNumber(const char* expression, size_t& pos) {
     int result = 0;
-    const int startPos = pos;
+    const size_t startPos = pos;
     while (isdigit(expression[pos])) {
         result = result * 10 + (expression[pos++] - '0');
     }
@@ -188,8 +198,8 @@ std::shared_ptr<ASTNode> getNumber(const char* expression, int &pos) {
     return std::make_shared<ASTNode>(std::make_shared<ConstantValueToken>(result));
 }
 
-std::shared_ptr<Token> getId(const char* expression, int& pos) {
-    int startPos = pos;
+static std::shared_ptr<Token> getId(const char* expression, size_t& pos) {
+    size_t startPos = pos;
     while (isalpha(expression[pos])) {
         ++pos;
     }
@@ -198,7 +208,7 @@ std::shared_ptr<Token> getId(const char* expression, int& pos) {
     }
 
     char* name = (char*)calloc(pos - startPos + 1, sizeof(char));
-    for (int i = startPos; i < pos; ++i) {
+    for (size_t i = startPos; i < pos; ++i) {
         name[i - startPos] = expression[i];
     }
     std::shared_ptr<Token> id = symbolTable.getSymbolByName(name);
@@ -207,6 +217,6 @@ std::shared_ptr<Token> getId(const char* expression, int& pos) {
     return id;
 }
 
-void skipSpaces(const char* expression, int& pos) {
+static void skipSpaces(const char* expression, size_t& pos) {
     while (std::isspace(expression[pos])) ++pos;
 }
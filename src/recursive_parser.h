@@ -32,6 +32,22 @@ public:
     std::shared_ptr<Token> getSymbolByName(char* name) noexcept;
 };
 
+/**
+ * Builds AST from the expression. Uses the same parser core as buildAST and buildASTIteratively,
+ * so it supports real constants, unary operators and functions and doesn't overflow the stack on deep nesting.
+ * @param expression expression to parse
+ * @return root of the built AST.
+ * @throws SyntaxError if expression is invalid.
+ */
 std::shared_ptr<ASTNode> buildASTRecursively(const char* expression);
 
+/**
+ * Builds AST with the original recursive descent parser (integer constants, no unary operators).
+ * It's kept only as a baseline for the parser benchmark. Use buildASTRecursively instead.
+ * @param expression expression to parse
+ * @return root of the built AST.
+ * @throws SyntaxError if expression is invalid.
+ */
+std::shared_ptr<ASTNode> buildASTByRecursiveDescent(const char* expression);
+
 #endif // RECURSIVE_PARSER_CALCULATOR_H
@@ -0,0 +1,224 @@
+/**
+ * @file
+ * @brief Implementation of asynchronous rendering pipeline
+ */
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include "allocation_tracker.h"
+#include "binary_ast.h"
+#include "render_pipeline.h"
+#include "tracing.h"
+
+/** How often the pipeline thread checks whether the child processes exited **/
+static constexpr std::chrono::milliseconds PROCESS_POLL_INTERVAL(5);
+
+static inline double getMillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Starts "sh -c <command>" with stdin, stdout and stderr redirected to /dev/null, so renderers can't block
+ * on the terminal.
+ * @return pid of the shell.
+ * @throws std::system_error if the process can't be started.
+ */
+static pid_t spawnShell(const std::string& command) {
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+    posix_spawn_file_actions_addopen(&fileActions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&fileActions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&fileActions, STDOUT_FILENO, STDERR_FILENO);
+
+    const char* arguments[] = { "sh", "-c", command.c_str(), nullptr };
+    pid_t pid = 0;
+    const int result = posix_spawn(&pid, "/bin/sh", &fileActions, nullptr, (char* const*)arguments, environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    if (result != 0) {
+        throw std::system_error(result, std::generic_category(), "Can't launch '" + command + "'");
+    }
+    return pid;
+}
+
+RenderPipeline::RenderPipeline(size_t maxProcessesNumber_)
+        : maxProcessesNumber(maxProcessesNumber_ != 0 ? maxProcessesNumber_
+                                                      : std::max(std::thread::hardware_concurrency(), 1u)) {
+    thread = std::thread(&RenderPipeline::run, this);
+}
+
+RenderPipeline::~RenderPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    thread.join();
+}
+
+void RenderPipeline::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        reapProcesses();
+        if (!jobs.empty() && (jobs.front().command.empty() || (processes.size() < maxProcessesNumber))) {
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            runJob(job, lock);
+            changed.notify_all();
+        } else if (!processes.empty()) {
+            changed.wait_for(lock, PROCESS_POLL_INTERVAL);
+        } else if (jobs.empty()) {
+            if (stopping) {
+                return;
+            }
+            changed.wait(lock);
+        }
+    }
+}
+
+/**
+ * Runs the job without the lock. Errors are kept for waitAll, so following jobs are still run.
+ */
+void RenderPipeline::runJob(Job& job, std::unique_lock<std::mutex>& lock) {
+    busy = true;
+    lock.unlock();
+    const auto start = std::chrono::steady_clock::now();
+    pid_t pid = 0;
+    std::exception_ptr jobError;
+    try {
+        if (job.write) {
+            job.write();
+        } else {
+            pid = spawnShell(job.command);
+        }
+    } catch (...) {
+        jobError = std::current_exception();
+    }
+    lock.lock();
+    busy = false;
+
+    if (jobError != nullptr) {
+        if (error == nullptr) error = jobError;
+    } else if (pid != 0) {
+        processes.push_back(Process{ pid, std::move(job.stage), start });
+    } else {
+        timings.push_back(StageTiming{ std::move(job.stage), getMillisecondsSince(start) });
+    }
+}
+
+/**
+ * Collects the exited child processes without waiting. Is called under the lock.
+ */
+void RenderPipeline::reapProcesses() {
+    bool reaped = false;
+    for (size_t i = 0; i < processes.size();) {
+        if (waitpid(processes[i].pid, nullptr, WNOHANG) == 0) {
+            ++i;
+            continue;
+        }
+        timings.push_back(StageTiming{ std::move(processes[i].stage), getMillisecondsSince(processes[i].start) });
+        processes.erase(processes.begin() + i);
+        reaped = true;
+    }
+    if (reaped) {
+        changed.notify_all();
+    }
+}
+
+void RenderPipeline::output(const std::shared_ptr<ASTNode>& root, const std::string& fileName, RenderMode renderMode,
+                            bool binary) {
+    Job writeJob;
+    writeJob.stage = "write " + fileName;
+    writeJob.write = [root, fileName, renderMode, binary]() {
+        TRACE_SCOPE("write");
+        AllocationScope scope(RENDER_STAGE);
+        // Pictures are rendered in-process, only the viewer is a separate process
+        root->visualize(fileName, renderMode == NO_RENDER ? NO_RENDER : RENDER);
+        root->texify(fileName, NO_RENDER);
+        if (binary) {
+            saveAST(root, (fileName + ".astb").c_str());
+        }
+    };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(writeJob));
+    }
+    changed.notify_all();
+
+    if (renderMode != NO_RENDER) {
+        launch("compile " + fileName + ".tex", getTexCommand(fileName, renderMode == RENDER_AND_VIEW));
+    }
+    if (renderMode == RENDER_AND_VIEW) {
+        launch("view " + fileName + ".svg", getViewCommand(fileName + ".svg"));
+    }
+}
+
+void RenderPipeline::launch(const std::string& stage, const std::string& command) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(Job{ stage, nullptr, command });
+    }
+    changed.notify_all();
+}
+
+void RenderPipeline::addTiming(const std::string& stage, double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    timings.push_back(StageTiming{ stage, milliseconds });
+}
+
+void RenderPipeline::waitAll() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return jobs.empty() && !busy && processes.empty(); });
+    if (error != nullptr) {
+        std::exception_ptr jobError = error;
+        error = nullptr;
+        std::rethrow_exception(jobError);
+    }
+}
+
+std::vector<StageTiming> RenderPipeline::getTimings() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return timings;
+}
+
+std::string quoteForShell(const std::string& argument) {
+    std::string quotedArgument = "'";
+    for (char symbol : argument) {
+        if (symbol == '\'') {
+            quotedArgument += "'\\''";
+        } else {
+            quotedArgument += symbol;
+        }
+    }
+    quotedArgument += '\'';
+    return quotedArgument;
+}
+
+std::string getTexCommand(const std::string& fileName, bool viewed) {
+    const size_t nameStart = fileName.rfind('/');
+    const std::string directory = nameStart == std::string::npos ? "." : fileName.substr(0, nameStart + 1);
+    std::string command = "pdflatex -interaction=batchmode -output-directory=" + quoteForShell(directory) + " " +
+                          quoteForShell(fileName + ".tex") + " && rm -f " + quoteForShell(fileName + ".log") + " " +
+                          quoteForShell(fileName + ".aux");
+    if (viewed) {
+        command += " && " + getViewCommand(fileName + ".pdf");
+    }
+    return command;
+}
+
+std::string getViewCommand(const std::string& fileName) {
+    return "xdg-open " + quoteForShell(fileName);
+}
+
+void launchInBackground(const std::string& command) {
+    const std::string backgroundCommand = "(" + command + ") >/dev/null 2>&1 &";
+    const char* arguments[] = { "sh", "-c", backgroundCommand.c_str(), nullptr };
+    pid_t pid = 0;
+    if (posix_spawn(&pid, "/bin/sh", nullptr, nullptr, (char* const*)arguments, environ) == 0) {
+        waitpid(pid, nullptr, 0);
+    }
+}
@@ -0,0 +1,140 @@
+/**
+ * @file
+ * @brief Definition of asynchronous rendering pipeline
+ *
+ * Pipeline takes the output of ASTs off the calling thread: files (DOT, SVG, TeX, binary AST) are written by the
+ * pipeline thread in order of submission, renderers and viewers (pdflatex, xdg-open) are launched after them as
+ * child processes. Number of concurrently running child processes is bounded, the rest wait in the queue.
+ * Meanwhile the calling thread goes on with parsing, optimizing and differentiating.
+ *
+ * Submitted ASTs must not be changed until the pipeline is waited for.
+ */
+#ifndef AST_BUILDER_RENDER_PIPELINE_H
+#define AST_BUILDER_RENDER_PIPELINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+#include "ast.h"
+
+struct StageTiming {
+    std::string stage;
+    double milliseconds;
+};
+
+class RenderPipeline {
+
+private:
+    /** Job either writes files or launches a shell command in a child process **/
+    struct Job {
+        std::string stage;
+        std::function<void()> write;
+        std::string command;
+    };
+
+    struct Process {
+        pid_t pid;
+        std::string stage;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    const size_t maxProcessesNumber;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Job> jobs;
+    std::vector<Process> processes;
+    std::vector<StageTiming> timings;
+    /** First error of writing or launching, it's rethrown by waitAll **/
+    std::exception_ptr error;
+    bool busy = false;
+    bool stopping = false;
+    std::thread thread;
+
+    void run();
+    void runJob(Job& job, std::unique_lock<std::mutex>& lock);
+    void reapProcesses();
+
+public:
+    /**
+     * Starts the pipeline thread.
+     * @param maxProcessesNumber_ maximum number of running child processes. If it's 0, number of hardware threads is used.
+     */
+    explicit RenderPipeline(size_t maxProcessesNumber_ = 0);
+
+    RenderPipeline(const RenderPipeline& pipeline) = delete;
+    RenderPipeline& operator=(const RenderPipeline& pipeline) = delete;
+
+    /**
+     * Finishes all the jobs and waits for the child processes. Errors are ignored.
+     */
+    ~RenderPipeline();
+
+    /**
+     * Queues the output of the AST: <fileName>.dot and <fileName>.tex, <fileName>.svg unless renderMode is NO_RENDER
+     * and <fileName>.astb if binary is set. Then the TeX document is compiled, and pictures are opened if renderMode
+     * is RENDER_AND_VIEW.
+     * @param root          root of the AST, it must not be changed until the pipeline is waited for
+     * @param fileName      name of the files without extension
+     * @param renderMode    whether the output is rendered and opened in the viewer
+     * @param binary        whether the AST is saved in binary format
+     */
+    void output(const std::shared_ptr<ASTNode>& root, const std::string& fileName, RenderMode renderMode, bool binary);
+
+    /**
+     * Queues the shell command, it's launched when a slot for the child process is free.
+     * @param stage     name of the stage in the timings
+     * @param command   shell command
+     */
+    void launch(const std::string& stage, const std::string& command);
+
+    /**
+     * Adds the timing of the stage that is done outside of the pipeline (e.g. parsing).
+     */
+    void addTiming(const std::string& stage, double milliseconds);
+
+    /**
+     * Waits until all the jobs are done and all the child processes exit.
+     * Rethrows the first error of the jobs (e.g. std::system_error if some file can't be written or some process
+     * can't be launched), following jobs are run anyway.
+     */
+    void waitAll();
+
+    /**
+     * @return timings of the stages in order of their end. Stages of the pipeline are jobs (writing of files)
+     * and child processes (from launch to exit), they overlap with each other and with the caller's stages.
+     */
+    std::vector<StageTiming> getTimings();
+};
+
+/**
+ * Quotes the argument for /bin/sh.
+ */
+std::string quoteForShell(const std::string& argument);
+
+/**
+ * @return shell command that compiles <fileName>.tex into <fileName>.pdf and optionally opens it.
+ */
+std::string getTexCommand(const std::string& fileName, bool viewed);
+
+/**
+ * @return shell command that opens the file in the viewer.
+ */
+std::string getViewCommand(const std::string& fileName);
+
+/**
+ * Runs the shell command in background without waiting for it. Shell starts the command as a background job and
+ * exits at once, so the caller waits only for the shell and no zombie processes are left.
+ */
+void launchInBackground(const std::string& command);
+
+#endif // AST_BUILDER_RENDER_PIPELINE_H
@@ -0,0 +1,390 @@
+/**
+ * @file
+ * @brief Implementation of shared-memory ring buffer for bulk evaluation
+ */
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <limits>
+#include <linux/futex.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+#include "iterative_parser.h"
+#include "shm_ring.h"
+
+static const uint32_t RING_MAGIC = 0x52545341; // "ASTR"
+static const uint32_t RING_VERSION = 2;
+static const size_t SLOT_HEADER_SIZE = 64;
+/** Number of rows in the slot that marks the end of the stream **/
+static const uint64_t END_OF_STREAM = UINT64_MAX;
+static const int SPIN_ITERATIONS = 4096;
+/** Period of checking that the other side is alive while sleeping **/
+static const long SLEEP_NANOSECONDS = 100 * 1000 * 1000;
+
+struct ShmRing::Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slotsNumber;
+    uint64_t rowsPerSlot;
+    uint64_t variablesNumber;
+    char expression[MAX_EXPRESSION_LENGTH];
+    char variables[MAX_VARIABLES_NUMBER][MAX_VARIABLE_NAME_LENGTH];
+    std::atomic<int32_t> producerPid;
+    std::atomic<int32_t> evaluatorPid;
+    Counter submitted;
+    Counter evaluated;
+};
+
+static inline size_t alignToCacheLine(size_t size) {
+    return (size + 63) & ~(size_t)63;
+}
+
+ShmRing::~ShmRing() {
+    if (header != nullptr) {
+        munmap(header, mappingSize);
+    }
+}
+
+void ShmRing::map(int fd, size_t size) {
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), name);
+    }
+    header = (Header*)mapping;
+    mappingSize = size;
+}
+
+void ShmRing::notify(Counter& counter) {
+    if (counter.sleepersNumber.load() > 0) {
+        syscall(SYS_futex, &counter.value, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+/**
+ * @return false if the process doesn't exist. Process of another user exists, though it can't be signalled.
+ */
+static bool isProcessAlive(int32_t pid) {
+    return (kill((pid_t)pid, 0) == 0) || (errno != ESRCH);
+}
+
+/**
+ * Waits until the counter is changed. Spins first because the other side is usually fast.
+ * @return new value of the counter.
+ */
+uint32_t ShmRing::waitWhileEquals(Counter& counter, uint32_t value, const std::atomic<int32_t>& peerPid) {
+    for (int i = 0; i < SPIN_ITERATIONS; ++i) {
+        const uint32_t currentValue = counter.value.load(std::memory_order_acquire);
+        if (currentValue != value) return currentValue;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    while (true) {
+        counter.sleepersNumber.fetch_add(1);
+        if (counter.value.load() == value) {
+            // Returns immediately if the value is already changed, so the wake can't be missed
+            const timespec timeout = {0, SLEEP_NANOSECONDS};
+            syscall(SYS_futex, &counter.value, FUTEX_WAIT, value, &timeout, nullptr, 0);
+        }
+        counter.sleepersNumber.fetch_sub(1);
+
+        const uint32_t currentValue = counter.value.load(std::memory_order_acquire);
+        if (currentValue != value) return currentValue;
+
+        const int32_t pid = peerPid.load();
+        if (pid == 0) {
+            if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds((int)ATTACH_TIMEOUT_MILLISECONDS)) {
+                throw std::system_error(ETIMEDOUT, std::generic_category(), "Nobody has opened the ring");
+            }
+        } else if (!isProcessAlive(pid)) {
+            throw std::system_error(EPIPE, std::generic_category(), "Other side of the ring has exited");
+        }
+    }
+}
+
+size_t ShmRing::getSlotSize(size_t variablesNumber, size_t rowsPerSlot) {
+    return SLOT_HEADER_SIZE + alignToCacheLine((variablesNumber + 1) * rowsPerSlot * sizeof(double));
+}
+
+bool ShmRing::tryGetRingSize(size_t slotsNumber, size_t variablesNumber, size_t rowsPerSlot, size_t& size) {
+    size_t columnsSize = 0;
+    if (__builtin_mul_overflow(variablesNumber + 1, rowsPerSlot, &columnsSize) ||
+        __builtin_mul_overflow(columnsSize, sizeof(double), &columnsSize) ||
+        (columnsSize > SIZE_MAX - SLOT_HEADER_SIZE - 63)) {
+        return false;
+    }
+    return !__builtin_mul_overflow(slotsNumber, getSlotSize(variablesNumber, rowsPerSlot), &size) &&
+           !__builtin_add_overflow(size, alignToCacheLine(sizeof(Header)), &size);
+}
+
+char* ShmRing::getSlot(uint32_t sequenceNumber) const {
+    const size_t slotIndex = sequenceNumber % slotsNumber;
+    return (char*)header + alignToCacheLine(sizeof(Header)) + slotIndex * getSlotSize(variablesNumber, rowsPerSlot);
+}
+
+size_t ShmRing::getSlotsNumber() const {
+    return slotsNumber;
+}
+
+size_t ShmRing::getRowsPerSlot() const {
+    return rowsPerSlot;
+}
+
+size_t ShmRing::getVariablesNumber() const {
+    return variablesNumber;
+}
+
+double* ShmRing::getColumn(uint32_t sequenceNumber, size_t variableIndex) const {
+    assert(variableIndex < variablesNumber);
+    return (double*)(getSlot(sequenceNumber) + SLOT_HEADER_SIZE) + variableIndex * rowsPerSlot;
+}
+
+double* ShmRing::getResults(uint32_t sequenceNumber) const {
+    return (double*)(getSlot(sequenceNumber) + SLOT_HEADER_SIZE) + variablesNumber * rowsPerSlot;
+}
+
+ShmRingProducer::ShmRingProducer(const char* name_, const char* expression, const std::vector<std::string>& variables,
+                                 size_t slotsNumber_, size_t rowsPerSlot_) {
+    assert(name_ != nullptr);
+    assert(expression != nullptr);
+    assert((slotsNumber_ > 0) && (rowsPerSlot_ > 0));
+
+    if (strlen(expression) >= MAX_EXPRESSION_LENGTH) {
+        throw std::invalid_argument("Expression is too long for the ring");
+    }
+    if (variables.size() > MAX_VARIABLES_NUMBER) {
+        throw std::invalid_argument("Too many variables for the ring");
+    }
+    for (const std::string& variable : variables) {
+        if (variable.size() >= MAX_VARIABLE_NAME_LENGTH) {
+            throw std::invalid_argument("Variable name is too long for the ring");
+        }
+    }
+
+    size_t size = 0;
+    if (!tryGetRingSize(slotsNumber_, variables.size(), rowsPerSlot_, size) || (size > (size_t)std::numeric_limits<off_t>::max())) {
+        throw std::invalid_argument("Ring is too large");
+    }
+    slotsNumber = slotsNumber_;
+    rowsPerSlot = rowsPerSlot_;
+    variablesNumber = variables.size();
+
+    name = name_;
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), name);
+    }
+    try {
+        if (ftruncate(fd, (off_t)size) != 0) {
+            throw std::system_error(errno, std::generic_category(), name);
+        }
+        map(fd, size);
+    } catch (const std::system_error&) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        throw;
+    }
+    ::close(fd); // Mapping stays valid after the descriptor is closed
+
+    header = new (header) Header();
+    header->version = RING_VERSION;
+    header->slotsNumber = slotsNumber;
+    header->rowsPerSlot = rowsPerSlot;
+    header->variablesNumber = variables.size();
+    strcpy(header->expression, expression);
+    for (size_t i = 0; i < variables.size(); ++i) {
+        strcpy(header->variables[i], variables[i].c_str());
+    }
+    header->producerPid = (int32_t)getpid();
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = RING_MAGIC;
+}
+
+ShmRingProducer::~ShmRingProducer() {
+    try {
+        close();
+    } catch (const std::system_error&) {
+        // Evaluator is gone, nobody waits for the end of the stream
+    }
+    shm_unlink(name.c_str());
+}
+
+uint32_t ShmRingProducer::acquireSlot() {
+    if (submittedNumber - releasedNumber >= slotsNumber) {
+        throw std::logic_error("All slots of the ring are in use");
+    }
+    return submittedNumber;
+}
+
+void ShmRingProducer::submitSlot(uint32_t sequenceNumber, size_t rowsNumber) {
+    assert(sequenceNumber == submittedNumber);
+    assert((rowsNumber <= rowsPerSlot) || (rowsNumber == END_OF_STREAM));
+
+    *(uint64_t*)getSlot(sequenceNumber) = rowsNumber;
+    header->submitted.value.store(++submittedNumber);
+    notify(header->submitted);
+}
+
+const double* ShmRingProducer::waitResults(uint32_t sequenceNumber) {
+    assert(sequenceNumber == releasedNumber);
+    assert(sequenceNumber != submittedNumber);
+
+    // Evaluated number is between the released and submitted numbers, so it's equal to the earliest
+    // submitted slot's number only while this slot isn't evaluated
+    uint32_t evaluatedNumber = header->evaluated.value.load(std::memory_order_acquire);
+    while (evaluatedNumber == sequenceNumber) {
+        evaluatedNumber = waitWhileEquals(header->evaluated, sequenceNumber, header->evaluatorPid);
+    }
+    return getResults(sequenceNumber);
+}
+
+void ShmRingProducer::releaseSlot(uint32_t sequenceNumber) {
+    assert(sequenceNumber == releasedNumber);
+    (void)sequenceNumber;
+    ++releasedNumber;
+}
+
+void ShmRingProducer::evaluate(const double* const* columns, size_t rowsNumber, double* results) {
+    assert((columns != nullptr) || (variablesNumber == 0));
+    assert(results != nullptr);
+
+    size_t submittedRows = 0;
+    size_t collectedRows = 0;
+    while (collectedRows < rowsNumber) {
+        if ((submittedRows < rowsNumber) && (submittedNumber - releasedNumber < slotsNumber)) {
+            const uint32_t slot = acquireSlot();
+            const size_t slotRows = std::min<size_t>(rowsPerSlot, rowsNumber - submittedRows);
+            for (size_t i = 0; i < variablesNumber; ++i) {
+                memcpy(getColumn(slot, i), columns[i] + submittedRows, slotRows * sizeof(double));
+            }
+            submitSlot(slot, slotRows);
+            submittedRows += slotRows;
+        } else {
+            const uint32_t slot = releasedNumber;
+            const size_t slotRows = std::min<size_t>(rowsPerSlot, rowsNumber - collectedRows);
+            memcpy(results + collectedRows, waitResults(slot), slotRows * sizeof(double));
+            releaseSlot(slot);
+            collectedRows += slotRows;
+        }
+    }
+}
+
+void ShmRingProducer::close() {
+    if ((header == nullptr) || (header->magic != RING_MAGIC)) {
+        return;
+    }
+    if (submittedNumber - releasedNumber >= slotsNumber) {
+        waitResults(releasedNumber);
+        releaseSlot(releasedNumber);
+    }
+    submitSlot(acquireSlot(), END_OF_STREAM);
+    header->magic = 0; // Closed ring can't be opened
+}
+
+ShmRingEvaluator::ShmRingEvaluator(const char* name_) {
+    assert(name_ != nullptr);
+
+    name = name_;
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), name);
+    }
+    struct stat fileStat = {};
+    if ((fstat(fd, &fileStat) != 0) || ((size_t)fileStat.st_size < sizeof(Header))) {
+        ::close(fd);
+        throw std::invalid_argument("Shared-memory object is not a ring");
+    }
+    try {
+        map(fd, (size_t)fileStat.st_size);
+    } catch (const std::system_error&) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    if ((header->magic != RING_MAGIC) || (header->version != RING_VERSION)) {
+        throw std::invalid_argument("Shared-memory object is not an open ring");
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // Header is written by another process, so it's validated before anything is read by it's sizes
+    slotsNumber = header->slotsNumber;
+    rowsPerSlot = header->rowsPerSlot;
+    variablesNumber = header->variablesNumber;
+    size_t size = 0;
+    if ((variablesNumber > MAX_VARIABLES_NUMBER) || (slotsNumber == 0) || (rowsPerSlot == 0) ||
+        !tryGetRingSize(slotsNumber, variablesNumber, rowsPerSlot, size) || ((size_t)fileStat.st_size < size)) {
+        throw std::invalid_argument("Sizes of the ring don't match the shared-memory object");
+    }
+    if (strnlen(header->expression, MAX_EXPRESSION_LENGTH) == MAX_EXPRESSION_LENGTH) {
+        throw std::invalid_argument("Expression in the ring is not terminated");
+    }
+    for (size_t i = 0; i < variablesNumber; ++i) {
+        if (strnlen(header->variables[i], MAX_VARIABLE_NAME_LENGTH) == MAX_VARIABLE_NAME_LENGTH) {
+            throw std::invalid_argument("Variable name in the ring is not terminated");
+        }
+    }
+
+    ParseResult result = tryBuildAST(header->expression);
+    if (!result.isSuccess()) {
+        throw std::invalid_argument(std::string("Invalid expression in the ring: ") + result.getError().getMessage());
+    }
+    expression.reset(new CompiledExpression(result.getRoot()));
+    for (const std::string& variable : expression->getVariables()) {
+        size_t columnIndex = 0;
+        while ((columnIndex < variablesNumber) && (variable != header->variables[columnIndex])) {
+            ++columnIndex;
+        }
+        if (columnIndex == variablesNumber) {
+            throw std::invalid_argument("Variable '" + variable + "' has no column in the ring");
+        }
+        columnIndices.push_back(columnIndex);
+    }
+    header->evaluatorPid = (int32_t)getpid();
+}
+
+size_t ShmRingEvaluator::run() {
+    std::vector<const double*> columns(columnIndices.size());
+    size_t evaluatedRows = 0;
+    uint32_t evaluatedNumber = header->evaluated.value.load();
+    while (true) {
+        uint32_t submittedNumber = header->submitted.value.load(std::memory_order_acquire);
+        if (submittedNumber == evaluatedNumber) {
+            submittedNumber = waitWhileEquals(header->submitted, evaluatedNumber, header->producerPid);
+        }
+
+        for (; evaluatedNumber != submittedNumber; ++evaluatedNumber) {
+            const uint64_t rowsNumber = *(const uint64_t*)getSlot(evaluatedNumber);
+            if (rowsNumber == END_OF_STREAM) {
+                header->evaluated.value.store(evaluatedNumber + 1);
+                notify(header->evaluated);
+                return evaluatedRows;
+            }
+            if (rowsNumber > rowsPerSlot) {
+                throw std::invalid_argument("Slot has more rows than the ring allows");
+            }
+
+            for (size_t i = 0; i < columnIndices.size(); ++i) {
+                columns[i] = getColumn(evaluatedNumber, columnIndices[i]);
+            }
+            expression->evaluateColumns(columns.data(), rowsNumber, getResults(evaluatedNumber));
+            evaluatedRows += rowsNumber;
+
+            header->evaluated.value.store(evaluatedNumber + 1);
+            notify(header->evaluated);
+        }
+    }
+}
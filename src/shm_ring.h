@@ -0,0 +1,194 @@
+/**
+ * @file
+ * @brief Definition of shared-memory ring buffer for bulk evaluation
+ *
+ * Producer process creates a POSIX shared-memory object with the expression text, names of the variables
+ * and a ring of slots. Every slot has one input column per variable and a result column. Producer writes
+ * input columns right into the shared memory and submits the slot, evaluator (ast-builder --shm) evaluates
+ * the slot in place and writes the results next to the inputs. No data goes through syscalls.
+ *
+ * Slots are submitted, evaluated and released in order. Synchronization uses two shared counters: number of
+ * submitted slots (written by the producer) and number of evaluated slots (written by the evaluator).
+ * Waiting side spins for a while and then sleeps on the counter's futex, notifying side calls futex wake
+ * only if somebody sleeps. Sleeping side wakes up periodically and fails if the other process has exited,
+ * so a dead peer can't block it forever.
+ */
+#ifndef AST_BUILDER_SHM_RING_H
+#define AST_BUILDER_SHM_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "compiled_expression.h"
+
+class ShmRing {
+
+protected:
+    struct alignas(64) Counter {
+        std::atomic<uint32_t> value;
+        std::atomic<uint32_t> sleepersNumber;
+    };
+
+    struct Header;
+
+    std::string name;
+    Header* header = nullptr;
+    size_t mappingSize = 0;
+    /** Layout of the ring is kept in the process, so the other side can't change it after it's validated **/
+    size_t slotsNumber = 0;
+    size_t rowsPerSlot = 0;
+    size_t variablesNumber = 0;
+
+    ShmRing() = default;
+
+    void map(int fd, size_t size);
+
+    static void notify(Counter& counter);
+
+    /**
+     * Waits until the counter is changed.
+     * @param peerPid   pid of the process that changes the counter, 0 while it hasn't opened the ring
+     * @throws std::system_error with EPIPE if the peer has exited, with ETIMEDOUT if it doesn't open the ring in time.
+     */
+    static uint32_t waitWhileEquals(Counter& counter, uint32_t value, const std::atomic<int32_t>& peerPid);
+
+    static size_t getSlotSize(size_t variablesNumber, size_t rowsPerSlot);
+
+    /**
+     * Computes the size of the ring with the header.
+     * @return false if the size doesn't fit into size_t.
+     */
+    static bool tryGetRingSize(size_t slotsNumber, size_t variablesNumber, size_t rowsPerSlot, size_t& size);
+
+    char* getSlot(uint32_t sequenceNumber) const;
+
+public:
+    static constexpr size_t MAX_EXPRESSION_LENGTH = 16 * 1024;
+    static constexpr size_t MAX_VARIABLES_NUMBER = 16;
+    static constexpr size_t MAX_VARIABLE_NAME_LENGTH = 64;
+    /** Time for the evaluator to open the ring while the producer waits for results **/
+    static constexpr int ATTACH_TIMEOUT_MILLISECONDS = 10000;
+
+    ShmRing(const ShmRing& ring) = delete;
+    ShmRing& operator=(const ShmRing& ring) = delete;
+
+    virtual ~ShmRing();
+
+    size_t getSlotsNumber() const;
+    size_t getRowsPerSlot() const;
+    size_t getVariablesNumber() const;
+
+    /**
+     * Input column of the slot.
+     * @param sequenceNumber    sequence number of the slot (see ShmRingProducer::acquireSlot)
+     * @param variableIndex     index of the variable in the list given to the producer
+     * @return column of getRowsPerSlot() values.
+     */
+    double* getColumn(uint32_t sequenceNumber, size_t variableIndex) const;
+
+    /**
+     * Result column of the slot.
+     */
+    double* getResults(uint32_t sequenceNumber) const;
+};
+
+class ShmRingProducer : public ShmRing {
+
+private:
+    uint32_t submittedNumber = 0;
+    uint32_t releasedNumber = 0;
+
+public:
+    /**
+     * Creates the shared-memory object.
+     * @param name_         name of the object (like "/ast-builder-ring")
+     * @param expression    expression to evaluate
+     * @param variables     names of the variables, input columns go in the same order
+     * @param slotsNumber   number of slots in the ring
+     * @param rowsPerSlot   maximum number of rows in one slot
+     * @throws std::invalid_argument if expression or variables are too long or the ring is too large.
+     * @throws std::system_error if the object can't be created.
+     */
+    ShmRingProducer(const char* name_, const char* expression, const std::vector<std::string>& variables,
+                    size_t slotsNumber = 8, size_t rowsPerSlot = 16 * 1024);
+
+    /**
+     * Closes the ring (if it's not closed) and removes the shared-memory object. Doesn't wait for the evaluator
+     * that has exited or hasn't opened the ring in time.
+     */
+    ~ShmRingProducer() override;
+
+    /**
+     * Takes the next free slot. Write it's input columns (see getColumn) and submit it.
+     * @return sequence number of the slot.
+     * @throws std::logic_error if all the slots are submitted and not released.
+     */
+    uint32_t acquireSlot();
+
+    /**
+     * Passes the slot to the evaluator.
+     * @param sequenceNumber    sequence number of the slot
+     * @param rowsNumber        number of filled rows (not more than getRowsPerSlot())
+     */
+    void submitSlot(uint32_t sequenceNumber, size_t rowsNumber);
+
+    /**
+     * Waits until the slot is evaluated.
+     * @param sequenceNumber sequence number of the earliest submitted slot that is not released
+     * @return result column of the slot.
+     * @throws std::system_error if the evaluator has exited or hasn't opened the ring in time.
+     */
+    const double* waitResults(uint32_t sequenceNumber);
+
+    /**
+     * Makes the earliest submitted slot free.
+     */
+    void releaseSlot(uint32_t sequenceNumber);
+
+    /**
+     * Evaluates the expression for all the rows through the ring. Slots are kept full, so the evaluator
+     * works on some slots while the producer copies the others.
+     * @param columns       input columns in order of the variables given to the constructor
+     * @param rowsNumber    number of rows in every column
+     * @param results       column for the values of the expression
+     * @throws std::system_error if the evaluator has exited or hasn't opened the ring in time.
+     */
+    void evaluate(const double* const* columns, size_t rowsNumber, double* results);
+
+    /**
+     * Tells the evaluator that there will be no more slots. Evaluator finishes submitted slots and stops.
+     * @throws std::system_error if the ring is full and the evaluator has exited or hasn't opened the ring in time.
+     */
+    void close();
+};
+
+class ShmRingEvaluator : public ShmRing {
+
+private:
+    std::unique_ptr<CompiledExpression> expression;
+    /** Index of the input column of every variable of the expression **/
+    std::vector<size_t> columnIndices;
+
+public:
+    /**
+     * Opens the shared-memory object created by ShmRingProducer.
+     * @param name_ name of the object
+     * @throws std::system_error if the object can't be opened.
+     * @throws std::invalid_argument if it's not a ring, it's header doesn't match the size of the object
+     * or it's expression is invalid.
+     */
+    explicit ShmRingEvaluator(const char* name_);
+
+    /**
+     * Evaluates submitted slots until the producer closes the ring.
+     * @return number of evaluated rows.
+     * @throws std::invalid_argument if a slot has more rows than the ring allows.
+     * @throws std::system_error if the producer has exited.
+     */
+    size_t run();
+};
+
+#endif // AST_BUILDER_SHM_RING_H
@@ -0,0 +1,403 @@
+/**
+ * @file
+ * @brief Implementation of SVG rendering of AST
+ */
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include "output_buffer.h"
+#include "svg_renderer.h"
+
+static constexpr double CHARACTER_WIDTH = 7.5;
+static constexpr double NODE_PADDING = 8.;
+static constexpr double NODE_HEIGHT = 36.;
+/** Minimal horizontal gap between neighbour nodes **/
+static constexpr double NODE_GAP = 12.;
+static constexpr double LEVEL_HEIGHT = 64.;
+static constexpr double MARGIN = 10.;
+
+/** Size of the buffered SVG text that is written to the file at once **/
+static constexpr size_t SVG_BUFFER_SIZE = 1u << 20u;
+
+static constexpr size_t NO_NODE = SIZE_MAX;
+
+/**
+ * Node of the tree that is being laid out. Names of the fields follow the paper of Buchheim, Junger and Leipert
+ * "Improving Walker's Algorithm to Run in Linear Time".
+ */
+struct TidyNode {
+    size_t parent;
+    size_t children[2];
+    size_t childrenNumber;
+    /** Index among the siblings **/
+    size_t number;
+    double width;
+    double prelim;
+    double mod;
+    double shift;
+    double change;
+    size_t thread;
+    size_t ancestor;
+};
+
+/**
+ * Appends the first line of the label of the node.
+ */
+static void appendKind(OutputBuffer& buffer, const Token* token) {
+    switch (token->getType()) {
+        case TokenType::CONSTANT_VALUE:
+            buffer.append("const");
+            return;
+        case TokenType::VARIABLE:
+            buffer.append("var");
+            return;
+        case TokenType::OPERATOR: {
+            const size_t arity = static_cast<const OperatorToken*>(token)->getArity();
+            if ((arity != 1) && (arity != 2)) {
+                throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
+            }
+            buffer.append(arity == 1 ? "unary op" : "binary op");
+            return;
+        }
+        case TokenType::FUNCTION:
+            if (static_cast<const FunctionToken*>(token)->getArity() != 1) {
+                throw std::logic_error("Unsupported arity of function. Only unary are supported yet");
+            }
+            buffer.append("unary func");
+            return;
+        default:
+            throw std::logic_error("Unsupported token type");
+    }
+}
+
+/**
+ * Appends the second line of the label of the node. Names and symbols contain no XML special characters.
+ */
+static void appendDetails(OutputBuffer& buffer, const Token* token) {
+    switch (token->getType()) {
+        case TokenType::CONSTANT_VALUE:
+            buffer.append("value: ");
+            buffer.appendNumber(static_cast<const ConstantValueToken*>(token)->getValue());
+            return;
+        case TokenType::VARIABLE:
+            buffer.append("name: ");
+            buffer.append(static_cast<const VariableToken*>(token)->getName());
+            return;
+        case TokenType::OPERATOR:
+            buffer.append("op: ");
+            buffer.append(static_cast<const OperatorToken*>(token)->getSymbol());
+            return;
+        case TokenType::FUNCTION:
+            buffer.append("func: ");
+            buffer.append(static_cast<const FunctionToken*>(token)->getName());
+            return;
+        default:
+            throw std::logic_error("Unsupported token type");
+    }
+}
+
+/**
+ * Returns the width of the node box that fits both lines of the label.
+ * @param scratch buffer for the label, it's cleared when it grows large
+ */
+static double getNodeWidth(OutputBuffer& scratch, const Token* token) {
+    if (scratch.getSize() >= SVG_BUFFER_SIZE) {
+        scratch.release();
+    }
+    size_t start = scratch.getSize();
+    appendKind(scratch, token);
+    const size_t kindLength = scratch.getSize() - start;
+    start = scratch.getSize();
+    appendDetails(scratch, token);
+    const size_t detailsLength = scratch.getSize() - start;
+    return (double)std::max(kindLength, detailsLength) * CHARACTER_WIDTH + 2 * NODE_PADDING;
+}
+
+static inline double getDistance(const std::vector<TidyNode>& nodes, size_t leftNode, size_t rightNode) {
+    return (nodes[leftNode].width + nodes[rightNode].width) / 2 + NODE_GAP;
+}
+
+static inline size_t nextLeft(const std::vector<TidyNode>& nodes, size_t node) {
+    return nodes[node].childrenNumber > 0 ? nodes[node].children[0] : nodes[node].thread;
+}
+
+static inline size_t nextRight(const std::vector<TidyNode>& nodes, size_t node) {
+    return nodes[node].childrenNumber > 0 ? nodes[node].children[nodes[node].childrenNumber - 1] : nodes[node].thread;
+}
+
+static void moveSubtree(std::vector<TidyNode>& nodes, size_t leftSubtree, size_t rightSubtree, double shift) {
+    const double subtreesNumber = (double)(nodes[rightSubtree].number - nodes[leftSubtree].number);
+    nodes[rightSubtree].change -= shift / subtreesNumber;
+    nodes[rightSubtree].shift += shift;
+    nodes[leftSubtree].change += shift / subtreesNumber;
+    nodes[rightSubtree].prelim += shift;
+    nodes[rightSubtree].mod += shift;
+}
+
+/**
+ * Places the subtree of the node next to the subtrees of it's left siblings, moving it right until their
+ * contours don't overlap. Contours are followed by threads, so every level is visited once.
+ * @return new default ancestor.
+ */
+static size_t apportion(std::vector<TidyNode>& nodes, size_t node, size_t defaultAncestor) {
+    const TidyNode& parent = nodes[nodes[node].parent];
+    if (nodes[node].number == 0) {
+        return defaultAncestor;
+    }
+
+    // Inner and outer contours of the left (minus) and the right (plus) subtrees
+    size_t innerPlus = node;
+    size_t outerPlus = node;
+    size_t innerMinus = parent.children[nodes[node].number - 1];
+    size_t outerMinus = parent.children[0];
+    double innerPlusSum = nodes[innerPlus].mod;
+    double outerPlusSum = nodes[outerPlus].mod;
+    double innerMinusSum = nodes[innerMinus].mod;
+    double outerMinusSum = nodes[outerMinus].mod;
+    while ((nextRight(nodes, innerMinus) != NO_NODE) && (nextLeft(nodes, innerPlus) != NO_NODE)) {
+        innerMinus = nextRight(nodes, innerMinus);
+        innerPlus = nextLeft(nodes, innerPlus);
+        outerMinus = nextLeft(nodes, outerMinus);
+        outerPlus = nextRight(nodes, outerPlus);
+        nodes[outerPlus].ancestor = node;
+        const double shift = (nodes[innerMinus].prelim + innerMinusSum) - (nodes[innerPlus].prelim + innerPlusSum)
+                             + getDistance(nodes, innerMinus, innerPlus);
+        if (shift > 0) {
+            const size_t ancestor = nodes[innerMinus].ancestor;
+            moveSubtree(nodes, nodes[ancestor].parent == nodes[node].parent ? ancestor : defaultAncestor, node, shift);
+            innerPlusSum += shift;
+            outerPlusSum += shift;
+        }
+        innerMinusSum += nodes[innerMinus].mod;
+        innerPlusSum += nodes[innerPlus].mod;
+        outerMinusSum += nodes[outerMinus].mod;
+        outerPlusSum += nodes[outerPlus].mod;
+    }
+    if ((nextRight(nodes, innerMinus) != NO_NODE) && (nextRight(nodes, outerPlus) == NO_NODE)) {
+        nodes[outerPlus].thread = nextRight(nodes, innerMinus);
+        nodes[outerPlus].mod += innerMinusSum - outerPlusSum;
+    }
+    if ((nextLeft(nodes, innerPlus) != NO_NODE) && (nextLeft(nodes, outerMinus) == NO_NODE)) {
+        nodes[outerMinus].thread = nextLeft(nodes, innerPlus);
+        nodes[outerMinus].mod += innerPlusSum - outerMinusSum;
+        defaultAncestor = node;
+    }
+    return defaultAncestor;
+}
+
+static void executeShifts(std::vector<TidyNode>& nodes, size_t node) {
+    double shift = 0;
+    double change = 0;
+    for (size_t i = nodes[node].childrenNumber; i > 0; --i) {
+        TidyNode& child = nodes[nodes[node].children[i - 1]];
+        child.prelim += shift;
+        child.mod += shift;
+        change += child.change;
+        shift += child.shift + change;
+    }
+}
+
+/**
+ * Builds the tree to lay out in pre-order. Node that is already in the tree isn't added again.
+ */
+static void buildTidyTree(const ASTNode& root, std::vector<LayoutNode>& layout, std::vector<TidyNode>& nodes) {
+    OutputBuffer scratch;
+    std::unordered_map<const ASTNode*, size_t> indices;
+    std::vector<std::pair<const ASTNode*, size_t> > stack;
+    stack.emplace_back(&root, NO_PARENT);
+    while (!stack.empty()) {
+        const ASTNode* node = stack.back().first;
+        const size_t parent = stack.back().second;
+        stack.pop_back();
+        if (!indices.emplace(node, layout.size()).second) {
+            continue;
+        }
+
+        const size_t index = layout.size();
+        const double width = getNodeWidth(scratch, node->getToken().get());
+        layout.push_back(LayoutNode{ node, parent, parent == NO_PARENT ? 0 : layout[parent].depth + 1, 0., width });
+        nodes.push_back(TidyNode{ parent, { NO_NODE, NO_NODE }, 0, 0, width, 0., 0., 0., 0., NO_NODE, index });
+        if (parent != NO_PARENT) {
+            nodes[index].number = nodes[parent].childrenNumber;
+            nodes[parent].children[nodes[parent].childrenNumber++] = index;
+        }
+
+        const std::shared_ptr<ASTNode>* children = node->getChildren();
+        for (size_t i = node->getChildrenNumber(); i > 0; --i) { // Left child is popped first
+            if (indices.find(children[i - 1].get()) == indices.end()) {
+                stack.emplace_back(children[i - 1].get(), index);
+            }
+        }
+    }
+}
+
+std::vector<LayoutNode> layoutAST(const ASTNode& root) {
+    std::vector<LayoutNode> layout;
+    std::vector<TidyNode> nodes;
+    buildTidyTree(root, layout, nodes);
+
+    // First walk: children go after their parent, so the reverse order visits every subtree before it's root.
+    // Subtree of every node is laid out relative to it's root, then it's children are placed next to each other.
+    for (size_t node = nodes.size(); node > 0; --node) {
+        TidyNode& parent = nodes[node - 1];
+        if (parent.childrenNumber == 0) {
+            continue;
+        }
+        size_t defaultAncestor = parent.children[0];
+        for (size_t i = 0; i < parent.childrenNumber; ++i) {
+            TidyNode& child = nodes[parent.children[i]];
+            // Until now prelim of the child with children is the midpoint of them
+            const double midpoint = child.prelim;
+            if (i > 0) {
+                child.prelim = nodes[parent.children[i - 1]].prelim + getDistance(nodes, parent.children[i - 1], parent.children[i]);
+                if (child.childrenNumber > 0) {
+                    child.mod = child.prelim - midpoint;
+                }
+            }
+            defaultAncestor = apportion(nodes, parent.children[i], defaultAncestor);
+        }
+        executeShifts(nodes, node - 1);
+        parent.prelim = (nodes[parent.children[0]].prelim + nodes[parent.children[parent.childrenNumber - 1]].prelim) / 2;
+    }
+
+    // Second walk: modifiers of the ancestors are summed up, parent goes before it's children
+    std::vector<double> modifiers(nodes.size());
+    modifiers[0] = -nodes[0].prelim;
+    double left = 0;
+    for (size_t node = 0; node < nodes.size(); ++node) {
+        if (node > 0) {
+            modifiers[node] = modifiers[nodes[node].parent] + nodes[nodes[node].parent].mod;
+        }
+        layout[node].x = nodes[node].prelim + modifiers[node];
+        left = std::min(left, layout[node].x - layout[node].width / 2);
+    }
+    for (LayoutNode& node : layout) {
+        node.x -= left;
+    }
+    return layout;
+}
+
+/**
+ * Appends the coordinate rounded to tenths, so it's written shortly.
+ */
+static inline void appendCoordinate(OutputBuffer& buffer, double coordinate) {
+    buffer.appendNumber(std::round(coordinate * 10) / 10);
+}
+
+static inline double getTop(const LayoutNode& node) {
+    return MARGIN + (double)node.depth * LEVEL_HEIGHT;
+}
+
+static void appendEdge(OutputBuffer& buffer, const LayoutNode& parent, const LayoutNode& child) {
+    buffer.append("<line x1=\"");
+    appendCoordinate(buffer, MARGIN + parent.x);
+    buffer.append("\" y1=\"");
+    appendCoordinate(buffer, getTop(parent) + NODE_HEIGHT);
+    buffer.append("\" x2=\"");
+    appendCoordinate(buffer, MARGIN + child.x);
+    buffer.append("\" y2=\"");
+    appendCoordinate(buffer, getTop(child));
+    buffer.append("\"/>\n");
+}
+
+static void appendNode(OutputBuffer& buffer, const LayoutNode& node) {
+    const Token* token = node.node->getToken().get();
+    const double top = getTop(node);
+    buffer.append("<rect class=\"");
+    switch (token->getType()) {
+        case TokenType::CONSTANT_VALUE: buffer.append('c'); break;
+        case TokenType::VARIABLE:       buffer.append('v'); break;
+        default:                        buffer.append('o'); break;
+    }
+    buffer.append("\" x=\"");
+    appendCoordinate(buffer, MARGIN + node.x - node.width / 2);
+    buffer.append("\" y=\"");
+    appendCoordinate(buffer, top);
+    buffer.append("\" width=\"");
+    appendCoordinate(buffer, node.width);
+    buffer.append("\" height=\"");
+    appendCoordinate(buffer, NODE_HEIGHT);
+    buffer.append("\"/><text x=\"");
+    appendCoordinate(buffer, MARGIN + node.x);
+    buffer.append("\" y=\"");
+    appendCoordinate(buffer, top + NODE_HEIGHT / 2 - 3);
+    buffer.append("\">");
+    appendKind(buffer, token);
+    buffer.append("<tspan x=\"");
+    appendCoordinate(buffer, MARGIN + node.x);
+    buffer.append("\" dy=\"14\">");
+    appendDetails(buffer, token);
+    buffer.append("</tspan></text>\n");
+}
+
+static void flushBuffer(OutputBuffer& buffer, FILE* svgFile, bool force) {
+    if ((force || (buffer.getSize() >= SVG_BUFFER_SIZE)) && !buffer.writeTo(svgFile)) {
+        throw std::system_error(errno, std::generic_category(), "Can't write SVG file");
+    }
+}
+
+void svgPrint(const ASTNode& root, FILE* svgFile) {
+    assert(svgFile != nullptr);
+
+    const std::vector<LayoutNode> layout = layoutAST(root);
+    double width = 0;
+    size_t depth = 0;
+    std::unordered_map<const ASTNode*, size_t> indices;
+    indices.reserve(layout.size());
+    for (size_t i = 0; i < layout.size(); ++i) {
+        width = std::max(width, layout[i].x + layout[i].width / 2);
+        depth = std::max(depth, layout[i].depth);
+        indices.emplace(layout[i].node, i);
+    }
+    const double height = (double)depth * LEVEL_HEIGHT + NODE_HEIGHT + 2 * MARGIN;
+    width += 2 * MARGIN;
+
+    OutputBuffer buffer;
+    buffer.reserve(SVG_BUFFER_SIZE + 4096);
+    buffer.append("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+    appendCoordinate(buffer, width);
+    buffer.append("\" height=\"");
+    appendCoordinate(buffer, height);
+    buffer.append("\" font-family=\"monospace\" font-size=\"12\">\n"
+                  "<defs><marker id=\"a\" viewBox=\"0 0 10 10\" refX=\"10\" refY=\"5\" markerWidth=\"8\" markerHeight=\"8\" "
+                  "orient=\"auto\"><path d=\"M0,0L10,5L0,10z\"/></marker></defs>\n"
+                  "<style>line{stroke:black;marker-end:url(#a)}rect{stroke:grey}text{text-anchor:middle}"
+                  ".c{fill:#FFFEC9}.v{fill:#99FF9D}.o{fill:#C9E7FF}</style>\n");
+
+    // Edges go first, so nodes are drawn over them. Edges to shared nodes aren't in the layout, so they're taken
+    // from the AST.
+    for (const LayoutNode& parent : layout) {
+        const std::shared_ptr<ASTNode>* children = parent.node->getChildren();
+        for (size_t i = 0; i < parent.node->getChildrenNumber(); ++i) {
+            appendEdge(buffer, parent, layout[indices.at(children[i].get())]);
+        }
+        flushBuffer(buffer, svgFile, false);
+    }
+    for (const LayoutNode& node : layout) {
+        appendNode(buffer, node);
+        flushBuffer(buffer, svgFile, false);
+    }
+    buffer.append("</svg>\n");
+    flushBuffer(buffer, svgFile, true);
+}
+
+void saveSVG(const ASTNode& root, const std::string& fileName) {
+    FILE* svgFile = fopen(fileName.c_str(), "w");
+    if (svgFile == nullptr) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+    try {
+        svgPrint(root, svgFile);
+    } catch (...) {
+        fclose(svgFile);
+        throw;
+    }
+    if (fclose(svgFile) != 0) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+}
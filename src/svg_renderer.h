@@ -0,0 +1,59 @@
+/**
+ * @file
+ * @brief Definition of SVG rendering of AST
+ *
+ * AST is laid out as a tidy tree with the Buchheim-Walker algorithm in linear time: parent is centered above
+ * it's children, subtrees are placed as close as possible without overlapping, and equal subtrees are drawn equally.
+ * Layout and writing are iterative and output is buffered, so trees with millions of nodes are rendered
+ * in seconds without external processes. Nodes have the same labels and colors as in DOT graphs.
+ *
+ * Node shared by several parents (e.g. in derivatives) is laid out once under the first of them,
+ * other parents get edges to it.
+ */
+#ifndef AST_BUILDER_SVG_RENDERER_H
+#define AST_BUILDER_SVG_RENDERER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+static constexpr size_t NO_PARENT = SIZE_MAX;
+
+struct LayoutNode {
+    const ASTNode* node;
+    /** Index of the parent in the layout, NO_PARENT for the root **/
+    size_t parent;
+    size_t depth;
+    /** Center of the node **/
+    double x;
+    double width;
+};
+
+/**
+ * Lays out the AST as a tidy tree.
+ * @param root root of the AST
+ * @return nodes in pre-order (parent goes before it's children) with horizontal positions starting from 0.
+ * @throws std::logic_error if the AST contains unsupported tokens.
+ */
+std::vector<LayoutNode> layoutAST(const ASTNode& root);
+
+/**
+ * Writes the AST as an SVG picture.
+ * @param root      root of the AST
+ * @param svgFile   file to write the picture to
+ * @throws std::system_error if the file can't be written.
+ */
+void svgPrint(const ASTNode& root, FILE* svgFile);
+
+/**
+ * Writes the AST as an SVG picture into the file.
+ * @param root      root of the AST
+ * @param fileName  name of the file
+ * @throws std::system_error if the file can't be written.
+ */
+void saveSVG(const ASTNode& root, const std::string& fileName);
+
+#endif // AST_BUILDER_SVG_RENDERER_H
@@ -0,0 +1,310 @@
+/**
+ * @file
+ * @brief Implementation of TeX writer of AST
+ */
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "tex_writer.h"
+
+static constexpr size_t NO_NAME = SIZE_MAX;
+
+enum TexBraceType { NONE, ROUND, CURLY };
+
+static TexBraceType getChildBraceType(const OperatorToken* parentOperator, const Token* child, bool isRightChild) {
+    if (child->getType() != TokenType::OPERATOR)
+        return NONE;
+
+    if (parentOperator->getOperatorType() == OperatorType::POWER)
+        return isRightChild ? CURLY : ROUND;
+
+    if (static_cast<const OperatorToken*>(child)->getPrecedence() < parentOperator->getPrecedence())
+        return ROUND;
+
+    if (isRightChild && (parentOperator->getOperatorType() == OperatorType::SUBTRACTION) &&
+        (static_cast<const OperatorToken*>(child)->getPrecedence() == parentOperator->getPrecedence()))
+        return ROUND;
+
+    return NONE;
+}
+
+static inline size_t addSaturated(size_t first, size_t second) {
+    return first > SIZE_MAX - second ? SIZE_MAX : first + second;
+}
+
+static inline bool isSum(const ASTNode* node) {
+    if (node->getChildrenNumber() != 2) return false;
+    const OperatorType operatorType = static_cast<const OperatorToken*>(node->getToken().get())->getOperatorType();
+    return (operatorType == ADDITION) || (operatorType == SUBTRACTION);
+}
+
+/**
+ * Writer of one document. Nodes are grouped into classes of structurally equal subtrees, class of a child always
+ * has smaller id than class of it's parent.
+ */
+class TexWriter {
+
+private:
+    const TexOptions options;
+    std::unordered_map<const ASTNode*, size_t> classes;
+    /** First found node of every class **/
+    std::vector<const ASTNode*> representatives;
+    std::vector<size_t> names;
+    size_t namesNumber = 0;
+
+    void classify(const ASTNode& root);
+    void chooseNames();
+    void appendName(OutputBuffer& buffer, size_t name) const;
+    void printTerm(OutputBuffer& buffer, const ASTNode* node, TexBraceType braceType, const ASTNode* definition) const;
+    void printExpression(OutputBuffer& buffer, const ASTNode* root) const;
+
+public:
+    explicit TexWriter(const TexOptions& options_) : options(options_) { }
+
+    void print(const ASTNode& root, OutputBuffer& buffer);
+};
+
+/**
+ * Finds classes in post-order. Candidates are found by structural hash and are compared by structure,
+ * shared children make the comparison stop early.
+ */
+void TexWriter::classify(const ASTNode& root) {
+    std::unordered_map<uint64_t, std::vector<size_t> > classesByHash;
+    std::vector<std::pair<const ASTNode*, size_t> > stack;
+    stack.emplace_back(&root, 0);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        const ASTNode* node = top.first;
+        if (top.second < node->getChildrenNumber()) {
+            const ASTNode* child = node->getChildren()[top.second++].get();
+            if (classes.find(child) == classes.end()) {
+                stack.emplace_back(child, 0);
+            }
+            continue;
+        }
+        stack.pop_back();
+        if (classes.find(node) != classes.end()) {
+            continue;
+        }
+
+        std::vector<size_t>& candidates = classesByHash[node->getHash()];
+        size_t nodeClass = representatives.size();
+        for (size_t candidate : candidates) {
+            const ASTNode* representative = representatives[candidate];
+            bool childrenEqual = representative->getChildrenNumber() == node->getChildrenNumber();
+            for (size_t i = 0; childrenEqual && (i < node->getChildrenNumber()); ++i) {
+                childrenEqual = classes.at(representative->getChildren()[i].get()) == classes.at(node->getChildren()[i].get());
+            }
+            if (childrenEqual && representative->structurallyEquals(*node)) {
+                nodeClass = candidate;
+                break;
+            }
+        }
+        if (nodeClass == representatives.size()) {
+            representatives.push_back(node);
+            candidates.push_back(nodeClass);
+        }
+        classes.emplace(node, nodeClass);
+    }
+}
+
+/**
+ * Counts how many times every class is written, parents go first. Children of a named class are written once
+ * in it's definition, children of other classes are written every time their parent is written.
+ */
+void TexWriter::chooseNames() {
+    std::vector<size_t> sizes(representatives.size());
+    for (size_t i = 0; i < representatives.size(); ++i) {
+        sizes[i] = 1;
+        for (size_t j = 0; j < representatives[i]->getChildrenNumber(); ++j) {
+            sizes[i] = addSaturated(sizes[i], sizes[classes.at(representatives[i]->getChildren()[j].get())]);
+        }
+    }
+
+    names.assign(representatives.size(), NO_NAME);
+    std::vector<size_t> occurrences(representatives.size());
+    occurrences.back() = 1;
+    for (size_t i = representatives.size(); i > 0; --i) {
+        const size_t nodeClass = i - 1;
+        if ((options.minNamedSize > 0) && (occurrences[nodeClass] >= 2) && (sizes[nodeClass] >= options.minNamedSize)) {
+            names[nodeClass] = namesNumber++;
+        }
+        const size_t childOccurrences = names[nodeClass] != NO_NAME ? 1 : occurrences[nodeClass];
+        for (size_t j = 0; j < representatives[nodeClass]->getChildrenNumber(); ++j) {
+            size_t& count = occurrences[classes.at(representatives[nodeClass]->getChildren()[j].get())];
+            count = addSaturated(count, childOccurrences);
+        }
+    }
+}
+
+/**
+ * Names are calligraphic letters, so they don't look like variables: A, ..., Z, A_1, ..., Z_1, A_2, ...
+ */
+void TexWriter::appendName(OutputBuffer& buffer, size_t name) const {
+    buffer.append("{\\mathcal{");
+    buffer.append((char)('A' + name % 26));
+    buffer.append('}');
+    if (name >= 26) {
+        buffer.append("_{");
+        buffer.appendUnsigned(name / 26);
+        buffer.append('}');
+    }
+    buffer.append('}');
+}
+
+/**
+ * Writes the subtree, named subtrees (except the defined one) are written as names.
+ */
+void TexWriter::printTerm(OutputBuffer& buffer, const ASTNode* node, TexBraceType braceType,
+                          const ASTNode* definition) const {
+    static const char* const closingBraces[] = { nullptr, ")", "}" };
+
+    struct Item {
+        const ASTNode* node;
+        TexBraceType braceType;
+        const char* text;
+    };
+    printInStackOrder(buffer, Item{ node, braceType, nullptr }, [this, &buffer, definition](const Item& item,
+                                                                                            std::vector<Item>& items) {
+        if (item.node != definition) {
+            const size_t name = names[classes.at(item.node)];
+            if (name != NO_NAME) {
+                appendName(buffer, name);
+                return;
+            }
+        }
+
+        const Token* token = item.node->getToken().get();
+        const std::shared_ptr<ASTNode>* children = item.node->getChildren();
+        if (token->getType() == TokenType::CONSTANT_VALUE) {
+            buffer.append('{');
+            buffer.appendNumber(static_cast<const ConstantValueToken*>(token)->getValue());
+            buffer.append('}');
+        } else if (token->getType() == TokenType::VARIABLE) {
+            buffer.append('{');
+            buffer.append(static_cast<const VariableToken*>(token)->getName());
+            buffer.append('}');
+        } else if (token->getType() == TokenType::OPERATOR) {
+            auto operatorToken = static_cast<const OperatorToken*>(token);
+            if (operatorToken->getArity() == 1) {
+                if (item.braceType != NONE) buffer.append(item.braceType == ROUND ? "(" : "{");
+                buffer.append(operatorToken->getSymbol());
+                if (item.braceType != NONE) items.push_back({ nullptr, NONE, closingBraces[item.braceType] });
+                items.push_back({ children[0].get(), ROUND, nullptr });
+            } else if (operatorToken->getArity() == 2) {
+                if (operatorToken->getOperatorType() == OperatorType::DIVISION) {
+                    // No braces needed, because `\frac` can be safely used with `^` as `\frac{...}{...} ^ \frac{...}{...}`
+                    buffer.append("\\frac{");
+                    items.push_back({ nullptr, NONE, "}" });
+                    items.push_back({ children[1].get(), NONE, nullptr });
+                    items.push_back({ nullptr, NONE, "}{" });
+                    items.push_back({ children[0].get(), NONE, nullptr });
+                } else {
+                    if (item.braceType != NONE) buffer.append(item.braceType == ROUND ? "(" : "{");
+                    if (item.braceType != NONE) items.push_back({ nullptr, NONE, closingBraces[item.braceType] });
+                    const Token* rightChild = children[1]->getToken().get();
+                    items.push_back({ children[1].get(), getChildBraceType(operatorToken, rightChild, true), nullptr });
+                    items.push_back({ nullptr, NONE, BinaryOperatorTexts[operatorToken->getOperatorType()] });
+                    const Token* leftChild = children[0]->getToken().get();
+                    items.push_back({ children[0].get(), getChildBraceType(operatorToken, leftChild, false), nullptr });
+                }
+            } else {
+                throw std::logic_error("Unsupported arity of operator. Only unary and binary are supported yet");
+            }
+        } else if (token->getType() == TokenType::FUNCTION) {
+            auto functionToken = static_cast<const FunctionToken*>(token);
+            if (functionToken->getArity() != 1) {
+                throw std::logic_error("Unsupported arity of function. Only unary are supported yet");
+            }
+            buffer.append('{');
+            buffer.append(functionToken->getName());
+            buffer.append('}');
+            items.push_back({ children[0].get(), ROUND, nullptr });
+        } else {
+            throw std::logic_error("Unsupported token type");
+        }
+    });
+}
+
+/**
+ * Writes the expression as terms of it's top-level sum, line is broken before the term that goes after
+ * the line limit. Lines are aligned by "&" that is written before the expression.
+ */
+void TexWriter::printExpression(OutputBuffer& buffer, const ASTNode* root) const {
+    struct Term {
+        const char* operatorText;
+        const ASTNode* node;
+        TexBraceType braceType;
+    };
+    std::vector<Term> terms;
+    const ASTNode* node = root;
+    while (isSum(node) && ((node == root) || (names[classes.at(node)] == NO_NAME))) {
+        auto operatorToken = static_cast<const OperatorToken*>(node->getToken().get());
+        const ASTNode* rightChild = node->getChildren()[1].get();
+        terms.push_back({ operatorToken->getOperatorType() == ADDITION ? " + " : " - ", rightChild,
+                          getChildBraceType(operatorToken, rightChild->getToken().get(), true) });
+        node = node->getChildren()[0].get();
+    }
+    // Left operand of a sum never needs braces
+    terms.push_back({ nullptr, node, NONE });
+
+    size_t lineStart = buffer.getSize();
+    for (size_t i = terms.size(); i > 0; --i) {
+        const Term& term = terms[i - 1];
+        if (term.operatorText != nullptr) {
+            if (buffer.getSize() - lineStart > options.maxLineLength) {
+                buffer.append(" \\\\\n&\\quad");
+                lineStart = buffer.getSize();
+            }
+            buffer.append(term.operatorText);
+        }
+        printTerm(buffer, term.node, term.braceType, root);
+    }
+}
+
+void TexWriter::print(const ASTNode& root, OutputBuffer& buffer) {
+    classify(root);
+    chooseNames();
+
+    buffer.append("\\documentclass{article}\n\\usepackage{amsmath}\n\\allowdisplaybreaks\n"
+                  "\\begin{document}\n\\begin{align*}\n&");
+    printExpression(buffer, &root);
+
+    // Definitions are written top-down, in order of names
+    std::vector<const ASTNode*> definitions(namesNumber);
+    for (size_t i = 0; i < representatives.size(); ++i) {
+        if (names[i] != NO_NAME) {
+            definitions[names[i]] = representatives[i];
+        }
+    }
+    for (size_t i = 0; i < definitions.size(); ++i) {
+        buffer.append(i == 0 ? " \\\\\n\\text{where } " : " \\\\\n");
+        appendName(buffer, i);
+        buffer.append(" &= ");
+        printExpression(buffer, definitions[i]);
+    }
+    buffer.append("\n\\end{align*}\n\\end{document}\n");
+}
+
+void texPrint(const ASTNode& root, OutputBuffer& buffer, const TexOptions& options) {
+    TexWriter(options).print(root, buffer);
+}
+
+void saveTeX(const ASTNode& root, const std::string& fileName, const TexOptions& options) {
+    OutputBuffer buffer;
+    texPrint(root, buffer, options);
+
+    FILE* texFile = fopen(fileName.c_str(), "w");
+    if (texFile == nullptr) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+    const bool written = buffer.writeTo(texFile);
+    const int writeError = errno;
+    if ((fclose(texFile) != 0) || !written) {
+        throw std::system_error(written ? errno : writeError, std::generic_category(), fileName);
+    }
+}
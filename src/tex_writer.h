@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @brief Definition of TeX writer of AST
+ *
+ * Writer keeps the document small, so even derivatives of nested expressions can be compiled:
+ * - subtrees that are repeated (equal by structure, not only shared) and are large enough are written once and are
+ *   referenced by name: "A + A^{2}, where A = ...";
+ * - top-level sums of the expression and of the definitions are broken into aligned lines.
+ *
+ * Traversals are iterative and text is built in memory, so deep trees don't overflow the call stack.
+ */
+#ifndef AST_BUILDER_TEX_WRITER_H
+#define AST_BUILDER_TEX_WRITER_H
+
+#include <cstddef>
+#include <string>
+#include "ast.h"
+#include "output_buffer.h"
+
+struct TexOptions {
+    /** Repeated subtrees with at least this number of nodes are named, 0 disables naming **/
+    size_t minNamedSize = 8;
+    /** Sums are broken into lines after this number of characters of TeX text **/
+    size_t maxLineLength = 120;
+};
+
+/**
+ * Writes the TeX document with the expression.
+ * @param root      root of the AST
+ * @param buffer    buffer to append the document to
+ * @param options   options of naming and line breaking
+ * @throws std::logic_error if the AST contains unsupported tokens.
+ */
+void texPrint(const ASTNode& root, OutputBuffer& buffer, const TexOptions& options = TexOptions());
+
+/**
+ * Writes the TeX document with the expression into the file.
+ * @param root      root of the AST
+ * @param fileName  name of the file
+ * @param options   options of naming and line breaking
+ * @throws std::system_error if the file can't be written.
+ */
+void saveTeX(const ASTNode& root, const std::string& fileName, const TexOptions& options = TexOptions());
+
+#endif // AST_BUILDER_TEX_WRITER_H
@@ -0,0 +1,197 @@
+/**
+ * @file
+ * @brief Implementation of work-stealing thread pool
+ */
+#include <cstdint>
+#include "thread_pool.h"
+
+/** Index of the current worker's queue or SIZE_MAX if current thread isn't a worker of currentPool. **/
+static thread_local size_t currentQueueIndex = SIZE_MAX;
+static thread_local const ThreadPool* currentPool = nullptr;
+/** Number of tasks that are run by runPendingTask in the current thread and are nested in each other **/
+static thread_local size_t nestedTasksNumber = 0;
+
+/**
+ * Counts the nested task while it runs.
+ */
+class NestedTaskScope {
+
+public:
+    NestedTaskScope() {
+        ++nestedTasksNumber;
+    }
+
+    ~NestedTaskScope() {
+        --nestedTasksNumber;
+    }
+};
+
+ThreadPool::ThreadPool(size_t threadsNumber) : pendingTasksNumber(0), nextQueue(0), submittedTasksNumber(0) {
+    if (threadsNumber == 0) {
+        threadsNumber = std::thread::hardware_concurrency();
+        if (threadsNumber == 0) threadsNumber = 1;
+    }
+
+    for (size_t i = 0; i < threadsNumber; ++i) {
+        queues.emplace_back(new TaskQueue());
+    }
+    for (size_t i = 0; i < threadsNumber; ++i) {
+        threads.emplace_back(&ThreadPool::runWorker, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    size_t queueIndex = currentQueueIndex;
+    if ((currentPool != this) || (queueIndex >= queues.size())) {
+        queueIndex = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    }
+    // Counted before it's pushed, so it can't be taken and uncounted first
+    pendingTasksNumber.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks.push_back(std::move(task));
+    }
+    submittedTasksNumber.fetch_add(1);
+    bool waitersSleep = false;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex); // Sleeping threads shouldn't miss the notification
+        waitersSleep = sleepingWaitersNumber > 0;
+    }
+    wakeUp.notify_one();
+    if (waitersSleep) {
+        waitersWakeUp.notify_all();
+    }
+}
+
+bool ThreadPool::runPendingTask() {
+    const bool isWorker = currentPool == this;
+    const bool stealing = nestedTasksNumber < MAX_NESTED_STEALING_DEPTH;
+    if (!isWorker && !stealing) {
+        return false; // Thread without it's own queue waits for the workers
+    }
+    Task task;
+    if (!takeTask(isWorker ? currentQueueIndex : 0, stealing, task)) {
+        return false;
+    }
+    const NestedTaskScope scope;
+    task();
+    return true;
+}
+
+void ThreadPool::sleepUntilSubmit(uint64_t submittedTasksNumber_, const std::function<bool()>& isDone) {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    ++sleepingWaitersNumber;
+    waitersWakeUp.wait(lock, [&]() { return (submittedTasksNumber.load() != submittedTasksNumber_) || isDone(); });
+    --sleepingWaitersNumber;
+}
+
+void ThreadPool::notifyWaiters() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex); // Sleeping threads shouldn't miss the notification
+    }
+    waitersWakeUp.notify_all();
+}
+
+/**
+ * Takes a task from the back of the given queue or steals it from the front of another one, if stealing is allowed.
+ */
+bool ThreadPool::takeTask(size_t queueIndex, bool stealing, Task& task) {
+    if (pendingTasksNumber.load() == 0) {
+        return false;
+    }
+
+    const size_t queuesNumber = queues.size();
+    for (size_t i = 0; i < (stealing ? queuesNumber : 1); ++i) {
+        TaskQueue& queue = *queues[(queueIndex + i) % queuesNumber];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            pendingTasksNumber.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runWorker(size_t queueIndex) {
+    currentPool = this;
+    currentQueueIndex = queueIndex;
+
+    while (true) {
+        Task task;
+        if (takeTask(queueIndex, true, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this]() { return stopping || (pendingTasksNumber.load() > 0); });
+        if (stopping && (pendingTasksNumber.load() == 0)) {
+            return;
+        }
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    // Tasks reference the group, so it can't be destroyed before they finish
+    waitForTasks();
+}
+
+/**
+ * Runs pending tasks of the pool while there are any and sleeps otherwise. Sleeping thread is woken when a task
+ * is submitted, because it may be able to run it, and when the last task of the group finishes.
+ */
+void TaskGroup::waitForTasks() {
+    while (unfinishedTasksNumber.load() > 0) {
+        const uint64_t submittedTasksNumber = pool.getSubmittedTasksNumber();
+        if (pool.runPendingTask()) continue;
+
+        pool.sleepUntilSubmit(submittedTasksNumber, [this]() { return unfinishedTasksNumber.load() == 0; });
+    }
+}
+
+void TaskGroup::run(Task task) {
+    unfinishedTasksNumber.fetch_add(1);
+    // Group can be destroyed as soon as the counter becomes 0, so only the pool is used after that
+    ThreadPool* threadPool = &pool;
+    pool.submit([this, threadPool, task]() {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(exceptionMutex);
+            if (exception == nullptr) {
+                exception = std::current_exception();
+            }
+        }
+        if (unfinishedTasksNumber.fetch_sub(1) == 1) {
+            threadPool->notifyWaiters();
+        }
+    });
+}
+
+void TaskGroup::wait() {
+    waitForTasks();
+    std::lock_guard<std::mutex> lock(exceptionMutex);
+    if (exception != nullptr) {
+        std::exception_ptr thrownException = exception;
+        exception = nullptr;
+        std::rethrow_exception(thrownException);
+    }
+}
@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @brief Definition of work-stealing thread pool
+ */
+#ifndef AST_BUILDER_THREAD_POOL_H
+#define AST_BUILDER_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Task = std::function<void()>;
+
+/** Maximum nesting of the tasks that are run by waiting threads with stealing (see ThreadPool::runPendingTask) **/
+static const size_t MAX_NESTED_STEALING_DEPTH = 16;
+
+/**
+ * Thread pool where every worker has it's own queue of tasks. Worker takes tasks from the back of it's own queue
+ * and steals them from the front of the other queues when it's own is empty. Tasks submitted by a worker go to
+ * it's own queue, so forked subtasks are usually executed by the same thread.
+ */
+class ThreadPool {
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue> > queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> pendingTasksNumber;
+    std::atomic<size_t> nextQueue;
+    std::atomic<uint64_t> submittedTasksNumber;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    /** Threads that wait for tasks (see sleepUntilSubmit) sleep separately, so submit wakes only one worker **/
+    std::condition_variable waitersWakeUp;
+    size_t sleepingWaitersNumber = 0;
+    bool stopping = false;
+
+    void runWorker(size_t queueIndex);
+    bool takeTask(size_t queueIndex, bool stealing, Task& task);
+
+public:
+    /**
+     * Starts the workers.
+     * @param threadsNumber number of worker threads. If it's 0, number of hardware threads is used.
+     */
+    explicit ThreadPool(size_t threadsNumber = 0);
+
+    ThreadPool(const ThreadPool& threadPool) = delete;
+    ThreadPool& operator=(const ThreadPool& threadPool) = delete;
+
+    /**
+     * Finishes all submitted tasks and stops the workers.
+     */
+    ~ThreadPool();
+
+    void submit(Task task);
+
+    /**
+     * Runs one of the submitted tasks in the current thread. Is used by threads that wait for tasks to finish.
+     * Stolen task can wait for it's subtasks too, so nested waits steal only up to MAX_NESTED_STEALING_DEPTH
+     * levels and then run only the tasks of the worker's own queue, otherwise the stack could overflow.
+     * @return true, if some task was run, false if there were no tasks.
+     */
+    bool runPendingTask();
+
+    /**
+     * @return number of tasks submitted so far. Waiting thread reads it before runPendingTask, so it doesn't miss
+     * the tasks that are submitted after runPendingTask finds nothing to run.
+     */
+    uint64_t getSubmittedTasksNumber() const {
+        return submittedTasksNumber.load();
+    }
+
+    /**
+     * Sleeps until more than submittedTasksNumber tasks are submitted or until isDone returns true.
+     * isDone is checked when notifyWaiters is called.
+     */
+    void sleepUntilSubmit(uint64_t submittedTasksNumber, const std::function<bool()>& isDone);
+
+    /**
+     * Wakes the threads that sleep in sleepUntilSubmit, so they check their isDone again.
+     */
+    void notifyWaiters();
+
+    size_t getThreadsNumber() const {
+        return threads.size();
+    }
+};
+
+/**
+ * Group of tasks that can be waited for. Waiting thread runs pending tasks of the pool meanwhile,
+ * so tasks can wait for their subtasks without blocking the workers. When there is nothing to run,
+ * it sleeps until a new task is submitted or the last task of the group finishes.
+ */
+class TaskGroup {
+
+private:
+    ThreadPool& pool;
+    std::atomic<size_t> unfinishedTasksNumber;
+    std::mutex exceptionMutex;
+    std::exception_ptr exception = nullptr;
+
+    void waitForTasks();
+
+public:
+    explicit TaskGroup(ThreadPool& pool_) : pool(pool_), unfinishedTasksNumber(0) { }
+
+    TaskGroup(const TaskGroup& taskGroup) = delete;
+    TaskGroup& operator=(const TaskGroup& taskGroup) = delete;
+
+    ~TaskGroup();
+
+    /**
+     * Submits the task to the pool. Forking every subtask of a task is wasteful: the last one is better run by
+     * the forking thread before wait, this saves a submit and a steal and the thread has to wait for it anyway.
+     */
+    void run(Task task);
+
+    /**
+     * Waits for all the tasks of the group.
+     * @throws exception thrown by one of the tasks (the first one).
+     */
+    void wait();
+};
+
+#endif // AST_BUILDER_THREAD_POOL_H
@@ -20,7 +20,7 @@ void ConstantValueToken::print() const {
     printf(" VALUE=%lf", value);
 }
 
-double ConstantValueToken::calculate(size_t argc, ...) const {
+double ConstantValueToken::calculate(size_t argc __attribute__((unused)), ...) const {
     assert(argc == 0);
     return value;
 }
@@ -108,13 +108,24 @@ double PowerOperator::calculate(size_t argc, ...) const {
 }
 
 std::map<char*, std::shared_ptr<VariableToken>, VariableToken::keyCompare> VariableToken::symbolTable;
+std::shared_timed_mutex VariableToken::symbolTableMutex;
 
 std::shared_ptr<VariableToken> VariableToken::getVariableByName(char* name) {
-    if (symbolTable.count(name) == 0) {
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(symbolTableMutex);
+        const auto variable = symbolTable.find(name);
+        if (variable != symbolTable.end()) {
+            return variable->second;
+        }
+    }
+
+    std::lock_guard<std::shared_timed_mutex> lock(symbolTableMutex);
+    auto variable = symbolTable.find(name); // Could be created by another thread meanwhile
+    if (variable == symbolTable.end()) {
         auto token = std::shared_ptr<VariableToken>(new VariableToken(name));
-        symbolTable[token->name] = token;
+        variable = symbolTable.emplace(token->name, token).first;
     }
-    return symbolTable[name];
+    return variable->second;
 }
 
 void VariableToken::print() const {
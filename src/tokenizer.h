@@ -7,9 +7,12 @@
 
 #include <cctype>
 #include <climits>
+#include <cstdlib>
 #include <cstring>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 
 enum TokenType {
@@ -104,6 +107,9 @@ static const char* const OperatorTypeStrings[] = {
     "POWER",
 };
 
+/** Texts of the binary operators with spaces around them, unary operators have none **/
+static const char* const BinaryOperatorTexts[] = { " + ", " - ", " * ", " / ", nullptr, nullptr, " ^ " };
+
 class OperatorToken : public Token {
 
 private:
@@ -235,6 +241,8 @@ private:
     };
 
     static std::map<char*, std::shared_ptr<VariableToken>, keyCompare> symbolTable;
+    /** Variables are looked up much more often than created, e.g. by parallel differentiation **/
+    static std::shared_timed_mutex symbolTableMutex;
     char* name;
 
     explicit VariableToken(const char* name_) : Token(VARIABLE) {
@@ -252,6 +260,11 @@ public:
 
     static constexpr size_t MAX_NAME_LENGTH = 256u;
 
+    /**
+     * Returns the only token of the variable with such name, creates it if it doesn't exist.
+     * Is thread-safe, so expressions can be parsed and differentiated in parallel. Existing variables are found
+     * under a shared lock, so threads don't wait for each other.
+     */
     static std::shared_ptr<VariableToken> getVariableByName(char* name);
 
     void print() const override;
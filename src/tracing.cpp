@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @brief Implementation of scoped trace spans with export into Chrome trace format
+ *
+ * Every thread appends it's spans to it's own buffer, so threads don't contend. Mutex of the buffer is taken only
+ * by the owner and by the export. Buffers are kept after their threads exit, so spans of pool workers aren't lost.
+ */
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+#include "tracing.h"
+
+std::atomic<bool> tracingEnabled(false);
+
+struct TraceEvent {
+    const char* name;
+    /** Start and duration in microseconds **/
+    double start;
+    double duration;
+    size_t depth;
+};
+
+struct ThreadTrace {
+    pid_t threadId;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+static std::mutex threadTracesMutex;
+static std::vector<std::unique_ptr<ThreadTrace> > threadTraces;
+static thread_local ThreadTrace* threadTrace = nullptr;
+static thread_local size_t openSpansNumber = 0;
+
+static std::chrono::steady_clock::time_point getTraceOrigin() {
+    static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    return origin;
+}
+
+static inline double getMicroseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void setTracing(bool enabled) {
+    getTraceOrigin();
+    tracingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void clearTrace() {
+    std::lock_guard<std::mutex> lock(threadTracesMutex);
+    for (const auto& trace : threadTraces) {
+        std::lock_guard<std::mutex> traceLock(trace->mutex);
+        trace->events.clear();
+    }
+}
+
+void TraceSpan::begin() {
+    depth = openSpansNumber++;
+    start = std::chrono::steady_clock::now();
+}
+
+void TraceSpan::end() {
+    const std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+    --openSpansNumber;
+    if (threadTrace == nullptr) {
+        std::unique_ptr<ThreadTrace> trace(new ThreadTrace());
+        trace->threadId = (pid_t)syscall(SYS_gettid);
+        threadTrace = trace.get();
+        std::lock_guard<std::mutex> lock(threadTracesMutex);
+        threadTraces.push_back(std::move(trace));
+    }
+    const TraceEvent event = { name, getMicroseconds(start - getTraceOrigin()), getMicroseconds(finish - start), depth };
+    std::lock_guard<std::mutex> lock(threadTrace->mutex);
+    threadTrace->events.push_back(event);
+}
+
+static void appendJSONString(OutputBuffer& buffer, const char* string) {
+    buffer.append('"');
+    for (const char* symbol = string; *symbol != '\0'; ++symbol) {
+        if ((*symbol == '"') || (*symbol == '\\')) {
+            buffer.append('\\');
+        }
+        buffer.append(*symbol);
+    }
+    buffer.append('"');
+}
+
+void writeChromeTrace(OutputBuffer& buffer) {
+    const pid_t processId = getpid();
+    bool firstEvent = true;
+    buffer.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    std::lock_guard<std::mutex> lock(threadTracesMutex);
+    for (const auto& trace : threadTraces) {
+        std::lock_guard<std::mutex> traceLock(trace->mutex);
+        for (const TraceEvent& event : trace->events) {
+            buffer.append(firstEvent ? "\n{\"name\":" : ",\n{\"name\":");
+            appendJSONString(buffer, event.name);
+            buffer.append(",\"ph\":\"X\",\"pid\":");
+            buffer.appendUnsigned((uint64_t)processId);
+            buffer.append(",\"tid\":");
+            buffer.appendUnsigned((uint64_t)trace->threadId);
+            buffer.append(",\"ts\":");
+            buffer.appendNumber(event.start);
+            buffer.append(",\"dur\":");
+            buffer.appendNumber(event.duration);
+            buffer.append(",\"args\":{\"depth\":");
+            buffer.appendUnsigned(event.depth);
+            buffer.append("}}");
+            firstEvent = false;
+        }
+    }
+    buffer.append("\n]}\n");
+}
+
+void saveChromeTrace(const std::string& fileName) {
+    OutputBuffer buffer;
+    writeChromeTrace(buffer);
+
+    FILE* traceFile = fopen(fileName.c_str(), "w");
+    if (traceFile == nullptr) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+    const bool written = buffer.writeTo(traceFile);
+    const int writeError = errno;
+    if ((fclose(traceFile) != 0) || !written) {
+        throw std::system_error(written ? errno : writeError, std::generic_category(), fileName);
+    }
+}
@@ -0,0 +1,90 @@
+/**
+ * @file
+ * @brief Definition of scoped trace spans with export into Chrome trace format
+ *
+ * Span records the name, start and duration of a scope, id of the thread and nesting depth of the span in it's thread.
+ * Spans are kept in per-thread buffers and are exported as trace_event JSON, which is opened by chrome://tracing
+ * and Perfetto:
+ *
+ *     void parse() {
+ *         TRACE_SCOPE("parse");
+ *         ...
+ *     }
+ *
+ * Tracing is off by default. Then a span costs one relaxed atomic load on construction and one branch on destruction.
+ */
+#ifndef AST_BUILDER_TRACING_H
+#define AST_BUILDER_TRACING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include "output_buffer.h"
+
+#define TRACE_CONCATENATE_IMPL(first, second) first##second
+#define TRACE_CONCATENATE(first, second) TRACE_CONCATENATE_IMPL(first, second)
+
+/**
+ * Traces the rest of the enclosing scope. Name must live until the trace is exported (e.g. a string literal).
+ */
+#define TRACE_SCOPE(name) const TraceSpan TRACE_CONCATENATE(traceSpan, __LINE__)(name)
+
+/** Is read by isTracingEnabled, use setTracing to change it **/
+extern std::atomic<bool> tracingEnabled;
+
+/**
+ * Turns tracing on or off. Recorded spans are kept when tracing is off.
+ */
+void setTracing(bool enabled);
+
+inline bool isTracingEnabled() {
+    return tracingEnabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Removes recorded spans of all the threads. Spans that are open at the moment are recorded when they end.
+ */
+void clearTrace();
+
+/**
+ * Writes recorded spans as Chrome trace_event JSON with complete ("X") events. Timestamps are in microseconds
+ * since the start of the process, nesting depth of every span is written to it's args.
+ */
+void writeChromeTrace(OutputBuffer& buffer);
+
+/**
+ * Writes recorded spans into the file (see writeChromeTrace).
+ * @throws std::system_error if the file can't be written.
+ */
+void saveChromeTrace(const std::string& fileName);
+
+class TraceSpan {
+
+private:
+    /** Name or nullptr if the span isn't recorded **/
+    const char* const name;
+    std::chrono::steady_clock::time_point start;
+    size_t depth = 0;
+
+    void begin();
+    void end();
+
+public:
+    /**
+     * Starts the span if tracing is on.
+     * @param name_ name of the span. If it's nullptr, span isn't recorded.
+     */
+    explicit TraceSpan(const char* name_) : name(((name_ != nullptr) && isTracingEnabled()) ? name_ : nullptr) {
+        if (name != nullptr) begin();
+    }
+
+    TraceSpan(const TraceSpan& span) = delete;
+    TraceSpan& operator=(const TraceSpan& span) = delete;
+
+    ~TraceSpan() {
+        if (name != nullptr) end();
+    }
+};
+
+#endif // AST_BUILDER_TRACING_H
@@ -0,0 +1,301 @@
+/**
+ * @file
+ * @brief Implementation of workload log
+ */
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include "workload_log.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const char WORKLOAD_LOG_MAGIC[4] = { 'A', 'S', 'T', 'W' };
+
+/**
+ * Checks if the request starts with the command (like the server does).
+ */
+static bool isCommand(const char* request, const char* command) {
+    const size_t commandLength = strlen(command);
+    return (strncmp(request, command, commandLength) == 0) &&
+           ((request[commandLength] == ' ') || (request[commandLength] == '\0'));
+}
+
+/**
+ * @return whether the first argument of the request is a handle.
+ */
+static bool hasHandleArgument(const char* request) {
+    return isCommand(request, "OPTIMIZE") || isCommand(request, "DIFF") || isCommand(request, "EVAL") ||
+           isCommand(request, "PRINT") || isCommand(request, "RELEASE");
+}
+
+uint64_t getCreatedHandle(const char* request, const char* response) {
+    assert((request != nullptr) && (response != nullptr));
+    if (!isCommand(request, "PARSE") && !isCommand(request, "OPTIMIZE") && !isCommand(request, "DIFF")) {
+        return 0;
+    }
+    if (strncmp(response, "OK ", 3) != 0) {
+        return 0;
+    }
+    return strtoull(response + 3, nullptr, 10);
+}
+
+static uint64_t getWallClockNanoseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool writeAll(int file, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(file, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+WorkloadRecorder::WorkloadRecorder(const char* fileName_)
+        : fileName(fileName_), sourceId(((uint64_t)getpid() << 32u) ^ getWallClockNanoseconds()) {
+    file = open(fileName_, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (file < 0) {
+        throw std::system_error(errno, std::generic_category(), fileName);
+    }
+
+    // Lock keeps several processes that open an empty log from writing the header twice
+    struct stat fileStat = {};
+    bool written = (flock(file, LOCK_EX) == 0) && (fstat(file, &fileStat) == 0);
+    if (written && (fileStat.st_size == 0)) {
+        WorkloadLogHeader header = {};
+        memcpy(header.magic, WORKLOAD_LOG_MAGIC, sizeof(header.magic));
+        header.version = WORKLOAD_LOG_VERSION;
+        written = writeAll(file, (const char*)&header, sizeof(header));
+    }
+    const int error = errno;
+    flock(file, LOCK_UN);
+    if (!written) {
+        close(file);
+        throw std::system_error(error, std::generic_category(), fileName);
+    }
+}
+
+WorkloadRecorder::~WorkloadRecorder() {
+    close(file);
+}
+
+bool WorkloadRecorder::record(const std::string& request, uint64_t createdHandle, uint64_t duration) {
+    if (request.size() > MAX_RECORDED_REQUEST_LENGTH) {
+        return false;
+    }
+
+    WorkloadRecordHeader header = {};
+    header.timestamp = getWallClockNanoseconds();
+    header.sourceId = sourceId;
+    header.createdHandle = createdHandle;
+    header.duration = duration;
+    header.requestLength = (uint32_t)request.size();
+
+    // Record is written at once, so records of different threads and processes aren't mixed
+    std::string data;
+    data.reserve(sizeof(header) + request.size());
+    data.append((const char*)&header, sizeof(header));
+    data.append(request);
+    std::replace(data.begin() + sizeof(header), data.end(), '\n', ' ');
+    std::replace(data.begin() + sizeof(header), data.end(), '\r', ' ');
+    return writeAll(file, data.data(), data.size());
+}
+
+WorkloadLogReader::WorkloadLogReader(const char* fileName) : file(fileName) {
+    WorkloadLogHeader header = {};
+    if (file.getSize() < sizeof(header)) {
+        throw std::invalid_argument("Workload log is too small");
+    }
+    memcpy(&header, file.begin(), sizeof(header));
+    if (memcmp(header.magic, WORKLOAD_LOG_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::invalid_argument("File isn't a workload log");
+    }
+    if (header.version != WORKLOAD_LOG_VERSION) {
+        throw std::invalid_argument("Unsupported version of workload log");
+    }
+    position = file.begin() + sizeof(header);
+}
+
+bool WorkloadLogReader::next(WorkloadRecord& record) {
+    const size_t remainingSize = file.end() - position;
+    if (remainingSize == 0) {
+        return false;
+    }
+    if (remainingSize < sizeof(WorkloadRecordHeader)) {
+        truncated = true;
+        position = file.end();
+        return false;
+    }
+    memcpy(&record.header, position, sizeof(WorkloadRecordHeader)); // Records aren't aligned
+    if (remainingSize - sizeof(WorkloadRecordHeader) < record.header.requestLength) {
+        truncated = true;
+        position = file.end();
+        return false;
+    }
+    position += sizeof(WorkloadRecordHeader);
+    record.request.assign(position, record.header.requestLength);
+    position += record.header.requestLength;
+    return true;
+}
+
+struct HandleKey {
+    uint64_t sourceId;
+    uint64_t handle;
+
+    bool operator==(const HandleKey& key) const {
+        return (sourceId == key.sourceId) && (handle == key.handle);
+    }
+};
+
+struct HandleKeyHash {
+    size_t operator()(const HandleKey& key) const {
+        return (size_t)(key.sourceId * 0x9E3779B97F4A7C15ull ^ key.handle);
+    }
+};
+
+/**
+ * Replaces the recorded handle of the request with the handle of the replay server.
+ * @return false if the recorded handle isn't known.
+ */
+static bool mapHandle(std::string& request, uint64_t sourceId,
+                      const std::unordered_map<HandleKey, uint64_t, HandleKeyHash>& handles) {
+    const size_t handleStart = request.find_first_not_of(' ', request.find(' '));
+    if (handleStart == std::string::npos) {
+        return true; // Server answers with an error
+    }
+    const size_t handleEnd = std::min(request.find(' ', handleStart), request.size());
+    char* numberEnd = nullptr;
+    const uint64_t handle = strtoull(request.c_str() + handleStart, &numberEnd, 10);
+    if (numberEnd != request.c_str() + handleEnd) {
+        return true; // Invalid handle is replayed as is
+    }
+    const auto mappedHandle = handles.find(HandleKey{sourceId, handle});
+    if (mappedHandle == handles.end()) {
+        return false;
+    }
+    request.replace(handleStart, handleEnd - handleStart, std::to_string(mappedHandle->second));
+    return true;
+}
+
+static CommandStatistics& getCommandStatistics(ReplayStatistics& statistics, const std::string& request) {
+    const std::string command = request.substr(0, request.find(' '));
+    for (CommandStatistics& commandStatistics : statistics.commands) {
+        if (commandStatistics.command == command) {
+            return commandStatistics;
+        }
+    }
+    statistics.commands.emplace_back();
+    statistics.commands.back().command = command;
+    return statistics.commands.back();
+}
+
+ReplayStatistics replayWorkload(WorkloadLogReader& reader, ExpressionClient& client, const ReplayOptions& options) {
+    ReplayStatistics statistics;
+    std::unordered_map<HandleKey, uint64_t, HandleKeyHash> handles;
+    /** Handles of the requests that failed when they were recorded **/
+    std::vector<uint64_t> unrecordedHandles;
+    const std::chrono::nanoseconds interval((options.rate > 0.) ? (int64_t)(1e9 / options.rate) : 0);
+
+    const Clock::time_point start = Clock::now();
+    Clock::time_point scheduledTime = start;
+    WorkloadRecord record;
+    while (reader.next(record)) {
+        std::string request = record.request;
+        const uint64_t sourceId = record.header.sourceId;
+        if (hasHandleArgument(request.c_str()) && !mapHandle(request, sourceId, handles)) {
+            ++statistics.skippedNumber;
+            continue;
+        }
+
+        if (options.rate > 0.) {
+            std::this_thread::sleep_until(scheduledTime);
+        } else {
+            scheduledTime = Clock::now();
+        }
+        const std::string response = client.request(request);
+        const double latency = std::chrono::duration<double, std::nano>(Clock::now() - scheduledTime).count();
+        scheduledTime += interval;
+
+        CommandStatistics& commandStatistics = getCommandStatistics(statistics, request);
+        commandStatistics.latencies.push_back(latency);
+        commandStatistics.recordedDurations.push_back((double)record.header.duration);
+        ++statistics.requestsNumber;
+        if (strncmp(response.c_str(), "ERROR", 5) == 0) {
+            ++commandStatistics.errorsNumber;
+            ++statistics.errorsNumber;
+        }
+
+        const uint64_t createdHandle = getCreatedHandle(request.c_str(), response.c_str());
+        if ((record.header.createdHandle != 0) && (createdHandle != 0)) {
+            handles[HandleKey{sourceId, record.header.createdHandle}] = createdHandle;
+        } else if (createdHandle != 0) {
+            unrecordedHandles.push_back(createdHandle);
+        } else if (isCommand(record.request.c_str(), "RELEASE")) {
+            handles.erase(HandleKey{sourceId, strtoull(record.request.c_str() + strlen("RELEASE"), nullptr, 10)});
+        }
+    }
+    statistics.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (options.releaseHandles) {
+        for (const auto& handle : handles) {
+            unrecordedHandles.push_back(handle.second);
+        }
+        for (uint64_t handle : unrecordedHandles) {
+            client.request("RELEASE " + std::to_string(handle));
+        }
+    }
+    return statistics;
+}
+
+static double getPercentile(const std::vector<double>& sortedValues, double percentile) {
+    const size_t index = (size_t)(percentile / 100. * (double)(sortedValues.size() - 1));
+    return sortedValues[index];
+}
+
+void printReplayStatistics(FILE* file, const ReplayStatistics& statistics) {
+    fprintf(file, "requests:    %zu in %.3lf s (%.0lf req/s), %zu errors, %zu skipped\n", statistics.requestsNumber,
+            statistics.seconds, (double)statistics.requestsNumber / std::max(statistics.seconds, 1e-9),
+            statistics.errorsNumber, statistics.skippedNumber);
+
+    std::vector<double> latencies;
+    for (const CommandStatistics& command : statistics.commands) {
+        latencies.insert(latencies.end(), command.latencies.begin(), command.latencies.end());
+    }
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    fprintf(file, "latency us:  p50 %.1lf, p90 %.1lf, p99 %.1lf, p99.9 %.1lf, max %.1lf\n",
+            getPercentile(latencies, 50) / 1000., getPercentile(latencies, 90) / 1000.,
+            getPercentile(latencies, 99) / 1000., getPercentile(latencies, 99.9) / 1000., latencies.back() / 1000.);
+
+    fprintf(file, "%-10s %10s %8s %12s %12s %16s %16s\n", "command", "requests", "errors", "p50 us", "p99 us",
+            "recorded p50 us", "recorded p99 us");
+    for (const CommandStatistics& command : statistics.commands) {
+        std::vector<double> commandLatencies = command.latencies;
+        std::vector<double> recordedDurations = command.recordedDurations;
+        std::sort(commandLatencies.begin(), commandLatencies.end());
+        std::sort(recordedDurations.begin(), recordedDurations.end());
+        fprintf(file, "%-10s %10zu %8zu %12.1lf %12.1lf %16.1lf %16.1lf\n", command.command.c_str(),
+                commandLatencies.size(), command.errorsNumber, getPercentile(commandLatencies, 50) / 1000.,
+                getPercentile(commandLatencies, 99) / 1000., getPercentile(recordedDurations, 50) / 1000.,
+                getPercentile(recordedDurations, 99) / 1000.);
+    }
+}
@@ -0,0 +1,177 @@
+/**
+ * @file
+ * @brief Definition of workload log: capture and replay of requests
+ *
+ * Workload log records what is actually sent to the CLI and to the expression server, so regressions can be
+ * reproduced and engine changes can be evaluated on real traffic. Every request is recorded as a line
+ * of the server protocol (see ExpressionServer) with the time of handling it, so the CLI run "ast-builder <e>
+ * --optimized" is recorded as "PARSE <e>", "OPTIMIZE 1", "DIFF 2 x" and "OPTIMIZE 3" with parse, optimize,
+ * differentiate and optimize timings.
+ *
+ * Log is a binary file that is only appended to: header followed by records, every record is written with one
+ * write call, so processes and threads can record into the same log. Record that is cut by a crash ends the log.
+ * Handles are local to the recording process, so replay maps recorded handles to the handles of the replay server.
+ */
+#ifndef AST_BUILDER_WORKLOAD_LOG_H
+#define AST_BUILDER_WORKLOAD_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "expression_client.h"
+#include "mapped_file.h"
+
+static const uint32_t WORKLOAD_LOG_VERSION = 1;
+/** Longer requests aren't recorded (same as the request length limit of the server) **/
+static const size_t MAX_RECORDED_REQUEST_LENGTH = 64 * 1024 * 1024;
+
+struct WorkloadLogHeader {
+    char magic[4];
+    uint32_t version;
+};
+
+struct WorkloadRecordHeader {
+    /** Wall clock time of the request in nanoseconds since the epoch **/
+    uint64_t timestamp;
+    /** Id of the recording process or server, handles are local to it **/
+    uint64_t sourceId;
+    /** Handle created by the request (PARSE, OPTIMIZE, DIFF) or 0 **/
+    uint64_t createdHandle;
+    /** Time of handling the request in nanoseconds **/
+    uint64_t duration;
+    uint32_t requestLength;
+    uint32_t reserved;
+};
+
+struct WorkloadRecord {
+    WorkloadRecordHeader header;
+    /** Request line of the server protocol without line break **/
+    std::string request;
+};
+
+/**
+ * Finds the handle created by the request.
+ * @param request   request line
+ * @param response  response line
+ * @return handle from "OK <handle>" response to PARSE, OPTIMIZE or DIFF request, 0 for other requests and errors.
+ */
+uint64_t getCreatedHandle(const char* request, const char* response);
+
+/**
+ * Appends records to the workload log. Can be used from several threads.
+ */
+class WorkloadRecorder {
+
+private:
+    int file = -1;
+    const std::string fileName;
+    const uint64_t sourceId;
+
+public:
+    /**
+     * Opens the log for appending, header is written if the log is empty.
+     * @param fileName_ name of the log file
+     * @throws std::system_error if the file can't be opened or written.
+     */
+    explicit WorkloadRecorder(const char* fileName_);
+
+    WorkloadRecorder(const WorkloadRecorder& recorder) = delete;
+    WorkloadRecorder& operator=(const WorkloadRecorder& recorder) = delete;
+
+    ~WorkloadRecorder();
+
+    /**
+     * Appends the request. Line breaks of the request are replaced with spaces, too long requests aren't recorded.
+     * @param request       request line of the server protocol
+     * @param createdHandle handle created by the request or 0
+     * @param duration      time of handling the request in nanoseconds
+     * @return false if the record can't be written.
+     */
+    bool record(const std::string& request, uint64_t createdHandle, uint64_t duration);
+
+    uint64_t getSourceId() const {
+        return sourceId;
+    }
+};
+
+/**
+ * Reads records of the workload log one by one. Log is memory-mapped, so it isn't loaded at once.
+ */
+class WorkloadLogReader {
+
+private:
+    MappedFile file;
+    const char* position;
+    bool truncated = false;
+
+public:
+    /**
+     * Opens the log and checks it's header.
+     * @param fileName name of the log file
+     * @throws std::system_error if the file can't be opened.
+     * @throws std::invalid_argument if the file isn't a workload log of supported version.
+     */
+    explicit WorkloadLogReader(const char* fileName);
+
+    /**
+     * Reads the next record.
+     * @param record record to read to
+     * @return false if there are no more records.
+     */
+    bool next(WorkloadRecord& record);
+
+    /**
+     * @return whether the last record is cut (e.g. recording process crashed while writing it).
+     */
+    bool isTruncated() const {
+        return truncated;
+    }
+};
+
+struct ReplayOptions {
+    /** Requests per second, 0 sends every request as soon as the previous one is answered **/
+    double rate = 0.;
+    /** Handles that are left at the end are released, so the server doesn't keep them **/
+    bool releaseHandles = true;
+};
+
+struct CommandStatistics {
+    std::string command;
+    size_t errorsNumber = 0;
+    /** Latencies of the replayed requests in nanoseconds **/
+    std::vector<double> latencies;
+    /** Recorded times of handling the requests in nanoseconds **/
+    std::vector<double> recordedDurations;
+};
+
+struct ReplayStatistics {
+    size_t requestsNumber = 0;
+    size_t errorsNumber = 0;
+    /** Requests referring to handles that weren't created in the log or whose creation failed in replay **/
+    size_t skippedNumber = 0;
+    double seconds = 0.;
+    /** Statistics of every command in order of first appearance **/
+    std::vector<CommandStatistics> commands;
+};
+
+/**
+ * Sends requests of the log to the server and waits for every response. With a rate, request is scheduled
+ * at a fixed interval after the previous one and it's latency is measured from the scheduled time, so delays
+ * of a slow server aren't hidden.
+ * @param reader    reader of the log
+ * @param client    connection to the server
+ * @param options   rate of the requests
+ * @return throughput and latencies of the requests.
+ * @throws std::system_error if the connection fails.
+ */
+ReplayStatistics replayWorkload(WorkloadLogReader& reader, ExpressionClient& client,
+                                const ReplayOptions& options = ReplayOptions());
+
+/**
+ * Prints throughput, latency percentiles of all requests and of every command, compared with the recorded times.
+ */
+void printReplayStatistics(FILE* file, const ReplayStatistics& statistics);
+
+#endif // AST_BUILDER_WORKLOAD_LOG_H
@@ -0,0 +1,88 @@
+/**
+ * @file
+ * @brief Tests for heap allocation tracker
+ */
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "testlib.h"
+#include "../src/allocation_tracker.h"
+#include "../src/iterative_parser.h"
+
+TEST(AllocationTracker, disabledByDefault) {
+    ASSERT_TRUE(!isAllocationTrackingEnabled());
+    resetAllocationStatistics();
+    std::vector<char> buffer(1000);
+    ASSERT_EQUALS(getTotalAllocationStatistics().allocationsNumber, 0u);
+}
+
+TEST(AllocationTracker, stages) {
+    resetAllocationStatistics();
+    setAllocationTracking(true);
+    std::shared_ptr<ASTNode> root;
+    {
+        AllocationScope scope(PARSE_STAGE);
+        root = buildASTIteratively("sin(x) * (2 + ln(y))");
+        {
+            AllocationScope innerScope(RENDER_STAGE);
+            std::vector<char> buffer(100);
+        }
+    }
+    const size_t otherAllocationsNumber = getAllocationStatistics(OTHER_STAGE).allocationsNumber;
+    root.reset();
+    setAllocationTracking(false);
+
+    const AllocationStatistics parse = getAllocationStatistics(PARSE_STAGE);
+    ASSERT_TRUE(parse.allocationsNumber >= 7u); // At least every node
+    ASSERT_TRUE(parse.allocatedBytes >= parse.peakLiveBytes);
+    ASSERT_TRUE(parse.peakLiveBytes > 0u);
+    const AllocationStatistics render = getAllocationStatistics(RENDER_STAGE);
+    ASSERT_EQUALS(render.allocationsNumber, 1u);
+    ASSERT_EQUALS(render.deallocationsNumber, 1u);
+    ASSERT_TRUE(render.allocatedBytes >= 100u);
+    ASSERT_EQUALS(otherAllocationsNumber, 0u);
+    ASSERT_TRUE(getAllocationStatistics(OTHER_STAGE).deallocationsNumber >= 7u); // AST is freed outside of scopes
+
+    const AllocationStatistics total = getTotalAllocationStatistics();
+    ASSERT_EQUALS(total.allocationsNumber, parse.allocationsNumber + render.allocationsNumber +
+                                           getAllocationStatistics(OTHER_STAGE).allocationsNumber);
+}
+
+TEST(AllocationTracker, peakLiveBytes) {
+    resetAllocationStatistics();
+    setAllocationTracking(true);
+    {
+        AllocationScope scope(DIFFERENTIATE_STAGE);
+        for (int i = 0; i < 4; ++i) {
+            std::vector<char> buffer(1u << 20);
+        }
+        void* volatile memory = calloc(1000, 100); // Volatile, so the unused allocation isn't optimized out
+        free(memory);
+    }
+    setAllocationTracking(false);
+
+    const AllocationStatistics statistics = getAllocationStatistics(DIFFERENTIATE_STAGE);
+    ASSERT_EQUALS(statistics.allocationsNumber, 5u);
+    ASSERT_EQUALS(statistics.deallocationsNumber, 5u);
+    ASSERT_TRUE(statistics.allocatedBytes >= 4 * (1u << 20) + 100000u);
+    // Buffers don't live at the same time
+    ASSERT_TRUE(statistics.peakLiveBytes >= (1u << 20));
+    ASSERT_TRUE(statistics.peakLiveBytes < 2 * (1u << 20));
+}
+
+TEST(AllocationTracker, stagesArePerThread) {
+    resetAllocationStatistics();
+    setAllocationTracking(true);
+    {
+        AllocationScope scope(OPTIMIZE_STAGE);
+        std::thread thread([]() {
+            std::vector<char> buffer(100);
+        });
+        thread.join();
+    }
+    setAllocationTracking(false);
+
+    ASSERT_EQUALS(getAllocationStatistics(OPTIMIZE_STAGE).allocationsNumber, getTotalAllocationStatistics().allocationsNumber -
+                                                                             getAllocationStatistics(OTHER_STAGE).allocationsNumber);
+    ASSERT_TRUE(getAllocationStatistics(OTHER_STAGE).allocationsNumber >= 1u); // Buffer of the thread
+}
@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @brief Tests for size metrics of AST
+ */
+#include <cstdint>
+#include <string>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/ast_metrics.h"
+#include "../src/iterative_parser.h"
+
+TEST(ASTMetrics, tree) {
+    const auto root = buildASTIteratively("sin(x) * (2 + ln(y)) - x^2 - -3");
+    const ASTMetrics metrics = computeASTMetrics(root);
+    ASSERT_EQUALS(metrics.nodesNumber, 14u);
+    ASSERT_EQUALS(metrics.uniqueNodesNumber, 14u);
+    ASSERT_DOUBLE_EQUALS(metrics.getSharingRatio(), 1.0);
+    ASSERT_EQUALS(metrics.depth, 6u); // - - * + ln y
+    ASSERT_EQUALS(metrics.constantsNumber, 3u);
+    ASSERT_EQUALS(metrics.variablesNumber, 2u);
+    ASSERT_EQUALS(metrics.operatorsNumbers[SUBTRACTION], 2u);
+    ASSERT_EQUALS(metrics.operatorsNumbers[MULTIPLICATION], 1u);
+    ASSERT_EQUALS(metrics.operatorsNumbers[ADDITION], 1u);
+    ASSERT_EQUALS(metrics.operatorsNumbers[POWER], 1u);
+    ASSERT_EQUALS(metrics.operatorsNumbers[ARITHMETIC_NEGATION], 1u);
+    ASSERT_EQUALS(metrics.operatorsNumbers[DIVISION], 0u);
+    ASSERT_EQUALS(metrics.functionsNumbers[SIN], 1u);
+    ASSERT_EQUALS(metrics.functionsNumbers[LN], 1u);
+    ASSERT_EQUALS(metrics.functionsNumbers[COS], 0u);
+    ASSERT_TRUE(metrics.estimatedBytes >= 14 * sizeof(ASTNode));
+}
+
+TEST(ASTMetrics, singleNode) {
+    const ASTMetrics metrics = computeASTMetrics(buildASTIteratively("42"));
+    ASSERT_EQUALS(metrics.nodesNumber, 1u);
+    ASSERT_EQUALS(metrics.depth, 1u);
+    ASSERT_EQUALS(metrics.constantsNumber, 1u);
+    ASSERT_EQUALS(metrics.variablesNumber, 0u);
+}
+
+TEST(ASTMetrics, sharedNodes) {
+    // (x + 1) * (x + 1) with the sum stored once
+    const auto sum = buildASTIteratively("x + 1");
+    const auto root = std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), sum, sum);
+    const ASTMetrics metrics = computeASTMetrics(root);
+    ASSERT_EQUALS(metrics.nodesNumber, 7u);
+    ASSERT_EQUALS(metrics.uniqueNodesNumber, 4u);
+    ASSERT_DOUBLE_EQUALS(metrics.getSharingRatio(), 7.0 / 4.0);
+    ASSERT_EQUALS(metrics.depth, 3u);
+    ASSERT_EQUALS(metrics.operatorsNumbers[ADDITION], 1u);
+    ASSERT_TRUE(metrics.estimatedBytes < computeASTMetrics(buildASTIteratively("(x + 1) * (x + 1)")).estimatedBytes);
+}
+
+TEST(ASTMetrics, exponentialSharing) {
+    auto root = buildASTIteratively("x");
+    for (int i = 0; i < 100; ++i) {
+        root = std::make_shared<ASTNode>(std::make_shared<AdditionOperator>(), root, root);
+    }
+    const ASTMetrics metrics = computeASTMetrics(root);
+    ASSERT_EQUALS(metrics.nodesNumber, SIZE_MAX); // 2^101 - 1 nodes
+    ASSERT_EQUALS(metrics.uniqueNodesNumber, 101u);
+    ASSERT_EQUALS(metrics.depth, 101u);
+    ASSERT_EQUALS(metrics.operatorsNumbers[ADDITION], 100u);
+}
+
+TEST(ASTMetrics, deepTree) {
+    std::string expression = "x";
+    for (int i = 0; i < 100000; ++i) {
+        expression += "+x";
+    }
+    const ASTMetrics metrics = computeASTMetrics(buildASTIteratively(expression.c_str(), 100000));
+    ASSERT_EQUALS(metrics.nodesNumber, 200001u);
+    ASSERT_EQUALS(metrics.depth, 100001u);
+    ASSERT_EQUALS(metrics.variablesNumber, 1u);
+}
+
+TEST(ASTMetrics, derivativeGrows) {
+    const auto root = buildASTIteratively("sin(x) * cos(x) * ln(x)");
+    const ASTMetrics expressionMetrics = computeASTMetrics(root);
+    const ASTMetrics derivativeMetrics = computeASTMetrics(differentiate(root, "x"));
+    ASSERT_TRUE(derivativeMetrics.nodesNumber > expressionMetrics.nodesNumber);
+    ASSERT_TRUE(derivativeMetrics.estimatedBytes > expressionMetrics.estimatedBytes);
+    ASSERT_EQUALS(derivativeMetrics.variablesNumber, 1u);
+}
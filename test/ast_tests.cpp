@@ -0,0 +1,151 @@
+/**
+ * @file
+ * @brief Tests for structural hash, equality, infix and DOT printing of AST nodes
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <unordered_set>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/ast-optimizers.h"
+#include "../src/iterative_parser.h"
+
+TEST(ASTNode, structuralHash) {
+    const auto first = buildASTIteratively("sin(x) * (y + 2)");
+    const auto second = buildASTIteratively("(sin(x)) * ((y) + 2)");
+    const auto swapped = buildASTIteratively("(y + 2) * sin(x)");
+    const auto otherConstant = buildASTIteratively("sin(x) * (y + 2.5)");
+
+    ASSERT_EQUALS(first->getHash(), second->getHash());
+    ASSERT_TRUE(first->structurallyEquals(*second));
+    ASSERT_TRUE(first->getHash() != swapped->getHash());
+    ASSERT_TRUE(!first->structurallyEquals(*swapped));
+    ASSERT_TRUE(!first->structurallyEquals(*otherConstant));
+    ASSERT_TRUE(first->structurallyEquals(*copyAST(first)));
+}
+
+TEST(ASTNode, hashIsResetByOptimizers) {
+    auto root = buildASTIteratively("x * (y + 0)");
+    const auto optimized = buildASTIteratively("x * y");
+    const uint64_t hash = root->getHash();
+
+    const TrivialOperationsOptimizer optimizer;
+    root = optimizer.optimize(root);
+
+    ASSERT_TRUE(root->getHash() != hash);
+    ASSERT_EQUALS(root->getHash(), optimized->getHash());
+    ASSERT_TRUE(root->structurallyEquals(*optimized));
+}
+
+TEST(ASTNode, hashSetOfExpressions) {
+    std::unordered_set<std::shared_ptr<ASTNode>, ASTNodeHash, ASTNodeEqual> expressions;
+    for (const char* expression : { "x + 1", "(x) + 1", "x + 1.0", "1 + x", "x + 1 + 0", "ln(x) / x", "ln((x)) / x" }) {
+        expressions.insert(buildASTIteratively(expression));
+    }
+    ASSERT_EQUALS(expressions.size(), 4u);
+    ASSERT_TRUE(expressions.count(differentiate(buildASTIteratively("x ^ 2 / 2"), "y")) == 0);
+}
+
+TEST(ASTNode, deepTreeHash) {
+    std::string expression;
+    for (int i = 0; i < 100000; ++i) {
+        expression += "x + ";
+    }
+    expression += "1";
+    const auto first = buildASTIteratively(expression.c_str(), 100000);
+    const auto second = buildASTIteratively(expression.c_str(), 100000);
+    ASSERT_TRUE(first->structurallyEquals(*second));
+}
+
+TEST(ASTNode, infixMinimalParentheses) {
+    ASSERT_EQUALS(buildASTIteratively("((x + y)) + (z)")->toInfix(), "x + y + z");
+    ASSERT_EQUALS(buildASTIteratively("x + (y + z)")->toInfix(), "x + (y + z)");
+    ASSERT_EQUALS(buildASTIteratively("x - (y - z) * 2")->toInfix(), "x - (y - z) * 2");
+    ASSERT_EQUALS(buildASTIteratively("x / (y * z)")->toInfix(), "x / (y * z)");
+    ASSERT_EQUALS(buildASTIteratively("x ^ (y ^ z)")->toInfix(), "x ^ y ^ z");
+    ASSERT_EQUALS(buildASTIteratively("(x ^ y) ^ z")->toInfix(), "(x ^ y) ^ z");
+    ASSERT_EQUALS(buildASTIteratively("-(x ^ 2) + (-x) ^ 2")->toInfix(), "-(x ^ 2) + -x ^ 2");
+    ASSERT_EQUALS(buildASTIteratively("sin((x + 1)) * -(+y)")->toInfix(), "sin(x + 1) * -+y");
+    ASSERT_EQUALS(buildASTIteratively("0.1 + 1e20 + 2.50")->toInfix(), "0.1 + 1e+20 + 2.5");
+}
+
+TEST(ASTNode, infixRoundTrip) {
+    const char* const expressions[] = {
+        "x - (y - (z - 1)) / (2 / (x * y))",
+        "-(-x) ^ -(y ^ 2) ^ z",
+        "ln(x / (y - z)) ^ (1 / 3) - ctg(tg(-x))",
+        "x * 0.30000000000000004 - 1e-300",
+    };
+    for (const char* expression : expressions) {
+        const auto root = buildASTIteratively(expression);
+        ASSERT_TRUE(buildASTIteratively(root->toInfix().c_str())->structurallyEquals(*root));
+    }
+
+    // Derivatives contain derivatives of other variables, e.g. y'
+    const auto derivative = differentiate(buildASTIteratively("x * y / sin(x + y)"), "x");
+    ASSERT_TRUE(buildASTIteratively(derivative->toInfix().c_str())->structurallyEquals(*derivative));
+}
+
+TEST(ASTNode, infixDeepTree) {
+    std::string expression;
+    for (int i = 0; i < 5000; ++i) {
+        expression += "-(x + ";
+    }
+    expression += "1";
+    expression.append(5000, ')');
+    ASSERT_EQUALS(buildASTIteratively(expression.c_str(), 10000)->toInfix(), expression);
+}
+
+static std::string printDot(const std::shared_ptr<ASTNode>& root) {
+    char* data = nullptr;
+    size_t size = 0;
+    FILE* file = open_memstream(&data, &size);
+    root->dotPrint(file);
+    fclose(file);
+    std::string dot(data, size);
+    free(data);
+    return dot;
+}
+
+TEST(ASTNode, dotPrint) {
+    ASSERT_EQUALS(printDot(buildASTIteratively("sin(x) - 2.5")),
+                  "digraph AST {\n"
+                  "0 [label=\"binary op\\nop: -\", shape=box, style=filled, color=\"grey\", fillcolor=\"#C9E7FF\"];\n"
+                  "0->1\n0->2\n"
+                  "1 [label=\"unary func\\nfunc: sin\", shape=box, style=filled, color=\"grey\", fillcolor=\"#C9E7FF\"];\n"
+                  "1->3\n"
+                  "3 [label=\"var\\nname: x\", shape=box, style=filled, color=\"grey\", fillcolor=\"#99FF9D\"];\n"
+                  "2 [label=\"const\\nvalue: 2.5\", shape=box, style=filled, color=\"grey\", fillcolor=\"#FFFEC9\"];\n"
+                  "}\n");
+}
+
+TEST(ASTNode, dotPrintSharedNodesOnce) {
+    const auto shared = buildASTIteratively("x + 1");
+    const auto root = std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), shared, shared);
+    const std::string dot = printDot(root);
+
+    ASSERT_EQUALS(std::count(dot.begin(), dot.end(), '['), 4); // '*', '+', 'x' and '1'
+    ASSERT_TRUE(dot.find("0->1\n0->1\n") != std::string::npos);
+}
+
+TEST(ASTNode, visualizeDeepTree) {
+    auto root = buildASTIteratively("x");
+    for (int i = 0; i < 200000; ++i) {
+        root = std::make_shared<ASTNode>(std::make_shared<ArithmeticNegationOperator>(), root);
+    }
+    const std::string fileName = "/tmp/ast-builder-test-" + std::to_string(getpid());
+    root->visualize(fileName);
+
+    FILE* file = fopen((fileName + ".dot").c_str(), "r");
+    ASSERT_NOT_NULL(file);
+    size_t linesNumber = 0;
+    for (int symbol = fgetc(file); symbol != EOF; symbol = fgetc(file)) {
+        if (symbol == '\n') ++linesNumber;
+    }
+    fclose(file);
+    unlink((fileName + ".dot").c_str());
+    ASSERT_EQUALS(linesNumber, 400003u); // Header, nodes, edges and closing brace
+}
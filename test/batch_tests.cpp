@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @brief Tests for thread pool, compiled expressions and batch mode
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "testlib.h"
+#include "../src/batch.h"
+#include "../src/compiled_expression.h"
+#include "../src/iterative_parser.h"
+#include "../src/thread_pool.h"
+
+/**
+ * Runs the batch on the input and returns it's output.
+ */
+static std::string runBatchOn(const char* input, const BatchOptions& options) {
+    FILE* inputFile = fmemopen((void*)input, strlen(input), "r");
+    char* outputBuffer = nullptr;
+    size_t outputSize = 0;
+    FILE* outputFile = open_memstream(&outputBuffer, &outputSize);
+    runBatch(inputFile, outputFile, options);
+    fclose(inputFile);
+    fclose(outputFile);
+    std::string output(outputBuffer, outputSize);
+    free(outputBuffer);
+    return output;
+}
+
+TEST(ThreadPool, nestedTaskGroups) {
+    ThreadPool pool(4);
+    std::atomic<size_t> finishedTasksNumber(0);
+
+    TaskGroup tasks(pool);
+    for (size_t i = 0; i < 16; ++i) {
+        tasks.run([&]() {
+            TaskGroup subtasks(pool);
+            for (size_t j = 0; j < 16; ++j) {
+                subtasks.run([&]() { finishedTasksNumber.fetch_add(1); });
+            }
+            subtasks.wait();
+        });
+    }
+    tasks.wait();
+
+    ASSERT_EQUALS(finishedTasksNumber.load(), 256u);
+}
+
+TEST(ThreadPool, exceptionIsRethrownByWait) {
+    ThreadPool pool(2);
+    TaskGroup tasks(pool);
+    tasks.run([]() { throw std::logic_error("Task failed"); });
+
+    bool thrown = false;
+    try {
+        tasks.wait();
+    } catch (const std::logic_error& ex) {
+        thrown = (strcmp(ex.what(), "Task failed") == 0);
+    }
+    ASSERT_TRUE(thrown);
+}
+
+TEST(CompiledExpression, sameValueAsAST) {
+    std::shared_ptr<ASTNode> root = buildASTIteratively("-2 ^ 2 * sin(3) + 10 / (4 - +1) - ln(5)");
+    CompiledExpression expression(root);
+
+    ASSERT_EQUALS(expression.getVariables().size(), 0u);
+    ASSERT_DOUBLE_EQUALS(expression.evaluate(nullptr), root->calculate());
+}
+
+TEST(CompiledExpression, variables) {
+    CompiledExpression expression(buildASTIteratively("x * y - x / 2"));
+    const double values[] = {4, 3};
+
+    ASSERT_EQUALS(expression.getVariables().size(), 2u);
+    ASSERT_EQUALS(expression.getVariableIndex("x"), 0u);
+    ASSERT_EQUALS(expression.getVariableIndex("y"), 1u);
+    ASSERT_EQUALS(expression.getVariableIndex("z"), SIZE_MAX);
+    ASSERT_DOUBLE_EQUALS(expression.evaluate(values), 10);
+}
+
+TEST(runBatch, resultsInInputOrder) {
+    std::string input;
+    for (int i = 0; i < 10000; ++i) {
+        input += "x * " + std::to_string(i) + "\n";
+    }
+    BatchOptions options;
+    options.threadsNumber = 4;
+    options.variableValues = parseVariableValues("x=2");
+
+    std::string output = runBatchOn(input.c_str(), options);
+
+    size_t lineStart = 0;
+    for (int i = 0; i < 10000; ++i) {
+        size_t lineEnd = output.find('\n', lineStart);
+        std::string expected = "{\"line\":" + std::to_string(i + 1) + ",\"nodes\":3,\"value\":" + std::to_string(2 * i);
+        ASSERT_EQUALS(output.compare(lineStart, expected.size(), expected), 0);
+        lineStart = lineEnd + 1;
+    }
+    ASSERT_EQUALS(lineStart, output.size());
+}
+
+TEST(runBatch, errorsAndUnknownValues) {
+    BatchOptions options;
+    options.optimized = true;
+
+    std::string output = runBatchOn("2 * x\n1 + $\n\nx ^ x\n", options);
+
+    ASSERT_EQUALS(output,
+                  "{\"line\":1,\"nodes\":3,\"value\":null,\"derivative\":\"2\",\"derivative_nodes\":1,\"derivative_value\":2}\n"
+                  "{\"line\":2,\"error\":{\"code\":\"INVALID_SYMBOL\",\"position\":4,\"message\":\"Invalid symbol\"}}\n"
+                  "{\"line\":3,\"error\":{\"code\":\"INVALID_SYMBOL\",\"position\":0,\"message\":\"Invalid symbol\"}}\n"
+                  "{\"line\":4,\"error\":{\"code\":\"UNSUPPORTED_OPERATION\",\"message\":\"Derivative of f(x)^g(x) is not supported yet\"}}\n");
+}
+
+TEST(runBatch, tooDeepLineBetweenValidLines) {
+    const std::string negations = std::string(100000, '-') + "x";
+    std::string powers;
+    for (int i = 0; i < 100000; ++i) {
+        powers += "2^";
+    }
+    powers += "x";
+    BatchOptions options;
+    options.threadsNumber = 2;
+    options.variableValues = parseVariableValues("x=3");
+
+    std::string output = runBatchOn(("x + 1\n" + negations + "\n" + powers + "\nx * 2\n").c_str(), options);
+
+    const size_t negationPosition = 100000 - DEFAULT_MAX_NESTING_DEPTH - 1;
+    const size_t powerPosition = 2 * negationPosition + 1;
+    ASSERT_EQUALS(output,
+                  "{\"line\":1,\"nodes\":3,\"value\":4,\"derivative\":\"1 + 0\",\"derivative_nodes\":3,\"derivative_value\":1}\n"
+                  "{\"line\":2,\"error\":{\"code\":\"MAX_NESTING_DEPTH_EXCEEDED\",\"position\":" + std::to_string(negationPosition) +
+                  ",\"message\":\"Maximum nesting depth exceeded\"}}\n"
+                  "{\"line\":3,\"error\":{\"code\":\"MAX_NESTING_DEPTH_EXCEEDED\",\"position\":" + std::to_string(powerPosition) +
+                  ",\"message\":\"Maximum nesting depth exceeded\"}}\n"
+                  "{\"line\":4,\"nodes\":3,\"value\":6,\"derivative\":\"1 * 2 + x * 0\",\"derivative_nodes\":7,\"derivative_value\":2}\n");
+}
+
+TEST(runBatch, infinitiesAndNaN) {
+    BatchOptions options;
+
+    std::string output = runBatchOn("1 / 0\n-1 / 0\n0 / 0\n", options);
+
+    ASSERT_TRUE(output.find("{\"line\":1,\"nodes\":3,\"value\":1e999,") == 0);
+    ASSERT_TRUE(output.find("\n{\"line\":2,\"nodes\":4,\"value\":-1e999,") != std::string::npos);
+    ASSERT_TRUE(output.find("\n{\"line\":3,\"nodes\":3,\"value\":null,") != std::string::npos);
+}
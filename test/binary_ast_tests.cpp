@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Tests for compact binary format of AST
+ */
+#include <string>
+#include <unistd.h>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/binary_ast.h"
+#include "../src/compiled_expression.h"
+#include "../src/iterative_parser.h"
+
+TEST(BinaryAST, roundTrip) {
+    const std::shared_ptr<ASTNode> root = buildASTIteratively("-x ^ 2 + sin(y) / (x - 3 * y) * ln(2.5)");
+    const std::string data = serializeAST(root);
+    const ASTView view(data.data(), data.size());
+
+    CompiledExpression expression(root);
+    const double values[] = { 1.5, 0.25 }; // Variables of the compiled expression are in order of first appearance
+    const double expected = expression.evaluate(values);
+    ASSERT_DOUBLE_EQUALS(view.evaluate({ { "x", 1.5 }, { "y", 0.25 } }), expected);
+    ASSERT_DOUBLE_EQUALS(CompiledExpression(view.toAST()).evaluate(values), expected);
+    ASSERT_TRUE(serializeAST(view.toAST()) == data);
+}
+
+TEST(BinaryAST, sharedNodesStoredOnce) {
+    // Derivative of the quotient refers to the numerator and the denominator several times
+    const std::shared_ptr<ASTNode> derivative = differentiate(buildASTIteratively("sin(x) / (x * x + 1)"), "x");
+    const std::string data = serializeAST(derivative);
+    const ASTView view(data.data(), data.size());
+
+    size_t treeSize = 0;
+    std::vector<const ASTNode*> stack = { derivative.get() };
+    while (!stack.empty()) {
+        const ASTNode* node = stack.back();
+        stack.pop_back();
+        ++treeSize;
+        for (size_t i = 0; i < node->getChildrenNumber(); ++i) {
+            stack.push_back(node->getChildren()[i].get());
+        }
+    }
+    ASSERT_TRUE(view.getNodesNumber() < treeSize);
+
+    const double value = CompiledExpression(derivative).evaluate(std::vector<double>{ 0.75 }.data());
+    ASSERT_DOUBLE_EQUALS(view.evaluate({ { "x", 0.75 } }), value);
+}
+
+TEST(BinaryAST, invalidData) {
+    const std::string data = serializeAST(buildASTIteratively("x + 1"));
+    auto isRejected = [](const std::string& bytes) {
+        try {
+            ASTView(bytes.data(), bytes.size());
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+
+    std::string badMagic = data;
+    badMagic[0] = 'X';
+    ASSERT_TRUE(isRejected(badMagic));
+
+    ASSERT_TRUE(isRejected(data.substr(0, data.size() - 1)));
+
+    // Root refers to itself
+    std::string cycle = data;
+    BinaryASTNode* nodes = (BinaryASTNode*)&cycle[sizeof(BinaryASTHeader)];
+    nodes[2].children[1] = 2;
+    ASSERT_TRUE(isRejected(cycle));
+
+    // Variable name must be shorter than names of the tokens
+    auto withVariableName = [&data](const std::string& name) {
+        std::string bytes = data + name + '\0';
+        BinaryASTHeader* header = (BinaryASTHeader*)&bytes[0];
+        BinaryASTNode* nodes = (BinaryASTNode*)&bytes[sizeof(BinaryASTHeader)];
+        for (uint32_t i = 0; i < header->nodesNumber; ++i) {
+            if (nodes[i].kind == VARIABLE) {
+                nodes[i].nameOffset = (uint32_t)header->stringsSize;
+            }
+        }
+        header->stringsSize += name.size() + 1;
+        return bytes;
+    };
+    ASSERT_TRUE(!isRejected(withVariableName(std::string(VariableToken::MAX_NAME_LENGTH - 1, 'y'))));
+    ASSERT_TRUE(isRejected(withVariableName(std::string(VariableToken::MAX_NAME_LENGTH, 'y'))));
+
+    bool thrown = false;
+    try {
+        ASTView(data.data(), data.size()).evaluate();
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
+
+TEST(BinaryAST, mappedFile) {
+    const std::string fileName = "/tmp/ast-builder-test-" + std::to_string(getpid()) + ".astb";
+    saveAST(buildASTIteratively("x * y - y"), fileName.c_str());
+    {
+        MappedAST file(fileName.c_str());
+        ASSERT_DOUBLE_EQUALS(file.getView().evaluate({ { "y", 3. }, { "x", 2. } }), 3.);
+        ASSERT_EQUALS(file.getView().getNodesNumber(), 5); // Both 'y' nodes are stored, only shared objects are merged
+    }
+    unlink(fileName.c_str());
+}
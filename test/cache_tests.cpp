@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @brief Tests for expression cache
+ */
+#include <atomic>
+#include <cmath>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "testlib.h"
+#include "../src/expression_cache.h"
+
+static void removeDirectory(const std::string& directory) {
+    DIR* directoryStream = opendir(directory.c_str());
+    if (directoryStream == nullptr) return;
+    while (dirent* entry = readdir(directoryStream)) {
+        if (entry->d_name[0] != '.') unlink((directory + "/" + entry->d_name).c_str());
+    }
+    closedir(directoryStream);
+    rmdir(directory.c_str());
+}
+
+TEST(ExpressionCache, normalizeExpression) {
+    ASSERT_EQUALS(normalizeExpression(" x *  ( y+1 )\t"), "x*(y+1)");
+    ASSERT_EQUALS(normalizeExpression("sin ( 2 x )"), "sin(2 x)");
+    ASSERT_EQUALS(normalizeExpression("1 2"), "1 2");
+    ASSERT_EQUALS(normalizeExpression("y '+1"), "y '+1");
+}
+
+TEST(ExpressionCache, spaceBeforeApostrophe) {
+    ExpressionCache cache(16);
+    ParseError error(NO_ERROR, 0);
+
+    ASSERT_NOT_NULL(cache.get("y'+1", "x", false, error));
+    ASSERT_NULL(cache.get("y '+1", "x", false, error));
+    ASSERT_EQUALS(error.code, INVALID_SYMBOL);
+    ASSERT_EQUALS(error.position, 2);
+}
+
+TEST(ExpressionCache, hitsAndMisses) {
+    ExpressionCache cache(16);
+    ParseError error(NO_ERROR, 0);
+
+    auto first = cache.get("x ^ 2 + 0 * x", "x", true, error);
+    auto second = cache.get("x^2 + 0*x", "x", true, error);
+    auto unoptimized = cache.get("x^2 + 0*x", "x", false, error);
+    auto sameStructure = cache.get("(x) ^ (2) + 0 * (x)", "x", true, error);
+    ASSERT_NOT_NULL(first);
+    ASSERT_TRUE(first == second);
+    ASSERT_TRUE(first == sameStructure);
+    ASSERT_TRUE(first != unoptimized);
+
+    const double values[] = { 3. };
+    ASSERT_DOUBLE_EQUALS(first->expression.evaluate(values), 9.);
+    ASSERT_DOUBLE_EQUALS(first->derivativeExpression->evaluate(values), 6.);
+    ASSERT_DOUBLE_EQUALS(unoptimized->derivativeExpression->evaluate(values), 6.);
+
+    ASSERT_NULL(cache.get("x ^ (2", "x", true, error));
+    ASSERT_EQUALS(error.code, EXPECTED_CLOSING_PARENTHESIS);
+
+    const ExpressionCacheStatistics statistics = cache.getStatistics();
+    ASSERT_EQUALS(statistics.hits, 1u);
+    ASSERT_EQUALS(statistics.misses, 4u);
+    ASSERT_EQUALS(statistics.structuralHits, 1u);
+    ASSERT_EQUALS(statistics.size, 3u);
+}
+
+TEST(ExpressionCache, leastRecentlyUsedEviction) {
+    ExpressionCache cache(2);
+    ParseError error(NO_ERROR, 0);
+
+    auto first = cache.get("x + 1", "", false, error);
+    cache.get("x + 2", "", false, error);
+    ASSERT_TRUE(cache.get("x + 1", "", false, error) == first); // "x + 2" becomes the least recently used
+    cache.get("x + 3", "", false, error);
+    ASSERT_TRUE(cache.get("x + 1", "", false, error) == first);
+    ASSERT_NULL(first->derivative);
+
+    const ExpressionCacheStatistics statistics = cache.getStatistics();
+    ASSERT_EQUALS(statistics.hits, 2u);
+    ASSERT_EQUALS(statistics.evictions, 1u);
+    ASSERT_EQUALS(statistics.size, 2u);
+
+    cache.get("x + 2", "", false, error);
+    ASSERT_EQUALS(cache.getStatistics().misses, 4u);
+}
+
+TEST(ExpressionCache, spillSurvivesRestart) {
+    const std::string directory = "/tmp/ast-builder-test-cache-" + std::to_string(getpid());
+    mkdir(directory.c_str(), 0700);
+    ParseError error(NO_ERROR, 0);
+    {
+        ExpressionCache cache(1, directory);
+        cache.get("sin(x) * y", "x", true, error);
+        cache.get("ln(x)", "x", false, error); // Spills "sin(x) * y"
+    }
+
+    std::shared_ptr<const CachedExpression> first;
+    std::shared_ptr<const CachedExpression> second;
+    size_t diskHits;
+    {
+        ExpressionCache cache(4, directory);
+        first = cache.get("sin(x)*y", "x", true, error);
+        second = cache.get("ln(x)", "x", false, error);
+        diskHits = cache.getStatistics().diskHits;
+    }
+    removeDirectory(directory);
+
+    ASSERT_NOT_NULL(first);
+    ASSERT_NOT_NULL(second);
+    ASSERT_EQUALS(diskHits, 2u);
+    const double values[] = { 0.5, 2. };
+    ASSERT_DOUBLE_EQUALS(first->derivativeExpression->evaluate(values), 2. * cos(0.5));
+    ASSERT_DOUBLE_EQUALS(second->derivativeExpression->evaluate(values), 2.);
+}
+
+TEST(ExpressionCache, concurrentUse) {
+    ExpressionCache cache(8);
+    std::atomic<int> wrongResultsNumber(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]() {
+            ParseError error(NO_ERROR, 0);
+            for (int j = 0; j < 1000; ++j) {
+                const std::string expression = "x * " + std::to_string(j % 16);
+                auto cachedExpression = cache.get(expression.c_str(), "x", true, error);
+                const double values[] = { 2. };
+                if (std::fabs(cachedExpression->expression.evaluate(values) - 2. * (j % 16)) > 1e-9) {
+                    ++wrongResultsNumber;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQUALS(wrongResultsNumber.load(), 0);
+    const ExpressionCacheStatistics statistics = cache.getStatistics();
+    ASSERT_EQUALS(statistics.hits + statistics.misses, 4000u);
+    ASSERT_EQUALS(statistics.size, 8u);
+}
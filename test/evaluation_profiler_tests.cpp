@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief Tests for per-node evaluation profiler
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include "testlib.h"
+#include "../src/evaluation_profiler.h"
+#include "../src/iterative_parser.h"
+
+static const std::vector<std::pair<std::string, double> > VALUES = { {"x", 0.5}, {"y", 2.} };
+
+static std::string printToString(const std::function<void(FILE*)>& print) {
+    char* data = nullptr;
+    size_t size = 0;
+    FILE* file = open_memstream(&data, &size);
+    print(file);
+    fclose(file);
+    std::string text(data, size);
+    free(data);
+    return text;
+}
+
+TEST(EvaluationProfiler, valueAndCalls) {
+    const auto root = buildASTIteratively("sin(x) * y + 2 ^ -x");
+    const EvaluationProfile profile(root, VALUES, 10);
+    ASSERT_DOUBLE_EQUALS(profile.getValue(), sin(0.5) * 2. + pow(2., -0.5));
+    ASSERT_EQUALS(profile.getNodes().size(), 9u);
+
+    uint64_t selfTicks = 0;
+    for (const NodeProfile& node : profile.getNodes()) {
+        ASSERT_EQUALS(node.callsNumber, 10u);
+        ASSERT_TRUE(node.totalTicks >= node.selfTicks);
+        selfTicks += node.selfTicks;
+    }
+    ASSERT_EQUALS(selfTicks, profile.getTotalTicks());
+    ASSERT_EQUALS(profile.getProfile(*root).totalTicks, profile.getTotalTicks());
+    ASSERT_EQUALS(profile.getProfile(*root).subtreeSize, 9u);
+    ASSERT_EQUALS(profile.getProfile(*root->getChildren()[0]).totalTicks,
+                  profile.getProfile(*root->getChildren()[0]).selfTicks +
+                  profile.getProfile(*root->getChildren()[0]->getChildren()[0]).totalTicks +
+                  profile.getProfile(*root->getChildren()[0]->getChildren()[1]).totalTicks);
+}
+
+TEST(EvaluationProfiler, sharedNodes) {
+    const auto sum = buildASTIteratively("x + 1");
+    const auto root = std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), sum, sum);
+    const EvaluationProfile profile(root, VALUES, 5);
+    ASSERT_DOUBLE_EQUALS(profile.getValue(), 2.25);
+    ASSERT_EQUALS(profile.getNodes().size(), 4u);
+    ASSERT_EQUALS(profile.getProfile(*sum).callsNumber, 10u); // Evaluated for both parents
+    ASSERT_EQUALS(profile.getProfile(*root).callsNumber, 5u);
+    ASSERT_EQUALS(profile.getProfile(*root).subtreeSize, 7u);
+}
+
+TEST(EvaluationProfiler, invalidArguments) {
+    bool thrown = false;
+    try {
+        EvaluationProfile(buildASTIteratively("x + z"), VALUES);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+
+    thrown = false;
+    try {
+        EvaluationProfile(buildASTIteratively("x"), VALUES, 0);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
+
+TEST(EvaluationProfiler, transcendentalCallsDominate) {
+    const auto root = buildASTIteratively("tg(x) ^ y + ln(y) + x");
+    const EvaluationProfile profile(root, VALUES, 2000);
+    const NodeProfile& power = profile.getProfile(*root->getChildren()[0]->getChildren()[0]);
+    const NodeProfile& addition = profile.getProfile(*root);
+    ASSERT_TRUE(power.selfTicks > addition.selfTicks);
+    ASSERT_TRUE(power.totalTicks > profile.getTotalTicks() / 4);
+}
+
+TEST(EvaluationProfiler, heatmapAndReport) {
+    const auto root = buildASTIteratively("sin(x) ^ 2 + ln(y)");
+    const EvaluationProfile profile(root, VALUES, 100);
+    const std::string dot = printToString([&profile](FILE* file) { profile.dotPrint(file); });
+    ASSERT_TRUE(dot.find("0 [label=\"binary op\\nop: +\\ncalls: 100\\nself: ") == strlen("digraph AST {\n"));
+    ASSERT_TRUE(dot.find("total: 100.0%\", shape=box, style=filled, color=\"grey\", fillcolor=\"#FF3030\"];") !=
+                std::string::npos);
+    ASSERT_TRUE(dot.find("fillcolor=\"#C9E7FF\"") == std::string::npos); // Every node is colored by the profile
+
+    const std::string report = printToString([&profile](FILE* file) { profile.printReport(file, 3); });
+    ASSERT_TRUE(report.find("Evaluated 100 times") == 0);
+    ASSERT_EQUALS(std::count(report.begin(), report.end(), '\n'), 5); // Summary, header and 3 nodes
+    ASSERT_TRUE(report.find("   1 ") != std::string::npos);
+}
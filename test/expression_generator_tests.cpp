@@ -0,0 +1,128 @@
+/**
+ * @file
+ * @brief Tests for generator of random expressions
+ */
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/expression_generator.h"
+#include "../src/iterative_parser.h"
+#include "../src/recursive_parser.h"
+
+/**
+ * @return number of nodes and depth of the AST.
+ */
+static std::pair<size_t, size_t> measureAST(const std::shared_ptr<ASTNode>& root) {
+    size_t nodesNumber = 0;
+    size_t depth = 0;
+    std::vector<std::pair<const ASTNode*, size_t> > nodes(1, std::make_pair(root.get(), 1));
+    while (!nodes.empty()) {
+        const auto node = nodes.back();
+        nodes.pop_back();
+        ++nodesNumber;
+        depth = std::max(depth, node.second);
+        for (size_t i = 0; i < node.first->getChildrenNumber(); ++i) {
+            nodes.emplace_back(node.first->getChildren()[i].get(), node.second + 1);
+        }
+    }
+    return std::make_pair(nodesNumber, depth);
+}
+
+TEST(ExpressionGenerator, sameSeedSameExpressions) {
+    ExpressionGenerator first(GeneratorOptions(), 7);
+    ExpressionGenerator second(GeneratorOptions(), 7);
+    ExpressionGenerator other(GeneratorOptions(), 8);
+
+    bool differs = false;
+    for (int i = 0; i < 20; ++i) {
+        const std::string expression = first.generateExpression();
+        ASSERT_EQUALS(second.generateExpression(), expression);
+        differs = differs || (other.generateExpression() != expression);
+    }
+    ASSERT_TRUE(differs);
+}
+
+TEST(ExpressionGenerator, sizeAndDepth) {
+    GeneratorOptions options;
+    options.nodesNumber = 200;
+    options.maxDepth = 6;
+    ExpressionGenerator generator(options);
+    for (int i = 0; i < 50; ++i) {
+        const auto size = measureAST(generator.generateAST());
+        ASSERT_TRUE(size.first <= 200u);
+        ASSERT_TRUE(size.second <= 6u);
+    }
+
+    options.maxDepth = UNLIMITED_DEPTH;
+    ExpressionGenerator unlimitedGenerator(options);
+    for (int i = 0; i < 50; ++i) {
+        ASSERT_EQUALS(measureAST(unlimitedGenerator.generateAST()).first, 200u);
+    }
+}
+
+TEST(ExpressionGenerator, expressionsParsedBack) {
+    ExpressionGenerator generator(GeneratorOptions(), 1);
+    for (int i = 0; i < 200; ++i) {
+        const auto root = generator.generateAST();
+        const std::string expression = root->toInfix();
+
+        ASSERT_TRUE(root->structurallyEquals(*buildASTIteratively(expression.c_str())));
+        differentiate(root, "x"); // Exponents are constants, so it doesn't throw
+    }
+}
+
+TEST(ExpressionGenerator, recursiveDescentGrammar) {
+    GeneratorOptions options;
+    options.unaryWeight = 0;
+    ExpressionGenerator generator(options, 1);
+    for (int i = 0; i < 200; ++i) {
+        const auto root = generator.generateAST();
+        ASSERT_TRUE(root->structurallyEquals(*buildASTByRecursiveDescent(root->toInfix().c_str())));
+    }
+}
+
+TEST(ExpressionGenerator, onlyConstants) {
+    GeneratorOptions options;
+    options.variablesNumber = 0;
+    ExpressionGenerator generator(options);
+    for (int i = 0; i < 20; ++i) {
+        generator.generateAST()->calculate(); // Variables can't be calculated
+    }
+}
+
+TEST(ExpressionGenerator, presets) {
+    const auto sums = ExpressionGenerator(getPresetOptions(LONG_SUMS, 1001)).generateAST();
+    ASSERT_EQUALS(measureAST(sums).second, 501u);
+    ASSERT_TRUE(sums->toInfix().find('(') == std::string::npos);
+
+    const auto powers = ExpressionGenerator(getPresetOptions(DEEP_POWER_CHAINS, 1001)).generateAST();
+    const std::string powersExpression = powers->toInfix();
+    ASSERT_EQUALS(measureAST(powers).second, 501u);
+    ASSERT_TRUE(powersExpression.find('(') == std::string::npos);
+    ASSERT_EQUALS((size_t)std::count(powersExpression.begin(), powersExpression.end(), '^'), 500u);
+    ASSERT_TRUE(powers->structurallyEquals(*buildASTIteratively(powersExpression.c_str())));
+
+    const auto functions = ExpressionGenerator(getPresetOptions(NESTED_FUNCTIONS, 1000)).generateAST();
+    const std::string functionsExpression = functions->toInfix();
+    ASSERT_EQUALS(measureAST(functions).second, 1000u);
+    ASSERT_EQUALS((size_t)std::count(functionsExpression.begin(), functionsExpression.end(), '('), 999u);
+    ASSERT_TRUE(functionsExpression.find("sin") == std::string::npos);
+    ASSERT_TRUE(functions->structurallyEquals(*buildASTIteratively(functionsExpression.c_str())));
+}
+
+TEST(ExpressionGenerator, presetNames) {
+    ASSERT_EQUALS(getPresetByName("realistic"), REALISTIC_MIX);
+    ASSERT_EQUALS(getPresetByName("nested-functions"), NESTED_FUNCTIONS);
+
+    bool thrown = false;
+    try {
+        getPresetByName("unknown");
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
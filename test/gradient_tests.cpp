@@ -0,0 +1,78 @@
+/**
+ * @file
+ * @brief Tests for differentiation by several variables
+ */
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/ast_metrics.h"
+#include "../src/expression_generator.h"
+#include "../src/iterative_parser.h"
+
+static void assertSameAsSeparate(const std::shared_ptr<ASTNode>& root, const std::vector<std::string>& names) {
+    const auto partialDerivatives = gradient(root, names);
+    ASSERT_EQUALS(partialDerivatives.size(), names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        const auto derivative = differentiate(root, names[i].c_str());
+        ASSERT_TRUE(partialDerivatives[i]->structurallyEquals(*derivative));
+        ASSERT_EQUALS(partialDerivatives[i]->toInfix(), derivative->toInfix());
+    }
+}
+
+TEST(gradient, sameAsSeparate) {
+    assertSameAsSeparate(buildASTIteratively("x * y / (sin(x) + z) + 2 ^ y - ln(x * z) + cos(-x) ^ 3"), {"x", "y", "z", "w"});
+    assertSameAsSeparate(buildASTIteratively("tg(x) * ctg(y) + +5"), {"y"});
+    assertSameAsSeparate(buildASTIteratively("x"), {"x", "y"});
+    assertSameAsSeparate(buildASTIteratively("2"), {"x"});
+}
+
+TEST(gradient, generatedAST) {
+    GeneratorOptions options = getPresetOptions(REALISTIC_MIX, 20000);
+    options.maxDepth = 24;
+    ExpressionGenerator generator(options);
+    assertSameAsSeparate(generator.generateAST(), {"x", "y", "z", "t"});
+}
+
+TEST(gradient, sharedNodes) {
+    // Shared subtree is differentiated once, derivatives and copies are reused by both parents
+    const auto shared = buildASTIteratively("sin(x * y) / z");
+    const auto root = std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), shared, shared);
+    assertSameAsSeparate(root, {"x", "y", "z"});
+    const auto partialDerivatives = gradient(root, {"x", "y"});
+    const auto separateMetrics = computeASTMetrics(differentiate(root, "x"));
+    ASSERT_TRUE(computeASTMetrics(partialDerivatives[0]).uniqueNodesNumber < separateMetrics.uniqueNodesNumber);
+}
+
+TEST(gradient, sharedBetweenPartials) {
+    // Derivatives of sin(z) by x and y are equal, so they are the same node
+    const auto root = buildASTIteratively("x * y + sin(z)");
+    const auto partialDerivatives = gradient(root, {"x", "y"});
+    ASSERT_TRUE(partialDerivatives[0]->getChildren()[1] == partialDerivatives[1]->getChildren()[1]);
+    ASSERT_EQUALS(partialDerivatives[0]->getChildren()[1]->toInfix(), "z' * cos(z)");
+}
+
+TEST(gradient, noVariables) {
+    ASSERT_TRUE(gradient(buildASTIteratively("x + 1"), {}).empty());
+}
+
+TEST(gradient, unsupportedPower) {
+    bool thrown = false;
+    try {
+        gradient(buildASTIteratively("y + x ^ sin(x)"), {"y", "x"});
+    } catch (const std::logic_error&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
+
+TEST(compareGradient, savesNodes) {
+    GeneratorOptions options = getPresetOptions(REALISTIC_MIX, 5000);
+    options.maxDepth = 20;
+    ExpressionGenerator generator(options);
+    const GradientStatistics statistics = compareGradient(generator.generateAST(), {"x", "y", "z"});
+    ASSERT_EQUALS(statistics.variablesNumber, 3u);
+    ASSERT_TRUE(statistics.uniqueNodesNumber > 0);
+    ASSERT_TRUE(statistics.uniqueNodesNumber < statistics.separateUniqueNodesNumber);
+}
@@ -0,0 +1,128 @@
+/**
+ * @file
+ * @brief Tests for parallel differentiation and optimization
+ */
+#include <stdexcept>
+#include <string>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/ast-optimizers.h"
+#include "../src/ast_metrics.h"
+#include "../src/expression_generator.h"
+#include "../src/iterative_parser.h"
+#include "../src/thread_pool.h"
+
+static std::shared_ptr<ASTNode> generateLargeAST() {
+    GeneratorOptions options = getPresetOptions(REALISTIC_MIX, 20000);
+    options.maxDepth = 24;
+    ExpressionGenerator generator(options);
+    return generator.generateAST();
+}
+
+TEST(findLargeSubtrees, sizesAndSharing) {
+    const auto root = buildASTIteratively("sin(x) * (y + 2) + x");
+    const auto largeSubtrees = findLargeSubtrees(root, 4);
+    ASSERT_EQUALS(largeSubtrees.size(), 2u); // Root with 9 nodes and the product with 7
+    ASSERT_TRUE(largeSubtrees.at(root));
+    ASSERT_TRUE(largeSubtrees.at(root->getChildren()[0]));
+
+    // Copy of the divisor is shared by the numerator and the denominator of the derivative of division
+    const auto derivative = differentiate(buildASTIteratively("(x + 1) / (x + 2) + y"), "x");
+    const auto& divisionDerivative = derivative->getChildren()[0]; // Reference, so use count isn't changed
+    const auto derivativeSubtrees = findLargeSubtrees(derivative, 4);
+    ASSERT_TRUE(derivativeSubtrees.at(divisionDerivative));
+    ASSERT_TRUE(!derivativeSubtrees.at(divisionDerivative->getChildren()[0]));
+    ASSERT_TRUE(!derivativeSubtrees.at(divisionDerivative->getChildren()[1]));
+    ASSERT_TRUE(!findLargeSubtrees(derivative, 3).at(divisionDerivative->getChildren()[1]->getChildren()[0])); // Divisor
+    // Shared divisor is counted for every parent
+    ASSERT_TRUE(findLargeSubtrees(derivative, 26).empty());
+    ASSERT_EQUALS(findLargeSubtrees(derivative, 24).size(), 1u); // Root with 25 nodes
+    ASSERT_EQUALS(findLargeSubtrees(derivative, 23).size(), 2u); // And the derivative of division with 23
+
+    // Subtree isn't independent if it's node is referenced from outside of the AST
+    const auto child = root->getChildren()[1];
+    ASSERT_TRUE(!findLargeSubtrees(root, 1).at(child));
+}
+
+TEST(differentiateInParallel, sameAsSequential) {
+    ThreadPool pool(4);
+    const auto root = generateLargeAST();
+    const auto derivative = differentiate(root, "x");
+    for (size_t cutoff : {(size_t)1, (size_t)64, DEFAULT_PARALLEL_CUTOFF}) {
+        const auto parallelDerivative = differentiateInParallel(root, "x", pool, cutoff);
+        ASSERT_TRUE(parallelDerivative->structurallyEquals(*derivative));
+        ASSERT_EQUALS(parallelDerivative->toInfix(), derivative->toInfix());
+
+        ASSERT_EQUALS(computeASTMetrics(parallelDerivative).uniqueNodesNumber, computeASTMetrics(derivative).uniqueNodesNumber);
+    }
+}
+
+TEST(differentiateInParallel, otherVariables) {
+    ThreadPool pool(2);
+    const auto root = buildASTIteratively("y * sin(x) / (z + x) + 2 ^ y");
+    const auto derivative = differentiateInParallel(root, "x", pool, 1);
+    ASSERT_EQUALS(derivative->toInfix(), differentiate(root, "x")->toInfix());
+    ASSERT_EQUALS(differentiateInParallel(buildASTIteratively("-y"), "x", pool, 1)->toInfix(), "-y'");
+}
+
+TEST(differentiateInParallel, unsupportedPower) {
+    ThreadPool pool(2);
+    const auto root = buildASTIteratively("sin(x) + cos(x) * (y + x ^ x)");
+    bool thrown = false;
+    try {
+        differentiateInParallel(root, "x", pool, 1);
+    } catch (const std::logic_error&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
+
+TEST(differentiate, tooLongVariableName) {
+    std::string name(VariableToken::MAX_NAME_LENGTH - 1, 'y');
+    const auto root = buildASTIteratively(("x + " + name).c_str());
+    bool thrown = false;
+    try {
+        differentiate(root, "x");
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
+
+TEST(optimizeInParallel, sameAsSequential) {
+    ThreadPool pool(4);
+    const FullOptimizer optimizer;
+    const auto root = generateLargeAST();
+
+    // Shared divisors of the derivative are optimized by the tasks of their divisions
+    for (size_t cutoff : {(size_t)1, (size_t)64}) {
+        auto expected = differentiate(root, "x");
+        auto derivative = differentiate(root, "x");
+        expected = optimizer.optimize(expected);
+        derivative = optimizeInParallel(optimizer, derivative, pool, cutoff);
+        ASSERT_TRUE(derivative->structurallyEquals(*expected));
+        ASSERT_EQUALS(derivative->toInfix(), expected->toInfix());
+        ASSERT_EQUALS(computeASTMetrics(derivative).uniqueNodesNumber, computeASTMetrics(expected).uniqueNodesNumber);
+    }
+}
+
+TEST(optimizeInParallel, sharedUnaryAddition) {
+    ThreadPool pool(4);
+    const FullOptimizer optimizer;
+    // Shared copies of the divisor +(...) are replaced by the same child, so it's optimized by the task of it's parents
+    const auto root = buildASTIteratively("x * sin(x) / +(--(x * 1 + 0) * (y + 2 * 3) - x)");
+    auto expected = differentiate(root, "x");
+    auto derivative = differentiate(root, "x");
+    expected = optimizer.optimize(expected);
+    derivative = optimizeInParallel(optimizer, derivative, pool, 1);
+    ASSERT_TRUE(derivative->structurallyEquals(*expected));
+    ASSERT_EQUALS(derivative->toInfix(), expected->toInfix());
+}
+
+TEST(optimizeInParallel, smallAST) {
+    ThreadPool pool(2);
+    const FullOptimizer optimizer;
+    auto root = buildASTIteratively("0 * x + --(1 * y) + +2 * 3");
+    root = optimizeInParallel(optimizer, root, pool);
+    ASSERT_EQUALS(root->toInfix(), "y + 6");
+}
@@ -0,0 +1,286 @@
+/**
+ * @file
+ * @brief Tests for parsers
+ */
+#include <cstring>
+#include <string>
+#include "testlib.h"
+#include "../src/ast.h"
+#include "../src/incremental_parser.h"
+#include "../src/iterative_parser.h"
+#include "../src/mapped_file.h"
+#include "../src/recursive_parser.h"
+#include "../src/SyntaxError.h"
+
+TEST(buildASTIteratively, operatorsPrecedenceAndAssociativity) {
+    std::shared_ptr<ASTNode> root = buildASTIteratively("2 ^ 3 ^ 2 - 10 / 5 * 2 - 1");
+
+    ASSERT_DOUBLE_EQUALS(root->calculate(), 512 - 4 - 1);
+}
+
+TEST(buildASTIteratively, functionsAndVariables) {
+    std::shared_ptr<ASTNode> root = buildASTIteratively("sin(x) * (2 + ln(y))");
+
+    ASSERT_EQUALS(root->getToken()->getType(), OPERATOR);
+    auto leftChild = root->getChildren()[0];
+    ASSERT_EQUALS(leftChild->getToken()->getType(), FUNCTION);
+    ASSERT_EQUALS(dynamic_cast<FunctionToken*>(leftChild->getToken().get())->getFunctionType(), SIN);
+    ASSERT_EQUALS(leftChild->getChildren()[0]->getToken()->getType(), VARIABLE);
+}
+
+TEST(buildASTIteratively, deeplyNestedParentheses) {
+    const size_t depth = 300000;
+    std::string expression = std::string(depth, '(') + "1" + std::string(depth, ')') + "+2";
+
+    std::shared_ptr<ASTNode> root = buildASTIteratively(expression.c_str(), depth);
+
+    ASSERT_DOUBLE_EQUALS(root->getChildren()[1]->calculate(), 2);
+}
+
+TEST(buildASTIteratively, deeplyNestedFunctions) {
+    const size_t depth = 300000;
+    std::string expression;
+    for (size_t i = 0; i < depth; ++i) {
+        expression += "ln(";
+    }
+    expression += "x" + std::string(depth, ')');
+
+    std::shared_ptr<ASTNode> root = buildASTIteratively(expression.c_str(), depth);
+
+    ASSERT_EQUALS(root->getToken()->getType(), FUNCTION);
+}
+
+TEST(buildASTIteratively, nestingDepthLimit) {
+    try {
+        buildASTIteratively("((1)) + (((2)))", 2);
+        ASSERT_TRUE(false);
+    } catch (SyntaxError& ex) {
+        ASSERT_EQUALS(ex.at(), 10);
+        ASSERT_TRUE(strcmp(ex.what(), "Maximum nesting depth exceeded at 10") == 0);
+    }
+}
+
+TEST(buildASTIteratively, unaryOperatorsDepthLimit) {
+    const std::string expression = std::string(100000, '-') + "x";
+
+    ASSERT_EQUALS(tryBuildAST(expression.c_str()).getError().code, MAX_NESTING_DEPTH_EXCEEDED);
+    ASSERT_EQUALS(validateExpression(expression.c_str()).code, MAX_NESTING_DEPTH_EXCEEDED);
+    ASSERT_TRUE(tryBuildAST(expression.c_str() + 100000 - DEFAULT_MAX_NESTING_DEPTH).isSuccess());
+}
+
+TEST(buildASTIteratively, powerChainDepthLimit) {
+    std::string expression;
+    for (int i = 0; i < 100000; ++i) {
+        expression += "2^";
+    }
+    expression += "x";
+
+    ASSERT_EQUALS(tryBuildAST(expression.c_str()).getError().code, MAX_NESTING_DEPTH_EXCEEDED);
+    ASSERT_EQUALS(validateExpression(expression.c_str()).code, MAX_NESTING_DEPTH_EXCEEDED);
+    ASSERT_EQUALS(buildASTIteratively(expression.c_str(), 100000)->getToken()->getType(), OPERATOR);
+}
+
+TEST(validateExpression, depthOfOperators) {
+    ASSERT_TRUE(!validateExpression("-x + 1", 2).isError());
+    ASSERT_TRUE(!validateExpression("((x)) + 1", 2).isError());
+    ASSERT_EQUALS(validateExpression("--x + 1", 2).code, MAX_NESTING_DEPTH_EXCEEDED);
+    ASSERT_EQUALS(validateExpression("--x + 1", 2).position, 4);
+    ASSERT_EQUALS(validateExpression("x + x + x + x", 2).code, MAX_NESTING_DEPTH_EXCEEDED);
+    ASSERT_EQUALS(validateExpression("sin(x * 2)", 1).code, MAX_NESTING_DEPTH_EXCEEDED);
+}
+
+TEST(buildASTIteratively, unclosedParenthesis) {
+    try {
+        buildASTIteratively("(1 + 2");
+        ASSERT_TRUE(false);
+    } catch (SyntaxError& ex) {
+        ASSERT_EQUALS(ex.at(), 6);
+        ASSERT_TRUE(strcmp(ex.what(), "Expected closing parenthesis at 6") == 0);
+    }
+}
+
+TEST(buildASTIteratively, missingOperand) {
+    try {
+        buildASTIteratively("1 + * 2");
+        ASSERT_TRUE(false);
+    } catch (SyntaxError& ex) {
+        ASSERT_EQUALS(ex.at(), 4);
+    }
+}
+
+TEST(tryBuildAST, validExpression) {
+    ParseResult result = tryBuildAST("(1 + 2) * 3");
+
+    ASSERT_TRUE(result.isSuccess());
+    ASSERT_NOT_NULL(result.getRoot());
+    ASSERT_DOUBLE_EQUALS(result.getRoot()->calculate(), 9);
+}
+
+TEST(tryBuildAST, invalidExpression) {
+    ParseResult result = tryBuildAST("sin x");
+
+    ASSERT_TRUE(!result.isSuccess());
+    ASSERT_NULL(result.getRoot());
+    ASSERT_EQUALS(result.getError().code, EXPECTED_OPEN_PARENTHESIS);
+    ASSERT_EQUALS(result.getError().position, 4);
+    ASSERT_TRUE(strcmp(result.getError().getMessage(), "Expected open parenthesis") == 0);
+}
+
+TEST(validateExpression, validExpression) {
+    ParseError error = validateExpression("ln(x) ^ 2 / (y - 1)");
+
+    ASSERT_TRUE(!error.isError());
+}
+
+TEST(validateExpression, invalidExpressions) {
+    ASSERT_EQUALS(validateExpression("1 +").code, INVALID_SYMBOL);
+    ASSERT_EQUALS(validateExpression("1 + 2)").code, INVALID_SYMBOL);
+    ASSERT_EQUALS(validateExpression("(1 + 2").code, EXPECTED_CLOSING_PARENTHESIS);
+    ASSERT_EQUALS(validateExpression("((x))", 1).code, MAX_NESTING_DEPTH_EXCEEDED);
+    ASSERT_EQUALS(validateExpression("2 x").position, 2);
+    ASSERT_EQUALS(validateExpression("x + \xE9").code, INVALID_SYMBOL);
+    ASSERT_EQUALS(validateExpression("x\xE9").position, 1);
+}
+
+TEST(validateExpression, tooLongVariableName) {
+    const std::string name(VariableToken::MAX_NAME_LENGTH - 2, 'y');
+
+    ParseResult result = tryBuildAST(("1 + " + name + "'").c_str());
+    ASSERT_TRUE(result.isSuccess());
+    ASSERT_EQUALS(std::string(dynamic_cast<VariableToken*>(result.getRoot()->getChildren()[1]->getToken().get())->getName()),
+                  name + "'");
+    ASSERT_EQUALS(tryBuildAST(("1 + " + name + "''").c_str()).getError().code, TOO_LONG_VARIABLE_NAME);
+    ASSERT_EQUALS(validateExpression(("1 + " + name + "yy").c_str()).code, TOO_LONG_VARIABLE_NAME);
+    ASSERT_EQUALS(validateExpression(("1 + " + name + "yy").c_str()).position, 4);
+}
+
+TEST(buildAST, realConstantsAndUnaryOperators) {
+    std::shared_ptr<ASTNode> root = buildAST((char*)"-1.5e1 * -(+2 - 0.5) / --3.");
+
+    ASSERT_DOUBLE_EQUALS(root->calculate(), -15 * -1.5 / 3);
+}
+
+TEST(buildAST, unaryOperatorsBindTighterThanPower) {
+    ASSERT_DOUBLE_EQUALS(buildAST((char*)"-2 ^ 2")->calculate(), 4);
+    ASSERT_DOUBLE_EQUALS(buildAST((char*)"2 ^ -1 ^ 2")->calculate(), 2);
+}
+
+TEST(buildAST, variablesWithDigits) {
+    std::shared_ptr<ASTNode> root = buildAST((char*)"x1 + -ln(y2)");
+
+    ASSERT_EQUALS(root->getChildren()[0]->getToken()->getType(), VARIABLE);
+    ASSERT_TRUE(strcmp(dynamic_cast<VariableToken*>(root->getChildren()[0]->getToken().get())->getName(), "x1") == 0);
+    ASSERT_EQUALS(root->getChildren()[1]->getChildren()[0]->getToken()->getType(), FUNCTION);
+}
+
+TEST(buildAST, invalidConstant) {
+    try {
+        buildAST((char*)"1.5.5");
+        ASSERT_TRUE(false);
+    } catch (SyntaxError& ex) {
+        ASSERT_EQUALS(ex.at(), 3);
+    }
+}
+
+TEST(buildASTRecursively, sameParserAsBuildAST) {
+    const char* expression = "2 ^ 3 ^ 2 - cos(-0.5) * 4";
+
+    ASSERT_DOUBLE_EQUALS(buildASTRecursively(expression)->calculate(), buildAST((char*)expression)->calculate());
+    ASSERT_DOUBLE_EQUALS(buildASTRecursively(expression)->calculate(), 512 - cos(-0.5) * 4);
+}
+
+TEST(IncrementalParser, editInsideParenthesesKeepsOtherSubtrees) {
+    IncrementalParser parser("sin(x + (y * 2)) + ln(z)");
+    const std::shared_ptr<ASTNode> oldRoot = parser.getRoot();
+    const std::shared_ptr<ASTNode> lnSubtree = oldRoot->getChildren()[1];
+    const std::shared_ptr<ASTNode> xNode = oldRoot->getChildren()[0]->getChildren()[0]->getChildren()[0];
+
+    ParseError error = parser.edit(13, 14, "3 - 1");
+
+    ASSERT_TRUE(!error.isError());
+    ASSERT_TRUE(parser.getSource() == "sin(x + (y * 3 - 1)) + ln(z)");
+    ASSERT_EQUALS(parser.getReparsedLength(), 9);
+    ASSERT_TRUE(parser.getRoot() != oldRoot);
+    ASSERT_TRUE(parser.getRoot()->getChildren()[1] == lnSubtree);
+    ASSERT_TRUE(parser.getRoot()->getChildren()[0]->getChildren()[0]->getChildren()[0] == xNode);
+}
+
+TEST(IncrementalParser, editOfConstant) {
+    IncrementalParser parser("2 * 3 + 4");
+    const std::shared_ptr<ASTNode> rightSubtree = parser.getRoot()->getChildren()[1];
+
+    parser.edit(4, 5, "30");
+
+    ASSERT_EQUALS(parser.getReparsedLength(), 2);
+    ASSERT_DOUBLE_EQUALS(parser.getRoot()->calculate(), 64);
+    ASSERT_TRUE(parser.getRoot()->getChildren()[1] == rightSubtree);
+}
+
+TEST(IncrementalParser, consecutiveEdits) {
+    IncrementalParser parser("(1 + 2) * (3 + 4)");
+
+    parser.edit(11, 12, "5");
+    parser.edit(1, 2, "10");
+    parser.edit(16, 17, "6 * 2");
+
+    ASSERT_TRUE(parser.getSource() == "(10 + 2) * (5 + 6 * 2)");
+    ASSERT_DOUBLE_EQUALS(parser.getRoot()->calculate(), 12 * 17);
+    ASSERT_DOUBLE_EQUALS(buildAST((char*)parser.getSource().c_str())->calculate(), 12 * 17);
+}
+
+TEST(IncrementalParser, editThatChangesStructureReparsesAll) {
+    IncrementalParser parser("(1 + 2) * 3");
+
+    parser.edit(10, 11, "(3 * 3");
+
+    ASSERT_TRUE(parser.getSource() == "(1 + 2) * (3 * 3");
+    ASSERT_EQUALS(parser.getReparsedLength(), parser.getSource().size());
+    ASSERT_NULL(parser.getRoot());
+
+    ParseError error = parser.edit(16, 16, ")");
+
+    ASSERT_TRUE(!error.isError());
+    ASSERT_DOUBLE_EQUALS(parser.getRoot()->calculate(), 27);
+}
+
+TEST(IncrementalParser, editThatExceedsDepthLimit) {
+    IncrementalParser parser("-(x) * 2", 3);
+
+    ASSERT_TRUE(!parser.edit(2, 3, "-x").isError());
+    ASSERT_EQUALS(parser.getReparsedLength(), 2);
+    ASSERT_EQUALS(parser.edit(2, 4, "--x").code, MAX_NESTING_DEPTH_EXCEEDED);
+    ASSERT_NULL(parser.getRoot());
+}
+
+TEST(buildASTFromRange, notNullTerminatedRange) {
+    const char expression[] = { '1', '+', '2', '*', '3' };
+
+    std::shared_ptr<ASTNode> root = buildASTFromRange(expression, expression + 3);
+
+    ASSERT_DOUBLE_EQUALS(root->calculate(), 3);
+}
+
+TEST(buildASTFromRange, nullSymbolInsideRange) {
+    const char expression[] = { '1', '+', '2', '\0', '3' };
+
+    ParseResult result = tryBuildASTFromRange(expression, expression + sizeof(expression));
+
+    ASSERT_EQUALS(result.getError().code, INVALID_SYMBOL);
+    ASSERT_EQUALS(result.getError().position, 3);
+}
+
+TEST(buildASTFromRange, mappedFile) {
+    char fileName[] = "/tmp/ast-builder-testXXXXXX";
+    int fd = mkstemp(fileName);
+    ASSERT_TRUE(fd >= 0);
+    const char expression[] = "(1 + 2) * 3.5\n";
+    ASSERT_EQUALS(write(fd, expression, sizeof(expression) - 1), (ssize_t)(sizeof(expression) - 1));
+    close(fd);
+
+    {
+        MappedFile file(fileName);
+        ASSERT_EQUALS(file.getSize(), sizeof(expression) - 1);
+        ASSERT_DOUBLE_EQUALS(buildASTFromRange(file.begin(), file.end())->calculate(), 10.5);
+    }
+    unlink(fileName);
+}
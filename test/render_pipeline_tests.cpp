@@ -0,0 +1,198 @@
+/**
+ * @file
+ * @brief Tests for asynchronous rendering pipeline
+ */
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/ast-optimizers.h"
+#include "../src/binary_ast.h"
+#include "../src/iterative_parser.h"
+#include "../src/mapped_file.h"
+#include "../src/render_pipeline.h"
+
+static std::string getTestFileName() {
+    return "/tmp/ast-builder-pipeline-" + std::to_string(getpid());
+}
+
+/**
+ * @return shell command that waits until the file exists, but not longer than 5 seconds.
+ */
+static std::string getWaitCommand(const std::string& fileName) {
+    return "n=0; while [ ! -e " + quoteForShell(fileName) + " ] && [ $n -lt 500 ]; do sleep 0.01; n=$((n+1)); done";
+}
+
+static void writeFile(const std::string& fileName, const std::string& content) {
+    FILE* file = fopen(fileName.c_str(), "w");
+    ASSERT_NOT_NULL(file);
+    ASSERT_EQUALS(fwrite(content.data(), 1, content.size(), file), content.size());
+    fclose(file);
+}
+
+static size_t getFileSize(const std::string& fileName) {
+    struct stat fileStat;
+    return (stat(fileName.c_str(), &fileStat) == 0) ? (size_t)fileStat.st_size : 0;
+}
+
+TEST(RenderPipeline, launchDoesNotBlock) {
+    const std::string fileName = getTestFileName();
+    RenderPipeline pipeline(2);
+    // Process waits for the file that is created only after launch returns, so launch can't wait for the process
+    pipeline.launch("wait", getWaitCommand(fileName) + "; [ -e " + quoteForShell(fileName) + " ] && touch " +
+                            quoteForShell(fileName + ".seen") + "; sleep 0.1");
+    FILE* file = fopen(fileName.c_str(), "w");
+    ASSERT_NOT_NULL(file);
+    fclose(file);
+
+    pipeline.waitAll();
+    ASSERT_EQUALS(access((fileName + ".seen").c_str(), F_OK), 0);
+    ASSERT_EQUALS(pipeline.getTimings().size(), 1u);
+    ASSERT_EQUALS(pipeline.getTimings()[0].stage, "wait");
+    ASSERT_TRUE(pipeline.getTimings()[0].milliseconds >= 100);
+
+    unlink(fileName.c_str());
+    unlink((fileName + ".seen").c_str());
+}
+
+TEST(RenderPipeline, processesNumberBounded) {
+    const std::string directory = getTestFileName() + "-processes";
+    ASSERT_EQUALS(mkdir(directory.c_str(), 0700), 0);
+    RenderPipeline pipeline(2);
+    const size_t processesNumber = 6;
+    for (size_t i = 0; i < processesNumber; ++i) {
+        // Process saves the number of finished ones when it starts and waits until it's pair (0 and 1, 2 and 3, ...)
+        // starts too, so the pair must run concurrently
+        const std::string path = quoteForShell(directory) + "/";
+        pipeline.launch("process " + std::to_string(i),
+                        "ls " + path + " | grep -c '^finished' > " + path + "started-" + std::to_string(i) +
+                        "; touch " + path + "running-" + std::to_string(i) + "; " +
+                        getWaitCommand(directory + "/running-" + std::to_string(i ^ 1)) + "; [ -e " + path + "running-" +
+                        std::to_string(i ^ 1) + " ] && touch " + path + "met-" + std::to_string(i) +
+                        "; touch " + path + "finished-" + std::to_string(i));
+    }
+    pipeline.waitAll();
+    ASSERT_EQUALS(pipeline.getTimings().size(), processesNumber);
+
+    for (size_t i = 0; i < processesNumber; ++i) {
+        const std::string suffix = "-" + std::to_string(i);
+        ASSERT_EQUALS(access((directory + "/met" + suffix).c_str(), F_OK), 0);
+        // Process is launched only after all the previous ones except one have exited
+        FILE* file = fopen((directory + "/started" + suffix).c_str(), "r");
+        ASSERT_NOT_NULL(file);
+        size_t finishedNumber = 0;
+        const int scanned = fscanf(file, "%zu", &finishedNumber);
+        fclose(file);
+        ASSERT_EQUALS(scanned, 1);
+        ASSERT_TRUE(finishedNumber + 1 >= i);
+        for (const char* name : {"/started", "/running", "/met", "/finished"}) {
+            unlink((directory + name + suffix).c_str());
+        }
+    }
+    rmdir(directory.c_str());
+}
+
+TEST(RenderPipeline, outputWritesFiles) {
+    const std::string fileName = "/tmp/ast-builder-pipeline-" + std::to_string(getpid());
+    RenderPipeline pipeline;
+    pipeline.addTiming("parse", 1.5);
+    pipeline.output(buildASTIteratively("sin(x) * x"), fileName, NO_RENDER, true);
+    pipeline.waitAll();
+
+    ASSERT_EQUALS(access((fileName + ".dot").c_str(), F_OK), 0);
+    ASSERT_EQUALS(access((fileName + ".tex").c_str(), F_OK), 0);
+    ASSERT_EQUALS(access((fileName + ".astb").c_str(), F_OK), 0);
+    ASSERT_TRUE(access((fileName + ".svg").c_str(), F_OK) != 0); // Nothing is rendered
+    const std::vector<StageTiming> timings = pipeline.getTimings();
+    ASSERT_EQUALS(timings.size(), 2u);
+    ASSERT_EQUALS(timings[0].stage, "parse");
+    ASSERT_EQUALS(timings[1].stage, "write " + fileName);
+
+    unlink((fileName + ".dot").c_str());
+    unlink((fileName + ".tex").c_str());
+    unlink((fileName + ".astb").c_str());
+}
+
+TEST(RenderPipeline, errorsRethrown) {
+    RenderPipeline pipeline;
+    pipeline.output(buildASTIteratively("x + 1"), "/nonexistent-directory/expression", NO_RENDER, false);
+    pipeline.launch("true", "true");
+
+    bool thrown = false;
+    try {
+        pipeline.waitAll();
+    } catch (const std::system_error&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+    ASSERT_EQUALS(pipeline.getTimings().size(), 1u); // Following jobs are still run
+    pipeline.waitAll();
+}
+
+TEST(RenderPipeline, commands) {
+    ASSERT_EQUALS(quoteForShell("it's"), "'it'\\''s'");
+    ASSERT_EQUALS(getTexCommand("out/expression", false),
+                  "pdflatex -interaction=batchmode -output-directory='out/' 'out/expression.tex' && "
+                  "rm -f 'out/expression.log' 'out/expression.aux'");
+    ASSERT_EQUALS(getViewCommand("expression.svg"), "xdg-open 'expression.svg'");
+}
+
+TEST(RenderPipeline, largeMappedFile) {
+    // Stages of ast-builder --file <file> --optimized --no-render --binary. Sum of parenthesised sums is wide, but not deep.
+    const std::string fileName = getTestFileName() + "-large";
+    std::string expression;
+    for (int i = 0; i < 100; ++i) {
+        expression += (i == 0) ? "(" : " + (";
+        for (int j = 0; j < 200; ++j) {
+            expression += (j == 0) ? "x * " : " - x * ";
+            expression += std::to_string(j);
+        }
+        expression += ")";
+    }
+    writeFile(fileName + ".txt", expression);
+
+    FullOptimizer optimizer;
+    RenderPipeline pipeline(2);
+    std::shared_ptr<ASTNode> root;
+    {
+        MappedFile file((fileName + ".txt").c_str());
+        root = buildASTFromRange(file.begin(), file.end());
+    }
+    optimizer.optimize(root);
+    pipeline.output(root, fileName, NO_RENDER, true);
+    auto derivative = differentiate(root, "x");
+    optimizer.optimize(derivative);
+    pipeline.output(derivative, fileName + "-derivative", NO_RENDER, true);
+    pipeline.waitAll();
+
+    for (const std::string& name : {fileName, fileName + "-derivative"}) {
+        for (const char* extension : {".dot", ".tex", ".astb"}) {
+            ASSERT_TRUE(getFileSize(name + extension) > 0);
+        }
+    }
+    {
+        MappedAST file((fileName + "-derivative.astb").c_str());
+        ASSERT_TRUE(file.getView().toAST()->structurallyEquals(*derivative));
+    }
+
+    // The same number of terms in one sum is too deep for the stages after parsing, so it's rejected by the parser
+    std::string sum = "x";
+    for (int i = 0; i < 20000; ++i) {
+        sum += " + x";
+    }
+    writeFile(fileName + ".txt", sum);
+    {
+        MappedFile file((fileName + ".txt").c_str());
+        ASSERT_EQUALS(tryBuildASTFromRange(file.begin(), file.end()).getError().code, MAX_NESTING_DEPTH_EXCEEDED);
+    }
+
+    unlink((fileName + ".txt").c_str());
+    for (const std::string& name : {fileName, fileName + "-derivative"}) {
+        for (const char* extension : {".dot", ".tex", ".astb"}) {
+            unlink((name + extension).c_str());
+        }
+    }
+}
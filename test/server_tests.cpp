@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Tests for expression server and client
+ */
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "testlib.h"
+#include "../src/expression_client.h"
+#include "../src/expression_server.h"
+
+static std::string getSocketPath() {
+    return "/tmp/ast-builder-test-" + std::to_string(getpid()) + ".sock";
+}
+
+TEST(ExpressionServer, handleRequest) {
+    ExpressionServer server(getSocketPath().c_str());
+    std::string response;
+
+    server.handleRequest("PARSE x ^ 2 + 0 * y", response);
+    ASSERT_EQUALS(response, "OK 1\n");
+    server.handleRequest("OPTIMIZE 1", response);
+    server.handleRequest("DIFF 2 x", response);
+    server.handleRequest("EVAL 3 x=3", response);
+    server.handleRequest("EVAL 1 x=3", response);
+    server.handleRequest("EVAL 1 x=3,y=1", response);
+    server.handleRequest("RELEASE 1", response);
+    server.handleRequest("EVAL 1 x=3,y=1", response);
+
+    ASSERT_EQUALS(response, "OK 1\nOK 2\nOK 3\nOK 6\nERROR Variable 'y' has no value\nOK 9\nOK\nERROR Unknown handle\n");
+    ASSERT_EQUALS(server.getExpressionsNumber(), 2u);
+}
+
+TEST(ExpressionServer, invalidRequests) {
+    ExpressionServer server(getSocketPath().c_str());
+    std::string response;
+
+    server.handleRequest("PARSE 1 + (2", response);
+    server.handleRequest("PARSE x ^ x", response);
+    server.handleRequest("DIFF 1 x", response);
+    server.handleRequest("DIFF one x", response);
+    server.handleRequest("SIMPLIFY 1", response);
+
+    ASSERT_EQUALS(response, "ERROR EXPECTED_CLOSING_PARENTHESIS 6 Expected closing parenthesis\n"
+                            "OK 1\n"
+                            "ERROR Derivative of f(x)^g(x) is not supported yet\n"
+                            "ERROR Invalid handle\n"
+                            "ERROR Unknown command\n");
+}
+
+TEST(ExpressionServer, tooDeepExpression) {
+    const std::string socketPath = getSocketPath();
+    ExpressionServer server(socketPath.c_str());
+    std::thread serverThread(&ExpressionServer::run, &server);
+    std::string powers;
+    for (int i = 0; i < 100000; ++i) {
+        powers += "2 ^ ";
+    }
+    powers += "x";
+
+    ExpressionClient client(socketPath.c_str());
+    ASSERT_EQUALS(client.request("PARSE " + powers).compare(0, 33, "ERROR MAX_NESTING_DEPTH_EXCEEDED "), 0);
+    ASSERT_EQUALS(client.request("PARSE " + std::string(100000, '-') + "x").compare(0, 33, "ERROR MAX_NESTING_DEPTH_EXCEEDED "), 0);
+    // Rejected expressions aren't stored, so the connection and the server keep working
+    ASSERT_EQUALS(client.request("PARSE x * x"), "OK 1");
+    ASSERT_EQUALS(client.request("DIFF 1 x"), "OK 2");
+    ASSERT_EQUALS(server.getExpressionsNumber(), 2u);
+
+    server.stop();
+    serverThread.join();
+}
+
+TEST(ExpressionServer, cachedParse) {
+    ExpressionServer server(getSocketPath().c_str());
+    std::string response;
+
+    server.handleRequest("PARSE x * (y + 1)", response);
+    server.handleRequest("PARSE x*(y+1)", response);
+    server.handleRequest("PARSE (x) * ((y) + 1)", response);
+    server.handleRequest("EVAL 3 x=2,y=1", response);
+    server.handleRequest("PRINT 3", response);
+    server.handleRequest("STATS", response);
+
+    ASSERT_EQUALS(response, "OK 1\nOK 2\nOK 3\nOK 4\nOK x * (y + 1)\nOK hits=1 misses=2 evictions=0 size=2\n");
+}
+
+TEST(ExpressionServer, pipelinedRequestsOverSocket) {
+    const std::string socketPath = getSocketPath();
+    ExpressionServer server(socketPath.c_str());
+    std::thread serverThread(&ExpressionServer::run, &server);
+
+    ExpressionClient client(socketPath.c_str());
+    ASSERT_EQUALS(client.request("PARSE 2 * x"), "OK 1");
+    for (int i = 0; i < 1000; ++i) {
+        client.send("EVAL 1 x=" + std::to_string(i));
+    }
+    bool allCorrect = true;
+    for (int i = 0; i < 1000; ++i) {
+        allCorrect = allCorrect && (client.receive() == "OK " + std::to_string(2 * i));
+    }
+    ASSERT_TRUE(allCorrect);
+
+    server.stop();
+    serverThread.join();
+}
@@ -0,0 +1,158 @@
+/**
+ * @file
+ * @brief Tests for shared-memory ring buffer
+ */
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "testlib.h"
+#include "../src/compiled_expression.h"
+#include "../src/iterative_parser.h"
+#include "../src/shm_ring.h"
+
+static std::string getRingName() {
+    return "/ast-builder-test-" + std::to_string(getpid());
+}
+
+TEST(CompiledExpression, evaluateColumns) {
+    CompiledExpression expression(buildASTIteratively("-x ^ 2 + sin(y) / (x - 3 * y)"));
+    const size_t rowsNumber = 1000; // Not a multiple of the block size
+    std::vector<double> x(rowsNumber);
+    std::vector<double> y(rowsNumber);
+    for (size_t i = 0; i < rowsNumber; ++i) {
+        x[i] = 0.5 * (double)i + 0.25;
+        y[i] = 1. / (double)(i + 1);
+    }
+    const double* columns[] = { x.data(), y.data() };
+    std::vector<double> results(rowsNumber);
+
+    expression.evaluateColumns(columns, rowsNumber, results.data());
+
+    for (size_t i = 0; i < rowsNumber; ++i) {
+        const double values[] = { x[i], y[i] };
+        ASSERT_DOUBLE_EQUALS(results[i], expression.evaluate(values));
+    }
+}
+
+TEST(ShmRing, evaluateThroughRing) {
+    const std::string name = getRingName();
+    // Columns go in different order than variables of the expression, 'z' is not used
+    ShmRingProducer producer(name.c_str(), "x * y + 1", { "y", "z", "x" }, 3, 100);
+    ShmRingEvaluator evaluator(name.c_str());
+    size_t evaluatedRows = 0;
+    std::thread evaluatorThread([&]() { evaluatedRows = evaluator.run(); });
+
+    const size_t rowsNumber = 1234;
+    std::vector<double> x(rowsNumber);
+    std::vector<double> y(rowsNumber, 2.);
+    std::vector<double> z(rowsNumber, -1.);
+    for (size_t i = 0; i < rowsNumber; ++i) {
+        x[i] = (double)i;
+    }
+    const double* columns[] = { y.data(), z.data(), x.data() };
+    std::vector<double> results(rowsNumber);
+    producer.evaluate(columns, rowsNumber, results.data());
+    producer.close();
+    evaluatorThread.join();
+
+    ASSERT_EQUALS(evaluatedRows, rowsNumber);
+    for (size_t i = 0; i < rowsNumber; ++i) {
+        ASSERT_DOUBLE_EQUALS(results[i], 2. * (double)i + 1);
+    }
+}
+
+TEST(ShmRing, missingColumn) {
+    const std::string name = getRingName();
+    ShmRingProducer producer(name.c_str(), "x * y", { "x" });
+
+    bool thrown = false;
+    try {
+        ShmRingEvaluator evaluator(name.c_str());
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+}
+
+static bool isRingRejected(const std::string& name) {
+    try {
+        ShmRingEvaluator evaluator(name.c_str());
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+TEST(ShmRing, corruptedHeader) {
+    const std::string name = getRingName();
+    ShmRingProducer producer(name.c_str(), "x + y", { "x", "y" }, 4, 16);
+    const int fd = shm_open(name.c_str(), O_RDWR, 0);
+    ASSERT_TRUE(fd >= 0);
+    const size_t headerSize = 32 + ShmRing::MAX_EXPRESSION_LENGTH;
+    char* header = (char*)mmap(nullptr, headerSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    ASSERT_TRUE(header != MAP_FAILED);
+    // Header starts with the magic, the version, numbers of slots, rows per slot and variables, and the expression
+    uint64_t* slotsNumber = (uint64_t*)(header + 8);
+    uint64_t* rowsPerSlot = (uint64_t*)(header + 16);
+    uint64_t* variablesNumber = (uint64_t*)(header + 24);
+    char* expression = header + 32;
+    ASSERT_TRUE(!isRingRejected(name));
+
+    for (uint64_t* size : {slotsNumber, rowsPerSlot, variablesNumber}) {
+        const uint64_t value = *size;
+        for (uint64_t corruptedValue : {(uint64_t)0, (uint64_t)100, UINT64_MAX / 2, UINT64_MAX}) {
+            *size = corruptedValue;
+            ASSERT_TRUE(isRingRejected(name) || ((size == variablesNumber) && (corruptedValue == 0)));
+        }
+        *size = value;
+    }
+
+    std::string savedExpression(expression);
+    memset(expression, 'x', ShmRing::MAX_EXPRESSION_LENGTH);
+    ASSERT_TRUE(isRingRejected(name));
+    strcpy(expression, savedExpression.c_str());
+    ASSERT_TRUE(!isRingRejected(name));
+    munmap(header, headerSize);
+}
+
+TEST(ShmRing, deadEvaluator) {
+    const std::string name = getRingName();
+    const size_t rowsNumber = 100;
+    std::vector<double> x(rowsNumber, 1.);
+    std::vector<double> results(rowsNumber);
+    const double* columns[] = { x.data() };
+    bool thrown = false;
+    {
+        ShmRingProducer producer(name.c_str(), "x + 1", { "x" }, 2, 10);
+        const pid_t pid = fork();
+        ASSERT_TRUE(pid >= 0);
+        if (pid == 0) {
+            // Evaluator opens the ring and exits without evaluating anything
+            try {
+                ShmRingEvaluator evaluator(name.c_str());
+            } catch (...) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+        try {
+            producer.evaluate(columns, rowsNumber, results.data());
+        } catch (const std::system_error&) {
+            thrown = true;
+        }
+        // Ring is full, destructor doesn't wait for the evaluator either
+    }
+    ASSERT_TRUE(thrown);
+}
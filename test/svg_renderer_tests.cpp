@@ -0,0 +1,127 @@
+/**
+ * @file
+ * @brief Tests for tidy tree layout and SVG rendering of AST
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include "testlib.h"
+#include "../src/iterative_parser.h"
+#include "../src/svg_renderer.h"
+
+/**
+ * Generates a random expression with the given number of binary operators.
+ */
+static std::string generateExpression(std::minstd_rand& random, size_t operatorsNumber) {
+    if (operatorsNumber == 0) {
+        return random() % 2 == 0 ? "x" : "12.5";
+    }
+    const size_t leftOperatorsNumber = random() % operatorsNumber;
+    const char* operators[] = { " + ", " - ", " * ", " / " };
+    return "(" + generateExpression(random, leftOperatorsNumber) + operators[random() % 4] +
+           (random() % 3 == 0 ? "sin(" + generateExpression(random, operatorsNumber - 1 - leftOperatorsNumber) + ")"
+                              : generateExpression(random, operatorsNumber - 1 - leftOperatorsNumber)) + ")";
+}
+
+static void checkLayout(const std::vector<LayoutNode>& layout) {
+    // Nodes of every level don't overlap
+    std::map<size_t, std::vector<const LayoutNode*> > levels;
+    for (const LayoutNode& node : layout) {
+        ASSERT_TRUE(node.x - node.width / 2 >= -1e-9);
+        levels[node.depth].push_back(&node);
+    }
+    for (auto& level : levels) {
+        std::vector<const LayoutNode*>& nodes = level.second;
+        std::sort(nodes.begin(), nodes.end(), [](const LayoutNode* a, const LayoutNode* b) { return a->x < b->x; });
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            ASSERT_TRUE(nodes[i]->x - nodes[i - 1]->x >= (nodes[i]->width + nodes[i - 1]->width) / 2 - 1e-6);
+        }
+    }
+
+    // Parent is centered above it's children, left child is on the left
+    std::vector<std::vector<size_t> > children(layout.size());
+    for (size_t i = 1; i < layout.size(); ++i) {
+        ASSERT_TRUE(layout[i].parent < i);
+        ASSERT_EQUALS(layout[i].depth, layout[layout[i].parent].depth + 1);
+        children[layout[i].parent].push_back(i);
+    }
+    for (size_t i = 0; i < layout.size(); ++i) {
+        if (children[i].empty()) continue;
+        const double center = (layout[children[i].front()].x + layout[children[i].back()].x) / 2;
+        ASSERT_TRUE(std::fabs(layout[i].x - center) < 1e-6);
+        ASSERT_TRUE(layout[children[i].front()].x <= layout[children[i].back()].x);
+    }
+}
+
+TEST(SVGRenderer, layoutSmallTree) {
+    const auto root = buildASTIteratively("sin(x) - 2.5");
+    const std::vector<LayoutNode> layout = layoutAST(*root);
+
+    ASSERT_EQUALS(layout.size(), 4u);
+    ASSERT_TRUE(layout[0].node == root.get());
+    ASSERT_EQUALS(layout[0].parent, NO_PARENT);
+    ASSERT_TRUE(layout[1].node == root->getChildren()[0].get()); // Pre-order: '-', 'sin', 'x', '2.5'
+    ASSERT_TRUE(layout[3].node == root->getChildren()[1].get());
+    ASSERT_EQUALS(layout[2].depth, 2u);
+    ASSERT_TRUE(std::fabs(layout[1].x - layout[2].x) < 1e-9);
+    checkLayout(layout);
+}
+
+TEST(SVGRenderer, layoutRandomTrees) {
+    std::minstd_rand random(42);
+    for (size_t operatorsNumber = 1; operatorsNumber <= 300; operatorsNumber += 7) {
+        const auto root = buildASTIteratively(generateExpression(random, operatorsNumber).c_str());
+        checkLayout(layoutAST(*root));
+    }
+}
+
+TEST(SVGRenderer, layoutEqualSubtreesEqually) {
+    const auto root = buildASTIteratively("(x * (x + 1) - 2) + (x * (x + 1) - 2)");
+    const std::vector<LayoutNode> layout = layoutAST(*root);
+
+    ASSERT_EQUALS(layout.size() % 2, 1u);
+    const size_t subtreeSize = layout.size() / 2;
+    for (size_t i = 1; i <= subtreeSize; ++i) {
+        ASSERT_TRUE(std::fabs((layout[i].x - layout[1].x) - (layout[i + subtreeSize].x - layout[1 + subtreeSize].x)) < 1e-6);
+    }
+    checkLayout(layout);
+}
+
+TEST(SVGRenderer, sharedNodesLaidOutOnce) {
+    const auto shared = buildASTIteratively("x + 1");
+    const auto root = std::make_shared<ASTNode>(std::make_shared<MultiplicationOperator>(), shared, shared);
+    const std::vector<LayoutNode> layout = layoutAST(*root);
+    ASSERT_EQUALS(layout.size(), 4u);
+
+    char* data = nullptr;
+    size_t size = 0;
+    FILE* file = open_memstream(&data, &size);
+    svgPrint(*root, file);
+    fclose(file);
+    const std::string svg(data, size);
+    free(data);
+
+    size_t linesNumber = 0;
+    for (size_t position = svg.find("<line"); position != std::string::npos; position = svg.find("<line", position + 1)) {
+        ++linesNumber;
+    }
+    ASSERT_EQUALS(linesNumber, 4u); // Both edges of '*' go to the same node
+    ASSERT_TRUE(svg.find("<svg ") == 0);
+    ASSERT_TRUE(svg.find(">binary op<tspan") != std::string::npos);
+    ASSERT_TRUE(svg.find(">value: 1</tspan>") != std::string::npos);
+    ASSERT_TRUE(svg.find("fill:#99FF9D") != std::string::npos);
+    ASSERT_TRUE(svg.rfind("</svg>\n") == svg.size() - 7);
+}
+
+TEST(SVGRenderer, layoutDeepTree) {
+    auto root = buildASTIteratively("x - 1");
+    for (int i = 0; i < 100000; ++i) {
+        root = std::make_shared<ASTNode>(std::make_shared<AdditionOperator>(), buildASTIteratively("y"), root);
+    }
+    const std::vector<LayoutNode> layout = layoutAST(*root);
+    ASSERT_EQUALS(layout.size(), 200003u);
+    checkLayout(layout);
+}
@@ -0,0 +1,102 @@
+/**
+ * @file
+ * @brief Tests for TeX writer of AST
+ */
+#include <string>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/iterative_parser.h"
+#include "../src/tex_writer.h"
+
+static std::string printTeX(const std::shared_ptr<ASTNode>& root, const TexOptions& options = TexOptions()) {
+    OutputBuffer buffer;
+    texPrint(*root, buffer, options);
+    return buffer.release();
+}
+
+/**
+ * @return text between "\begin{align*}" and "\end{align*}".
+ */
+static std::string printTeXLines(const std::shared_ptr<ASTNode>& root, const TexOptions& options = TexOptions()) {
+    const std::string document = printTeX(root, options);
+    const size_t start = document.find("\\begin{align*}\n") + 15;
+    return document.substr(start, document.find("\n\\end{align*}") - start);
+}
+
+TEST(TexWriter, document) {
+    ASSERT_EQUALS(printTeX(buildASTIteratively("sin(x) - 2.5 / y")),
+                  "\\documentclass{article}\n\\usepackage{amsmath}\n\\allowdisplaybreaks\n"
+                  "\\begin{document}\n\\begin{align*}\n"
+                  "&{sin}{x} - \\frac{{2.5}}{{y}}\n"
+                  "\\end{align*}\n\\end{document}\n");
+}
+
+TEST(TexWriter, braces) {
+    ASSERT_EQUALS(printTeXLines(buildASTIteratively("(a - (b - c)) * -(d + e) ^ (f * g)")),
+                  "&({a} - ({b} - {c})) * (-({d} + {e})) ^ {{f} * {g}}");
+}
+
+TEST(TexWriter, repeatedSubtreesNamed) {
+    ASSERT_EQUALS(printTeXLines(buildASTIteratively("(sin(x * y + 1) + 2) * (sin(x * y + 1) + 2)")),
+                  "&{\\mathcal{A}} * {\\mathcal{A}} \\\\\n"
+                  "\\text{where } {\\mathcal{A}} &= {sin}({x} * {y} + {1}) + {2}");
+}
+
+TEST(TexWriter, nestedNames) {
+    TexOptions options;
+    options.minNamedSize = 3;
+    // Inner subtree is repeated only inside the definition of the outer one
+    ASSERT_EQUALS(printTeXLines(buildASTIteratively("(x + 1) * (x + 1) + (x + 1) * (x + 1)"), options),
+                  "&{\\mathcal{A}} + {\\mathcal{A}} \\\\\n"
+                  "\\text{where } {\\mathcal{A}} &= {\\mathcal{B}} * {\\mathcal{B}} \\\\\n"
+                  "{\\mathcal{B}} &= {x} + {1}");
+
+    options.minNamedSize = 0;
+    ASSERT_EQUALS(printTeXLines(buildASTIteratively("(x + 1) * (x + 1) + (x + 1) * (x + 1)"), options),
+                  "&({x} + {1}) * ({x} + {1}) + ({x} + {1}) * ({x} + {1})");
+}
+
+TEST(TexWriter, longSumsBroken) {
+    std::string expression = "x0";
+    for (int i = 1; i < 100; ++i) {
+        expression += (i % 2 == 0 ? " + x" : " - x") + std::to_string(i);
+    }
+    TexOptions options;
+    options.maxLineLength = 40;
+    const std::string lines = printTeXLines(buildASTIteratively(expression.c_str()), options);
+
+    ASSERT_TRUE(lines.find("&{x0} - {x1} + {x2}") == 0);
+    size_t linesNumber = 0;
+    size_t lineStart = 0;
+    for (size_t lineEnd = lines.find(" \\\\\n"); lineEnd != std::string::npos; lineEnd = lines.find(" \\\\\n", lineStart)) {
+        ASSERT_TRUE(lineEnd - lineStart <= 40 + 20); // Line is broken after the term that crosses the limit
+        ASSERT_TRUE(lines.compare(lineEnd + 4, 8, "&\\quad -") == 0 || lines.compare(lineEnd + 4, 8, "&\\quad +") == 0);
+        lineStart = lineEnd + 4;
+        ++linesNumber;
+    }
+    ASSERT_TRUE(linesNumber >= 10);
+}
+
+TEST(TexWriter, derivativeIsSmall) {
+    // Derivative of every level contains derivative of the previous one twice
+    auto root = buildASTIteratively("x");
+    for (int i = 0; i < 8; ++i) {
+        const std::string previous = root->toInfix();
+        root = buildASTIteratively(("sin(" + previous + ") * cos(" + previous + ")").c_str());
+    }
+    const auto derivative = differentiate(root, "x");
+    TexOptions options;
+    options.minNamedSize = 0;
+    const size_t inlineSize = printTeX(derivative, options).size();
+    const size_t namedSize = printTeX(derivative).size();
+    ASSERT_TRUE(namedSize * 20 < inlineSize);
+}
+
+TEST(TexWriter, deepTree) {
+    auto root = buildASTIteratively("x");
+    for (int i = 0; i < 100000; ++i) {
+        root = std::make_shared<ASTNode>(std::make_shared<ArithmeticNegationOperator>(), root);
+    }
+    const std::string lines = printTeXLines(root);
+    ASSERT_EQUALS(lines.size(), 2 + 99999 * 3 + 3u); // "&-", "(-" and ")" for every nested negation, "{x}"
+}
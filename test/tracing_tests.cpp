@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief Tests for trace spans and Chrome trace export
+ */
+#include <set>
+#include <string>
+#include <thread>
+#include "testlib.h"
+#include "../src/ast-math.h"
+#include "../src/ast-optimizers.h"
+#include "../src/iterative_parser.h"
+#include "../src/tracing.h"
+
+static std::string getChromeTrace() {
+    OutputBuffer buffer;
+    writeChromeTrace(buffer);
+    return buffer.release();
+}
+
+static size_t countOccurrences(const std::string& text, const std::string& pattern) {
+    size_t occurrencesNumber = 0;
+    for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1)) {
+        ++occurrencesNumber;
+    }
+    return occurrencesNumber;
+}
+
+TEST(Tracing, disabledByDefault) {
+    ASSERT_TRUE(!isTracingEnabled());
+    clearTrace();
+    {
+        TRACE_SCOPE("ignored");
+    }
+    ASSERT_EQUALS(getChromeTrace(), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n]}\n");
+}
+
+TEST(Tracing, nestedSpans) {
+    clearTrace();
+    setTracing(true);
+    {
+        TRACE_SCOPE("outer");
+        {
+            TRACE_SCOPE("inner \"quoted\"");
+        }
+    }
+    setTracing(false);
+
+    const std::string trace = getChromeTrace();
+    ASSERT_EQUALS(countOccurrences(trace, "\"ph\":\"X\""), 2u);
+    // Inner span ends first
+    const size_t innerPosition = trace.find("{\"name\":\"inner \\\"quoted\\\"\",\"ph\":\"X\",\"pid\":");
+    const size_t outerPosition = trace.find("{\"name\":\"outer\",\"ph\":\"X\",\"pid\":");
+    ASSERT_TRUE(innerPosition < outerPosition);
+    ASSERT_TRUE(outerPosition != std::string::npos);
+    ASSERT_TRUE(trace.find("\"args\":{\"depth\":1}}", innerPosition) < outerPosition);
+    ASSERT_TRUE(trace.find("\"args\":{\"depth\":0}}", outerPosition) != std::string::npos);
+}
+
+TEST(Tracing, spanPerCall) {
+    auto root = buildASTIteratively("+(x * 1 + 0) * (sin(x) + 2 * 3) - --y");
+    clearTrace();
+    setTracing(true);
+    root = FullOptimizer().optimize(root);
+    differentiate(root, "x");
+    setTracing(false);
+
+    // Recursion into the children doesn't make spans
+    const std::string trace = getChromeTrace();
+    ASSERT_EQUALS(countOccurrences(trace, "\"name\":\"FullOptimizer\""), 1u);
+    ASSERT_EQUALS(countOccurrences(trace, "\"name\":\"UnaryAdditionOptimizer\""), 1u);
+    ASSERT_EQUALS(countOccurrences(trace, "\"name\":\"TrivialOperationsOptimizer\""), 1u);
+    ASSERT_EQUALS(countOccurrences(trace, "\"name\":\"differentiate\""), 1u);
+    ASSERT_EQUALS(countOccurrences(trace, "\"ph\":\"X\""), 5u);
+}
+
+TEST(Tracing, threads) {
+    clearTrace();
+    setTracing(true);
+    {
+        TRACE_SCOPE("main");
+        std::thread thread([]() {
+            TRACE_SCOPE("worker");
+        });
+        thread.join();
+    }
+    setTracing(false);
+
+    // Span of the exited thread is kept
+    const std::string trace = getChromeTrace();
+    std::set<std::string> threadIds;
+    for (size_t position = trace.find("\"tid\":"); position != std::string::npos; position = trace.find("\"tid\":", position + 1)) {
+        threadIds.insert(trace.substr(position, trace.find(',', position) - position));
+    }
+    ASSERT_EQUALS(threadIds.size(), 2u);
+    ASSERT_EQUALS(countOccurrences(trace, "\"name\":\"worker\""), 1u);
+}
@@ -0,0 +1,148 @@
+/**
+ * @file
+ * @brief Tests for workload capture and replay
+ */
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "testlib.h"
+#include "../src/expression_client.h"
+#include "../src/expression_server.h"
+#include "../src/workload_log.h"
+
+static std::string getLogPath() {
+    return "/tmp/ast-builder-test-" + std::to_string(getpid()) + ".workload";
+}
+
+static std::string getSocketPath() {
+    return "/tmp/ast-builder-test-" + std::to_string(getpid()) + "-replay.sock";
+}
+
+TEST(WorkloadLog, recordAndRead) {
+    const std::string logPath = getLogPath();
+    unlink(logPath.c_str());
+    uint64_t firstSourceId = 0;
+    {
+        WorkloadRecorder recorder(logPath.c_str());
+        firstSourceId = recorder.getSourceId();
+        ASSERT_TRUE(recorder.record("PARSE x +\n1", 1, 1500));
+        ASSERT_TRUE(recorder.record("DIFF 1 x", 2, 700));
+    }
+    {
+        WorkloadRecorder recorder(logPath.c_str()); // Appends without the second header
+        ASSERT_TRUE(recorder.getSourceId() != firstSourceId);
+        ASSERT_TRUE(recorder.record("STATS", 0, 10));
+    }
+
+    WorkloadLogReader reader(logPath.c_str());
+    WorkloadRecord record;
+    ASSERT_TRUE(reader.next(record));
+    ASSERT_EQUALS(record.request, "PARSE x + 1");
+    ASSERT_EQUALS(record.header.sourceId, firstSourceId);
+    ASSERT_EQUALS(record.header.createdHandle, 1u);
+    ASSERT_EQUALS(record.header.duration, 1500u);
+    const uint64_t firstTimestamp = record.header.timestamp;
+    ASSERT_TRUE(reader.next(record));
+    ASSERT_EQUALS(record.request, "DIFF 1 x");
+    ASSERT_TRUE(record.header.timestamp >= firstTimestamp);
+    ASSERT_TRUE(reader.next(record));
+    ASSERT_EQUALS(record.request, "STATS");
+    ASSERT_TRUE(record.header.sourceId != firstSourceId);
+    ASSERT_TRUE(!reader.next(record));
+    ASSERT_TRUE(!reader.isTruncated());
+    unlink(logPath.c_str());
+}
+
+TEST(WorkloadLog, truncatedRecord) {
+    const std::string logPath = getLogPath();
+    unlink(logPath.c_str());
+    {
+        WorkloadRecorder recorder(logPath.c_str());
+        recorder.record("PARSE sin(x)", 1, 100);
+        recorder.record("PARSE cos(x)", 2, 100);
+    }
+    ASSERT_EQUALS(truncate(logPath.c_str(), sizeof(WorkloadLogHeader) + 2 * sizeof(WorkloadRecordHeader) + 15), 0);
+
+    WorkloadLogReader reader(logPath.c_str());
+    WorkloadRecord record;
+    ASSERT_TRUE(reader.next(record));
+    ASSERT_EQUALS(record.request, "PARSE sin(x)");
+    ASSERT_TRUE(!reader.next(record));
+    ASSERT_TRUE(reader.isTruncated());
+    unlink(logPath.c_str());
+}
+
+TEST(WorkloadLog, invalidLog) {
+    const std::string logPath = getLogPath();
+    FILE* file = fopen(logPath.c_str(), "w");
+    fputs("PARSE x + 1\n", file);
+    fclose(file);
+
+    bool thrown = false;
+    try {
+        WorkloadLogReader reader(logPath.c_str());
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT_TRUE(thrown);
+    unlink(logPath.c_str());
+}
+
+TEST(WorkloadLog, createdHandle) {
+    ASSERT_EQUALS(getCreatedHandle("PARSE x", "OK 12"), 12u);
+    ASSERT_EQUALS(getCreatedHandle("OPTIMIZE 3", "OK 4"), 4u);
+    ASSERT_EQUALS(getCreatedHandle("DIFF 3 x", "ERROR Unknown handle"), 0u);
+    ASSERT_EQUALS(getCreatedHandle("EVAL 3 x=1", "OK 5"), 0u);
+    ASSERT_EQUALS(getCreatedHandle("PARSER x", "OK 5"), 0u);
+}
+
+TEST(WorkloadLog, serverRecordingAndReplay) {
+    const std::string logPath = getLogPath();
+    unlink(logPath.c_str());
+    {
+        WorkloadRecorder recorder(logPath.c_str());
+        ExpressionServer server(getSocketPath().c_str(), DEFAULT_CACHE_CAPACITY, &recorder);
+        std::string response;
+        server.handleRequest("PARSE x ^ 2 + 0 * y", response);
+        server.handleRequest("OPTIMIZE 1", response);
+        server.handleRequest("DIFF 2 x", response);
+        server.handleRequest("EVAL 3 x=3", response);
+        server.handleRequest("PARSE 1 + (2", response);
+        server.handleRequest("EVAL 42 x=1", response); // Handle that isn't created in the log
+        server.handleRequest("RELEASE 1", response);
+        ASSERT_EQUALS(response, "OK 1\nOK 2\nOK 3\nOK 6\nERROR EXPECTED_CLOSING_PARENTHESIS 6 Expected closing parenthesis\n"
+                                "ERROR Unknown handle\nOK\n");
+    }
+
+    // Replay server already has handles, so recorded handles must be mapped
+    const std::string socketPath = getSocketPath();
+    ExpressionServer server(socketPath.c_str());
+    std::string response;
+    server.handleRequest("PARSE y", response);
+    server.handleRequest("PARSE z", response);
+    std::thread serverThread(&ExpressionServer::run, &server);
+    {
+        WorkloadLogReader reader(logPath.c_str());
+        ExpressionClient client(socketPath.c_str());
+        ReplayOptions options;
+        options.rate = 200.;
+        const ReplayStatistics statistics = replayWorkload(reader, client, options);
+
+        ASSERT_EQUALS(statistics.requestsNumber, 6u);
+        ASSERT_EQUALS(statistics.errorsNumber, 1u); // Parse error
+        ASSERT_EQUALS(statistics.skippedNumber, 1u);
+        ASSERT_TRUE(statistics.seconds >= 5. / 200.);
+        ASSERT_EQUALS(statistics.commands.size(), 5u);
+        ASSERT_EQUALS(statistics.commands[0].command, "PARSE");
+        ASSERT_EQUALS(statistics.commands[0].latencies.size(), 2u);
+        ASSERT_EQUALS(statistics.commands[0].errorsNumber, 1u);
+        ASSERT_EQUALS(statistics.commands[3].command, "EVAL");
+        ASSERT_EQUALS(statistics.commands[3].errorsNumber, 0u);
+        ASSERT_EQUALS(client.request("STATS").substr(0, 3), "OK ");
+    }
+    server.stop();
+    serverThread.join();
+    ASSERT_EQUALS(server.getExpressionsNumber(), 2u); // Replayed handles are released
+    unlink(logPath.c_str());
+}
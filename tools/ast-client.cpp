@@ -0,0 +1,171 @@
+/**
+ * @file
+ * @brief Client and load generator for the expression server
+ *
+ * Interactive mode sends request lines from stdin and prints the responses:
+ *     ast-client <socket>
+ *
+ * Load mode parses the expression once per connection and then sends EVAL requests, keeping the given number
+ * of requests in flight on every connection. Latency is measured from sending a request to receiving it's response:
+ *     ast-client <socket> --load [--connections <n>] [--requests <n>] [--pipeline <n>] [--expression <e>] [--values <v>]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "../src/expression_client.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadOptions {
+    size_t connectionsNumber = 4;
+    size_t requestsNumber = 100000;
+    size_t pipelineDepth = 1;
+    std::string expression = "sin(x) * x ^ 2 + ln(y) / 3";
+    std::string values = "x=1.5,y=2";
+};
+
+static int runInteractive(const char* socketPath) {
+    ExpressionClient client(socketPath);
+    std::string request;
+    while (std::getline(std::cin, request)) {
+        printf("%s\n", client.request(request).c_str());
+        fflush(stdout);
+    }
+    return 0;
+}
+
+/**
+ * Runs the requests of one connection.
+ * @param latencies latencies of the requests in nanoseconds
+ */
+static void runConnection(const char* socketPath, const LoadOptions& options, size_t requestsNumber, std::vector<double>& latencies) {
+    ExpressionClient client(socketPath);
+    const std::string parseResponse = client.request("PARSE " + options.expression);
+    if (strncmp(parseResponse.c_str(), "OK ", 3) != 0) {
+        throw std::system_error(EINVAL, std::generic_category(), "Can't parse expression: " + parseResponse);
+    }
+    const std::string request = "EVAL " + parseResponse.substr(3) + " " + options.values;
+
+    std::deque<Clock::time_point> sendTimes;
+    size_t sentNumber = 0;
+    latencies.reserve(requestsNumber);
+    while (latencies.size() < requestsNumber) {
+        while ((sentNumber < requestsNumber) && (sendTimes.size() < options.pipelineDepth)) {
+            sendTimes.push_back(Clock::now());
+            client.send(request);
+            ++sentNumber;
+        }
+        const std::string response = client.receive();
+        latencies.push_back(std::chrono::duration<double, std::nano>(Clock::now() - sendTimes.front()).count());
+        sendTimes.pop_front();
+        if (strncmp(response.c_str(), "OK ", 3) != 0) {
+            throw std::system_error(EINVAL, std::generic_category(), "Request failed: " + response);
+        }
+    }
+}
+
+static double getPercentile(const std::vector<double>& sortedValues, double percentile) {
+    const size_t index = (size_t)(percentile / 100. * (double)(sortedValues.size() - 1));
+    return sortedValues[index];
+}
+
+static int runLoad(const char* socketPath, const LoadOptions& options) {
+    std::vector<std::vector<double> > latencies(options.connectionsNumber);
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(options.connectionsNumber);
+
+    const Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < options.connectionsNumber; ++i) {
+        const size_t requestsNumber = options.requestsNumber / options.connectionsNumber +
+                                      ((i < options.requestsNumber % options.connectionsNumber) ? 1 : 0);
+        threads.emplace_back([&, i, requestsNumber]() {
+            try {
+                runConnection(socketPath, options, requestsNumber, latencies[i]);
+            } catch (const std::system_error& ex) {
+                errors[i] = ex.what();
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (const std::string& error : errors) {
+        if (!error.empty()) {
+            fprintf(stderr, "Connection failed: %s\n", error.c_str());
+            return -1;
+        }
+    }
+
+    std::vector<double> allLatencies;
+    for (const auto& connectionLatencies : latencies) {
+        allLatencies.insert(allLatencies.end(), connectionLatencies.begin(), connectionLatencies.end());
+    }
+    if (allLatencies.empty()) {
+        fprintf(stderr, "No requests were sent\n");
+        return -1;
+    }
+    std::sort(allLatencies.begin(), allLatencies.end());
+
+    printf("connections: %zu, pipeline depth: %zu\n", options.connectionsNumber, options.pipelineDepth);
+    printf("requests:    %zu in %.3lf s (%.0lf req/s)\n", allLatencies.size(), seconds, (double)allLatencies.size() / seconds);
+    printf("latency us:  p50 %.1lf, p90 %.1lf, p99 %.1lf, p99.9 %.1lf, max %.1lf\n",
+           getPercentile(allLatencies, 50) / 1000., getPercentile(allLatencies, 90) / 1000.,
+           getPercentile(allLatencies, 99) / 1000., getPercentile(allLatencies, 99.9) / 1000.,
+           allLatencies.back() / 1000.);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <socket> [--load [--connections <n>] [--requests <n>] [--pipeline <n>] "
+                        "[--expression <e>] [--values <v>]]\n", argv[0]);
+        return -1;
+    }
+    const char* socketPath = argv[1];
+
+    try {
+        if (argc == 2) {
+            return runInteractive(socketPath);
+        }
+        if (strcmp(argv[2], "--load") != 0) {
+            fprintf(stderr, "Invalid option '%s'. Only '--load' is supported", argv[2]);
+            return -1;
+        }
+
+        LoadOptions options;
+        for (int i = 3; i < argc; ++i) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Missing value of option '%s'", argv[i]);
+                return -1;
+            }
+            if (strcmp(argv[i], "--connections") == 0) {
+                options.connectionsNumber = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+            } else if (strcmp(argv[i], "--requests") == 0) {
+                options.requestsNumber = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--pipeline") == 0) {
+                options.pipelineDepth = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+            } else if (strcmp(argv[i], "--expression") == 0) {
+                options.expression = argv[++i];
+            } else if (strcmp(argv[i], "--values") == 0) {
+                options.values = argv[++i];
+            } else {
+                fprintf(stderr, "Invalid option '%s'", argv[i]);
+                return -1;
+            }
+        }
+        return runLoad(socketPath, options);
+    } catch (const std::system_error& ex) {
+        fprintf(stderr, "Can't connect to the server: %s\n", ex.what());
+        return -1;
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ * @file
+ * @brief Generator of random expressions for scaling and stress tests
+ *
+ * Prints the given number of generated expressions, one per line:
+ *     ast-generate [--preset <name>] [--count <n>] [--nodes <n>] [--depth <n>] [--variables <n>] [--seed <n>]
+ *
+ * Presets are realistic (default), deep-powers, long-sums and nested-functions (see getPresetOptions).
+ * Options that are given after the preset change it's settings.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "../src/expression_generator.h"
+#include "../src/output_buffer.h"
+
+int main(int argc, char* argv[]) {
+    size_t count = 1;
+    size_t nodesNumber = GeneratorOptions().nodesNumber;
+    unsigned int seed = DEFAULT_GENERATOR_SEED;
+    GeneratorOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Missing value of option '%s'\n", argv[i]);
+                return -1;
+            }
+            if (strcmp(argv[i], "--preset") == 0) {
+                options = getPresetOptions(getPresetByName(argv[++i]), nodesNumber);
+            } else if (strcmp(argv[i], "--count") == 0) {
+                count = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--nodes") == 0) {
+                nodesNumber = strtoul(argv[++i], nullptr, 10);
+                options.nodesNumber = nodesNumber;
+            } else if (strcmp(argv[i], "--depth") == 0) {
+                options.maxDepth = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--variables") == 0) {
+                options.variablesNumber = strtoul(argv[++i], nullptr, 10);
+            } else if (strcmp(argv[i], "--seed") == 0) {
+                seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+            } else {
+                fprintf(stderr, "Invalid option '%s'\n", argv[i]);
+                return -1;
+            }
+        }
+
+        ExpressionGenerator generator(options, seed);
+        OutputBuffer buffer;
+        for (size_t i = 0; i < count; ++i) {
+            generator.generateAST()->infixPrint(buffer);
+            buffer.append('\n');
+            if (buffer.getSize() >= (1u << 20)) {
+                buffer.writeTo(stdout);
+            }
+        }
+        buffer.writeTo(stdout);
+        return 0;
+    } catch (const std::invalid_argument& ex) {
+        fprintf(stderr, "%s\n", ex.what());
+        return -1;
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @brief Replay of recorded workload against the expression server
+ *
+ * Sends requests of the workload log (see workload_log.h) to the server and prints throughput and latency
+ * percentiles compared with the recorded times:
+ *     ast-replay <log> <socket> [--rate <requests per second>] [--keep-handles]
+ *
+ * Without a rate every request is sent as soon as the previous one is answered. Records of the log are printed with:
+ *     ast-replay <log> --print
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include "../src/expression_client.h"
+#include "../src/workload_log.h"
+
+static int printLog(WorkloadLogReader& reader) {
+    WorkloadRecord record;
+    while (reader.next(record)) {
+        printf("%llu %016llx %llu %.3lf %s\n", (unsigned long long)record.header.timestamp,
+               (unsigned long long)record.header.sourceId, (unsigned long long)record.header.createdHandle,
+               (double)record.header.duration / 1000., record.request.c_str());
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <log> <socket> [--rate <requests per second>] [--keep-handles]\n"
+                        "       %s <log> --print\n", argv[0], argv[0]);
+        return -1;
+    }
+
+    try {
+        WorkloadLogReader reader(argv[1]);
+        if (strcmp(argv[2], "--print") == 0) {
+            return printLog(reader);
+        }
+
+        ReplayOptions options;
+        for (int i = 3; i < argc; ++i) {
+            if ((strcmp(argv[i], "--rate") == 0) && (i + 1 < argc)) {
+                options.rate = strtod(argv[++i], nullptr);
+            } else if (strcmp(argv[i], "--keep-handles") == 0) {
+                options.releaseHandles = false;
+            } else {
+                fprintf(stderr, "Invalid option '%s'. Only '--rate' and '--keep-handles' are supported\n", argv[i]);
+                return -1;
+            }
+        }
+
+        ExpressionClient client(argv[2]);
+        const ReplayStatistics statistics = replayWorkload(reader, client, options);
+        printReplayStatistics(stdout, statistics);
+        if (reader.isTruncated()) {
+            fprintf(stderr, "Last record of the log is cut\n");
+        }
+        return 0;
+    } catch (const std::invalid_argument& ex) {
+        fprintf(stderr, "Invalid workload log: %s\n", ex.what());
+        return -1;
+    } catch (const std::system_error& ex) {
+        fprintf(stderr, "Can't replay workload: %s\n", ex.what());
+        return -1;
+    }
+}